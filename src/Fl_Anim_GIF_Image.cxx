@@ -0,0 +1,448 @@
+//
+// Animated GIF image code for the Fast Light Tool Kit (FLTK).
+//
+// Copyright 2021 by Bill Spitzak and others.
+//
+// This library is free software. Distribution and use rights are outlined in
+// the file "COPYING" which should have been included with this file.  If this
+// file is missing or damaged, see the license at:
+//
+//     https://www.fltk.org/COPYING.php
+//
+// Please see the following page on how to report bugs and issues:
+//
+//     https://www.fltk.org/bugs.php
+//
+
+#include <FL/Fl.H>
+#include <FL/Fl_Anim_GIF_Image.H>
+#include <FL/Fl_Widget.H>
+#include "Fl_Image_Reader.h"
+#include "Fl_GIF_Decoder.h"
+
+#include <string.h>
+
+// A frame of the animation, as far as it was seen
+struct Fl_Anim_GIF_Image::Frame {
+  unsigned int offset;  // reader position of the frame's first block
+  int x, y, w, h;       // frame rectangle on the logical screen
+  int delay;            // delay in 1/100 seconds
+  int dispose;          // disposal method
+  uchar *cache;         // composed frame, or NULL
+};
+
+/**
+ \brief The constructor loads the named GIF file and shows its first frame.
+
+ The file is kept open to read the following frames while the animation
+ is played.
+
+ \param[in] filename a full path and name pointing to a valid GIF file.
+ \param[in] canvas the widget to redraw when the frame changes, or NULL
+ \param[in] start if non-zero, start() the animation
+ */
+Fl_Anim_GIF_Image::Fl_Anim_GIF_Image(const char *filename, Fl_Widget *canvas, int start) :
+  Fl_RGB_Image(NULL, 0, 0, 4)
+{
+  init_(canvas);
+  if (rdr_->open(filename) == -1) {
+    Fl::error("Fl_Anim_GIF_Image: Unable to open %s!", filename);
+    ld(ERR_FILE_ACCESS);
+  } else {
+    load_();
+  }
+  if (start) this->start();
+}
+
+/**
+ \brief The constructor loads a GIF image from memory and shows its first frame.
+
+ The data must not be freed while the image exists, because the following
+ frames are read from it while the animation is played. This code will not
+ check for buffer overruns.
+
+ \param[in] imagename a name given to this image or NULL
+ \param[in] data pointer to the start of the GIF image in memory
+ \param[in] canvas the widget to redraw when the frame changes, or NULL
+ \param[in] start if non-zero, start() the animation
+ */
+Fl_Anim_GIF_Image::Fl_Anim_GIF_Image(const char *imagename, const unsigned char *data,
+                                     Fl_Widget *canvas, int start) :
+  Fl_RGB_Image(NULL, 0, 0, 4)
+{
+  init_(canvas);
+  if (rdr_->open(imagename, data) == -1) {
+    ld(ERR_FILE_ACCESS);
+  } else {
+    load_();
+  }
+  if (start) this->start();
+}
+
+/**
+ The destructor stops the animation and frees all memory and server
+ resources that are used by the image.
+ */
+Fl_Anim_GIF_Image::~Fl_Anim_GIF_Image() {
+  stop();
+  uncache();
+  for (int i = 0; i < frame_count_; i++)
+    delete[] frames_[i].cache;
+  delete[] frames_;
+  delete[] work_;
+  delete[] prev_;
+  delete[] display_;
+  delete dec_;
+  delete rdr_;
+}
+
+// Initialize all members
+void Fl_Anim_GIF_Image::init_(Fl_Widget *canvas) {
+  rdr_ = new Fl_Image_Reader;
+  dec_ = NULL;
+  frames_ = NULL;
+  frame_count_ = frame_alloc_ = 0;
+  complete_ = 0;
+  next_offset_ = 0;
+  decoded_ = -1;
+  frame_ = 0;
+  work_ = prev_ = display_ = NULL;
+  work_frame_ = -1;
+  cache_size_ = 0;
+  cache_limit_ = 16 * 1024 * 1024;
+  speed_ = 1.0;
+  playing_ = 0;
+  loops_ = 0;
+  to_desaturate_ = 0;
+  average_color_ = FL_BLACK;
+  average_weight_ = 1.0f;
+  canvas_ = canvas;
+}
+
+// Read the header and show the first frame
+void Fl_Anim_GIF_Image::load_() {
+  dec_ = new Fl_GIF_Decoder(*rdr_);
+  if (dec_->read_header() < 0) {
+    ld(ERR_FORMAT);
+    return;
+  }
+  next_offset_ = rdr_->tell();
+  if (dec_->screen_w <= 0 || dec_->screen_h <= 0) {
+    Fl::error("Fl_Anim_GIF_Image: %s has no size.", rdr_->name());
+    ld(ERR_FORMAT);
+    return;
+  }
+  if ((size_t)dec_->screen_w * dec_->screen_h * 4 > max_size()) {
+    Fl::error("Fl_Anim_GIF_Image: %s - image is too large", rdr_->name());
+    ld(ERR_FORMAT);
+    return;
+  }
+  w(dec_->screen_w);
+  h(dec_->screen_h);
+  work_ = new uchar[(size_t)w() * h() * 4];
+  if (!show_(0)) {
+    Fl::error("Fl_Anim_GIF_Image: %s - unexpected EOF", rdr_->name());
+    w(0); h(0); ld(ERR_FORMAT);
+  }
+}
+
+// Let dec_ hold the pixels of frame n, return 0 if there is no frame n
+int Fl_Anim_GIF_Image::decode_(int n) {
+  if (decoded_ == n) return 1;
+  if (n > frame_count_ || (n == frame_count_ && complete_)) return 0;
+  rdr_->seek(n < frame_count_ ? frames_[n].offset : next_offset_);
+  decoded_ = -1;
+  if (dec_->next_frame() != 1) {
+    if (n == frame_count_) complete_ = 1;
+    return 0;
+  }
+  decoded_ = n;
+  if (n == frame_count_) {
+    if (frame_count_ >= frame_alloc_) {
+      frame_alloc_ = frame_alloc_ ? 2 * frame_alloc_ : 16;
+      Frame *frames = new Frame[frame_alloc_];
+      if (frame_count_) memcpy(frames, frames_, frame_count_ * sizeof(Frame));
+      delete[] frames_;
+      frames_ = frames;
+    }
+    Frame &f = frames_[frame_count_++];
+    f.offset = next_offset_;
+    f.x = dec_->x;
+    f.y = dec_->y;
+    f.w = dec_->w;
+    f.h = dec_->h;
+    f.delay = dec_->delay;
+    f.dispose = dec_->dispose;
+    f.cache = NULL;
+    next_offset_ = rdr_->tell();
+  }
+  return 1;
+}
+
+// Return 1 if frame n exists, reading it if it was not seen yet
+int Fl_Anim_GIF_Image::exists_(int n) {
+  return n < frame_count_ || decode_(n);
+}
+
+// Apply the disposal method of frame n to the canvas
+void Fl_Anim_GIF_Image::dispose_(int n) {
+  Frame &f = frames_[n];
+  if (f.dispose != 2 && (f.dispose != 3 || !prev_)) return;
+  int x0 = f.x, x1 = f.x + f.w, y0 = f.y, y1 = f.y + f.h;
+  if (x1 > w()) x1 = w();
+  if (y1 > h()) y1 = h();
+  if (x0 >= x1 || y0 >= y1) return;
+  for (int y = y0; y < y1; y++) {
+    size_t pos = (size_t(y) * w() + x0) * 4;
+    if (f.dispose == 2) memset(work_ + pos, 0, (x1 - x0) * 4);
+    else memcpy(work_ + pos, prev_ + pos, (x1 - x0) * 4);
+  }
+}
+
+/*
+ Compose frame n on the canvas work_, return 0 if there is no frame n.
+
+ The canvas must hold frame n-1, which is taken from the frame cache if
+ possible. Otherwise all frames are composed again from the first one.
+ Frame n is put into the cache while it is not full.
+*/
+int Fl_Anim_GIF_Image::compose_(int n) {
+  size_t size = size_t(w()) * h() * 4;
+  if (n == 0) {
+    memset(work_, 0, size);
+    work_frame_ = -1;
+  } else if (work_frame_ != n - 1) {
+    if (n - 1 < frame_count_ && frames_[n - 1].cache && frames_[n - 1].dispose != 3) {
+      memcpy(work_, frames_[n - 1].cache, size);
+      work_frame_ = n - 1;
+    } else {
+      for (int i = 0; i < n; i++)
+        if (!compose_(i)) return 0;
+    }
+  }
+  if (!decode_(n)) return 0;
+
+  Frame &f = frames_[n];
+  if (work_frame_ >= 0) dispose_(work_frame_);
+  int x0 = f.x, x1 = f.x + f.w, y0 = f.y, y1 = f.y + f.h;
+  if (x1 > w()) x1 = w();
+  if (y1 > h()) y1 = h();
+  if (f.dispose == 3 && x0 < x1 && y0 < y1) {
+    if (!prev_) prev_ = new uchar[size];
+    for (int y = y0; y < y1; y++) {
+      size_t pos = (size_t(y) * w() + x0) * 4;
+      memcpy(prev_ + pos, work_ + pos, (x1 - x0) * 4);
+    }
+  }
+
+  // draw the frame, skipping transparent pixels
+  int transparent = dec_->transparent;
+  int colors = dec_->colors;
+  for (int y = y0; y < y1; y++) {
+    const uchar *src = dec_->pixels + (size_t)(y - y0) * f.w;
+    uchar *dst = work_ + (size_t(y) * w() + x0) * 4;
+    for (int x = x0; x < x1; x++, src++, dst += 4) {
+      int c = *src;
+      if (c == transparent) continue;
+      if (c >= colors) c = 0;
+      dst[0] = dec_->red[c];
+      dst[1] = dec_->green[c];
+      dst[2] = dec_->blue[c];
+      dst[3] = 255;
+    }
+  }
+  work_frame_ = n;
+
+  if (!f.cache && cache_size_ + size <= cache_limit_) {
+    f.cache = new uchar[size];
+    memcpy(f.cache, work_, size);
+    cache_size_ += size;
+  }
+  return 1;
+}
+
+// Show frame n, return 0 if there is no frame n
+int Fl_Anim_GIF_Image::show_(int n) {
+  const uchar *src;
+  if (n < frame_count_ && frames_[n].cache) {
+    src = frames_[n].cache;
+  } else {
+    if (work_frame_ != n && !compose_(n)) return 0;
+    src = work_;
+  }
+  frame_ = n;
+
+  if (to_desaturate_ || average_weight_ < 1.0f) {
+    size_t count = (size_t)w() * h();
+    if (!display_) display_ = new uchar[count * 4];
+    uchar r, g, b;
+    Fl::get_color(average_color_, r, g, b);
+    unsigned ia = (unsigned)(256 * average_weight_);
+    if (to_desaturate_) r = g = b = (uchar)((r * 31 + g * 61 + b * 8) / 100);
+    unsigned ir = r * (256 - ia), ig = g * (256 - ia), ib = b * (256 - ia);
+    uchar *dst = display_;
+    for (size_t i = 0; i < count; i++, src += 4, dst += 4) {
+      uchar sr = src[0], sg = src[1], sb = src[2];
+      if (to_desaturate_) sr = sg = sb = (uchar)((31 * sr + 61 * sg + 8 * sb) / 100);
+      dst[0] = (uchar)((sr * ia + ir) >> 8);
+      dst[1] = (uchar)((sg * ia + ig) >> 8);
+      dst[2] = (uchar)((sb * ia + ib) >> 8);
+      dst[3] = src[3];
+    }
+    src = display_;
+  }
+
+  uncache();
+  array = src;
+  data((const char * const *)&array, 1);
+  if (canvas_) canvas_->redraw();
+  return 1;
+}
+
+// Timer callback: show the next frame, or stop after the last loop
+void Fl_Anim_GIF_Image::animate_(void *data) {
+  Fl_Anim_GIF_Image *self = (Fl_Anim_GIF_Image *)data;
+  int n = self->frame_ + 1;
+  if (!self->exists_(n)) {
+    int loop_count = self->dec_->loop_count;
+    self->loops_++;
+    if (self->frame_count_ < 2 || loop_count < 0 ||
+        (loop_count > 0 && self->loops_ > loop_count)) {
+      self->playing_ = 0;
+      return;
+    }
+    n = 0;
+  }
+  self->show_(n);
+  Fl::repeat_timeout(self->delay() / self->speed_, animate_, data);
+}
+
+/**
+ Sets the widget that is redrawn when the frame changes.
+
+ This is usually the widget that shows the image as its label image.
+ The widget must exist while the animation is playing.
+ */
+void Fl_Anim_GIF_Image::canvas(Fl_Widget *widget) {
+  canvas_ = widget;
+}
+
+/**
+ Returns the number of frames of the animation.
+
+ Frames are read while the animation is played, so the number of frames
+ is only known after the last frame was shown once. Before, this is the
+ number of frames read so far.
+ */
+int Fl_Anim_GIF_Image::frames() const {
+  return frame_count_;
+}
+
+/**
+ Shows frame \p n, starting with 0.
+
+ Frames that were not read yet are read up to frame \p n. Nothing is
+ changed if there is no frame \p n.
+ */
+void Fl_Anim_GIF_Image::frame(int n) {
+  if (fail() || n < 0 || n == frame_) return;
+  show_(n);
+}
+
+/**
+ Shows the frame following the frame shown, or the first frame after the
+ last one.
+
+ \return the index of the frame shown
+ */
+int Fl_Anim_GIF_Image::next() {
+  if (fail()) return frame_;
+  int n = frame_ + 1;
+  if (!exists_(n)) n = 0;
+  if (n != frame_) show_(n);
+  return frame_;
+}
+
+/**
+ Returns the delay of the frame shown in seconds.
+
+ Frames without a delay, or with a delay of less than 0.02 seconds, are
+ shown for 0.1 seconds, like web browsers do.
+ */
+double Fl_Anim_GIF_Image::delay() const {
+  if (frame_ >= frame_count_ || frames_[frame_].delay < 2) return 0.1;
+  return frames_[frame_].delay / 100.0;
+}
+
+/**
+ Starts playing the animation from the frame shown.
+
+ The animation is played as often as the GIF's loop count says, or once
+ if the GIF doesn't have one. Images with only one frame are not played.
+ */
+void Fl_Anim_GIF_Image::start() {
+  if (playing_ || fail() || (complete_ && frame_count_ < 2)) return;
+  playing_ = 1;
+  loops_ = 0;
+  Fl::add_timeout(delay() / speed_, animate_, this);
+}
+
+/**
+ Stops playing the animation, the frame shown remains.
+ */
+void Fl_Anim_GIF_Image::stop() {
+  if (!playing_) return;
+  Fl::remove_timeout(animate_, this);
+  playing_ = 0;
+}
+
+/**
+ Sets the playback speed factor.
+
+ A factor of 2 plays the animation twice as fast as the GIF's frame delays
+ say. The new speed is used from the next frame on.
+ */
+void Fl_Anim_GIF_Image::speed(double factor) {
+  if (factor > 0) speed_ = factor;
+}
+
+/**
+ Sets the maximum size of the frame cache in bytes.
+
+ Each composed frame takes w() * h() * 4 bytes. Frames are cached in the
+ order they are composed until the cache is full, so that the first frames
+ of a long animation are cached. The default size is 16 MB. A size of 0
+ disables the cache, then all frames are decoded again in every loop.
+ */
+void Fl_Anim_GIF_Image::frame_cache(size_t bytes) {
+  cache_limit_ = bytes;
+  size_t size = size_t(w()) * h() * 4;
+  for (int i = frame_count_ - 1; i >= 0 && cache_size_ > cache_limit_; i--) {
+    Frame &f = frames_[i];
+    if (!f.cache || f.cache == array) continue;
+    delete[] f.cache;
+    f.cache = NULL;
+    cache_size_ -= size;
+  }
+}
+
+/**
+ Converts all frames to gray, keeping the depth of 4.
+ */
+void Fl_Anim_GIF_Image::desaturate() {
+  if (fail()) return;
+  to_desaturate_ = 1;
+  show_(frame_);
+}
+
+/**
+ Blends all frames with color \p c, see Fl_RGB_Image::color_average().
+ */
+void Fl_Anim_GIF_Image::color_average(Fl_Color c, float i) {
+  if (fail()) return;
+  if (i < 0.0f) i = 0.0f;
+  else if (i > 1.0f) i = 1.0f;
+  average_color_ = c;
+  average_weight_ = i;
+  show_(frame_);
+}
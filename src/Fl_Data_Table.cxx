@@ -0,0 +1,115 @@
+//
+// Table of distinct data blocks for the Fast Light Tool Kit (FLTK).
+//
+// Copyright 2021 by Bill Spitzak and others.
+//
+// This library is free software. Distribution and use rights are outlined in
+// the file "COPYING" which should have been included with this file.  If this
+// file is missing or damaged, see the license at:
+//
+//     https://www.fltk.org/COPYING.php
+//
+// Please see the following page on how to report bugs and issues:
+//
+//     https://www.fltk.org/bugs.php
+//
+
+#include "Fl_Data_Table.H"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Hash the rows 4 bytes at a time, and the last bytes of each row one by one,
+// with FNV-1a and a variant of djb2.
+Fl_Data_Table::Key::Key(const unsigned char *data, size_t row_length, int rows, size_t ld) {
+  data_ = data;
+  row_length_ = row_length;
+  rows_ = rows;
+  ld_ = ld ? ld : row_length;
+  unsigned h1 = 2166136261U, h2 = 5381;
+  for (int j = 0; j < rows; j++) {
+    const unsigned char *p = data + j * ld_, *e = p + row_length;
+    for (; p + 4 <= e; p += 4) {
+      unsigned v = p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned)p[3] << 24);
+      h1 = (h1 ^ v) * 16777619U;
+      h2 = h2 * 33 + (v ^ (v >> 15));
+    }
+    for (; p < e; p++) {
+      h1 = (h1 ^ *p) * 16777619U;
+      h2 = h2 * 33 + *p;
+    }
+  }
+  hash1_ = h1;
+  hash2_ = h2;
+}
+
+Fl_Data_Table::Fl_Data_Table() {
+  blocks_ = NULL;
+  count_ = alloc_ = 0;
+  bucket_ = NULL;
+  bucket_count_ = 0;
+}
+
+Fl_Data_Table::~Fl_Data_Table() {
+  clear();
+  free(blocks_);
+  delete[] bucket_;
+}
+
+void Fl_Data_Table::rehash() {
+  bucket_count_ = bucket_count_ ? 2 * bucket_count_ : 64;
+  delete[] bucket_;
+  bucket_ = new int[bucket_count_];
+  int mask = bucket_count_ - 1, i;
+  for (i = 0; i < bucket_count_; i++) bucket_[i] = -1;
+  for (i = 0; i < count_; i++) {
+    int b = blocks_[i].hash1 & mask;
+    blocks_[i].next = bucket_[b];
+    bucket_[b] = i;
+  }
+}
+
+int Fl_Data_Table::equal(const Block &b, const Key &key) const {
+  if (b.hash1 != key.hash1_ || b.hash2 != key.hash2_ || b.length != key.length())
+    return 0;
+  const unsigned char *p = b.data;
+  for (int j = 0; j < key.rows_; j++, p += key.row_length_) {
+    if (memcmp(p, key.data_ + j * key.ld_, key.row_length_)) return 0;
+  }
+  return 1;
+}
+
+int Fl_Data_Table::find(const Key &key, int after) const {
+  if (!bucket_count_) return -1;
+  int i = after >= 0 ? blocks_[after].next : bucket_[key.hash1_ & (bucket_count_ - 1)];
+  for (; i >= 0; i = blocks_[i].next) {
+    if (equal(blocks_[i], key)) return i;
+  }
+  return -1;
+}
+
+int Fl_Data_Table::add(const Key &key) {
+  if (count_ >= alloc_) {
+    alloc_ = alloc_ ? 2 * alloc_ : 16;
+    blocks_ = (Block*)realloc(blocks_, alloc_ * sizeof(Block));
+  }
+  if (count_ >= bucket_count_) rehash();
+  int n = count_++;
+  Block &b = blocks_[n];
+  b.hash1 = key.hash1_;
+  b.hash2 = key.hash2_;
+  b.length = key.length();
+  b.data = (unsigned char*)malloc(b.length ? b.length : 1);
+  for (int j = 0; j < key.rows_; j++)
+    memcpy(b.data + j * key.row_length_, key.data_ + j * key.ld_, key.row_length_);
+  int h = b.hash1 & (bucket_count_ - 1);
+  b.next = bucket_[h];
+  bucket_[h] = n;
+  return n;
+}
+
+void Fl_Data_Table::clear() {
+  for (int i = 0; i < count_; i++) free(blocks_[i].data);
+  count_ = 0;
+  for (int i = 0; i < bucket_count_; i++) bucket_[i] = -1;
+}
@@ -22,6 +22,8 @@
 //   Fl_File_Browser::item_draw()       - Draw a list item.
 //   Fl_File_Browser::Fl_File_Browser() - Create a Fl_File_Browser widget.
 //   Fl_File_Browser::load()            - Load a directory into the browser.
+//   Fl_File_Browser::load_async()      - Load a directory in the background.
+//   Fl_File_Browser::cancel_load()     - Stop loading a directory.
 //   Fl_File_Browser::filter()          - Set the filename filter.
 //
 
@@ -64,6 +66,56 @@ struct FL_BLINE                 // data is in a linked list of these
 };
 
 
+//
+// Background loading (see Fl_File_Browser::load_async())...
+//
+//    A worker thread lists the directory and then finds the file type of
+//    each file, which may need a stat() call per file. The main thread adds
+//    the files whose type is known to the browser in load_done(), a few
+//    thousand at a time. Jobs are only created and deleted by the main
+//    thread; canceled jobs are deleted when their worker has finished.
+//    The fields marked (*) are protected by load_mutex.
+//
+
+#define FILE_CHUNK      256             // Files typed by the worker per lock
+#define ADD_CHUNK       4096            // Files added per load_done() call
+
+struct Fl_File_Browser_Job {
+  Fl_File_Browser       *browser;       // Browser to load, 0 if canceled (*)
+  char                  *directory;     // Directory name (copy)
+  Fl_File_Sort_F        *sort;          // Sort function
+  Fl_File_Browser_Loaded cb;            // Callback or 0
+  void                  *data;          // User data for cb
+  dirent                **files;        // Files in directory (*)
+  int                   *types;         // File types, see Fl_File_Icon (*)
+  int                   num_files;      // Number of files, -1 on error (*)
+  int                   listed;         // Directory was listed? (*)
+  int                   typed;          // Number of files with known type (*)
+  int                   running;        // Worker thread is running? (*)
+  int                   added;          // Number of files added to browser
+  int                   num_dirs;       // Number of directories in browser
+  int                   pass;           // Last load_done() call that added files
+  char                  errmsg[1024];   // OS error message (*)
+  Fl_File_Browser_Job   *next;          // Next job in list
+};
+
+static Fl_File_Browser_Job *load_jobs = 0;      // All jobs
+static int awake_sent = 0;                      // load_done() requested via Fl::awake()?
+static int load_pass = 0;                       // Number of load_done() calls
+static void *load_mutex = 0;                    // See Fl_System_Driver::mutex_lock()
+
+static void free_job(Fl_File_Browser_Job *job) {
+  if (job->files) {
+    for (int i = job->added; i < job->num_files; i ++)
+      free(job->files[i]);
+    free(job->files);
+  }
+  free(job->types);
+  free(job->directory);
+  delete job;
+}
+
+
 //
 // 'Fl_File_Browser::full_height()' - Return the height of the list.
 //
@@ -372,11 +424,13 @@ Fl_File_Browser::Fl_File_Browser(int        X,  // I - Upper-lefthand X coordina
   iconsize_  = (uchar)(3 * textsize() / 2);
   filetype_  = FILES;
   errmsg_    = NULL;
+  job_       = NULL;
 }
 
 
 // DTOR
 Fl_File_Browser::~Fl_File_Browser() {
+  cancel_load();
   errmsg(NULL);       // free()s prev errmsg, if any
 }
 
@@ -415,6 +469,7 @@ Fl_File_Browser::load(const char     *directory,// I - Directory to load
   char          filename[4096];                 // Current file
   Fl_File_Icon  *icon;                          // Icon to use
 
+  cancel_load();
   errmsg(NULL); // clear errors first
 
 //  printf("Fl_File_Browser::load(\"%s\")\n", directory);
@@ -477,6 +532,297 @@ Fl_File_Browser::load(const char     *directory,// I - Directory to load
 }
 
 
+/**
+  Loads the specified directory into the browser in the background.
+
+  This works like load(), but the directory is read by a worker thread,
+  so that the user interface stays responsive while large or slow (e.g.
+  network) directories are listed. The browser is cleared right away, and
+  the files are added in sorted order, in chunks, while the worker finds
+  their types. Loading a directory with load() or load_async() or
+  deleting the browser cancels the previous load_async().
+
+  If the callback \p cb is not NULL, it is called in the main thread after
+  each chunk of files was added with \p done = 0, and once with
+  \p done = 1 when the directory has been loaded completely. Then size()
+  is the number of entries in the browser, and errmsg() has the OS error
+  message if the directory could not be read.
+
+  The list of mount points or drive letters (\p directory = "") is loaded
+  immediately, like load() does. This also happens if the platform does
+  not support threads. \p cb is then called with \p done = 1 before
+  load_async() returns.
+
+  Files are only added while the program runs the FLTK event loop. If the
+  program called Fl::lock(), the worker thread wakes up the event loop
+  with Fl::awake(), otherwise the browser is checked for new files every
+  0.1 seconds.
+
+  \param[in] directory  directory to load, is not copied by the browser
+  \param[in] sort       sort function, see fl_filename_list()
+  \param[in] cb         function to call when files were added, or 0
+  \param[in] data       user data for \p cb
+
+  \return 1 if loading was started, otherwise the return value of load()
+
+  \see cancel_load(), loading()
+  \since 1.4.0
+*/
+int
+Fl_File_Browser::load_async(const char     *directory,
+                            Fl_File_Sort_F *sort,
+                            Fl_File_Browser_Loaded cb,
+                            void           *data)
+{
+  cancel_load();
+
+  if (!directory || !directory[0]) {
+    int num_files = load(directory, sort);
+    if (cb) (cb)(this, 1, data);
+    return num_files;
+  }
+
+  errmsg(NULL);
+  clear();
+  directory_ = directory;
+
+  Fl_File_Browser_Job *job = new Fl_File_Browser_Job;
+  job->browser   = this;
+  job->directory = fl_strdup(directory);
+  job->sort      = sort;
+  job->cb        = cb;
+  job->data      = data;
+  job->files     = 0;
+  job->types     = 0;
+  job->num_files = 0;
+  job->listed    = 0;
+  job->typed     = 0;
+  job->added     = 0;
+  job->num_dirs  = 0;
+  job->pass      = 0;
+  job->errmsg[0] = '\0';
+
+  // This also creates the lock before the worker thread uses it
+  Fl::system_driver()->mutex_lock(&load_mutex);
+  job->running   = 1;
+  Fl::system_driver()->mutex_unlock(load_mutex);
+
+  if (Fl::system_driver()->create_thread(load_thread, job) < 0) {
+    // No threads; load the directory now
+    free(job->directory);
+    delete job;
+    int num_files = load(directory, sort);
+    if (cb) (cb)(this, 1, data);
+    return num_files;
+  }
+
+  job->next = load_jobs;
+  load_jobs = job;
+  job_ = job;
+
+  if (!Fl::has_timeout(load_done, 0)) Fl::add_timeout(0.1, load_done, 0);
+
+  return 1;
+}
+
+
+/**
+  Stops loading a directory with load_async().
+
+  The files that were added to the browser so far remain in the browser.
+  The callback of load_async() is not called anymore.
+  \since 1.4.0
+*/
+void
+Fl_File_Browser::cancel_load()
+{
+  if (!job_) return;
+
+  Fl::system_driver()->mutex_lock(&load_mutex);
+  job_->browser = 0;
+  Fl::system_driver()->mutex_unlock(load_mutex);
+  job_ = 0;
+}
+
+
+//
+// 'Fl_File_Browser::load_thread()' - List a directory in a worker thread.
+//
+
+void
+Fl_File_Browser::load_thread(void *data)
+{
+  Fl_File_Browser_Job   *job = (Fl_File_Browser_Job *)data;
+  char                  filename[4096];         // Current file
+  char                  emsg[1024] = "";        // OS error message
+  dirent                **files = 0;            // Files in directory
+  int                   *types = 0;             // File types
+  int                   i, n, num_files;        // Looping vars
+  int                   canceled, send_awake;
+
+  num_files = Fl::system_driver()->file_browser_load_directory(job->directory,
+                                                               filename, sizeof(filename),
+                                                               &files, job->sort,
+                                                               emsg, sizeof(emsg));
+  if (num_files > 0) types = (int *)malloc(num_files * sizeof(int));
+
+  Fl::system_driver()->mutex_lock(&load_mutex);
+  job->files     = num_files > 0 ? files : 0;
+  job->types     = types;
+  job->num_files = num_files;
+  job->listed    = 1;
+  strlcpy(job->errmsg, emsg, sizeof(job->errmsg));
+  canceled = !job->browser;
+  Fl::system_driver()->mutex_unlock(load_mutex);
+
+  // Find the type of each file, the same way Fl_File_Icon::find() does
+  for (i = 0; i < num_files && !canceled; i = n) {
+    n = i + FILE_CHUNK < num_files ? i + FILE_CHUNK : num_files;
+    for (int j = i; j < n; j ++) {
+      fl_snprintf(filename, sizeof(filename), "%s/%s", job->directory, files[j]->d_name);
+      types[j] = Fl::system_driver()->file_type(filename);
+    }
+
+    Fl::system_driver()->mutex_lock(&load_mutex);
+    job->typed = n;
+    canceled = !job->browser;
+    send_awake = !awake_sent && !canceled;
+    if (send_awake) awake_sent = 1;
+    Fl::system_driver()->mutex_unlock(load_mutex);
+
+    // Wake up the main thread (works if the program called Fl::lock())
+    if (send_awake) Fl::awake(load_done, 0);
+  }
+
+  Fl::system_driver()->mutex_lock(&load_mutex);
+  job->running = 0;
+  send_awake = !awake_sent;
+  awake_sent = 1;
+  Fl::system_driver()->mutex_unlock(load_mutex);
+
+  if (send_awake) Fl::awake(load_done, 0);
+}
+
+
+//
+// 'Fl_File_Browser::add_files()' - Add typed files of a job to the browser.
+//
+// Adds the files up to (excluding) index n, returns the number of files added.
+//
+
+int
+Fl_File_Browser::add_files(Fl_File_Browser_Job *job,
+                           int                 n)
+{
+  char          filename[4096];                 // Current file
+  Fl_File_Icon  *icon;                          // Icon to use
+  int           i;
+
+  for (i = job->added; i < n; i ++) {
+    const char *name = job->files[i]->d_name;
+    if (strcmp(name, "./")) {
+      fl_snprintf(filename, sizeof(filename), "%s/%s", job->directory, name);
+
+      icon = Fl_File_Icon::find(filename, job->types[i]);
+      if ((icon && icon->type() == Fl_File_Icon::DIRECTORY) ||
+          Fl::system_driver()->filename_isdir_quick(filename)) {
+        job->num_dirs ++;
+        insert(job->num_dirs, name, icon);
+      } else if (filetype_ == FILES &&
+                 fl_filename_match(name, pattern_)) {
+        add(name, icon);
+      }
+    }
+
+    free(job->files[i]);
+  }
+
+  n -= job->added;
+  job->added += n;
+  return n;
+}
+
+
+//
+// 'Fl_File_Browser::load_done()' - Add loaded files to their browsers.
+//
+// Runs in the main thread, called via Fl::awake() and from a timeout that
+// runs until all jobs are done. The callbacks may run the event loop, start
+// or cancel loads, or delete browsers, which can free any job. The list is
+// therefore searched again from its head after each callback, skipping the
+// jobs that were already done in this call.
+//
+
+void
+Fl_File_Browser::load_done(void *)
+{
+  Fl_File_Browser_Job   *job, **prev;           // Current job
+  int                   more = 0;               // More files ready to add?
+  int                   pass = ++load_pass;     // This call
+
+  Fl::remove_timeout(load_done, 0);
+
+  Fl::system_driver()->mutex_lock(&load_mutex);
+  awake_sent = 0;
+  Fl::system_driver()->mutex_unlock(load_mutex);
+
+  for (prev = &load_jobs; (job = *prev) != NULL;) {
+    if (job->pass == pass) {
+      // Already done before a callback
+      prev = &job->next;
+      continue;
+    }
+    job->pass = pass;
+
+    Fl::system_driver()->mutex_lock(&load_mutex);
+    int running = job->running;
+    int typed = job->listed ? job->typed : 0;
+    Fl::system_driver()->mutex_unlock(load_mutex);
+
+    Fl_File_Browser *browser = job->browser;    // only changed by the main thread
+    if (!browser) {
+      // Canceled; delete the job when its worker is done
+      if (running) {
+        prev = &job->next;
+      } else {
+        *prev = job->next;
+        free_job(job);
+      }
+      continue;
+    }
+
+    int added = browser->add_files(job, typed < job->added + ADD_CHUNK ?
+                                        typed : job->added + ADD_CHUNK);
+
+    if (!running && job->added >= job->num_files) {
+      // All files were added (or the directory could not be read)
+      *prev = job->next;
+      browser->job_ = 0;
+      if (job->num_files <= 0) browser->errmsg(job->errmsg);
+      Fl_File_Browser_Loaded cb = job->cb;
+      void *data = job->data;
+      free_job(job);
+      if (cb) {
+        (cb)(browser, 1, data);
+        prev = &load_jobs;
+      }
+      continue;
+    }
+
+    if (job->added < typed) more = 1;
+    prev = &job->next;
+    if (added && job->cb) {
+      (job->cb)(browser, 0, job->data);
+      prev = &load_jobs;
+    }
+  }
+
+  // Keep checking for new files until all jobs are done
+  Fl::remove_timeout(load_done, 0);
+  if (load_jobs) Fl::add_timeout(more ? 0.0 : 0.1, load_done, 0);
+}
+
+
 //
 // 'Fl_File_Browser::filter()' - Set the filename filter.
 //
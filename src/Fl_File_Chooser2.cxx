@@ -327,6 +327,7 @@
 //   Fl_File_Chooser::newdir()            - Make a new directory.
 //   Fl_File_Chooser::value()             - Return a selected filename.
 //   Fl_File_Chooser::rescan()            - Rescan the current directory.
+//   Fl_File_Chooser::loadedCB()          - Handle files added to the Fl_File_Browser.
 //   Fl_File_Chooser::favoritesButtonCB() - Handle favorites selections.
 //   Fl_File_Chooser::fileListCB()        - Handle clicks (and double-clicks)
 //                                          in the Fl_File_Browser.
@@ -1093,18 +1094,9 @@ Fl_File_Chooser::rescan()
   else
     okButton->deactivate();
 
-  // Build the file list...
-  if ( fileList->load(directory_, sort) <= 0 ) {
-    if ( fileList->errmsg() ) errorBox->label(fileList->errmsg());     // show OS errormsg when possible
-    else                      errorBox->label("No files found...");
-    show_error_box(1);
-  } else {
-    show_error_box(0);
-  }
-
-  if (Fl::system_driver()->dot_file_hidden() && !showHiddenButton->value()) remove_hidden_files();
-  // Update the preview box...
-  update_preview();
+  // Build the file list in the background, see loadedCB()...
+  show_error_box(0);
+  fileList->load_async(directory_, sort, loadedCB, this);
 }
 
 /**
@@ -1120,42 +1112,67 @@ void Fl_File_Chooser::rescan_keep_filename()
     return;
   }
 
-  int   i;
-  char  pathname[FL_PATH_MAX];          // New pathname for filename field
-  strlcpy(pathname, fn, sizeof(pathname));
+  // Build the file list in the background; loadedCB() selects the file...
+  show_error_box(0);
+  fileList->load_async(directory_, sort, loadedCB, this);
+}
 
-  // Build the file list...
-  if (fileList->load(directory_, sort) <= 0) {
-    if ( fileList->errmsg() ) errorBox->label(fileList->errmsg());     // show OS errormsg when possible
-    else                      errorBox->label("No files found...");
-    show_error_box(1);
-  } else {
-    show_error_box(0);
+//
+// 'Fl_File_Chooser::loadedCB()' - Handle files added by Fl_File_Browser::load_async().
+//
+// Removes hidden files as they are added. When the directory has been
+// loaded, shows the error box if there are no files, updates the preview,
+// and selects the file in the filename field, if any.
+//
+
+void
+Fl_File_Chooser::loadedCB(Fl_File_Browser *b,   // I - File browser
+                          int             done, // I - All files added?
+                          void            *d)   // I - File chooser
+{
+  Fl_File_Chooser *fc = (Fl_File_Chooser *)d;
+
+  if (Fl::system_driver()->dot_file_hidden() && !fc->showHiddenButton->value()) {
+    int top = b->topline();
+    fc->remove_hidden_files();
+    b->topline(top);
+  }
+
+  if (!done) return;
+
+  if (b->size() <= 0) {
+    if ( b->errmsg() ) fc->errorBox->label(b->errmsg());     // show OS errormsg when possible
+    else               fc->errorBox->label("No files found...");
+    fc->show_error_box(1);
   }
-  if (Fl::system_driver()->dot_file_hidden() && !showHiddenButton->value()) remove_hidden_files();
+
   // Update the preview box...
-  update_preview();
+  fc->update_preview();
 
   // and select the chosen file
-  char found = 0;
-  char *slash = strrchr(pathname, '/');
+  const char *fn = fc->fileName->value();
+  if (!fn || !*fn || fn[strlen(fn) - 1] == '/') return;
+
+  int   i;
+  char  found = 0;
+  const char *slash = strrchr(fn, '/');
   if (slash)
     slash++;
   else
-    slash = pathname;
-  for (i = 1; i <= fileList->size(); i ++)
-    if ( (Fl::system_driver()->case_insensitive_filenames() ? strcasecmp(fileList->text(i), slash) : strcmp(fileList->text(i), slash)) == 0) {
-      fileList->topline(i);
-      fileList->select(i);
+    slash = fn;
+  for (i = 1; i <= b->size(); i ++)
+    if ( (Fl::system_driver()->case_insensitive_filenames() ? strcasecmp(b->text(i), slash) : strcmp(b->text(i), slash)) == 0) {
+      b->topline(i);
+      b->select(i);
       found = 1;
       break;
     }
 
   // update OK button activity
-  if (found || type_ & CREATE)
-    okButton->activate();
+  if (found || fc->type_ & CREATE)
+    fc->okButton->activate();
   else
-    okButton->deactivate();
+    fc->okButton->deactivate();
 }
 
 
@@ -1557,7 +1574,7 @@ void Fl_File_Chooser::show()
 void Fl_File_Chooser::showHidden(int value)
 {
   if (value) {
-    fileList->load(directory());
+    fileList->load_async(directory(), fl_numericsort, loadedCB, this);
   } else {
     remove_hidden_files();
     fileList->redraw();
@@ -32,6 +32,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <ctype.h>
 #include <FL/fl_utf8.h>
 #include "flstring.h"
 #include <FL/Fl.H>
@@ -48,6 +49,174 @@
 Fl_File_Icon    *Fl_File_Icon::first_ = (Fl_File_Icon *)0;
 
 
+//
+// Pattern index for Fl_File_Icon::find()...
+//
+//    find() returns the first icon in the list whose type and pattern match
+//    the file. Instead of matching every pattern, the patterns are sorted
+//    into classes when the index is built:
+//
+//    - "*.ext", "*.{ext1|ext2}" and "{*.ext1|*.ext2}": a hash table that maps
+//      extensions to icons, searched with each extension of the file name
+//    - literal names like "core": a hash table that maps names to icons,
+//      searched with the base name of the file
+//    - all other patterns, including "*": a list that is searched in order
+//
+//    Each icon keeps its position in the list (rank), so that find() can
+//    pick the first match over all classes. The index is rebuilt by the
+//    next find() call after an icon was created or destroyed.
+//
+
+struct Fl_File_Icon_Key {       // Extension or name of an icon pattern
+  const char    *key;           // Key text (points into the pattern)
+  int           len;            // Key length
+  int           rank;           // Position of icon in the list
+  Fl_File_Icon  *icon;          // Icon
+  int           next;           // Next key in hash chain, -1 if none
+};
+
+static Fl_File_Icon_Key *icon_keys = 0;         // Extension and name keys
+static int      num_keys = 0, alloc_keys = 0;
+static int      *ext_buckets = 0,               // Extension hash table
+                *name_buckets = 0;              // Name hash table
+static int      num_buckets = 0;                // Size of hash tables (power of 2)
+static Fl_File_Icon **other_icons = 0;          // Icons with other patterns
+static int      *other_ranks = 0;
+static int      num_other = 0, alloc_other = 0;
+static int      index_valid = 0;                // Index matches the icon list?
+
+// Characters that have a special meaning in fl_filename_match() patterns,
+// or separate the base name of a file (see fl_filename_name())
+static int is_special(char c) {
+  return strchr("?*[]{}|,\\/:", c) != NULL;
+}
+
+// Case-insensitive hash of a key, like fl_filename_match() compares
+static unsigned int hash_key(const char *s, int len) {
+  unsigned int h = 2166136261U;
+  for (int i = 0; i < len; i ++)
+    h = (h ^ (unsigned char)tolower(s[i])) * 16777619U;
+  return h;
+}
+
+// Add an extension (ext) or name key to the index
+static void add_key(int ext, const char *key, int len, int rank, Fl_File_Icon *icon) {
+  if (num_keys >= alloc_keys) {
+    alloc_keys = alloc_keys ? 2 * alloc_keys : 64;
+    icon_keys = (Fl_File_Icon_Key *)realloc(icon_keys, alloc_keys * sizeof(Fl_File_Icon_Key));
+  }
+  Fl_File_Icon_Key *k = icon_keys + num_keys;
+  k->key  = key;
+  k->len  = len;
+  k->rank = rank;
+  k->icon = icon;
+  k->next = -1;
+  // Keep the chains in rank order, icons are added in rank order
+  int *slot = (ext ? ext_buckets : name_buckets) + (hash_key(key, len) & (num_buckets - 1));
+  while (*slot >= 0) slot = &icon_keys[*slot].next;
+  *slot = num_keys ++;
+}
+
+// Check if p[0..len-1] is "*.ext" or a literal name, and return the
+// class (1 = extension, 2 = name, 0 = other) and the key
+static int key_class(const char *p, int len, const char **key, int *keylen) {
+  int i;
+  int ext = (len >= 2 && p[0] == '*' && p[1] == '.');
+  for (i = ext ? 2 : 0; i < len; i ++)
+    if (is_special(p[i])) return 0;
+  if (!ext && !len) return 0;
+  *key    = ext ? p + 2 : p;
+  *keylen = ext ? len - 2 : len;
+  return ext ? 1 : 2;
+}
+
+// Sort the pattern of an icon into the index, return 0 if it needs to be
+// matched with fl_filename_match()
+static int index_pattern(const char *p, int rank, Fl_File_Icon *icon) {
+  const char *key;
+  int keylen, cls, n = (int)strlen(p);
+  int pre = 0;                  // Prefix of alternatives: "{" or "*.{"
+
+  if (n >= 2 && p[0] == '{' && p[n-1] == '}') pre = 1;
+  else if (n >= 4 && !strncmp(p, "*.{", 3) && p[n-1] == '}') pre = 3;
+
+  if (!pre) {
+    cls = key_class(p, n, &key, &keylen);
+    if (cls) add_key(cls == 1, key, keylen, rank, icon);
+    return cls != 0;
+  }
+
+  // Check all alternatives first; they are separated by '|' or ','
+  const char *alt, *end;
+  for (int pass = 0; pass < 2; pass ++) {
+    for (alt = p + pre;; alt = end + 1) {
+      for (end = alt; *end != '|' && *end != ',' && end < p + n - 1; end ++) {/*empty*/}
+      if (pre == 3) {
+        for (key = alt; key < end; key ++)
+          if (is_special(*key)) return 0;
+        if (pass) add_key(1, alt, (int)(end - alt), rank, icon);
+      } else {
+        cls = key_class(alt, (int)(end - alt), &key, &keylen);
+        if (!cls) return 0;
+        if (pass) add_key(cls == 1, key, keylen, rank, icon);
+      }
+      if (end >= p + n - 1) break;
+    }
+  }
+  return 1;
+}
+
+// Rebuild the pattern index from the icon list
+static void build_index(Fl_File_Icon *first) {
+  Fl_File_Icon *icon;
+  int rank, n = 0;
+
+  for (icon = first; icon; icon = icon->next()) n ++;
+
+  free(ext_buckets);
+  num_buckets = 64;
+  while (num_buckets < 2 * n) num_buckets *= 2;
+  ext_buckets  = (int *)malloc(2 * num_buckets * sizeof(int));
+  name_buckets = ext_buckets + num_buckets;
+  memset(ext_buckets, -1, 2 * num_buckets * sizeof(int));
+  num_keys  = 0;
+  num_other = 0;
+
+  for (icon = first, rank = 0; icon; icon = icon->next(), rank ++) {
+    if (icon->pattern() && index_pattern(icon->pattern(), rank, icon)) continue;
+    if (num_other >= alloc_other) {
+      alloc_other = alloc_other ? 2 * alloc_other : 32;
+      other_icons = (Fl_File_Icon **)realloc(other_icons, alloc_other * sizeof(Fl_File_Icon *));
+      other_ranks = (int *)realloc(other_ranks, alloc_other * sizeof(int));
+    }
+    other_icons[num_other] = icon;
+    other_ranks[num_other] = rank;
+    num_other ++;
+  }
+
+  index_valid = 1;
+}
+
+// Find the first icon in a hash chain that has the key s[0..len-1], a
+// rank below best and a matching type
+static int find_key(int slot, const char *s, int len, int filetype, int best, Fl_File_Icon **found) {
+  for (; slot >= 0; slot = icon_keys[slot].next) {
+    Fl_File_Icon_Key *k = icon_keys + slot;
+    if (k->rank >= best) break;
+    if (k->len != len) continue;
+    int t = k->icon->type();
+    if (t != filetype && t != Fl_File_Icon::ANY) continue;
+    int i;
+    for (i = 0; i < len; i ++)
+      if (tolower(s[i]) != tolower(k->key[i])) break;
+    if (i < len) continue;
+    *found = k->icon;
+    return k->rank;
+  }
+  return best;
+}
+
+
 // Registers the FL_ICON_LABEL drawing function
 Fl_Labeltype fl_define_FL_ICON_LABEL() {
   Fl::set_labeltype(_FL_ICON_LABEL, Fl_File_Icon::labeltype, 0);
@@ -88,6 +257,7 @@ Fl_File_Icon::Fl_File_Icon(const char *p,       /* I - Filename pattern */
   // And add the icon to the list of icons...
   next_  = first_;
   first_ = this;
+  index_valid = 0;
 }
 
 
@@ -112,6 +282,7 @@ Fl_File_Icon::~Fl_File_Icon() {
       prev->next_ = current->next_;
     else
       first_ = current->next_;
+    index_valid = 0;
   }
 
   // Free any memory used...
@@ -164,8 +335,11 @@ Fl_File_Icon *                          // O - Matching file icon or NULL
 Fl_File_Icon::find(const char *filename,// I - Name of file */
                    int        filetype) // I - Enumerated file type
 {
-  Fl_File_Icon  *current;               // Current file in list
+  Fl_File_Icon  *current = 0;           // Current match
   const char    *name;                  // Base name of filename
+  const char    *ext;                   // Extension in name
+  int           best = 0x7fffffff;      // Rank of current match
+  int           i, len;
 
 
   // Get file information if needed...
@@ -173,16 +347,32 @@ Fl_File_Icon::find(const char *filename,// I - Name of file */
     filetype = Fl::system_driver()->file_type(filename);
   }
 
+  if (!index_valid) build_index(first_);
+
   // Look at the base name in the filename
   name = fl_filename_name(filename);
+  len  = (int)strlen(name);
+
+  // Look up the name and every extension, e.g. "tar.gz" and "gz"...
+  best = find_key(name_buckets[hash_key(name, len) & (num_buckets - 1)],
+                  name, len, filetype, best, &current);
+  for (ext = name; (ext = strchr(ext, '.')) != NULL;) {
+    ext ++;
+    int elen = len - (int)(ext - name);
+    best = find_key(ext_buckets[hash_key(ext, elen) & (num_buckets - 1)],
+                    ext, elen, filetype, best, &current);
+  }
 
-  // Loop through the available file types and return any match that
-  // is found...
-  for (current = first_; current != (Fl_File_Icon *)0; current = current->next_)
-    if ((current->type_ == filetype || current->type_ == ANY) &&
-        (fl_filename_match(filename, current->pattern_) ||
-         fl_filename_match(name, current->pattern_)))
+  // Then match the other patterns that come before the best match so far...
+  for (i = 0; i < num_other && other_ranks[i] < best; i ++) {
+    Fl_File_Icon *icon = other_icons[i];
+    if ((icon->type_ == filetype || icon->type_ == ANY) &&
+        (fl_filename_match(filename, icon->pattern_) ||
+         fl_filename_match(name, icon->pattern_))) {
+      current = icon;
       break;
+    }
+  }
 
   // Return the match (if any)...
   return (current);
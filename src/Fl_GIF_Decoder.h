@@ -0,0 +1,86 @@
+//
+// GIF stream decoder header for the Fast Light Tool Kit (FLTK).
+//
+// Copyright 2021 by Bill Spitzak and others.
+//
+// This library is free software. Distribution and use rights are outlined in
+// the file "COPYING" which should have been included with this file.  If this
+// file is missing or damaged, see the license at:
+//
+//     https://www.fltk.org/COPYING.php
+//
+// Please see the following page on how to report bugs and issues:
+//
+//     https://www.fltk.org/bugs.php
+//
+
+/*
+  This internal (undocumented) class decodes a GIF data stream frame by
+  frame, reading from an Fl_Image_Reader.
+
+  read_header() reads the logical screen descriptor and the global color
+  table. Every call of next_frame() then reads the extension blocks of the
+  following image (delay, disposal, transparency, loop count) and decodes
+  its LZW compressed pixels into an array of color indices. The LZW data is
+  read in whole sub-blocks with Fl_Image_Reader::read_block().
+
+  This class is used by Fl_GIF_Image, which only reads the first frame, and
+  by Fl_Anim_GIF_Image. The implementation is in Fl_GIF_Image.cxx.
+*/
+
+#ifndef FL_GIF_DECODER_H
+#define FL_GIF_DECODER_H
+
+#include <FL/fl_types.h>
+#include <stddef.h>
+
+class Fl_Image_Reader;
+
+class Fl_GIF_Decoder
+{
+public:
+  // Create the decoder for a reader that is positioned at the GIF signature
+  Fl_GIF_Decoder(Fl_Image_Reader &rdr);
+
+  // Free the pixel buffer
+  ~Fl_GIF_Decoder();
+
+  // Read the signature, the logical screen descriptor and the global color
+  // table, return 0 on success or -1 if this is not a GIF file
+  int read_header();
+
+  // Read and decode the next frame, return 1 if a frame was read or 0 at
+  // the end of the data stream
+  int next_frame();
+
+  // logical screen size (from read_header())
+  int screen_w, screen_h;
+  // number of times to repeat an animation, 0 = forever, -1 = no repeat
+  int loop_count;
+
+  // position and size of the last frame (from next_frame())
+  int x, y, w, h;
+  // frame delay in 1/100 seconds
+  int delay;
+  // frame disposal method: 0,1 = keep, 2 = restore background, 3 = restore previous
+  int dispose;
+  // transparent color index, or -1
+  int transparent;
+  // number of colors and the color table of the frame
+  int colors;
+  uchar red[256], green[256], blue[256];
+  // color indices of the frame, w*h bytes
+  uchar *pixels;
+
+private:
+
+  Fl_Image_Reader &rdr_;
+  size_t pixels_size_;
+  int global_colors_;
+  uchar global_red_[256], global_green_[256], global_blue_[256];
+
+  void skip_blocks_(int blocklen);
+  void decode_(int CodeSize, char Interlace);
+};
+
+#endif // FL_GIF_DECODER_H
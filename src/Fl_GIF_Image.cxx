@@ -31,6 +31,7 @@
 #include <FL/Fl.H>
 #include <FL/Fl_GIF_Image.H>
 #include "Fl_Image_Reader.h"
+#include "Fl_GIF_Decoder.h"
 #include <FL/fl_utf8.h>
 #include "flstring.h"
 
@@ -138,146 +139,222 @@ Fl_GIF_Image::Fl_GIF_Image(const char *imagename, const unsigned char *data) :
 }
 
 /*
- This method reads GIF image data and creates an RGB or RGBA image. The GIF
- format supports only 1 bit for alpha. To avoid code duplication, we use
- an Fl_Image_Reader that reads data from either a file or from memory.
+ The internal class Fl_GIF_Decoder reads the GIF data stream frame by frame,
+ see Fl_GIF_Decoder.h.
 */
-void Fl_GIF_Image::load_gif_(Fl_Image_Reader &rdr)
+Fl_GIF_Decoder::Fl_GIF_Decoder(Fl_Image_Reader &rdr) :
+  screen_w(0), screen_h(0), loop_count(-1),
+  x(0), y(0), w(0), h(0),
+  delay(0), dispose(0), transparent(-1), colors(0),
+  pixels(0L),
+  rdr_(rdr),
+  pixels_size_(0),
+  global_colors_(0)
 {
-  char **new_data;      // Data array
+  memset(red, 0, sizeof(red));
+  memset(green, 0, sizeof(green));
+  memset(blue, 0, sizeof(blue));
+}
 
-  {char b[6] = { 0 };
-    for (int i=0; i<6; ++i) b[i] = rdr.read_byte();
-    if (b[0]!='G' || b[1]!='I' || b[2] != 'F') {
-      Fl::error("Fl_GIF_Image: %s is not a GIF file.\n", rdr.name());
-      ld(ERR_FORMAT);
-      return;
-    }
-    if (b[3]!='8' || b[4]>'9' || b[5]!= 'a')
-      Fl::warning("%s is version %c%c%c.",rdr.name(),b[3],b[4],b[5]);
+Fl_GIF_Decoder::~Fl_GIF_Decoder() {
+  delete[] pixels;
+}
+
+int Fl_GIF_Decoder::read_header() {
+  // signature and logical screen descriptor:
+  uchar b[13] = { 0 };
+  if (rdr_.read_block(b, 13) < 13 || b[0]!='G' || b[1]!='I' || b[2] != 'F') {
+    Fl::error("Fl_GIF_Image: %s is not a GIF file.\n", rdr_.name());
+    return -1;
   }
+  if (b[3]!='8' || b[4]>'9' || b[5]!= 'a')
+    Fl::warning("%s is version %c%c%c.",rdr_.name(),b[3],b[4],b[5]);
 
-  int Width = rdr.read_word();
-  int Height = rdr.read_word();
+  screen_w = b[6] | (b[7] << 8);
+  screen_h = b[8] | (b[9] << 8);
 
-  uchar ch = rdr.read_byte();
-  char HasColormap = ((ch & 0x80) != 0);
-  int BitsPerPixel = (ch & 7) + 1;
-  int ColorMapSize;
-  if (HasColormap) {
-    ColorMapSize = 2 << (ch & 7);
-  } else {
-    ColorMapSize = 0;
+  uchar ch = b[10];
+  if (ch & 0x80) { // global color table
+    global_colors_ = 2 << (ch & 7);
   }
   // int OriginalResolution = ((ch>>4)&7)+1;
   // int SortedTable = (ch&8)!=0;
-  ch = rdr.read_byte(); // Background Color index
-  ch = rdr.read_byte(); // Aspect ratio is N/64
+  // b[11] is the Background Color index
+  // b[12] is the Aspect ratio N/64
 
   // Read in global colormap:
-  uchar transparent_pixel = 0;
-  char has_transparent = 0;
-  uchar Red[256], Green[256], Blue[256]; /* color map */
-  if (HasColormap) {
-    for (int i=0; i < ColorMapSize; i++) {
-      Red[i] = rdr.read_byte();
-      Green[i] = rdr.read_byte();
-      Blue[i] = rdr.read_byte();
-    }
+  for (int i=0; i < global_colors_; i++) {
+    global_red_[i] = rdr_.read_byte();
+    global_green_[i] = rdr_.read_byte();
+    global_blue_[i] = rdr_.read_byte();
   }
+  return 0;
+}
+
+// Skip a sequence of data sub-blocks, blocklen is the size of the first one
+void Fl_GIF_Decoder::skip_blocks_(int blocklen) {
+  uchar buf[256];
+  while (blocklen>0) {
+    if (rdr_.read_block(buf, blocklen) < blocklen) break; // EOF
+    blocklen = rdr_.read_byte();
+  }
+}
+
+int Fl_GIF_Decoder::next_frame() {
+  delay = 0;
+  dispose = 0;
+  transparent = -1;
 
   int CodeSize;         /* Code size, init from GIF header, increases... */
   char Interlace;
 
   for (;;) {
 
-    int i = rdr.read_byte();
-    if (i<0) {
-      Fl::error("Fl_GIF_Image: %s - unexpected EOF", rdr.name());
-      w(0); h(0); d(0); ld(ERR_FORMAT);
-      return;
+    uchar i;
+    if (rdr_.read_block(&i, 1) < 1) {
+      return 0;                 // EOF
     }
     int blocklen;
 
-    //  if (i == 0x3B) return 0;  eof code
+    if (i == 0x3B) return 0;    // trailer
 
     if (i == 0x21) {            // a "gif extension"
 
-      ch = rdr.read_byte();
-      blocklen = rdr.read_byte();
+      uchar ch = rdr_.read_byte();
+      blocklen = rdr_.read_byte();
 
       if (ch==0xF9 && blocklen==4) { // Netscape animation extension
 
-        char bits;
-        bits = rdr.read_byte();
-        rdr.read_word(); // GETSHORT(delay);
-        transparent_pixel = rdr.read_byte();
-        if (bits & 1) has_transparent = 1;
-        blocklen = rdr.read_byte();
+        uchar bits = rdr_.read_byte();
+        delay = rdr_.read_word();
+        uchar t = rdr_.read_byte();
+        if (bits & 1) transparent = t;
+        dispose = (bits >> 2) & 7;
+        blocklen = rdr_.read_byte();
 
       } else if (ch == 0xFF) { // Netscape repeat count
-        ;
+        if (blocklen == 11) {
+          uchar app[11];
+          rdr_.read_block(app, 11);
+          blocklen = rdr_.read_byte();
+          if (memcmp(app, "NETSCAPE2.0", 11) == 0 && blocklen == 3) {
+            uchar sub = rdr_.read_byte();
+            unsigned short n = rdr_.read_word();
+            if (sub == 1) loop_count = n;
+            blocklen = rdr_.read_byte();
+          }
+        }
 
       } else if (ch != 0xFE) { //Gif Comment
-        Fl::warning("%s: unknown gif extension 0x%02x.", rdr.name(), ch);
+        Fl::warning("%s: unknown gif extension 0x%02x.", rdr_.name(), ch);
       }
     } else if (i == 0x2c) {     // an image
 
-      ch = rdr.read_byte(); ch = rdr.read_byte(); // GETSHORT(x_position);
-      ch = rdr.read_byte(); ch = rdr.read_byte(); // GETSHORT(y_position);
-      Width = rdr.read_word();
-      Height = rdr.read_word();
-      ch = rdr.read_byte();
+      uchar d[9];
+      if (rdr_.read_block(d, 9) < 9) return 0; // EOF
+      x = d[0] | (d[1] << 8);
+      y = d[2] | (d[3] << 8);
+      w = d[4] | (d[5] << 8);
+      h = d[6] | (d[7] << 8);
+      uchar ch = d[8];
       Interlace = ((ch & 0x40) != 0);
+      int BitsPerPixel;
       if (ch & 0x80) { // image has local color table
         BitsPerPixel = (ch & 7) + 1;
-        ColorMapSize = 2 << (ch & 7);
-        for (i=0; i < ColorMapSize; i++) {
-          Red[i] = rdr.read_byte();
-          Green[i] = rdr.read_byte();
-          Blue[i] = rdr.read_byte();
+        colors = 2 << (ch & 7);
+        for (int c=0; c < colors; c++) {
+          red[c] = rdr_.read_byte();
+          green[c] = rdr_.read_byte();
+          blue[c] = rdr_.read_byte();
         }
+      } else {
+        colors = global_colors_;
+        for (BitsPerPixel = 1; (1 << BitsPerPixel) < colors; BitsPerPixel++) { }
+        memcpy(red, global_red_, colors);
+        memcpy(green, global_green_, colors);
+        memcpy(blue, global_blue_, colors);
+      }
+      CodeSize = rdr_.read_byte()+1;
+
+      if (colors && BitsPerPixel >= CodeSize)
+      {
+        // Workaround for broken GIF files...
+        BitsPerPixel = CodeSize - 1;
+        colors = 1 << BitsPerPixel;
       }
-      CodeSize = rdr.read_byte()+1;
-      break; // okay, this is the image we want
+
+      // Fix images w/o color table. The standard allows this and lets the
+      // decoder choose a default color table. The standard recommends the
+      // first two color table entries should be black and white.
+
+      if (colors == 0) { // no global and no local color table
+        Fl::warning("%s does not have a color table, using default.\n", rdr_.name());
+        BitsPerPixel = CodeSize - 1;
+        colors = 1 << BitsPerPixel;
+        red[0] = green[0] = blue[0] = 0;    // black
+        red[1] = green[1] = blue[1] = 255;  // white
+        for (int c = 2; c < colors; c++) {
+          red[c] = green[c] = blue[c] = (uchar)(255 * c / (colors - 1));
+        }
+      }
+
+      if ((size_t)w * h > Fl_RGB_Image::max_size()) {
+        Fl::error("Fl_GIF_Image: %s - image is too large", rdr_.name());
+        return 0;
+      }
+      if ((size_t)w * h > pixels_size_) {
+        delete[] pixels;
+        pixels_size_ = (size_t)w * h;
+        pixels = new uchar[pixels_size_];
+      }
+      decode_(CodeSize, Interlace);
+      return 1; // okay, this is the image we want
     } else {
-      Fl::warning("%s: unknown gif code 0x%02x", rdr.name(), i);
+      Fl::warning("%s: unknown gif code 0x%02x", rdr_.name(), i);
       blocklen = 0;
     }
 
     // skip the data:
-    while (blocklen>0) {while (blocklen--) {ch = rdr.read_byte();} blocklen = rdr.read_byte();}
-  }
-
-  if (BitsPerPixel >= CodeSize)
-  {
-    // Workaround for broken GIF files...
-    BitsPerPixel = CodeSize - 1;
-    ColorMapSize = 1 << BitsPerPixel;
+    skip_blocks_(blocklen);
   }
+}
 
-  // Fix images w/o color table. The standard allows this and lets the
-  // decoder choose a default color table. The standard recommends the
-  // first two color table entries should be black and white.
-
-  if (ColorMapSize == 0) { // no global and no local color table
-    Fl::warning("%s does not have a color table, using default.\n", rdr.name());
-    BitsPerPixel = CodeSize - 1;
-    ColorMapSize = 1 << BitsPerPixel;
-    Red[0] = Green[0] = Blue[0] = 0;    // black
-    Red[1] = Green[1] = Blue[1] = 255;  // white
-    for (int i = 2; i < ColorMapSize; i++) {
-      Red[i] = Green[i] = Blue[i] = (uchar)(255 * i / (ColorMapSize - 1));
+// Advance to the next row of an image, de-interlacing if needed
+static inline void next_row(uchar *Image, int Width, int Height, char Interlace,
+                            int &YC, int &Pass, uchar *&p, uchar *&eol)
+{
+  if (!Interlace) YC++;
+  else {
+    switch (Pass) {
+      case 0: case 1: YC += 8; break;
+      case 2: YC += 4; break;
+      case 3: YC += 2; break;
     }
-#if (0)
-    // fill color table to maximum size
-    for (int i = ColorMapSize; i < 256; i++) {
-      Red[i] = Green[i] = Blue[i] = 0; // black
+    while (YC >= Height && Pass < 3) { // next pass, skip empty passes
+      Pass++;
+      YC = 8 >> Pass; // 4, 2, 1
     }
-#endif
   }
+  if (YC>=Height) YC=0; /* cheap bug fix when excess data */
+  p = Image + YC*Width;
+  eol = p+Width;
+}
 
-  uchar *Image = new uchar[Width*Height];
+/*
+ Decode the LZW compressed image data of the current frame into pixels[].
+ The data sub-blocks are read as a whole and the codes are taken from a bit
+ buffer. On return the reader is positioned after the block terminator.
+*/
+void Fl_GIF_Decoder::decode_(int CodeSize, char Interlace)
+{
+  int Width = w, Height = h;
+  uchar *Image = pixels;
+
+  if (Width <= 0 || Height <= 0 || CodeSize < 2 || CodeSize > 12) {
+    if (Width > 0 && Height > 0) memset(Image, 0, (size_t)Width * Height);
+    skip_blocks_(rdr_.read_byte());
+    return;
+  }
 
   int YC = 0, Pass = 0; /* Used to de-interlace the picture */
   uchar *p = Image;
@@ -295,37 +372,36 @@ void Fl_GIF_Image::load_gif_(Fl_Image_Reader &rdr)
   // tables used by LZW decompresser:
   short int Prefix[4096];
   uchar Suffix[4096];
+  short int Length[4096]; // length of the string of each code
+  uchar OutCode[4097]; // temporary array for reversing codes
+  for (int c = 0; c < ClearCode; c++) Length[c] = 1;
 
-  int blocklen = rdr.read_byte();
-  uchar thisbyte = rdr.read_byte(); blocklen--;
-  int frombit = 0;
+  // the current data sub-block and the bits not yet used:
+  uchar block[256];
+  int blocklen = 0, blockpos = 0;
+  char eod = 0;         // block terminator or EOF was read
+  unsigned int bits = 0;
+  int nbits = 0;
 
   for (;;) {
 
     /* Fetch the next code from the raster data stream.  The codes can be
-     * any length from 3 to 12 bits, packed into 8-bit bytes, so we have to
-     * maintain our location as a pointer and a bit offset.
-     * In addition, GIF adds totally useless and annoying block counts
-     * that must be correctly skipped over. */
-    int CurCode = thisbyte;
-    if (frombit+CodeSize > 7) {
-      if (blocklen <= 0) {
-        blocklen = rdr.read_byte();
-        if (blocklen <= 0) break;
-      }
-      thisbyte = rdr.read_byte(); blocklen--;
-      CurCode |= thisbyte<<8;
-    }
-    if (frombit+CodeSize > 15) {
-      if (blocklen <= 0) {
-        blocklen = rdr.read_byte();
-        if (blocklen <= 0) break;
+     * any length from 3 to 12 bits, packed LSB-first into the bytes of
+     * data sub-blocks of up to 255 bytes each. */
+    while (nbits < CodeSize) {
+      if (blockpos >= blocklen) {
+        blocklen = rdr_.read_byte();
+        if (blocklen > 0) blocklen = rdr_.read_block(block, blocklen);
+        blockpos = 0;
+        if (blocklen <= 0) {eod = 1; break;}
       }
-      thisbyte = rdr.read_byte(); blocklen--;
-      CurCode |= thisbyte<<16;
+      bits |= (unsigned int)block[blockpos++] << nbits;
+      nbits += 8;
     }
-    CurCode = (CurCode>>frombit)&ReadMask;
-    frombit = (frombit+CodeSize)%8;
+    if (nbits < CodeSize) break;
+    int CurCode = bits & ReadMask;
+    bits >>= CodeSize;
+    nbits -= CodeSize;
 
     if (CurCode == ClearCode) {
       CodeSize = InitCodeSize;
@@ -337,48 +413,96 @@ void Fl_GIF_Image::load_gif_(Fl_Image_Reader &rdr)
 
     if (CurCode == EOFCode) break;
 
-    uchar OutCode[4097]; // temporary array for reversing codes
-    uchar *tp = OutCode;
-    int i;
-    if (CurCode < FreeCode) i = CurCode;
-    else if (CurCode == FreeCode) {*tp++ = (uchar)FinChar; i = OldCode;}
-    else {Fl::error("Fl_GIF_Image: %s - LZW Barf!", rdr.name()); break;}
-
-    while (i >= ColorMapSize) {*tp++ = Suffix[i]; i = Prefix[i];}
-    *tp++ = FinChar = i;
-    do {
-      *p++ = *--tp;
-      if (p >= eol) {
-        if (!Interlace) YC++;
-        else switch (Pass) {
-          case 0: YC += 8; if (YC >= Height) {Pass++; YC = 4;} break;
-          case 1: YC += 8; if (YC >= Height) {Pass++; YC = 2;} break;
-          case 2: YC += 4; if (YC >= Height) {Pass++; YC = 1;} break;
-          case 3: YC += 2; break;
-        }
-        if (YC>=Height) YC=0; /* cheap bug fix when excess data */
-        p = Image + YC*Width;
-        eol = p+Width;
-      }
-    } while (tp > OutCode);
+    int i, len;
+    if (CurCode < FreeCode) {i = CurCode; len = Length[i];}
+    else if (CurCode == FreeCode && OldCode != ClearCode) {i = OldCode; len = Length[i] + 1;}
+    else {Fl::error("Fl_GIF_Image: %s - LZW Barf!", rdr_.name()); break;}
+
+    if (eol - p >= len) {
+      // the string fits into the row, write it from its end
+      uchar *tp = p + len;
+      if (i != CurCode) *--tp = (uchar)FinChar;
+      while (i >= ClearCode) {*--tp = Suffix[i]; i = Prefix[i];}
+      *--tp = FinChar = i;
+      p += len;
+    } else {
+      uchar *tp = OutCode;
+      if (i != CurCode) *tp++ = (uchar)FinChar;
+      while (i >= ClearCode) {*tp++ = Suffix[i]; i = Prefix[i];}
+      *tp++ = FinChar = i;
+      do {
+        *p++ = *--tp;
+        if (p >= eol) next_row(Image, Width, Height, Interlace, YC, Pass, p, eol);
+      } while (tp > OutCode);
+    }
+    if (p >= eol) next_row(Image, Width, Height, Interlace, YC, Pass, p, eol);
 
-    if (OldCode != ClearCode) {
+    if (OldCode != ClearCode && FreeCode < 4096) { // table is full at 4096
       Prefix[FreeCode] = (short)OldCode;
       Suffix[FreeCode] = FinChar;
+      Length[FreeCode] = Length[OldCode] + 1;
       FreeCode++;
-      if (FreeCode > ReadMask) {
-        if (CodeSize < 12) {
-          CodeSize++;
-          ReadMask = (1 << CodeSize) - 1;
-        }
-        else FreeCode--;
+      if (FreeCode > ReadMask && CodeSize < 12) {
+        CodeSize++;
+        ReadMask = (1 << CodeSize) - 1;
       }
     }
     OldCode = CurCode;
   }
 
+  // skip the rest of the image data up to the block terminator
+  if (!eod) skip_blocks_(rdr_.read_byte());
+}
+
+/*
+ This method reads GIF image data and creates an RGB or RGBA image. The GIF
+ format supports only 1 bit for alpha. To avoid code duplication, we use
+ an Fl_Image_Reader that reads data from either a file or from memory.
+*/
+void Fl_GIF_Image::load_gif_(Fl_Image_Reader &rdr)
+{
+  char **new_data;      // Data array
+
+  Fl_GIF_Decoder dec(rdr);
+  if (dec.read_header() < 0) {
+    ld(ERR_FORMAT);
+    return;
+  }
+  if (dec.next_frame() != 1) {
+    Fl::error("Fl_GIF_Image: %s - unexpected EOF", rdr.name());
+    w(0); h(0); d(0); ld(ERR_FORMAT);
+    return;
+  }
+
+  int Width = dec.w;
+  int Height = dec.h;
+  int ColorMapSize = dec.colors;
+  uchar *Red = dec.red, *Green = dec.green, *Blue = dec.blue;
+  char has_transparent = (dec.transparent >= 0);
+  uchar transparent_pixel = has_transparent ? (uchar)dec.transparent : 0;
+  uchar *Image = dec.pixels;
+  uchar *p;
+  char header[64];      // first line of the xpm data
+
   // We are done reading the file, now convert to xpm:
 
+  // find out what colors are actually used:
+  uchar used[256]; uchar remap[256];
+  int i;
+  for (i = 0; i < 256; i++) used[i] = 0;
+  p = Image+Width*Height;
+  while (p-- > Image) used[*p] = 1;
+
+  // indices beyond the color table of broken files use color 0:
+  for (i = ColorMapSize; i < 256; i++) if (used[i]) break;
+  if (i < 256) {
+    p = Image+Width*Height;
+    while (p-- > Image) if (*p >= ColorMapSize) *p = 0;
+    for (i = ColorMapSize; i < 256; i++) used[i] = 0;
+    used[0] = 1;
+  }
+  if (transparent_pixel >= ColorMapSize) has_transparent = 0;
+
   // allocate line pointer arrays:
   w(Width);
   h(Height);
@@ -405,14 +529,11 @@ void Fl_GIF_Image::load_gif_(Fl_Image_Reader &rdr)
     t                        = Blue[0];
     Blue[0]                  = Blue[transparent_pixel];
     Blue[transparent_pixel]  = t;
-  }
 
-  // find out what colors are actually used:
-  uchar used[256]; uchar remap[256];
-  int i;
-  for (i = 0; i < ColorMapSize; i++) used[i] = 0;
-  p = Image+Width*Height;
-  while (p-- > Image) used[*p] = 1;
+    t                        = used[0];
+    used[0]                  = used[transparent_pixel];
+    used[transparent_pixel]  = t;
+  }
 
   // remap them to start with printing characters:
   int base = has_transparent && used[0] ? ' ' : ' '+1;
@@ -422,11 +543,11 @@ void Fl_GIF_Image::load_gif_(Fl_Image_Reader &rdr)
     numcolors++;
   }
 
-  // write the first line of xpm data (use suffix as temp array):
-  int length = sprintf((char*)(Suffix),
+  // write the first line of xpm data:
+  int length = sprintf(header,
                        "%d %d %d %d",Width,Height,-numcolors,1);
   new_data[0] = new char[length+1];
-  strcpy(new_data[0], (char*)Suffix);
+  strcpy(new_data[0], header);
 
   // write the colormap
   new_data[1] = (char*)(p = new uchar[4*numcolors]);
@@ -450,6 +571,4 @@ void Fl_GIF_Image::load_gif_(Fl_Image_Reader &rdr)
 
   data((const char **)new_data, Height + 2);
   alloc_data = 1;
-
-  delete[] Image;
 }
@@ -28,6 +28,7 @@
 //   Fl_Help_View::draw()            - Draw the Fl_Help_View widget.
 //   Fl_Help_View::format()          - Format the help text.
 //   Fl_Help_View::format_table()    - Format a table...
+//   Fl_Help_View::update_scrollbars() - Show/hide the scrollbars.
 //   Fl_Help_View::free_data()       - Free memory used for the document.
 //   Fl_Help_View::get_align()       - Get an alignment attribute.
 //   Fl_Help_View::get_attr()        - Get an attribute value from the string.
@@ -225,6 +226,120 @@ Fl_Help_View *Fl_Help_View::current_view = 0L;
 Fl_Color Fl_Help_View::hv_selection_color;
 Fl_Color Fl_Help_View::hv_selection_text_color;
 
+//
+// Text width cache for format() and draw()...
+//
+// Measuring text is the most expensive part of formatting a document,
+// and format() runs again whenever the widget's width changes. Words are
+// measured once per font, size, graphics driver, and scale factor, and
+// remembered for all Fl_Help_View widgets. The face name of the font is
+// part of the key, so that a font changed with Fl::set_font() is measured
+// again. The cache is simply flushed when it gets big.
+//
+
+struct hv_width_entry {
+  const char    *text;                  // Text (in width pool), 0 if unused
+  int           len;                    // Length of text
+  unsigned      hash;                   // Hash of text, font and size
+  Fl_Font       font;                   // Font
+  Fl_Fontsize   size;                   // Font size
+  const char    *name;                  // Face name of the font, see Fl::set_font()
+  void          *driver;                // Graphics driver used to measure
+  float         scale;                  // Scale factor of the driver
+  int           width;                  // Width of text
+};
+
+static const int HV_WIDTH_MAX     = 65536;  // Max entries before flushing
+static const int HV_WIDTH_MAXLEN  = 256;    // Longer text is not cached
+static const int HV_WIDTH_POOL    = 65536;  // Text pool chunk size
+
+static hv_width_entry *hv_width_table = 0;  // Open addressed hash table
+static int      hv_width_size = 0;          // Allocated entries (power of 2)
+static int      hv_width_count = 0;         // Used entries
+static char     *hv_width_pool = 0;         // Current text pool chunk
+static int      hv_width_pool_used = 0;     // Bytes used in current chunk
+
+// Flush the text width cache
+static void hv_width_flush() {
+  while (hv_width_pool) {                   // chunks are linked by their 1st bytes
+    char *prev = *(char **)hv_width_pool;
+    free(hv_width_pool);
+    hv_width_pool = prev;
+  }
+  hv_width_pool_used = 0;
+  if (hv_width_table) memset(hv_width_table, 0, hv_width_size * sizeof(hv_width_entry));
+  hv_width_count = 0;
+}
+
+// Copy text to the text pool
+static const char *hv_width_save(const char *t, int n) {
+  if (!hv_width_pool || hv_width_pool_used + n > HV_WIDTH_POOL) {
+    char *chunk = (char *)malloc(HV_WIDTH_POOL);
+    *(char **)chunk = hv_width_pool;
+    hv_width_pool = chunk;
+    hv_width_pool_used = sizeof(char *);
+  }
+  char *p = hv_width_pool + hv_width_pool_used;
+  memcpy(p, t, n);
+  hv_width_pool_used += n;
+  return p;
+}
+
+// Return the width of 'n' bytes of text 't' in the current font
+static int hv_width(const char *t, int n) {
+  if (n <= 0) return 0;
+  if (n > HV_WIDTH_MAXLEN) return (int)fl_width(t, n);
+
+  Fl_Font f = fl_font();
+  Fl_Fontsize s = fl_size();
+  const char *fn = Fl::get_font(f);
+  void *d = (void *)fl_graphics_driver;
+  float sc = fl_graphics_driver->scale();
+  unsigned h = 2166136261U;                 // FNV-1a
+  for (int i = 0; i < n; i ++) { h ^= (uchar)t[i]; h *= 16777619U; }
+  h ^= (unsigned)f * 2654435761U;
+  h ^= (unsigned)s * 40503U;
+
+  if ((hv_width_count + 1) * 2 > hv_width_size) {
+    if (hv_width_size >= HV_WIDTH_MAX * 2) hv_width_flush();
+    else {                                  // enlarge table
+      hv_width_entry *old = hv_width_table;
+      int oldsize = hv_width_size;
+      hv_width_size = oldsize ? oldsize * 2 : 1024;
+      hv_width_table = (hv_width_entry *)calloc(hv_width_size, sizeof(hv_width_entry));
+      for (int i = 0; i < oldsize; i ++) {
+        if (!old[i].text) continue;
+        unsigned j = old[i].hash & (hv_width_size - 1);
+        while (hv_width_table[j].text) j = (j + 1) & (hv_width_size - 1);
+        hv_width_table[j] = old[i];
+      }
+      free(old);
+    }
+  }
+
+  unsigned mask = hv_width_size - 1;
+  unsigned j = h & mask;
+  for (; hv_width_table[j].text; j = (j + 1) & mask) {
+    hv_width_entry &e = hv_width_table[j];
+    if (e.hash == h && e.len == n && e.font == f && e.size == s &&
+        e.name == fn && e.driver == d && e.scale == sc && !memcmp(e.text, t, n))
+      return e.width;
+  }
+
+  hv_width_entry &e = hv_width_table[j];
+  e.text   = hv_width_save(t, n);
+  e.len    = n;
+  e.hash   = h;
+  e.font   = f;
+  e.size   = s;
+  e.name   = fn;
+  e.driver = d;
+  e.scale  = sc;
+  e.width  = (int)fl_width(t, n);
+  hv_width_count ++;
+  return e.width;
+}
+
 /*
  * This function must be optimized for speed!
  */
@@ -233,9 +348,9 @@ void Fl_Help_View::hv_draw(const char *t, int x, int y, int entity_extra_length)
   if (selected && current_view==this && current_pos<selection_last && current_pos>=selection_first) {
     Fl_Color c = fl_color();
     fl_color(hv_selection_color);
-    int w = (int)fl_width(t);
+    int w = hv_width(t, (int)strlen(t));
     if (current_pos+(int)strlen(t)<selection_last)
-      w += (int)fl_width(' ');
+      w += hv_width(" ", 1);
     fl_rectf(x, y+fl_descent()-fl_height(), w, fl_height());
     fl_color(hv_selection_text_color);
     fl_draw(t, x, y);
@@ -244,7 +359,7 @@ void Fl_Help_View::hv_draw(const char *t, int x, int y, int entity_extra_length)
     fl_draw(t, x, y);
   }
   if (draw_mode) {
-    int w = (int)fl_width(t);
+    int w = hv_width(t, (int)strlen(t));
     if (mouse_x>=x && mouse_x<x+w) {
       if (mouse_y>=y-fl_height()+fl_descent()&&mouse_y<=y+fl_descent()) {
         int f = (int) current_pos;
@@ -311,7 +426,7 @@ public:
   void add(int ucs);
 
   int cmp(const char * str) { return !strcasecmp(buf_, str); }
-  int width() { return (int)fl_width(buf_); }
+  int width() { return hv_width(buf_, size_); }
 
   char & operator[] (int idx) { return buf_[idx]; }
   char operator[] (int idx) const { return buf_[idx]; }
@@ -708,7 +823,15 @@ Fl_Help_View::draw()
   fl_color(textcolor_);
 
   // Draw all visible blocks...
-  for (i = 0, block = blocks_; i < nblocks_; i ++, block ++)
+  //   Blocks are not sorted by y (e.g. table cells), but their ymax and
+  //   ymin are, so skip the blocks above and stop below the view.
+  int lo = 0, hi = nblocks_;
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+    if (blocks_[mid].ymax < topline_) lo = mid + 1;
+    else hi = mid;
+  }
+  for (i = lo, block = blocks_ + lo; i < nblocks_ && block->ymin < (topline_ + h()); i ++, block ++)
     if ((block->y + block->h) >= topline_ && block->y < (topline_ + h()))
     {
       line      = 0;
@@ -734,7 +857,7 @@ Fl_Help_View::draw()
             ww = buf.width();
 
             if (needspace && xx > block->x)
-              xx += (int)fl_width(' ');
+              xx += hv_width(" ", 1);
 
             if ((xx + ww) > block->w)
             {
@@ -749,7 +872,7 @@ Fl_Help_View::draw()
             buf.clear();
             entity_extra_length = 0;
             if (underline) {
-              xtra_ww = isspace((*ptr)&255)?(int)fl_width(' '):0;
+              xtra_ww = isspace((*ptr)&255)?hv_width(" ", 1):0;
               fl_xyline(xx + x() - leftline_, yy + y() + 1,
                         xx + x() - leftline_ + ww + xtra_ww);
             }
@@ -1059,7 +1182,7 @@ Fl_Help_View::draw()
             ww = width;
 
             if (needspace && xx > block->x)
-              xx += (int)fl_width(' ');
+              xx += hv_width(" ", 1);
 
             if ((xx + ww) > block->w)
             {
@@ -1152,7 +1275,7 @@ Fl_Help_View::draw()
         ww = buf.width();
 
         if (needspace && xx > block->x)
-          xx += (int)fl_width(' ');
+          xx += hv_width(" ", 1);
 
         if ((xx + ww) > block->w)
         {
@@ -1299,6 +1422,7 @@ void Fl_Help_View::format() {
                 needspace;      // Do we need whitespace?
   int           table_width,    // Width of table
                 table_offset;   // Offset of table
+  int           hsize_needed;   // Document width needed by wide text/images/tables
   int           column,         // Current table column number
                 columns[MAX_COLUMNS];
                                 // Column widths
@@ -1353,6 +1477,7 @@ void Fl_Help_View::format() {
     needspace    = 0;
     linkdest[0]  = '\0';
     table_offset = 0;
+    hsize_needed = hsize_;
 
     // Html text character loop
     for (ptr = value_, buf.clear(); *ptr;)
@@ -1366,14 +1491,13 @@ void Fl_Help_View::format() {
         if (!head && !pre)
         {
           // Check width...
-          if (ww > hsize_) {
-            hsize_ = ww;
-            done   = 0;
-            break;
-          }
+          //   Too wide? Finish this pass, so that all wide elements are
+          //   found at once, then format again with the width needed.
+          if (ww > hsize_needed)
+            hsize_needed = ww;
 
           if (needspace && xx > block->x)
-            ww += (int)fl_width(' ');
+            ww += hv_width(" ", 1);
 
   //        printf("line = %d, xx = %d, ww = %d, block->x = %d, block->w = %d\n",
   //           line, xx, ww, block->x, block->w);
@@ -1411,7 +1535,8 @@ void Fl_Help_View::format() {
           {
             if (*ptr == '\n')
             {
-              if (xx > hsize_) break;
+              if (xx > hsize_needed)
+                hsize_needed = xx;
 
               line     = do_align(block, line, xx, newalign, links);
               xx       = block->x;
@@ -1420,7 +1545,7 @@ void Fl_Help_View::format() {
               hh       = fsize + 2;
             }
             else
-              xx += (int)fl_width(' ');
+              xx += hv_width(" ", 1);
 
             if ((fsize + 2) > hh)
               hh = fsize + 2;
@@ -1428,11 +1553,8 @@ void Fl_Help_View::format() {
             ptr ++;
           }
 
-          if (xx > hsize_) {
-            hsize_ = xx;
-            done   = 0;
-            break;
-          }
+          if (xx > hsize_needed)
+            hsize_needed = xx;
 
           needspace = 0;
         }
@@ -1561,14 +1683,12 @@ void Fl_Help_View::format() {
 
             format_table(&table_width, columns, start);
 
-            if ((xx + table_width) > hsize_) {
+            if ((xx + table_width) > hsize_needed) {
 #ifdef DEBUG
               printf("xx=%d, table_width=%d, hsize_=%d\n", xx, table_width,
                      hsize_);
 #endif // DEBUG
-              hsize_ = xx + table_width;
-              done   = 0;
-              break;
+              hsize_needed = xx + table_width;
             }
 
             switch (get_align(attrs, talign))
@@ -1902,14 +2022,11 @@ void Fl_Help_View::format() {
 
           ww = width;
 
-          if (ww > hsize_) {
-            hsize_ = ww;
-            done   = 0;
-            break;
-          }
+          if (ww > hsize_needed)
+            hsize_needed = ww;
 
           if (needspace && xx > block->x)
-            ww += (int)fl_width(' ');
+            ww += hv_width(" ", 1);
 
           if ((xx + ww) > block->w)
           {
@@ -1936,11 +2053,8 @@ void Fl_Help_View::format() {
         if (linkdest[0])
           add_link(linkdest, xx, yy - hh, ww, hh);
 
-        if (xx > hsize_) {
-          hsize_ = xx;
-          done   = 0;
-          break;
-        }
+        if (xx > hsize_needed)
+          hsize_needed = xx;
 
         line      = do_align(block, line, xx, newalign, links);
         xx        = block->x;
@@ -1953,7 +2067,7 @@ void Fl_Help_View::format() {
       {
         needspace = 1;
         if ( pre ) {
-          xx += (int)fl_width(' ');
+          xx += hv_width(" ", 1);
         }
         ptr ++;
       }
@@ -1990,14 +2104,11 @@ void Fl_Help_View::format() {
   //    printf("line = %d, xx = %d, ww = %d, block->x = %d, block->w = %d\n",
   //       line, xx, ww, block->x, block->w);
 
-      if (ww > hsize_) {
-        hsize_ = ww;
-        done   = 0;
-        break;
-      }
+      if (ww > hsize_needed)
+        hsize_needed = ww;
 
       if (needspace && xx > block->x)
-        ww += (int)fl_width(' ');
+        ww += hv_width(" ", 1);
 
       if ((xx + ww) > block->w)
       {
@@ -2018,6 +2129,25 @@ void Fl_Help_View::format() {
 
     block->end = ptr;
     size_      = yy + hh;
+
+    if (hsize_needed > hsize_) {
+      // Format again with the document width needed...
+      hsize_ = hsize_needed;
+      done   = 0;
+    }
+  }
+
+  // Find each block's max. bottom so far and min. top from here on,
+  // so that draw() can quickly find the visible blocks...
+  if (nblocks_ > 0) {
+    blocks_[0].ymax = blocks_[0].y + blocks_[0].h;
+    for (i = 1; i < nblocks_; i ++) {
+      int bottom = blocks_[i].y + blocks_[i].h;
+      blocks_[i].ymax = bottom > blocks_[i - 1].ymax ? bottom : blocks_[i - 1].ymax;
+    }
+    blocks_[nblocks_ - 1].ymin = blocks_[nblocks_ - 1].y;
+    for (i = nblocks_ - 2; i >= 0; i --)
+      blocks_[i].ymin = blocks_[i].y < blocks_[i + 1].ymin ? blocks_[i].y : blocks_[i + 1].ymin;
   }
 
 //  printf("margins.depth_=%d\n", margins.depth_);
@@ -2026,6 +2156,18 @@ void Fl_Help_View::format() {
     qsort(targets_, ntargets_, sizeof(Fl_Help_Target),
           (compare_func_t)compare_targets);
 
+  update_scrollbars();
+}
+
+
+/** Shows or hides the scrollbars as needed by the formatted document
+    and the widget's size, and keeps the scroll position in range. */
+void
+Fl_Help_View::update_scrollbars()
+{
+  Fl_Boxtype    b = box() ? box() : FL_DOWN_BOX;
+                                // Box to draw...
+
   int dx = Fl::box_dw(b) - Fl::box_dx(b);
   int dy = Fl::box_dh(b) - Fl::box_dy(b);
   int ss = scrollbar_size_ ? scrollbar_size_ : Fl::scrollbar_size();
@@ -2366,7 +2508,7 @@ Fl_Help_View::format_table(int        *table_width,     // O - Total table width
 
         width += iwidth;
         if (needspace)
-          width += (int)fl_width(' ');
+          width += hv_width(" ", 1);
 
         if (width > max_width)
           max_width = width;
@@ -3451,6 +3593,7 @@ Fl_Help_View::resize(int xx,    // I - New left position
 {
   Fl_Boxtype            b = box() ? box() : FL_DOWN_BOX;
                                         // Box to draw...
+  int                   oldw = w();     // Old width
 
 
   Fl_Widget::resize(xx, yy, ww, hh);
@@ -3462,7 +3605,12 @@ Fl_Help_View::resize(int xx,    // I - New left position
                      y() + h() - scrollsize - Fl::box_dh(b) + Fl::box_dy(b),
                      w() - scrollsize - Fl::box_dw(b), scrollsize);
 
-  format();
+  // The layout only depends on the width; just move or show/hide
+  // the scrollbars if only the position or height changed...
+  if (w() == oldw && value_)
+    update_scrollbars();
+  else
+    format();
 }
 
 
@@ -21,6 +21,8 @@
 #include <FL/Fl_Menu_Item.H>
 #include <FL/Fl_Image.H>
 #include "flstring.h"
+#include "Fl_Image_Scaler.h"
+#include "Fl_System_Driver.H"
 
 void fl_restore_clip(); // from fl_rect.cxx
 
@@ -219,6 +221,8 @@ Fl_Image::measure(const Fl_Label *lo,           // I - Label
 
 /** Sets the RGB image scaling method used for copy(int, int).
     Applies to all RGB images, defaults to FL_RGB_SCALING_NEAREST.
+
+    Large images are scaled by several threads, if the platform supports it.
 */
 void Fl_Image::RGB_scaling(Fl_RGB_Scaling method) {
   RGB_scaling_ = method;
@@ -394,6 +398,140 @@ void Fl_RGB_Image::uncache() {
   Fl_Graphics_Driver::default_driver().uncache(this, id_, mask_);
 }
 
+//
+// Scaling of RGB images by Fl_RGB_Image::copy()...
+//
+//    Large images are scaled in bands of rows in parallel. The source pixels
+//    of each destination column and row are computed in advance.
+//
+
+struct Fl_RGB_Copy {
+  Fl_RGB_Scaling method;        // Scaling method
+  const uchar   *src;           // Source image data
+  int           sw, sh,         // Source size
+                d, ld;          // Depth and line delta
+  uchar         *dst;           // Destination image data
+  int           W, H;           // Destination size
+  int           bands;          // Number of bands of rows
+  int           *xi, *yi;       // Source offset (nearest) or left/upper pixel
+  int           *xr, *yd;       // Right/lower pixel (bilinear)
+  float         *xf, *yf;       // Fraction of the right/lower pixel (bilinear)
+};
+
+// Nearest-neighbor scaling of rows y0 .. y1 - 1
+static void copy_nearest(const Fl_RGB_Copy &job, int y0, int y1) {
+  const int d = job.d, W = job.W;
+  uchar *new_ptr = job.dst + (size_t)y0 * W * d;
+  for (int dy = y0; dy < y1; dy ++) {
+    const uchar *row = job.src + (size_t)job.yi[dy] * job.ld;
+    const int *xi = job.xi;
+    int dx;
+    switch (d) {
+      case 1:
+        for (dx = 0; dx < W; dx ++) *new_ptr++ = row[xi[dx]];
+        break;
+      case 3:
+        for (dx = 0; dx < W; dx ++, new_ptr += 3) {
+          const uchar *old_ptr = row + xi[dx];
+          new_ptr[0] = old_ptr[0];
+          new_ptr[1] = old_ptr[1];
+          new_ptr[2] = old_ptr[2];
+        }
+        break;
+      case 4:
+        for (dx = 0; dx < W; dx ++, new_ptr += 4) memcpy(new_ptr, row + xi[dx], 4);
+        break;
+      default:
+        for (dx = 0; dx < W; dx ++, new_ptr += d) memcpy(new_ptr, row + xi[dx], d);
+        break;
+    }
+  }
+}
+
+// Bilinear scaling of rows y0 .. y1 - 1
+static void copy_bilinear(const Fl_RGB_Copy &job, int y0, int y1) {
+  const int d = job.d, W = job.W;
+  uchar *new_ptr = job.dst + (size_t)y0 * W * d;
+  for (int dy = y0; dy < y1; dy ++) {
+    const uchar *up   = job.src + (size_t)job.yi[dy] * job.ld;
+    const uchar *down = job.src + (size_t)job.yd[dy] * job.ld;
+    const float upf = 1 - job.yf[dy];
+    const float downf = job.yf[dy];
+
+    for (int dx = 0; dx < W; dx ++, new_ptr += d) {
+      const uchar *left      = up + job.xi[dx] * d;
+      const uchar *right     = up + job.xr[dx] * d;
+      const uchar *downleft  = down + job.xi[dx] * d;
+      const uchar *downright = down + job.xr[dx] * d;
+      const float leftf = 1 - job.xf[dx];
+      const float rightf = job.xf[dx];
+      int i;
+
+      if (d == 4) {
+        // Premultiply the colors by alpha...
+        uchar l[4], r[4], dl[4], dr[4];
+        for (i = 0; i < 3; i++) {
+          l[i] = (uchar)(left[i] * left[3] / 255.0f);
+          r[i] = (uchar)(right[i] * right[3] / 255.0f);
+          dl[i] = (uchar)(downleft[i] * downleft[3] / 255.0f);
+          dr[i] = (uchar)(downright[i] * downright[3] / 255.0f);
+        }
+        l[3] = left[3];
+        r[3] = right[3];
+        dl[3] = downleft[3];
+        dr[3] = downright[3];
+
+        for (i = 0; i < 4; i++) {
+          new_ptr[i] = (uchar)((l[i] * leftf +
+                   r[i] * rightf) * upf +
+                   (dl[i] * leftf +
+                   dr[i] * rightf) * downf);
+        }
+
+        // ... and divide them again
+        if (new_ptr[3]) {
+          for (i = 0; i < 3; i++) {
+            new_ptr[i] = (uchar)(new_ptr[i] / (new_ptr[3] / 255.0f));
+          }
+        }
+      } else {
+        for (i = 0; i < d; i++) {
+          new_ptr[i] = (uchar)((left[i] * leftf +
+                   right[i] * rightf) * upf +
+                   (downleft[i] * leftf +
+                   downright[i] * rightf) * downf);
+        }
+      }
+    }
+  }
+}
+
+// Area-averaging scaling of rows y0 .. y1 - 1
+static void copy_area(const Fl_RGB_Copy &job, int y0, int y1) {
+  Fl_Image_Scaler scaler(job.sw, job.sh, job.d, job.W, job.H, job.dst);
+  scaler.rows(y0, y1);
+  while (!scaler.done() && scaler.src_row() < job.sh)
+    scaler.add_row(job.src + (size_t)scaler.src_row() * job.ld);
+}
+
+// Scale one band of rows (see Fl_System_Driver::run_parallel())
+static void copy_band(void *data, int band) {
+  const Fl_RGB_Copy &job = *(const Fl_RGB_Copy *)data;
+  int y0 = (int)((size_t)job.H * band / job.bands);
+  int y1 = (int)((size_t)job.H * (band + 1) / job.bands);
+  switch (job.method) {
+    case FL_RGB_SCALING_NEAREST:
+      copy_nearest(job, y0, y1);
+      break;
+    case FL_RGB_SCALING_BILINEAR:
+      copy_bilinear(job, y0, y1);
+      break;
+    default:
+      copy_area(job, y0, y1);
+      break;
+  }
+}
+
 Fl_Image *Fl_RGB_Image::copy(int W, int H) {
   Fl_RGB_Image  *new_image;     // New RGB image
   uchar         *new_array;     // New array for image data
@@ -428,22 +566,33 @@ Fl_Image *Fl_RGB_Image::copy(int W, int H) {
   if (W <= 0 || H <= 0) return 0;
 
   // OK, need to resize the image data; allocate memory and create new image
-  uchar         *new_ptr;       // Pointer into new array
-  const uchar   *old_ptr;       // Pointer into old array
-  int           dx, dy,         // Destination coordinates
-                line_d;         // stride from line to line
+  int           dx, dy;         // Destination coordinates
+  Fl_RGB_Copy   job;            // What the bands of rows need to know
 
   // Allocate memory for the new image...
   new_array = new uchar [W * H * d()];
   new_image = new Fl_RGB_Image(new_array, W, H, d());
   new_image->alloc_array = 1;
 
-  line_d = ld() ? ld() : data_w() * d();
-
-  if (Fl_Image::RGB_scaling() == FL_RGB_SCALING_NEAREST) {
-
-    int         c,              // Channel number
-                sy,             // Source coordinate
+  job.method = Fl_Image::RGB_scaling();
+  job.src    = array;
+  job.sw     = data_w();
+  job.sh     = data_h();
+  job.d      = d();
+  job.ld     = ld() ? ld() : data_w() * d();
+  job.dst    = new_array;
+  job.W      = W;
+  job.H      = H;
+  job.xi     = 0;
+  job.yi     = 0;
+  job.xr     = 0;
+  job.yd     = 0;
+  job.xf     = 0;
+  job.yf     = 0;
+
+  if (job.method == FL_RGB_SCALING_NEAREST) {
+
+    int         sx, sy,         // Source coordinates
                 xerr, yerr,     // X & Y errors
                 xmod, ymod,     // X & Y moduli
                 xstep, ystep;   // X & Y step increments
@@ -454,20 +603,20 @@ Fl_Image *Fl_RGB_Image::copy(int W, int H) {
     ymod   = data_h() % H;
     ystep  = data_h() / H;
 
-    // Scale the image using a nearest-neighbor algorithm...
-    for (dy = H, sy = 0, yerr = H, new_ptr = new_array; dy > 0; dy --) {
-      for (dx = W, xerr = W, old_ptr = array + sy * line_d; dx > 0; dx --) {
-        for (c = 0; c < d(); c ++) *new_ptr++ = old_ptr[c];
-
-        old_ptr += xstep;
-        xerr    -= xmod;
-
-        if (xerr <= 0) {
-          xerr    += W;
-          old_ptr += d();
-        }
+    // ... and the source pixel of each destination column and row
+    job.xi = new int[W];
+    for (dx = 0, sx = 0, xerr = W; dx < W; dx ++) {
+      job.xi[dx] = sx;
+      sx   += xstep;
+      xerr -= xmod;
+      if (xerr <= 0) {
+        xerr += W;
+        sx   += d();
       }
-
+    }
+    job.yi = new int[H];
+    for (dy = 0, sy = 0, yerr = H; dy < H; dy ++) {
+      job.yi[dy] = sy;
       sy   += ystep;
       yerr -= ymod;
       if (yerr <= 0) {
@@ -475,70 +624,50 @@ Fl_Image *Fl_RGB_Image::copy(int W, int H) {
         sy ++;
       }
     }
-  } else {
-    // Bilinear scaling (FL_RGB_SCALING_BILINEAR)
+  } else if (job.method == FL_RGB_SCALING_BILINEAR) {
+    // The source pixels and weights of each destination column and row
     const float xscale = (data_w() - 1) / (float) W;
     const float yscale = (data_h() - 1) / (float) H;
+    job.xi = new int[W];
+    job.xr = new int[W];
+    job.xf = new float[W];
+    for (dx = 0; dx < W; dx++) {
+      float oldx = dx * xscale;
+      if (oldx >= data_w())
+        oldx = float(data_w() - 1);
+      job.xf[dx] = oldx - (unsigned) oldx;
+      job.xi[dx] = (unsigned)oldx;
+      job.xr[dx] = (unsigned)(oldx + 1 >= data_w() ? oldx : oldx + 1);
+    }
+    job.yi = new int[H];
+    job.yd = new int[H];
+    job.yf = new float[H];
     for (dy = 0; dy < H; dy++) {
       float oldy = dy * yscale;
       if (oldy >= data_h())
         oldy = float(data_h() - 1);
-      const float yfract = oldy - (unsigned) oldy;
-
-      for (dx = 0; dx < W; dx++) {
-        new_ptr = new_array + dy * W * d() + dx * d();
-
-        float oldx = dx * xscale;
-        if (oldx >= data_w())
-          oldx = float(data_w() - 1);
-        const float xfract = oldx - (unsigned) oldx;
-
-        const unsigned leftx = (unsigned)oldx;
-        const unsigned lefty = (unsigned)oldy;
-        const unsigned rightx = (unsigned)(oldx + 1 >= data_w() ? oldx : oldx + 1);
-        const unsigned righty = (unsigned)oldy;
-        const unsigned dleftx = (unsigned)oldx;
-        const unsigned dlefty = (unsigned)(oldy + 1 >= data_h() ? oldy : oldy + 1);
-        const unsigned drightx = (unsigned)rightx;
-        const unsigned drighty = (unsigned)dlefty;
-
-        uchar left[4], right[4], downleft[4], downright[4];
-        memcpy(left, array + lefty * line_d + leftx * d(), d());
-        memcpy(right, array + righty * line_d + rightx * d(), d());
-        memcpy(downleft, array + dlefty * line_d + dleftx * d(), d());
-        memcpy(downright, array + drighty * line_d + drightx * d(), d());
-
-        int i;
-        if (d() == 4) {
-          for (i = 0; i < 3; i++) {
-            left[i] = (uchar)(left[i] * left[3] / 255.0f);
-            right[i] = (uchar)(right[i] * right[3] / 255.0f);
-            downleft[i] = (uchar)(downleft[i] * downleft[3] / 255.0f);
-            downright[i] = (uchar)(downright[i] * downright[3] / 255.0f);
-          }
-        }
-
-        const float leftf = 1 - xfract;
-        const float rightf = xfract;
-        const float upf = 1 - yfract;
-        const float downf = yfract;
-
-        for (i = 0; i < d(); i++) {
-          new_ptr[i] = (uchar)((left[i] * leftf +
-                   right[i] * rightf) * upf +
-                   (downleft[i] * leftf +
-                   downright[i] * rightf) * downf);
-        }
-
-        if (d() == 4 && new_ptr[3]) {
-          for (i = 0; i < 3; i++) {
-            new_ptr[i] = (uchar)(new_ptr[i] / (new_ptr[3] / 255.0f));
-          }
-        }
-      }
+      job.yf[dy] = oldy - (unsigned) oldy;
+      job.yi[dy] = (unsigned)oldy;
+      job.yd[dy] = (unsigned)(oldy + 1 >= data_h() ? oldy : oldy + 1);
     }
   }
 
+  // Scale large images in bands of rows in parallel
+  job.bands = 1;
+  if ((size_t)W * H >= 256 * 256) job.bands = H / 64 < 16 ? H / 64 : 16;
+  if (job.bands < 1) job.bands = 1; // short and wide images
+  if (job.bands > 1)
+    Fl::system_driver()->run_parallel(copy_band, &job, job.bands);
+  else
+    copy_band(&job, 0);
+
+  delete[] job.xi;
+  delete[] job.yi;
+  delete[] job.xr;
+  delete[] job.yd;
+  delete[] job.xf;
+  delete[] job.yf;
+
   return new_image;
 }
 
@@ -121,6 +121,21 @@ unsigned int Fl_Image_Reader::read_dword() {
 // Read a 32-bit signed integer, LSB-first
 // int Fl_Image_Reader::read_long() -- implementation in header file
 
+// Read up to n bytes into buf, return the number of bytes read
+int Fl_Image_Reader::read_block(uchar *buf, int n) {
+  if (n <= 0) {
+    return 0;
+  } else if (pIsFile) {
+    return (int)fread(buf, 1, n, pFile);
+  } else if (pIsData) {
+    memcpy(buf, pData, n);
+    pData += n;
+    return n;
+  } else {
+    return 0;
+  }
+}
+
 // Move the current read position to a byte offset from the beginning
 // of the file or the original start address in memory
 void Fl_Image_Reader::seek(unsigned int n) {
@@ -130,3 +145,15 @@ void Fl_Image_Reader::seek(unsigned int n) {
     pData = pStart + n;
   }
 }
+
+// Return the current read position as a byte offset from the beginning
+// of the file or the original start address in memory
+unsigned int Fl_Image_Reader::tell() const {
+  if (pIsFile) {
+    return (unsigned int)ftell(pFile);
+  } else if (pIsData) {
+    return (unsigned int)(pData - pStart);
+  } else {
+    return 0;
+  }
+}
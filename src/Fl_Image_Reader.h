@@ -64,10 +64,16 @@ public:
     return (int)read_dword();
   };
 
+  // Read up to n bytes into buf, return the number of bytes read
+  int read_block(unsigned char *buf, int n);
+
   // Move the current read position to a byte offset from the beginning
   // of the file or the original start address in memory
   void seek(unsigned int n);
 
+  // Return the current read position as a byte offset from the beginning
+  unsigned int tell() const;
+
   // return the name or filename for this reader
   const char *name() { return pName; }
 
@@ -0,0 +1,183 @@
+//
+// Internal (Image) Scaler class for the Fast Light Tool Kit (FLTK).
+//
+// Copyright 2021 by Bill Spitzak and others.
+//
+// This library is free software. Distribution and use rights are outlined in
+// the file "COPYING" which should have been included with this file.  If this
+// file is missing or damaged, see the license at:
+//
+//     https://www.fltk.org/COPYING.php
+//
+// Please see the following page on how to report bugs and issues:
+//
+//     https://www.fltk.org/bugs.php
+//
+
+
+//
+// Include necessary header files...
+//
+
+#include "Fl_Image_Scaler.h"
+
+#include <string.h>
+
+/*
+  This internal (undocumented) class scales image data row by row while
+  it is being decoded, so that the image in its original size is never
+  stored in memory.
+
+  Source pixel i covers [i * dw, (i + 1) * dw) and destination pixel j
+  covers [j * sw, (j + 1) * sw) of the same range [0, sw * dw), and
+  likewise for rows. A source pixel contributes to a destination pixel
+  with the size of the overlap of both ranges.
+
+  Colors with an alpha channel (depth 2 and 4) are premultiplied by alpha
+  while they are added up, so that the colors of transparent pixels don't
+  bleed into the visible ones, and divided by the alpha sum when a row is
+  complete.
+*/
+
+// Create the scaler and compute the weights of the source columns
+Fl_Image_Scaler::Fl_Image_Scaler(int sw, int sh, int d, int dw, int dh, unsigned char *dst) :
+  pSrcW(sw), pSrcH(sh),
+  pDepth(d),
+  pDstW(dw), pDstH(dh),
+  pDst(dst),
+  pSrcY(0), pDstY(0), pDstEnd(dh)
+{
+  pFirst  = new int[dw];
+  pCount  = new int[dw];
+  pWeight = new unsigned int[sw + dw];
+  pRow    = new float[dw * d];
+  pSum    = new float[dw * d];
+  pBuffer = new unsigned char[sw * d];
+  memset(pSum, 0, dw * d * sizeof(float));
+
+  int i = 0, k = 0;
+  for (int j = 0; j < dw; j ++) {
+    double a = (double)j * sw, b = a + sw;
+    while ((double)(i + 1) * dw <= a) i ++;
+    pFirst[j] = i;
+    pCount[j] = 0;
+    for (int s = i; s < sw && (double)s * dw < b; s ++) {
+      double lo = (double)s * dw, hi = lo + dw;
+      if (lo < a) lo = a;
+      if (hi > b) hi = b;
+      pWeight[k ++] = (unsigned int)(hi - lo);
+      pCount[j] ++;
+    }
+  }
+}
+
+// Destroy the scaler
+Fl_Image_Scaler::~Fl_Image_Scaler()
+{
+  delete[] pFirst;
+  delete[] pCount;
+  delete[] pWeight;
+  delete[] pRow;
+  delete[] pSum;
+  delete[] pBuffer;
+}
+
+// Compute only destination rows first to last - 1, e.g. to scale bands
+// of an image in parallel
+void Fl_Image_Scaler::rows(int first, int last)
+{
+  pDstY = first;
+  pDstEnd = last < pDstH ? last : pDstH;
+  pSrcY = (int)((double)first * pSrcH / pDstH); // first overlapping source row
+  memset(pSum, 0, pDstW * pDepth * sizeof(float));
+}
+
+// Scale the next source row horizontally and add it to the destination
+// rows it overlaps
+void Fl_Image_Scaler::add_row(const unsigned char *row)
+{
+  int j, c, s;
+  const int d = pDepth;
+
+  if (pSrcY >= pSrcH || pDstY >= pDstEnd) return;
+
+  // Scale the row horizontally...
+  const unsigned int *w = pWeight;
+  const float scale = 1.0f / pSrcW;
+  float *out = pRow;
+  unsigned int sum[4];
+  float fsum[4];
+  for (j = 0; j < pDstW; j ++, out += d) {
+    const unsigned char *in = row + pFirst[j] * d;
+    s = pCount[j];
+    switch (d) {
+      case 3: // RGB, the most common case (JPEG)
+        sum[0] = sum[1] = sum[2] = 0;
+        for (; s > 0; s --, w ++, in += 3) {
+          sum[0] += *w * in[0];
+          sum[1] += *w * in[1];
+          sum[2] += *w * in[2];
+        }
+        break;
+      case 2: // gray + alpha: premultiply the gray value by alpha
+        fsum[0] = fsum[1] = 0.0f;
+        for (; s > 0; s --, w ++, in += 2) {
+          float a = (float)(*w * in[1]);
+          fsum[0] += a * in[0];
+          fsum[1] += a;
+        }
+        out[0] = fsum[0] * scale * (1.0f / 255.0f);
+        out[1] = fsum[1] * scale;
+        continue;
+      case 4: // RGBA: premultiply the colors by alpha
+        fsum[0] = fsum[1] = fsum[2] = fsum[3] = 0.0f;
+        for (; s > 0; s --, w ++, in += 4) {
+          float a = (float)(*w * in[3]);
+          fsum[0] += a * in[0];
+          fsum[1] += a * in[1];
+          fsum[2] += a * in[2];
+          fsum[3] += a;
+        }
+        for (c = 0; c < 3; c ++) out[c] = fsum[c] * scale * (1.0f / 255.0f);
+        out[3] = fsum[3] * scale;
+        continue;
+      default:
+        for (c = 0; c < d; c ++) sum[c] = 0;
+        for (; s > 0; s --, w ++, in += d) {
+          for (c = 0; c < d; c ++) sum[c] += *w * in[c];
+        }
+        break;
+    }
+    for (c = 0; c < d; c ++) out[c] = sum[c] * scale;
+  }
+
+  // ... and add it to the destination rows it overlaps
+  double y0 = (double)pSrcY * pDstH, y1 = y0 + pDstH;
+  pSrcY ++;
+  while (pDstY < pDstEnd) {
+    double r0 = (double)pDstY * pSrcH, r1 = r0 + pSrcH;
+    double lo = y0 > r0 ? y0 : r0, hi = y1 < r1 ? y1 : r1;
+    if (hi > lo) {
+      float wy = (float)((hi - lo) / pSrcH);
+      for (j = 0; j < pDstW * d; j ++) pSum[j] += wy * pRow[j];
+    }
+    if (r1 > y1) break; // the destination row needs more source rows
+
+    // The destination row is complete
+    unsigned char *dst = pDst + (size_t)pDstY * pDstW * d;
+    if (d == 2 || d == 4) { // undo the premultiplication by alpha
+      float *p = pSum;
+      for (j = 0; j < pDstW; j ++, p += d) {
+        float a = p[d - 1];
+        float f = a > 0.0f ? 255.0f / a : 0.0f;
+        for (c = 0; c < d - 1; c ++) p[c] *= f;
+      }
+    }
+    for (j = 0; j < pDstW * d; j ++) {
+      float v = pSum[j] + 0.5f;
+      dst[j] = v >= 255.0f ? 255 : v <= 0.0f ? 0 : (unsigned char)v;
+      pSum[j] = 0.0f;
+    }
+    pDstY ++;
+  }
+}
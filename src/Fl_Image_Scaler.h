@@ -0,0 +1,96 @@
+//
+// Internal (Image) Scaler class for the Fast Light Tool Kit (FLTK).
+//
+// Copyright 2021 by Bill Spitzak and others.
+//
+// This library is free software. Distribution and use rights are outlined in
+// the file "COPYING" which should have been included with this file.  If this
+// file is missing or damaged, see the license at:
+//
+//     https://www.fltk.org/COPYING.php
+//
+// Please see the following page on how to report bugs and issues:
+//
+//     https://www.fltk.org/bugs.php
+//
+
+/*
+  This internal (undocumented) class scales image data row by row while
+  it is being decoded, so that the image in its original size is never
+  stored in memory.
+
+  Each destination pixel is the average of the source pixels it covers
+  (area averaging), which is well suited to make thumbnails of large
+  images. Fractions of source pixels are weighted accordingly, hence the
+  image can also be enlarged.
+
+  This class is used in Fl_JPEG_Image and Fl_PNG_Image to load images in
+  a given size, and by Fl_RGB_Image::copy() for FL_RGB_SCALING_AREA.
+*/
+
+#ifndef FL_IMAGE_SCALER_H
+#define FL_IMAGE_SCALER_H
+
+#include <FL/Fl_Export.H>
+
+class FL_EXPORT Fl_Image_Scaler
+{
+public:
+  // Create the scaler for an image of sw x sh pixels with d (1..4) channels
+  // that is scaled to dw x dh pixels, stored in dst (dw * dh * d bytes).
+  Fl_Image_Scaler(int sw, int sh, int d, int dw, int dh, unsigned char *dst);
+
+  // Destroy the scaler
+  ~Fl_Image_Scaler();
+
+  // Return a buffer for one source row (sw * d bytes) for use with add_row()
+  unsigned char *buffer() { return pBuffer; }
+
+  // Add the next source row (sw * d bytes), the destination rows are
+  // stored as soon as they are complete
+  void add_row(const unsigned char *row);
+
+  // Add the source row in buffer()
+  void add_row() { add_row(pBuffer); }
+
+  // Compute only destination rows first to last - 1: source rows must then
+  // be added starting with src_row()
+  void rows(int first, int last);
+
+  // Return the next source row to add
+  int src_row() const { return pSrcY; }
+
+  // Return 1 if all destination rows have been stored
+  int done() const { return pDstY >= pDstEnd; }
+
+private:
+
+  // size of the source image
+  int pSrcW, pSrcH;
+  // number of channels
+  int pDepth;
+  // size of the destination image
+  int pDstW, pDstH;
+  // destination image data
+  unsigned char *pDst;
+  // for each destination column: index of the first source column used
+  int *pFirst;
+  // for each destination column: number of source columns used
+  int *pCount;
+  // weights of the source columns used (sum is pSrcW for each destination column)
+  unsigned int *pWeight;
+  // the current source row, scaled horizontally (pDstW * pDepth values)
+  float *pRow;
+  // the current destination row being summed up (pDstW * pDepth values)
+  float *pSum;
+  // number of source rows added
+  int pSrcY;
+  // the current destination row
+  int pDstY;
+  // the destination row after the last one to compute
+  int pDstEnd;
+  // a source row buffer (see buffer())
+  unsigned char *pBuffer;
+};
+
+#endif // FL_IMAGE_SCALER_H
@@ -31,6 +31,54 @@ static int l_secret;
 
 extern void fl_draw(const char*, int, float, float);
 
+/* \internal
+  Layout of the text in lines, as drawn by drawtext().
+
+  Lines end where expand() stops: at newlines, where the text is wrapped,
+  and where the expanded text does not fit into the buffer. replace() only
+  moves the lines after the change and remembers which text was changed,
+  update_lines() lays out these lines again when they are needed next.
+*/
+struct Fl_Input_Line {
+  int start;            // index of the first byte of the line
+  int end;              // index after the last byte of the line
+  int width;            // width of the line in pixels, or -1 if not measured
+};
+
+struct Fl_Input_Lines {
+  Fl_Input_Line *line;  // the lines
+  int n;                // number of lines
+  int alloc;            // number of lines allocated
+  int valid;            // 0 if all text must be laid out again
+  int dirty_start;      // first index that must be laid out again, or -1
+  int dirty_end;        // index after the changed text
+  uchar type;           // type() used for the layout
+  int wrap_w;           // wrap width used for the layout, or 0
+  Fl_Font font;         // font used for the line widths
+  Fl_Fontsize size;     // font size used for the line widths
+
+  Fl_Input_Lines() : line(0), n(0), alloc(0), valid(0), dirty_start(-1),
+    dirty_end(-1), type(0), wrap_w(0), font(0), size(0) { }
+  ~Fl_Input_Lines() { free(line); }
+
+  void reserve(int k) {
+    if (k <= alloc) return;
+    if (!alloc) alloc = 16;
+    while (alloc < k) alloc *= 2;
+    line = (Fl_Input_Line*)realloc(line, alloc*sizeof(Fl_Input_Line));
+  }
+
+  // Returns the first line that ends at or after index i.
+  int find(int i) const {
+    int lo = 0, hi = n-1;
+    while (lo < hi) {
+      int m = (lo+hi)/2;
+      if (line[m].end < i) lo = m+1; else hi = m;
+    }
+    return lo;
+  }
+};
+
 ////////////////////////////////////////////////////////////////
 
 /** \internal
@@ -199,6 +247,117 @@ void Fl_Input_::setfont() const {
   fl_font(textfont(), textsize());
 }
 
+/** \internal
+  Updates the layout of the text in lines and returns it.
+
+  Only the lines changed by replace() since the last call are laid out
+  again, from the line before the first change until the new layout meets
+  the start of an old line after the changes. All lines are laid out again
+  if the text was set by value() or static_value(), or if the widget type,
+  its width or, for wrapped text, its font changed.
+
+  \return the lines of the current text, always at least one
+*/
+Fl_Input_Lines *Fl_Input_::update_lines() const {
+  Fl_Input_Lines *li = lines_;
+  if (!li) li = ((Fl_Input_*)this)->lines_ = new Fl_Input_Lines;
+  int wrap_w = wrap() ? w() - Fl::box_dw(box()) - 2 : 0;
+  if (li->type != type() || li->wrap_w != wrap_w) li->valid = 0;
+  if (li->font != textfont() || li->size != textsize()) {
+    if (wrap_w) li->valid = 0;
+    for (int k = 0; k < li->n; k++) li->line[k].width = -1;
+    li->font = textfont();
+    li->size = textsize();
+  }
+  if (li->valid && li->dirty_start < 0) return li;
+
+  if (wrap_w) setfont();
+  // lay out new lines replacing the old lines k0 ... j-1:
+  int k0 = 0, j = li->n, stop = -1;
+  if (li->valid) {
+    k0 = li->find(li->dirty_start);
+    j = k0 + 1;
+    stop = li->dirty_end;
+  }
+  Fl_Input_Line *nl = 0;
+  int nn = 0, na = 0;
+  char buf[MAXBUF];
+  const char *p = value() + (li->valid ? li->line[k0].start : 0);
+  for (;;) {
+    const char *e = expand(p, buf);
+    if (nn >= na) {
+      na = na ? 2*na : 16;
+      nl = (Fl_Input_Line*)realloc(nl, na*sizeof(Fl_Input_Line));
+    }
+    nl[nn].start = (int)(p-value());
+    nl[nn].end = (int)(e-value());
+    nl[nn].width = -1;
+    nn++;
+    if (e >= value_+size_) {j = li->n; break;}
+    // the next line starts after a newline or a space:
+    if (*e == '\n' || *e == ' ' || e == p) e++;
+    p = e;
+    if (stop >= 0) {
+      // stop where an old line after the changes starts:
+      int i = (int)(p-value());
+      while (j < li->n && li->line[j].start < i) j++;
+      if (i > stop && j < li->n && li->line[j].start == i) break;
+    }
+  }
+  int tail = li->n - j;
+  li->reserve(k0 + nn + tail);
+  memmove(li->line + k0 + nn, li->line + j, tail*sizeof(Fl_Input_Line));
+  memcpy(li->line + k0, nl, nn*sizeof(Fl_Input_Line));
+  li->n = k0 + nn + tail;
+  free(nl);
+
+  li->valid = 1;
+  li->dirty_start = li->dirty_end = -1;
+  li->type = type();
+  li->wrap_w = wrap_w;
+  return li;
+}
+
+/** \internal
+  Updates the layout of the lines after text was replaced.
+
+  This moves the lines after the replaced text and remembers the changed
+  text for the next update_lines(). The text from \p b to \p e was
+  replaced by \p ilen bytes.
+*/
+void Fl_Input_::lines_replaced(int b, int e, int ilen) {
+  Fl_Input_Lines *li = lines_;
+  if (!li || !li->valid) return;
+  int d = ilen - (e-b);
+  // kb is the line with the change, the following lines up to ke-1 start
+  // in the replaced text and are removed:
+  int kb = li->find(b);
+  int ke = kb + 1;
+  while (ke < li->n && li->line[ke].start <= e) ke++;
+  int end = li->line[ke-1].end >= e ? li->line[ke-1].end + d : b + ilen;
+  for (int k = ke; k < li->n; k++) {
+    li->line[k].start += d;
+    li->line[k].end += d;
+  }
+  if (ke > kb+1) {
+    memmove(li->line + kb + 1, li->line + ke, (li->n-ke)*sizeof(Fl_Input_Line));
+    li->n -= ke - kb - 1;
+  }
+  li->line[kb].end = end;
+  li->line[kb].width = -1;
+  // wrapped text may move up to the line before:
+  int ds = li->line[kb > 0 ? kb-1 : 0].start, de = b + ilen;
+  if (li->dirty_start >= 0) {
+    int os = li->dirty_start, oe = li->dirty_end;
+    if (os > e) os += d; else if (os > b) os = b;
+    if (oe > e) oe += d; else if (oe > b) oe = b + ilen;
+    if (os < ds) ds = os;
+    if (oe > de) de = oe;
+  }
+  li->dirty_start = ds;
+  li->dirty_end = de;
+}
+
 /**
   Draws the text in the passed bounding box.
 
@@ -232,38 +391,35 @@ void Fl_Input_::drawtext(int X, int Y, int W, int H) {
   const char *p, *e;
   char buf[MAXBUF];
 
-  // count how many lines and put the last one into the buffer:
-  // And figure out where the cursor is:
+  // find the line with the cursor and figure out where the cursor is:
   int height = fl_height();
   int threshold = height/2;
-  int lines;
-  int curx, cury;
-  for (p=value(), curx=cury=lines=0; ;) {
-    e = expand(p, buf);
-    if (position() >= p-value() && position() <= e-value()) {
-      curx = int(expandpos(p, value()+position(), buf, 0)+.5);
-      if (Fl::focus()==this && !was_up_down) up_down_pos = curx;
-      cury = lines*height;
-      int newscroll = xscroll_;
-      if (curx > newscroll+W-threshold) {
-        // figure out scrolling so there is space after the cursor:
-        newscroll = curx+threshold-W;
-        // figure out the furthest left we ever want to scroll:
-        int ex = int(expandpos(p, e, buf, 0))+4-W;
-        // use minimum of both amounts:
-        if (ex < newscroll) newscroll = ex;
-      } else if (curx < newscroll+threshold) {
-        newscroll = curx-threshold;
-      }
-      if (newscroll < 0) newscroll = 0;
-      if (newscroll != xscroll_) {
-        xscroll_ = newscroll;
-        mu_p = 0; erase_cursor_only = 0;
-      }
-    }
-    lines++;
-    if (e >= value_+size_) break;
-    p = e+1;
+  Fl_Input_Lines *li = update_lines();
+  int k = li->find(position());
+  // a line that does not start after a newline or space may start there, too:
+  if (k+1 < li->n && li->line[k+1].start <= position()) k++;
+  Fl_Input_Line &cl = li->line[k];
+  p = value() + cl.start;
+  e = expand(p, buf);
+  int curx = int(expandpos(p, value()+position(), buf, 0)+.5);
+  if (Fl::focus()==this && !was_up_down) up_down_pos = curx;
+  int cury = k*height;
+  int newscroll = xscroll_;
+  if (curx > newscroll+W-threshold) {
+    // figure out scrolling so there is space after the cursor:
+    newscroll = curx+threshold-W;
+    // figure out the furthest left we ever want to scroll:
+    if (cl.width < 0) cl.width = int(expandpos(p, e, buf, 0));
+    int ex = cl.width+4-W;
+    // use minimum of both amounts:
+    if (ex < newscroll) newscroll = ex;
+  } else if (curx < newscroll+threshold) {
+    newscroll = curx-threshold;
+  }
+  if (newscroll < 0) newscroll = 0;
+  if (newscroll != xscroll_) {
+    xscroll_ = newscroll;
+    mu_p = 0; erase_cursor_only = 0;
   }
 
   // adjust the scrolling:
@@ -280,15 +436,16 @@ void Fl_Input_::drawtext(int X, int Y, int W, int H) {
   fl_push_clip(X, Y, W, H);
   Fl_Color tc = active_r() ? textcolor() : fl_inactive(textcolor());
 
-  p = value();
-  // visit each line and draw it:
+  // visit each visible line and draw it:
   int desc = height-fl_descent();
   float xpos = (float)(X - xscroll_ + 1);
-  int ypos = -yscroll_;
-  for (; ypos < H;) {
+  k = yscroll_ > 0 ? yscroll_/height : 0;
+  if (k >= li->n) k = li->n-1;
+  int ypos = k*height - yscroll_;
+  for (; ypos < H; k++) {
 
-    // re-expand line unless it is the last one calculated above:
-    if (lines>1) e = expand(p, buf);
+    p = value() + li->line[k].start;
+    e = expand(p, buf);
 
     if (ypos <= -height) goto CONTINUE; // clipped off top
 
@@ -381,9 +538,7 @@ void Fl_Input_::drawtext(int X, int Y, int W, int H) {
 
   CONTINUE:
     ypos += height;
-    if (e >= value_+size_) break;
-    if (*e == '\n' || *e == ' ') e++;
-    p = e;
+    if (k+1 >= li->n) break;
   }
 
   // for minimal update, erase all lines below last one if necessary:
@@ -464,18 +619,9 @@ int Fl_Input_::line_end(int i) const {
   if (input_type() != FL_MULTILINE_INPUT) return size();
 
   if (wrap()) {
-    // go to the start of the paragraph:
-    int j = i;
-    while (j > 0 && index(j-1) != '\n') j--;
-    // now measure lines until we get past i, end of that line is real eol:
-    setfont();
-    for (const char* p=value()+j; ;) {
-      char buf[MAXBUF];
-      p = expand(p, buf);
-      int k = (int) (p-value());
-      if (k >= i) return k;
-      p++;
-    }
+    // the first line that ends at or after i:
+    Fl_Input_Lines *li = update_lines();
+    return li->line[li->find(i)].end;
   } else {
     while (i < size() && index(i) != '\n') i++;
     return i;
@@ -493,18 +639,14 @@ int Fl_Input_::line_end(int i) const {
 */
 int Fl_Input_::line_start(int i) const {
   if (input_type() != FL_MULTILINE_INPUT) return 0;
+  if (wrap()) {
+    // the first line that ends at or after i:
+    Fl_Input_Lines *li = update_lines();
+    return li->line[li->find(i)].start;
+  }
   int j = i;
   while (j > 0 && index(j-1) != '\n') j--;
-  if (wrap()) {
-    // now measure lines until we get past i, start of that line is real eol:
-    setfont();
-    for (const char* p=value()+j; ;) {
-      char buf[MAXBUF];
-      const char* e = expand(p, buf);
-      if ((int) (e-value()) >= i) return (int) (p-value());
-      p = e+1;
-    }
-  } else return j;
+  return j;
 }
 
 static int strict_word_start(const char *s, int i, int itype) {
@@ -537,12 +679,11 @@ void Fl_Input_::handle_mouse(int X, int Y, int /*W*/, int /*H*/, int drag) {
     (Fl::event_y()-Y+yscroll_)/fl_height() : 0;
 
   int newpos = 0;
-  for (p=value();; ) {
-    e = expand(p, buf);
-    theline--; if (theline < 0) break;
-    if (e >= value_+size_) break;
-    p = e+1;
-  }
+  Fl_Input_Lines *li = update_lines();
+  if (theline < 0) theline = 0;
+  if (theline >= li->n) theline = li->n-1;
+  p = value() + li->line[theline].start;
+  e = expand(p, buf);
   const char *l, *r, *t; double f0 = Fl::event_x()-X+xscroll_;
   for (l = p, r = e; l<r; ) {
     double f;
@@ -721,24 +862,163 @@ int Fl_Input_::copy(int clipboard) {
 
 #define MAXFLOATSIZE 40
 
-static char* undobuffer;
-static int undobufferlength;
-static Fl_Input_* undowidget;
-static int undoat;      // points after insertion
-static int undocut;     // number of characters deleted there
-static int undoinsert;  // number of characters inserted
-static int yankcut;     // length of valid contents of buffer, even if undocut=0
-
-static void undobuffersize(int n) {
-  if (n > undobufferlength) {
-    if (undobuffer) {
-      do {undobufferlength *= 2;} while (undobufferlength < n);
-      undobuffer = (char*)realloc(undobuffer, undobufferlength);
+/* \internal
+  Changes of the text for undo() and redo().
+
+  Every change replaced \c cut bytes at index \c at by \c insert bytes.
+  The removed bytes of all changes of a stack are kept in one buffer, in
+  the order of the changes, so that the text of the last change is at the
+  end. The inserted bytes are in the text of the widget. undo() takes the
+  last change from the undo stack, puts the removed text back and pushes
+  the opposite change to the redo stack, redo() does the same the other
+  way round.
+*/
+struct Fl_Input_Undo_Op {
+  int at;               // index of the change
+  int cut;              // number of bytes removed
+  int insert;           // number of bytes inserted
+};
+
+struct Fl_Input_Undo_Stack {
+  Fl_Input_Undo_Op *op; // the changes, oldest first
+  int n;                // number of changes
+  int alloc;            // number of changes allocated
+  char *text;           // removed bytes of all changes
+  int size;             // number of removed bytes
+  int text_alloc;       // number of bytes allocated
+
+  Fl_Input_Undo_Stack() : op(0), n(0), alloc(0), text(0), size(0), text_alloc(0) { }
+  ~Fl_Input_Undo_Stack() { free(op); free(text); }
+
+  void clear() { n = size = 0; }
+  // Overwrites all removed bytes, including the ones of forgotten changes.
+  void wipe() { if (text) memset(text, 0, text_alloc); clear(); }
+  // Returns the memory needed for the changes.
+  int bytes() const { return size + n*(int)sizeof(Fl_Input_Undo_Op); }
+  Fl_Input_Undo_Op *top() { return n ? op+n-1 : 0; }
+  const char *top_text() const { return text + size - op[n-1].cut; }
+
+  void reserve_text(int k) {
+    if (size + k <= text_alloc) return;
+    if (!text_alloc) text_alloc = 256;
+    while (text_alloc < size + k) text_alloc *= 2;
+    text = (char*)realloc(text, text_alloc);
+  }
+
+  void push(int at, const char *t, int cut, int insert) {
+    if (n >= alloc) {
+      alloc = alloc ? 2*alloc : 16;
+      op = (Fl_Input_Undo_Op*)realloc(op, alloc*sizeof(Fl_Input_Undo_Op));
+    }
+    reserve_text(cut);
+    memcpy(text+size, t, cut);
+    size += cut;
+    op[n].at = at;
+    op[n].cut = cut;
+    op[n].insert = insert;
+    n++;
+  }
+
+  void pop() { size -= op[n-1].cut; n--; }
+
+  // Adds removed bytes after the removed bytes of the last change.
+  void append_cut(const char *t, int k) {
+    reserve_text(k);
+    memcpy(text+size, t, k);
+    size += k;
+    op[n-1].cut += k;
+  }
+
+  // Adds removed bytes before the removed bytes of the last change.
+  void prepend_cut(const char *t, int k) {
+    reserve_text(k);
+    char *p = text + size - op[n-1].cut;
+    memmove(p+k, p, op[n-1].cut);
+    memcpy(p, t, k);
+    size += k;
+    op[n-1].cut += k;
+  }
+
+  // Forgets the k oldest changes.
+  void drop(int k) {
+    if (k <= 0) return;
+    int m = 0;
+    for (int i = 0; i < k; i++) m += op[i].cut;
+    memmove(text, text+m, size-m);
+    size -= m;
+    memmove(op, op+k, (n-k)*sizeof(Fl_Input_Undo_Op));
+    n -= k;
+  }
+};
+
+struct Fl_Input_Undo {
+  Fl_Input_Undo_Stack undo;     // changes that can be undone, last on top
+  Fl_Input_Undo_Stack redo;     // changes that can be redone, next on top
+  int coalesce;                 // 1 if the next change may be added to the last one
+  Fl_Input_Undo() : coalesce(0) { }
+};
+
+/*
+  Forgets the oldest changes of the undo stack, and then the changes of the
+  redo stack that would be redone last, until all changes fit into limit
+  bytes. The top change of the stack \p last is always kept. Secret input
+  widgets only keep this change, so that the removed text of a password
+  is not kept longer than with a single level of undo.
+*/
+static void trim_undo(Fl_Input_Undo *u, int limit, Fl_Input_Undo_Stack *last) {
+  int bytes = u->undo.bytes() + u->redo.bytes();
+  Fl_Input_Undo_Stack *stack[2] = { &u->undo, &u->redo };
+  for (int i = 0; i < 2; i++) {
+    Fl_Input_Undo_Stack *st = stack[i];
+    int k = 0, keep = (st == last) ? 1 : 0;
+    for (; bytes > limit && k < st->n - keep; k++)
+      bytes -= st->op[k].cut + (int)sizeof(Fl_Input_Undo_Op);
+    st->drop(k);
+  }
+}
+
+/** \internal
+  Records a change of the text for undo().
+
+  This must be called before the text from \p b to \p e is replaced by
+  \p ilen bytes of \p text. The change is added to the last change if it
+  continues it: typing or deleting more text at the same place. Typing
+  the first character of a word after a space starts a new change, so that
+  typed text is undone word by word. This forgets all changes that could
+  be redone.
+*/
+void Fl_Input_::record_change(int b, int e, const char *text, int ilen) {
+  if (e <= b && !ilen) return;
+  if (!undo_) undo_ = new Fl_Input_Undo;
+  Fl_Input_Undo *u = undo_;
+  Fl_Input_Undo_Stack &st = u->undo;
+  u->redo.clear();
+  int cut = e-b;
+  Fl_Input_Undo_Op *t = u->coalesce ? st.top() : 0;
+  if (t) {
+    int end = t->at + t->insert; // end of the inserted text
+    if (cut && !ilen && b == end) {
+      // deleting forward after the last change:
+      st.append_cut(value_+b, cut);
+    } else if (cut && !ilen && e == end && !t->insert) {
+      // deleting backward before the last deletion:
+      st.prepend_cut(value_+b, cut);
+      t->at = b;
+    } else if (cut && !ilen && e == end && cut <= t->insert) {
+      // deleting backward into the inserted text:
+      t->insert -= cut;
+    } else if (!cut && b == end &&
+               !(b > 0 && isspace(value_[b-1] & 255) && !isspace(text[0] & 255))) {
+      // typing more text:
+      t->insert += ilen;
     } else {
-      undobufferlength = n+9;
-      undobuffer = (char*)malloc(undobufferlength);
+      t = 0;
     }
+    if (t && !t->cut && !t->insert) st.pop();
   }
+  if (!t) st.push(b, value_+b, cut, ilen);
+  u->coalesce = 1;
+  trim_undo(u, input_type()==FL_SECRET_INPUT ? 0 : undo_limit_, &st);
 }
 
 /**
@@ -830,10 +1110,12 @@ int Fl_Input_::replace(int b, int e, const char* text, int ilen) {
   if (e<=b && !ilen) return 0; // don't clobber undo for a null operation
 
   // we must count UTF-8 *characters* to determine whether we can insert
-  // the full text or only a part of it (and how much this would be)
+  // the full text or only a part of it (and how much this would be),
+  // unless even the number of bytes is within maximum_size()
 
   int nchars = 0;       // characters in value() - deleted + inserted
   const char *p = value_;
+  if (size_-(e-b)+ilen <= maximum_size()) p = value_+size_;
   while (p < (char *)(value_+size_)) {
     if (p == (char *)(value_+b)) { // skip removed part
       p = (char *)(value_+e);
@@ -855,48 +1137,24 @@ int Fl_Input_::replace(int b, int e, const char* text, int ilen) {
   }
   ilen = nlen;
 
+  record_change(b, e, text, ilen);
   put_in_buffer(size_+ilen);
 
   if (e>b) {
-    if (undowidget == this && b == undoat) {
-      undobuffersize(undocut+(e-b));
-      memcpy(undobuffer+undocut, value_+b, e-b);
-      undocut += e-b;
-    } else if (undowidget == this && e == undoat && !undoinsert) {
-      undobuffersize(undocut+(e-b));
-      memmove(undobuffer+(e-b), undobuffer, undocut);
-      memcpy(undobuffer, value_+b, e-b);
-      undocut += e-b;
-    } else if (undowidget == this && e == undoat && (e-b)<undoinsert) {
-      undoinsert -= e-b;
-    } else {
-      undobuffersize(e-b);
-      memcpy(undobuffer, value_+b, e-b);
-      undocut = e-b;
-      undoinsert = 0;
-    }
     memmove(buffer+b, buffer+e, size_-e+1);
     size_ -= e-b;
-    undowidget = this;
-    undoat = b;
-    if (input_type() == FL_SECRET_INPUT) yankcut = 0; else yankcut = undocut;
   }
 
   if (ilen) {
-    if (undowidget == this && b == undoat)
-      undoinsert += ilen;
-    else {
-      undocut = 0;
-      undoinsert = ilen;
-    }
     memmove(buffer+b+ilen, buffer+b, size_-b+1);
     memcpy(buffer+b, text, ilen);
     size_ += ilen;
   }
-  undowidget = this;
+  lines_replaced(b, e, ilen);
   om = mark_;
   op = position_;
-  mark_ = position_ = undoat = b+ilen;
+  int end = b+ilen;
+  mark_ = position_ = end;
 
   // Insertions into the word at the end of the line will cause it to
   // wrap to the next line, so we must indicate that the changes may start
@@ -920,7 +1178,7 @@ int Fl_Input_::replace(int b, int e, const char* text, int ilen) {
 
   minimal_update(b);
 
-  mark_ = position_ = undoat;
+  mark_ = position_ = end;
 
   set_changed();
   if (when()&FL_WHEN_CHANGED) do_callback();
@@ -930,42 +1188,77 @@ int Fl_Input_::replace(int b, int e, const char* text, int ilen) {
 /**
   Undoes previous changes to the text buffer.
 
-  This call undoes a number of previous calls to replace().
+  Every call undoes one more change made by replace() and the functions
+  using it, until the text is the one set by value() or static_value(),
+  or until undo_limit() was reached. Typing and deleting text at the same
+  place is undone word by word.
 
   \return non-zero if any change was made.
+  \see redo(), can_undo(), undo_limit()
 */
 int Fl_Input_::undo() {
-  was_up_down = 0;
-  if ( undowidget != this || (!undocut && !undoinsert) ) return 0;
+  return undo_redo(0);
+}
+
+/**
+  Redoes the changes undone by undo().
 
-  int ilen = undocut;
-  int xlen = undoinsert;
-  int b = undoat-xlen;
-  int b1 = b;
+  Every call redoes the last change undone by undo(). Changes can be
+  redone until the text is changed otherwise.
 
-  put_in_buffer(size_+ilen);
+  \return non-zero if any change was made.
+  \see undo(), can_redo()
+*/
+int Fl_Input_::redo() {
+  return undo_redo(1);
+}
 
-  if (ilen) {
-    memmove(buffer+b+ilen, buffer+b, size_-b+1);
-    memcpy(buffer+b, undobuffer, ilen);
-    size_ += ilen;
-    b += ilen;
-  }
+/**
+  Returns non-zero if there is a change that undo() can undo.
+  \see undo()
+*/
+int Fl_Input_::can_undo() const {
+  return undo_ && undo_->undo.n;
+}
 
-  if (xlen) {
-    undobuffersize(xlen);
-    memcpy(undobuffer, buffer+b, xlen);
-    memmove(buffer+b, buffer+b+xlen, size_-xlen-b+1);
-    size_ -= xlen;
-  }
+/**
+  Returns non-zero if there is a change that redo() can redo.
+  \see redo()
+*/
+int Fl_Input_::can_redo() const {
+  return undo_ && undo_->redo.n;
+}
+
+/** \internal
+  Undoes the last change of the undo stack or redoes the next change of
+  the redo stack, and pushes the opposite change to the other stack.
 
-  undocut = xlen;
-  if (xlen) yankcut = xlen;
-  undoinsert = ilen;
-  undoat = b;
-  mark_ = b /* -ilen */;
+  \param [in] redo 0 to undo, 1 to redo a change
+  \return non-zero if any change was made.
+*/
+int Fl_Input_::undo_redo(int redo) {
+  was_up_down = 0;
+  if (!undo_) return 0;
+  Fl_Input_Undo_Stack &from = redo ? undo_->redo : undo_->undo;
+  Fl_Input_Undo_Stack &to = redo ? undo_->undo : undo_->redo;
+  if (!from.n) return 0;
+
+  Fl_Input_Undo_Op o = *from.top();
+  to.push(o.at, value_+o.at, o.insert, o.cut);
+  put_in_buffer(size_+o.cut);
+  memmove(buffer+o.at+o.cut, buffer+o.at+o.insert, size_-o.at-o.insert+1);
+  memcpy(buffer+o.at, from.top_text(), o.cut);
+  size_ += o.cut - o.insert;
+  from.pop();
+  lines_replaced(o.at, o.at+o.insert, o.cut);
+  undo_->coalesce = 0;
+  trim_undo(undo_, input_type()==FL_SECRET_INPUT ? 0 : undo_limit_, &to);
+
+  int b = o.at + o.cut;
+  mark_ = b;
   position_ = b;
 
+  int b1 = o.at;
   if (wrap())
     while (b1 > 0 && index(b1)!='\n') b1--;
   minimal_update(b1);
@@ -986,8 +1279,10 @@ int Fl_Input_::undo() {
 */
 int Fl_Input_::copy_cuts() {
   // put the yank buffer into the X clipboard
-  if (!yankcut || input_type()==FL_SECRET_INPUT) return 0;
-  Fl::copy(undobuffer, yankcut, 1);
+  if (!undo_ || input_type()==FL_SECRET_INPUT) return 0;
+  Fl_Input_Undo_Stack &st = undo_->undo;
+  if (!st.n || !st.top()->cut) return 0;
+  Fl::copy(st.top_text(), st.top()->cut, 1);
   return 1;
 }
 
@@ -1146,6 +1441,9 @@ Fl_Input_::Fl_Input_(int X, int Y, int W, int H, const char* l)
   bufsize = 0;
   buffer  = 0;
   value_ = "";
+  lines_ = 0;
+  undo_ = 0;
+  undo_limit_ = 1024*1024;
   xscroll_ = yscroll_ = 0;
   maximum_size_ = 32767;
   shortcut_ = 0;
@@ -1215,7 +1513,14 @@ void Fl_Input_::put_in_buffer(int len) {
 */
 int Fl_Input_::static_value(const char* str, int len) {
   clear_changed();
-  if (undowidget == this) undowidget = 0;
+  if (lines_) lines_->valid = 0;
+  if (undo_ && input_type()==FL_SECRET_INPUT) {
+    undo_->undo.wipe();
+    undo_->redo.wipe();
+  } else if (undo_) {
+    undo_->undo.clear();
+    undo_->redo.clear();
+  }
   if (str == value_ && len == size_) return 0;
   if (len) { // non-empty new value:
     if (xscroll_ || yscroll_) {
@@ -1316,8 +1621,13 @@ void Fl_Input_::resize(int X, int Y, int W, int H) {
   from the parent Fl_Group.
 */
 Fl_Input_::~Fl_Input_() {
-  if (undowidget == this) undowidget = 0;
   if (bufsize) free((void*)buffer);
+  delete lines_;
+  if (undo_ && input_type()==FL_SECRET_INPUT) {
+    undo_->undo.wipe();
+    undo_->redo.wipe();
+  }
+  delete undo_;
 }
 
 /** \internal
@@ -29,6 +29,7 @@
 #include <FL/Fl_Shared_Image.H>
 #include <FL/fl_utf8.h>
 #include <FL/Fl.H>
+#include "Fl_Image_Scaler.h"
 #include <config.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -104,6 +105,30 @@ Fl_JPEG_Image::Fl_JPEG_Image(const char *filename)
   load_jpg_(filename, 0L, 0L);
 }
 
+/**
+ \brief The constructor loads the JPEG image from the given jpeg filename
+ in the given size.
+
+ This is faster than loading the image and scaling it with copy(W, H),
+ in particular for small thumbnails of large photos: the image is
+ decoded in a reduced size (a power of 2 of its original size, but at
+ least \p W x \p H pixels) with fast DCT scaling, and the decoded rows
+ are scaled to \p W x \p H pixels as they are decoded. The image is
+ never stored in its original size.
+
+ \param[in] filename a full path and name pointing to a valid jpeg file.
+ \param[in] W, H the size of the image
+
+ \see Fl_JPEG_Image::Fl_JPEG_Image(const char *filename)
+
+ \version 1.4.0
+ */
+Fl_JPEG_Image::Fl_JPEG_Image(const char *filename, int W, int H)
+: Fl_RGB_Image(0,0,0)
+{
+  load_jpg_(filename, 0L, 0L, W, H);
+}
+
 /**
  \brief The constructor loads the JPEG image from memory.
 
@@ -209,9 +234,11 @@ static void jpeg_mem_src(j_decompress_ptr cinfo, const unsigned char *data)
  This method reads JPEG image data and creates an RGB or grayscale image.
  To avoid code duplication, we set filename if we want to read form a file or
  data to read from memory instead. Sharename can be set if the image is
- supposed to be added to teh Fl_Shared_Image list.
+ supposed to be added to teh Fl_Shared_Image list. If W and H are not 0,
+ the image is scaled to this size while it is decoded.
  */
-void Fl_JPEG_Image::load_jpg_(const char *filename, const char *sharename, const unsigned char *data)
+void Fl_JPEG_Image::load_jpg_(const char *filename, const char *sharename, const unsigned char *data,
+                              int W, int H)
 {
 #ifdef HAVE_LIBJPEG
   jpeg_decompress_struct  dinfo;    // Decompressor info
@@ -229,6 +256,9 @@ void Fl_JPEG_Image::load_jpg_(const char *filename, const char *sharename, const
 
   FILE** fp = new FILE*;   // always allocate file pointer
   *fp = NULL;
+  // Same for the scaler that scales the image while it is decoded
+  Fl_Image_Scaler** scaler = new Fl_Image_Scaler*;
+  *scaler = NULL;
 
   // Clear data...
   alloc_array = 0;
@@ -239,12 +269,14 @@ void Fl_JPEG_Image::load_jpg_(const char *filename, const char *sharename, const
     if ((*fp = fl_fopen(filename, "rb")) == NULL) {
       ld(ERR_FILE_ACCESS);
       delete fp;
+      delete scaler;
       return;
     }
   } else {
     if (data==0L) {
       ld(ERR_FILE_ACCESS);
       delete fp;
+      delete scaler;
       return;
     }
   }
@@ -290,6 +322,9 @@ void Fl_JPEG_Image::load_jpg_(const char *filename, const char *sharename, const
     free(max_destroy_decompress_err);
     free(max_finish_decompress_err);
 
+    delete *scaler;
+    delete scaler;
+
     ld(ERR_FORMAT);
     delete fp;
     return;
@@ -308,19 +343,52 @@ void Fl_JPEG_Image::load_jpg_(const char *filename, const char *sharename, const
   dinfo.out_color_components = 3;
   dinfo.output_components    = 3;
 
+  if (W > 0 && H > 0) {
+    // Let the decoder reduce the size as far as possible (DCT scaling)...
+    dinfo.scale_num   = 1;
+    dinfo.scale_denom = 1;
+    for (unsigned int denom = 8; denom > 1; denom /= 2) {
+      if ((dinfo.image_width + denom - 1) / denom >= (unsigned int)W &&
+          (dinfo.image_height + denom - 1) / denom >= (unsigned int)H) {
+        dinfo.scale_denom = denom;
+        break;
+      }
+    }
+    dinfo.dct_method          = JDCT_IFAST;
+    dinfo.do_fancy_upsampling = (boolean)FALSE;
+  }
+
   jpeg_calc_output_dimensions(&dinfo);
 
-  w(dinfo.output_width);
-  h(dinfo.output_height);
+  if (W > 0 && H > 0 &&
+      ((int)dinfo.output_width != W || (int)dinfo.output_height != H)) {
+    // ... and scale the rows to the requested size while decoding
+    w(W);
+    h(H);
+  } else {
+    w(dinfo.output_width);
+    h(dinfo.output_height);
+  }
   d(dinfo.output_components);
 
   if (((size_t)w()) * h() * d() > max_size() ) longjmp(jerr.errhand_, 1);
   array = new uchar[w() * h() * d()];
   alloc_array = 1;
 
+  if (w() != (int)dinfo.output_width || h() != (int)dinfo.output_height)
+    *scaler = new Fl_Image_Scaler(dinfo.output_width, dinfo.output_height,
+                                  dinfo.output_components, w(), h(),
+                                  (uchar *)array);
+
   jpeg_start_decompress(&dinfo);
 
   while (dinfo.output_scanline < dinfo.output_height) {
+    if (*scaler) {
+      row = (JSAMPROW)(*scaler)->buffer();
+      jpeg_read_scanlines(&dinfo, &row, (JDIMENSION)1);
+      (*scaler)->add_row();
+      continue;
+    }
     row = (JSAMPROW)(array +
                      dinfo.output_scanline * dinfo.output_width *
                      dinfo.output_components);
@@ -333,6 +401,9 @@ void Fl_JPEG_Image::load_jpg_(const char *filename, const char *sharename, const
   free(max_destroy_decompress_err);
   free(max_finish_decompress_err);
 
+  delete *scaler;
+  delete scaler;
+
   if (*fp)
     fclose(*fp);
 
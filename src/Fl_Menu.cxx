@@ -120,23 +120,37 @@ class menuwindow : public Fl_Menu_Window {
   void drawentry(const Fl_Menu_Item*, int i, int erase);
   int handle_part1(int);
   int handle_part2(int e, int ret);
+  void add_size(const struct Fl_Menu_Item_Size &s);
+  int measure(int n);
+  int measure_cached(int n);
+  int width() const;
 public:
   menutitle* title;
   int handle(int);
   int itemheight;       // zero == menubar
   int numitems;
+  const Fl_Menu_Item** items; // the numitems items of the menu
   int selected;
   int drawn_selected;   // last redraw has this selected
-  int shortcutWidth;
+  int first;            // first item shown
+  int rows;             // number of items shown, 0 if all items are shown
+  int labelWidth;       // widest label, including submenu arrows
+  int shortcutWidth;    // widest shortcut key
+  int modifierWidth;    // widest shortcut modifiers
+  int longWidth;        // widest shortcut with a long key name
+  int minWidth;         // minimum window width
   const Fl_Menu_Item* menu;
   menuwindow(const Fl_Menu_Item* m, int X, int Y, int W, int H,
              const Fl_Menu_Item* picked, const Fl_Menu_Item* title,
              int menubar = 0, int menubar_title = 0, int right_edge = 0);
   ~menuwindow();
+  // item n, or NULL if n is not an item of this menu:
+  const Fl_Menu_Item* item(int n) const {return n >= 0 && n < numitems ? items[n] : 0;}
   void set_selected(int);
   int find_selected(int mx, int my);
   int titlex(int);
   void autoscroll(int);
+  void scroll(int n);
   void position(int x, int y);
   int is_inside(int x, int y);
 };
@@ -286,6 +300,139 @@ menutitle::menutitle(int X, int Y, int W, int H, const Fl_Menu_Item* L) :
   if (L->labelcolor_ || Fl::scheme() || L->labeltype_ > FL_NO_LABEL) clear_overlay();
 }
 
+// Sizes of a menu item. Menus with many items only measure the items that
+// are shown, and the sizes are kept in a cache, so that a menu that pops up
+// again does not need to measure its items again.
+struct Fl_Menu_Item_Size {
+  const Fl_Menu_Item* item;     // the item, NULL if the cache slot is free
+  unsigned check;               // hash of everything that affects the sizes
+  int w, h;                     // label width, including submenu arrow, and height
+  int modw, keyw;               // width of the shortcut modifiers and key,
+                                // modw = -1 if keyw is the width of a long shortcut
+};
+
+static Fl_Menu_Item_Size* size_cache = 0;
+static int size_cache_alloc = 0; // number of slots, a power of 2
+static int size_cache_count = 0; // number of slots used
+
+// Returns a hash of the label and everything else that affects the sizes of
+// item m, or 0 if the sizes can't be cached (the label is not a string).
+static unsigned size_check(const Fl_Menu_Item* m) {
+  if (m->labeltype_ > _FL_EMBOSSED_LABEL) return 0;
+  unsigned h = 2166136261U;
+  for (const char* s = m->text; *s; s++) h = (h ^ (uchar)*s) * 16777619U;
+  unsigned v[7] = {
+    (unsigned)(m->flags & (FL_MENU_TOGGLE|FL_MENU_RADIO|FL_SUBMENU|FL_SUBMENU_POINTER)),
+    m->labeltype_, (unsigned)m->labelfont_, (unsigned)m->labelsize_,
+    (unsigned)m->shortcut_,
+    (unsigned)(button ? button->textfont() : FL_HELVETICA),
+    (unsigned)(button ? button->textsize() : FL_NORMAL_SIZE)
+  };
+  for (int i = 0; i < 7; i++) h = (h ^ v[i]) * 16777619U;
+  return h ? h : 1;
+}
+
+static unsigned size_slot(const Fl_Menu_Item* m) {
+  return (unsigned)(((fl_uintptr_t)m >> 3) * 2654435761U) & (size_cache_alloc - 1);
+}
+
+// Returns the cached sizes of item m, or NULL.
+static const Fl_Menu_Item_Size* cached_size(const Fl_Menu_Item* m, unsigned check) {
+  if (!size_cache || !check) return 0;
+  for (unsigned i = size_slot(m); size_cache[i].item; i = (i + 1) & (size_cache_alloc - 1))
+    if (size_cache[i].item == m)
+      return size_cache[i].check == check ? size_cache + i : 0;
+  return 0;
+}
+
+static void cache_size(const Fl_Menu_Item_Size& s) {
+  if (!s.check) return;
+  if (2 * (size_cache_count + 1) > size_cache_alloc) {
+    // grow the cache, or start again when it gets too large:
+    Fl_Menu_Item_Size* old = size_cache;
+    int n = size_cache_alloc;
+    size_cache_alloc = n ? 2 * n : 256;
+    if (size_cache_alloc > 65536) size_cache_alloc = n; // keep the size
+    size_cache = new Fl_Menu_Item_Size[size_cache_alloc];
+    memset(size_cache, 0, size_cache_alloc * sizeof(Fl_Menu_Item_Size));
+    size_cache_count = 0;
+    if (size_cache_alloc > n) for (int i = 0; i < n; i++) if (old[i].item) cache_size(old[i]);
+    delete[] old;
+  }
+  unsigned i = size_slot(s.item);
+  while (size_cache[i].item && size_cache[i].item != s.item) i = (i + 1) & (size_cache_alloc - 1);
+  if (!size_cache[i].item) size_cache_count++;
+  size_cache[i] = s;
+}
+
+// Adds the sizes of an item to the sizes of the menu.
+void menuwindow::add_size(const Fl_Menu_Item_Size &s) {
+  if (s.h + Fl::menu_linespacing() > itemheight) itemheight = s.h + Fl::menu_linespacing();
+  if (s.w > labelWidth) labelWidth = s.w;
+  if (s.modw >= 0) {
+    if (s.modw > modifierWidth) modifierWidth = s.modw;
+    if (s.keyw > shortcutWidth) shortcutWidth = s.keyw;
+  } else if (s.keyw > longWidth) {
+    longWidth = s.keyw;
+  }
+}
+
+// Measures item n and adds its sizes to the sizes of the menu.
+// Returns non-zero if the menu sizes changed.
+int menuwindow::measure(int n) {
+  const Fl_Menu_Item* m = items[n];
+  int ih = itemheight, lw = labelWidth, sw = shortcutWidth, mw = modifierWidth, ow = longWidth;
+  unsigned check = size_check(m);
+  const Fl_Menu_Item_Size* c = cached_size(m, check);
+  if (c) {
+    add_size(*c);
+  } else {
+    Fl_Menu_Item_Size s;
+    s.item = m;
+    s.check = check;
+    s.h = 0;
+    s.w = m->measure(&s.h, button);
+    if (m->flags&(FL_SUBMENU|FL_SUBMENU_POINTER))
+      s.w += FL_NORMAL_SIZE;
+    s.modw = s.keyw = 0;
+    // calculate the width of the shortcut
+    if (m->shortcut_) {
+      // s is a pointer to the UTF-8 string for the entire shortcut
+      // k points only to the key part (minus the modifier keys)
+      const char *k, *sc = fl_shortcut_label(m->shortcut_, &k);
+      if (fl_utf_nb_char((const unsigned char*)k, (int) strlen(k))<=4) {
+        // a regular shortcut has a right-justified modifier followed by a left-justified key
+        s.modw = int(fl_width(sc, (int) (k-sc)));
+        s.keyw = int(fl_width(k))+4;
+      } else {
+        // a shortcut with a long modifier is right-justified to the menu
+        s.modw = -1;
+        s.keyw = int(fl_width(sc))+4;
+      }
+    }
+    add_size(s);
+    cache_size(s);
+  }
+  return ih != itemheight || lw != labelWidth || sw != shortcutWidth ||
+         mw != modifierWidth || ow != longWidth;
+}
+
+// Adds the sizes of item n if they are in the cache, returns 0 if not.
+int menuwindow::measure_cached(int n) {
+  const Fl_Menu_Item* m = items[n];
+  const Fl_Menu_Item_Size* c = cached_size(m, size_check(m));
+  if (c) add_size(*c);
+  return c != 0;
+}
+
+// Returns the width of the window for the measured items.
+int menuwindow::width() const {
+  int hotModsw = modifierWidth;
+  if (longWidth > shortcutWidth + hotModsw) hotModsw = longWidth - shortcutWidth;
+  int W = labelWidth + shortcutWidth + hotModsw + 2*Fl::box_dx(box()) + 7;
+  return W > minWidth ? W : minWidth;
+}
+
 menuwindow::menuwindow(const Fl_Menu_Item* m, int X, int Y, int Wp, int Hp,
                        const Fl_Menu_Item* picked, const Fl_Menu_Item* t,
                        int menubar, int menubar_title, int right_edge)
@@ -304,6 +451,8 @@ menuwindow::menuwindow(const Fl_Menu_Item* m, int X, int Y, int Wp, int Hp,
   menu = m;
   if (m) m = m->first(); // find the first item that needs to be rendered
   drawn_selected = -1;
+  first = rows = 0;
+  labelWidth = shortcutWidth = modifierWidth = longWidth = minWidth = 0;
   if (button) {
     box(button->box());
     if (box() == FL_NO_BOX || box() == FL_FLAT_BOX) box(FL_UP_BOX);
@@ -322,6 +471,14 @@ menuwindow::menuwindow(const Fl_Menu_Item* m, int X, int Y, int Wp, int Hp,
     if (!m1->text) break;
   }
   numitems = j;}
+  items = numitems ? new const Fl_Menu_Item*[numitems] : 0;
+  {
+    int j = 0;
+    for (const Fl_Menu_Item* m1 = m; j < numitems; m1 = m1->next(), j++) {
+      items[j] = m1;
+      if (m1->labelcolor_ || Fl::scheme() || m1->labeltype_ > FL_NO_LABEL) clear_overlay();
+    }
+  }
 
   if (menubar) {
     itemheight = 0;
@@ -331,46 +488,35 @@ menuwindow::menuwindow(const Fl_Menu_Item* m, int X, int Y, int Wp, int Hp,
 
   itemheight = 1;
 
-  int hotKeysw = 0;
-  int hotModsw = 0;
   int Wtitle = 0;
   int Htitle = 0;
   if (t) Wtitle = t->measure(&Htitle, button) + 12;
-  int W = 0;
-  if (m) for (; m->text; m = m->next()) {
-    int hh;
-    int w1 = m->measure(&hh, button);
-    if (hh+Fl::menu_linespacing()>itemheight) itemheight = hh+Fl::menu_linespacing();
-    if (m->flags&(FL_SUBMENU|FL_SUBMENU_POINTER))
-      w1 += FL_NORMAL_SIZE;
-    if (w1 > W) W = w1;
-    // calculate the maximum width of all shortcuts
-    if (m->shortcut_) {
-      // s is a pointer to the UTF-8 string for the entire shortcut
-      // k points only to the key part (minus the modifier keys)
-      const char *k, *s = fl_shortcut_label(m->shortcut_, &k);
-      if (fl_utf_nb_char((const unsigned char*)k, (int) strlen(k))<=4) {
-        // a regular shortcut has a right-justified modifier followed by a left-justified key
-        w1 = int(fl_width(s, (int) (k-s)));
-        if (w1 > hotModsw) hotModsw = w1;
-        w1 = int(fl_width(k))+4;
-        if (w1 > hotKeysw) hotKeysw = w1;
-      } else {
-        // a shortcut with a long modifier is right-justified to the menu
-        w1 = int(fl_width(s))+4;
-        if (w1 > (hotModsw+hotKeysw)) {
-          hotModsw = w1-hotKeysw;
-        }
-      }
-    }
-    if (m->labelcolor_ || Fl::scheme() || m->labeltype_ > FL_NO_LABEL) clear_overlay();
+  int BW = Fl::box_dx(box());
+  // measure the items until they don't fit on the screen:
+  int j;
+  for (j = 0; j < numitems; j++) {
+    measure(j);
+    if ((j+1)*itemheight > scr_h) break;
+  }
+  if (j < numitems) {
+    // Too many items: show as many as fit on the screen and scroll the
+    // menu. Only the items shown are measured, but use the sizes of all
+    // items that were measured before.
+    for (int k = j; k < numitems; k++) measure_cached(k);
+    do {
+      rows = (scr_h - 2*BW - 3 + Fl::menu_linespacing()) / itemheight;
+      if (rows < 1) rows = 1;
+      first = selected - rows/2;
+      if (first > numitems - rows) first = numitems - rows;
+      if (first < 0) first = 0;
+      j = 0;
+      for (int k = first; k < first + rows; k++) j |= measure(k);
+    } while (j);
   }
-  shortcutWidth = hotKeysw;
+  int W = labelWidth;
   if (selected >= 0 && !Wp) X -= W/2;
-  int BW = Fl::box_dx(box());
-  W += hotKeysw+hotModsw+2*BW+7;
-  if (Wp > W) W = Wp;
-  if (Wtitle > W) W = Wtitle;
+  minWidth = Wp > Wtitle ? Wp : Wtitle;
+  W = width();
 
   if (X < scr_x) X = scr_x;
   // this change improves popup submenu positioning at right screen edge,
@@ -378,9 +524,10 @@ menuwindow::menuwindow(const Fl_Menu_Item* m, int X, int Y, int Wp, int Hp,
   //if (X > scr_x+scr_w-W) X = right_edge-W;
   if (X > scr_x+scr_w-W) X = scr_x+scr_w-W;
   x(X); w(W);
-  h((numitems ? itemheight*numitems-Fl::menu_linespacing() : 0)+2*BW+3);
+  int n = rows ? rows : numitems;
+  h((n ? itemheight*n-Fl::menu_linespacing() : 0)+2*BW+3);
   if (selected >= 0) {
-    Y = Y+(Hp-itemheight)/2-selected*itemheight-BW;
+    Y = Y+(Hp-itemheight)/2-(selected-first)*itemheight-BW;
   } else {
     Y = Y+Hp;
     // if the menu hits the bottom of the screen, we try to draw
@@ -407,6 +554,11 @@ menuwindow::menuwindow(const Fl_Menu_Item* m, int X, int Y, int Wp, int Hp,
       }
     }
   }
+  if (rows) {
+    // a scrolling menu is always on the screen:
+    if (Y > scr_y+scr_h-h()) Y = scr_y+scr_h-h();
+    if (Y < scr_y) Y = scr_y;
+  }
   if (m) y(Y); else {y(Y-2); w(1); h(1);}
 
   if (t) {
@@ -427,6 +579,7 @@ menuwindow::menuwindow(const Fl_Menu_Item* m, int X, int Y, int Wp, int Hp,
 menuwindow::~menuwindow() {
   hide();
   delete title;
+  delete[] items;
 }
 
 void menuwindow::position(int X, int Y) {
@@ -437,6 +590,13 @@ void menuwindow::position(int X, int Y) {
 
 // scroll so item i is visible on screen
 void menuwindow::autoscroll(int n) {
+  if (rows) {
+    // scroll the items, and keep one more item visible if possible:
+    int margin = rows > 2 ? 1 : 0;
+    if (n - margin < first) scroll(n - margin);
+    else if (n + margin >= first + rows) scroll(n + margin - rows + 1);
+    return;
+  }
   int scr_y, scr_h;
   int Y = y()+Fl::box_dx(box())+2+n*itemheight;
 
@@ -452,6 +612,31 @@ void menuwindow::autoscroll(int n) {
   // y(y()+Y); // don't wait for response from X
 }
 
+// show the items starting with item n in a scrolling menu
+void menuwindow::scroll(int n) {
+  if (n > numitems - rows) n = numitems - rows;
+  if (n < 0) n = 0;
+  if (!rows || n == first) return;
+  first = n;
+  // measure the items that are shown now:
+  int changed = 0;
+  for (int k = first; k < first + rows; k++) changed |= measure(k);
+  if (changed) {
+    // a taller item leaves room for fewer items:
+    int n = (h() - 2*Fl::box_dx(box()) - 3 + Fl::menu_linespacing()) / itemheight;
+    if (n < rows) rows = n > 0 ? n : 1;
+    int W = width();
+    if (W > w()) {
+      int X = x(), scr_x, scr_y, scr_w, scr_h;
+      Fl::screen_work_area(scr_x, scr_y, scr_w, scr_h);
+      if (X > scr_x+scr_w-W) X = scr_x+scr_w-W;
+      if (X < scr_x) X = scr_x;
+      resize(X, y(), W, h());
+    }
+  }
+  redraw();
+}
+
 ////////////////////////////////////////////////////////////////
 
 void menuwindow::drawentry(const Fl_Menu_Item* m, int n, int eraseit) {
@@ -461,7 +646,8 @@ void menuwindow::drawentry(const Fl_Menu_Item* m, int n, int eraseit) {
   int xx = BW;
   int W = w();
   int ww = W-2*BW-1;
-  int yy = BW+1+n*itemheight;
+  if (rows && (n < first || n >= first+rows)) return; // not shown
+  int yy = BW+1+(n-first)*itemheight;
   int hh = itemheight - Fl::menu_linespacing();
 
   if (eraseit && n != selected) {
@@ -512,14 +698,12 @@ void menutitle::draw() {
 void menuwindow::draw() {
   if (damage() != FL_DAMAGE_CHILD) {    // complete redraw
     fl_draw_box(box(), 0, 0, w(), h(), button ? button->color() : color());
-    if (menu) {
-      const Fl_Menu_Item* m; int j;
-      for (m=menu->first(), j=0; m->text; j++, m = m->next()) drawentry(m, j, 0);
-    }
+    int n = rows ? first+rows : numitems;
+    for (int j = first; j < n; j++) drawentry(items[j], j, 0);
   } else {
     if (damage() & FL_DAMAGE_CHILD && selected!=drawn_selected) { // change selection
-      drawentry(menu->next(drawn_selected), drawn_selected, 1);
-      drawentry(menu->next(selected), selected, 1);
+      drawentry(item(drawn_selected), drawn_selected, 1);
+      drawentry(item(selected), selected, 1);
     }
   }
   drawn_selected = selected;
@@ -548,7 +732,9 @@ int menuwindow::find_selected(int mx, int my) {
   }
   if (mx < Fl::box_dx(box()) || mx >= w()) return -1;
   int n = (my-Fl::box_dx(box())-1)/itemheight;
-  if (n < 0 || n>=numitems) return -1;
+  if (n < 0 || (rows && n >= rows)) return -1;
+  n += first;
+  if (n>=numitems) return -1;
   return n;
 }
 
@@ -626,7 +812,7 @@ static inline void setitem(const Fl_Menu_Item* i, int m, int n) {
 
 static void setitem(int m, int n) {
   menustate &pp = *p;
-  pp.current_item = (n >= 0) ? pp.p[m]->menu->next(n) : 0;
+  pp.current_item = pp.p[m]->item(n);
   pp.menu_number = m;
   pp.item_number = n;
 }
@@ -639,7 +825,7 @@ static int forward(int menu) { // go to next item in menu menu if possible
   menuwindow &m = *(pp.p[menu]);
   int item = (menu == pp.menu_number) ? pp.item_number : m.selected;
   while (++item < m.numitems) {
-    const Fl_Menu_Item* m1 = m.menu->next(item);
+    const Fl_Menu_Item* m1 = m.items[item];
     if (m1->activevisible()) {setitem(m1, menu, item); return 1;}
   }
   return 0;
@@ -651,7 +837,19 @@ static int backward(int menu) { // previous item in menu menu if possible
   int item = (menu == pp.menu_number) ? pp.item_number : m.selected;
   if (item < 0) item = m.numitems;
   while (--item >= 0) {
-    const Fl_Menu_Item* m1 = m.menu->next(item);
+    const Fl_Menu_Item* m1 = m.items[item];
+    if (m1->activevisible()) {setitem(m1, menu, item); return 1;}
+  }
+  return 0;
+}
+
+// go to the first active item at item or in direction dir (1 or -1) from it
+static int select_item(int menu, int item, int dir) {
+  menuwindow &m = *(p->p[menu]);
+  if (item >= m.numitems) item = m.numitems-1;
+  if (item < 0) item = 0;
+  for (; item >= 0 && item < m.numitems; item += dir) {
+    const Fl_Menu_Item* m1 = m.items[item];
     if (m1->activevisible()) {setitem(m1, menu, item); return 1;}
   }
   return 0;
@@ -754,6 +952,31 @@ int menuwindow::handle_part1(int e) {
       else if (pp.menu_number>0)
         setitem(pp.menu_number-1, pp.p[pp.menu_number-1]->selected);
       return 1;
+    case FL_Page_Up:
+    case FL_Page_Down:
+    case FL_Home:
+    case FL_End: {
+      int menu = pp.menu_number;
+      if (menu < 0) menu = 0;
+      else if (!menu && pp.menubar) {
+        if (pp.nummenus < 2) return 1;
+        menu = 1;
+      }
+      menuwindow &mw = *(pp.p[menu]);
+      int item = (menu == pp.menu_number) ? pp.item_number : mw.selected;
+      int page = mw.rows ? mw.rows-1 : mw.numitems;
+      switch (Fl::event_key()) {
+        case FL_Page_Up:
+          if (!select_item(menu, item-page, -1)) select_item(menu, item-page, 1);
+          break;
+        case FL_Page_Down:
+          if (!select_item(menu, item+page, 1)) select_item(menu, item+page, -1);
+          break;
+        case FL_Home: select_item(menu, 0, 1); break;
+        case FL_End: select_item(menu, mw.numitems-1, -1); break;
+      }
+      return 1;
+    }
     case FL_Enter:
     case FL_KP_Enter:
     case ' ':
@@ -778,6 +1001,22 @@ int menuwindow::handle_part1(int e) {
       }
     }
     break;
+  case FL_MOUSEWHEEL:
+    {
+      // scroll the menu under the mouse if it does not show all items:
+      int mx = Fl::event_x_root();
+      int my = Fl::event_y_root();
+      for (int mymenu = pp.nummenus-1; mymenu >= 0; mymenu--) {
+        menuwindow &mw = *(pp.p[mymenu]);
+        if (!mw.is_inside(mx, my)) continue;
+        if (!mw.rows || !Fl::event_dy()) return 1;
+        mw.scroll(mw.first + 3*Fl::event_dy());
+        int item = mw.find_selected(mx, my);
+        if (item >= 0) setitem(mymenu, item);
+        return 1;
+      }
+    }
+    break;
   case FL_MOVE: {
     static int use_part1_extra = Fl::system_driver()->need_menu_handle_part1_extra();
     if (use_part1_extra && pp.state == DONE_STATE) {
@@ -864,6 +1103,10 @@ int menuwindow::handle_part1(int e) {
   If \p initial_item is \p NULL or not found, the menu is aligned just
   below the rectangle (like a pulldown menu).
 
+  A menu with more items than fit on the screen shows as many items as fit
+  and scrolls with the mouse wheel, the arrow keys, Page Up, Page Down,
+  Home and End. Only the items shown are measured and drawn.
+
   The \p title and \p menubar arguments are used internally by the
   Fl_Menu_Bar widget.
 */
@@ -976,7 +1219,7 @@ const Fl_Menu_Item* Fl_Menu_Item::pulldown(
         initial_item = 0;
       } else {
         nX = cw.x() + cw.w();
-        nY = cw.y() + pp.item_number * cw.itemheight;
+        nY = cw.y() + (pp.item_number - cw.first) * cw.itemheight;
         title = 0;
       }
       if (initial_item) { // bring up submenu containing initial item:
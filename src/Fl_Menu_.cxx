@@ -74,7 +74,8 @@ int Fl_Menu_::item_pathname_(char *name,
   int level = 0;
   finditem = finditem ? finditem : mvalue();
   menu = menu ? menu : this->menu();
-  for ( int t=0; t<size(); t++ ) {
+  int n = size();
+  for ( int t=0; t<n; t++ ) {
     const Fl_Menu_Item *m = menu + t;
     if (m->submenu()) {                         // submenu? descend
       if (m->flags & FL_SUBMENU_POINTER) {
@@ -118,6 +119,132 @@ int Fl_Menu_::item_pathname_(char *name,
   return(-1);                                   // item not found
 }
 
+// Hash index of the menu item pathnames used by find_index(const char*).
+// The index is built when it is first needed after the menu array was
+// changed. It stores the index of the parent submenu of every item, so that
+// a match can be verified against the current labels of the items.
+struct Fl_Menu_Path_Index {
+  int valid;            // 1: index matches the menu array
+  int alloc;            // number of items allocated
+  int *parent;          // index of the parent submenu, or -1
+  int *next;            // next item in the same hash bucket, or -1
+  int *bucket;          // first item in each bucket, or -1
+  int nbucket;          // number of buckets, a power of 2
+
+  Fl_Menu_Path_Index() : valid(0), alloc(0), parent(0), next(0),
+                         bucket(0), nbucket(0) {}
+  ~Fl_Menu_Path_Index() {
+    delete[] parent;
+    delete[] next;
+    delete[] bucket;
+  }
+
+  static unsigned hash(unsigned h, const char *s) {
+    for (; *s; s++) h = (h ^ (unsigned char)*s) * 16777619U;
+    return h;
+  }
+  void build(const Fl_Menu_Item *menu, int n);
+  int match(const Fl_Menu_Item *menu, int t, const char *pathname, int len) const;
+  int find(const Fl_Menu_Item *menu, const char *pathname);
+};
+
+void Fl_Menu_Path_Index::build(const Fl_Menu_Item *menu, int n) {
+  if (n > alloc) {
+    delete[] parent;
+    delete[] next;
+    alloc = n + n / 2;
+    parent = new int[alloc];
+    next = new int[alloc];
+  }
+  if (nbucket < n || nbucket > 4 * n + 64) {
+    delete[] bucket;
+    for (nbucket = 64; nbucket < n; nbucket *= 2) { }
+    bucket = new int[nbucket];
+  }
+  int i;
+  for (i = 0; i < nbucket; i++) bucket[i] = -1;
+  // hash of the pathnames of the open submenus, the parent is on top
+  unsigned *stack = new unsigned[n + 1];
+  int depth = 0, p = -1;
+  for (int t = 0; t < n; t++) {
+    const Fl_Menu_Item *m = menu + t;
+    parent[t] = p;
+    next[t] = -1;
+    if (!m->text && !(m->flags & FL_SUBMENU)) {
+      // end of a submenu, pop back one level
+      if (p >= 0) { p = parent[p]; depth--; }
+      continue;
+    }
+    unsigned h = depth ? hash(stack[depth-1], "/") : 2166136261U;
+    h = hash(h, m->label() ? m->label() : "");
+    // append, so that the first item with a pathname is found first
+    int *link = bucket + (h & (nbucket - 1));
+    while (*link >= 0) link = next + *link;
+    *link = t;
+    if (m->flags & FL_SUBMENU) { stack[depth++] = h; p = t; }
+  }
+  delete[] stack;
+  valid = 1;
+}
+
+// Checks that the labels of item t and its parents form pathname.
+int Fl_Menu_Path_Index::match(const Fl_Menu_Item *menu, int t,
+                              const char *pathname, int len) const {
+  for (;;) {
+    const char *label = menu[t].label() ? menu[t].label() : "";
+    int l = (int)strlen(label);
+    if (l > len || memcmp(pathname + len - l, label, l)) return 0;
+    len -= l;
+    t = parent[t];
+    if (t < 0) return len == 0;
+    if (len == 0 || pathname[len-1] != '/') return 0;
+    len--;
+  }
+}
+
+int Fl_Menu_Path_Index::find(const Fl_Menu_Item *menu, const char *pathname) {
+  if (!valid) build(menu, menu->size());
+  unsigned h = hash(2166136261U, pathname);
+  int len = (int)strlen(pathname);
+  for (int t = bucket[h & (nbucket - 1)]; t >= 0; t = next[t])
+    if (match(menu, t, pathname, len)) return t;
+  return -1;
+}
+
+/**
+ Enables or disables a hash index of the menu item pathnames.
+
+ With the index, find_index(const char*) and find_item(const char*) find
+ an item in constant time instead of scanning the menu array, which helps
+ with menus that have thousands of items. The index is built when it is
+ first needed after the menu was changed with add(), insert(), remove(),
+ replace(), clear() or menu().
+
+ The index is off by default. While it is on, labels must not be changed
+ directly through Fl_Menu_Item pointers, because find_index() does not
+ notice that an item has a new pathname. Use replace() instead, or call
+ path_index(1) again to rebuild the index.
+
+ \param[in] on non-zero to use the index, 0 to free it
+ \see find_index(const char*)
+ \since 1.4.0
+ */
+void Fl_Menu_::path_index(int on) {
+  if (!on) {
+    delete path_index_;
+    path_index_ = 0;
+  } else if (!path_index_) {
+    path_index_ = new Fl_Menu_Path_Index;
+  } else {
+    path_index_->valid = 0;
+  }
+}
+
+// INTERNAL: The menu array was changed, rebuild the path index when needed
+void Fl_Menu_::path_index_changed_() {
+  if (path_index_) path_index_->valid = 0;
+}
+
 /**
  Find the menu item for a given menu \p pathname, such as "Edit/Copy".
 
@@ -196,7 +323,8 @@ int Fl_Menu_::find_index(const Fl_Menu_Item *item) const {
  \see      find_index(const char*)
  */
 int Fl_Menu_::find_index(Fl_Callback *cb) const {
-  for ( int t=0; t < size(); t++ )
+  int n = size();
+  for ( int t=0; t < n; t++ )
     if (menu_[t].callback_==cb)
       return(t);
   return(-1);
@@ -216,8 +344,11 @@ int Fl_Menu_::find_index(Fl_Callback *cb) const {
 
 */
 int Fl_Menu_::find_index(const char *pathname) const {
+  if (path_index_)
+    return menu_ ? path_index_->find(menu_, pathname) : -1;
   char menupath[1024] = "";     // File/Export
-  for ( int t=0; t < size(); t++ ) {
+  int n = size();
+  for ( int t=0; t < n; t++ ) {
     Fl_Menu_Item *m = menu_ + t;
     if (m->flags&FL_SUBMENU) {
       // IT'S A SUBMENU
@@ -257,7 +388,8 @@ int Fl_Menu_::find_index(const char *pathname) const {
  \see find_item(const char*)
  */
 const Fl_Menu_Item * Fl_Menu_::find_item(Fl_Callback *cb) {
-  for ( int t=0; t < size(); t++ ) {
+  int n = size();
+  for ( int t=0; t < n; t++ ) {
     const Fl_Menu_Item *m = menu_ + t;
     if (m->callback_==cb) {
       return m;
@@ -387,6 +519,7 @@ Fl_Menu_::Fl_Menu_(int X,int Y,int W,int H,const char* l)
   box(FL_UP_BOX);
   when(FL_WHEN_RELEASE_ALWAYS);
   value_ = menu_ = 0;
+  path_index_ = 0;
   alloc = 0;
   selection_color(FL_SELECTION_COLOR);
   textfont(FL_HELVETICA);
@@ -440,6 +573,7 @@ void Fl_Menu_::copy(const Fl_Menu_Item* m, void* ud) {
 
 Fl_Menu_::~Fl_Menu_() {
   clear();
+  delete path_index_;
 }
 
 // Fl_Menu::add() uses this to indicate the owner of the dynamically-
@@ -464,6 +598,7 @@ void Fl_Menu_::clear() {
   }
   menu_ = 0;
   value_ = 0;
+  path_index_changed_();
 }
 
 /**
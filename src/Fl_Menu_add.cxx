@@ -402,6 +402,7 @@ int Fl_Menu_::insert(
   int value_offset = (int) (value_-menu_);
   menu_ = local_array; // in case it reallocated it
   if (value_) value_ = menu_+value_offset;
+  path_index_changed_();
   return r;
 }
 
@@ -442,6 +443,219 @@ int Fl_Menu_::add(const char *str) {
 
 
 
+// Tree of menu items used by add(const Fl_Menu_Item*, int). The items of
+// the menu array and the new items are collected in this tree, and the
+// tree is written to a new menu array once.
+struct Fl_Menu_Tree_Node {
+  Fl_Menu_Item item;    // the item, the text is not copied
+  int parent;           // parent node, the root node 0 is the menu itself
+  int child, last;      // first and last child node, or -1
+  int next;             // next sibling, or -1
+  int hnext;            // next node in the same hash bucket, or -1
+  unsigned hash;        // hash of the parent node and the label
+};
+
+struct Fl_Menu_Tree {
+  Fl_Menu_Tree_Node *node;
+  int size, alloc;
+  int *bucket;          // first node in each bucket, or -1
+  int nbucket;          // number of buckets, a power of 2
+
+  Fl_Menu_Tree() : node(0), size(0), alloc(0), bucket(0), nbucket(0) {}
+  ~Fl_Menu_Tree() { free(node); delete[] bucket; }
+
+  // Hash of a label that ignores '&' like compare():
+  static unsigned hash(int parent, const char *s) {
+    unsigned h = 2166136261U ^ ((unsigned)parent * 2654435761U);
+    for (; *s; s++) if (*s != '&') h = (h ^ (unsigned char)*s) * 16777619U;
+    return h ? h : 1; // 0 marks nodes that are not in the hash table
+  }
+  void rehash() {
+    delete[] bucket;
+    for (nbucket = 64; nbucket < alloc; nbucket *= 2) { }
+    bucket = new int[nbucket];
+    int i;
+    for (i = 0; i < nbucket; i++) bucket[i] = -1;
+    for (i = 1; i < size; i++) if (node[i].hash) link(i);
+  }
+  void link(int n) {
+    int *b = bucket + (node[n].hash & (nbucket - 1));
+    node[n].hnext = *b;
+    *b = n;
+  }
+  // Finds the first submenu (submenu=1) or item (submenu=0) of parent with label
+  int find(int parent, const char *label, int submenu) const {
+    unsigned h = hash(parent, label);
+    int found = -1;
+    for (int n = bucket[h & (nbucket - 1)]; n >= 0; n = node[n].hnext) {
+      const Fl_Menu_Tree_Node &m = node[n];
+      if (m.hash == h && m.parent == parent &&
+          !(m.item.flags & FL_SUBMENU) == !submenu &&
+          !compare(label, m.item.text) && (found < 0 || n < found))
+        found = n;
+    }
+    return found;
+  }
+  // Appends a node to parent, returns the new node
+  int append(int parent, const Fl_Menu_Item &item) {
+    if (size >= alloc) {
+      alloc = alloc ? 2 * alloc : 64;
+      node = (Fl_Menu_Tree_Node*)realloc(node, alloc * sizeof(Fl_Menu_Tree_Node));
+      if (bucket) rehash();
+    }
+    int n = size++;
+    Fl_Menu_Tree_Node &m = node[n];
+    m.item = item;
+    m.parent = parent;
+    m.child = m.last = m.next = m.hnext = -1;
+    m.hash = 0;
+    if (n) {
+      Fl_Menu_Tree_Node &p = node[parent];
+      if (p.last >= 0) node[p.last].next = n;
+      else p.child = n;
+      p.last = n;
+      // index the node, unless an earlier sibling has the same label:
+      if (item.text && find(parent, item.text, item.flags & FL_SUBMENU) < 0) {
+        m.hash = hash(parent, item.text);
+        link(n);
+      }
+    }
+    return n;
+  }
+  // Writes the children of parent to array, returns the next free index
+  int write(int parent, Fl_Menu_Item *array, int i, int *index) const {
+    for (int n = node[parent].child; n >= 0; n = node[n].next) {
+      index[n] = i;
+      array[i++] = node[n].item;
+      if (node[n].item.flags & FL_SUBMENU) {
+        i = write(n, array, i, index);
+        memset(array + i++, 0, sizeof(Fl_Menu_Item));
+      }
+    }
+    return i;
+  }
+};
+
+/**
+  Adds \p n menu items at once.
+
+  This is the same as calling
+  add(items[i].text, items[i].shortcut_, items[i].callback_, items[i].user_data_, items[i].flags)
+  for each item, with the text of the items being menu pathnames like
+  "File/Recent/foo.txt". The other members of the items are ignored.
+
+  add() searches the existing items for each label and moves the items
+  behind the new one, so adding many items one by one takes quadratic
+  time. This method collects the menu and the new items in a tree with a
+  hash table of the labels and writes the new menu array once, so that
+  menus with thousands of items, for instance lists of symbols or recently
+  used files, are built in linear time.
+
+  No items must be added to a menu during a callback to the same menu.
+
+  \param[in] items  array of items with menu pathnames as text
+  \param[in] n      number of items
+  \returns          The index into the menu() array of the last item,
+                    or -1 if no item was added.
+  \see add(const char*, int, Fl_Callback*, void*, int)
+  \since 1.4.0
+*/
+int Fl_Menu_::add(const Fl_Menu_Item *items, int n) {
+  if (n <= 0) return -1;
+  Fl_Menu_Tree tree;
+  Fl_Menu_Item blank;
+  memset(&blank, 0, sizeof(blank));
+  tree.append(0, blank);
+  tree.rehash();
+
+  // collect the items of the menu array:
+  int msize = menu_ ? (menu_ == local_array ? local_array_size : menu_->size()) : 0;
+  int value_node = -1;
+  int parent = 0, i;
+  for (i = 0; i < msize - 1; i++) {
+    const Fl_Menu_Item &m = menu_[i];
+    if (!m.text) { parent = tree.node[parent].parent; continue; }
+    int nd = tree.append(parent, m);
+    if (value_ == menu_ + i) value_node = nd;
+    if (m.flags & FL_SUBMENU) parent = nd;
+  }
+
+  // add the new items:
+  char buf[1024];
+  int last = -1;
+  for (i = 0; i < n; i++) {
+    const char *mytext = items[i].text;
+    if (!mytext) continue;
+    int myflags = items[i].flags;
+    int flags1 = 0;
+    const char *item;
+    parent = 0;
+    // split at slashes to make submenus, same as Fl_Menu_Item::insert():
+    for (;;) {
+      if (*mytext == '/') {item = mytext; break;}
+      if (*mytext == '_') {mytext++; flags1 = FL_MENU_DIVIDER;}
+      char *q = buf;
+      const char *p;
+      for (p = mytext; *p && *p != '/'; p++) {
+        if (*p == '\\' && p[1]) p++;
+        if (q < buf + sizeof(buf) - 1) *q++ = *p;
+      }
+      *q = 0;
+      item = buf;
+      if (*p != '/') break;
+      mytext = p + 1;
+      int sub = tree.find(parent, item, 1);
+      if (sub < 0) {
+        Fl_Menu_Item m = blank;
+        m.text = fl_strdup(item);
+        m.flags = FL_SUBMENU | flags1;
+        m.labelfont_ = FL_HELVETICA;
+        sub = tree.append(parent, m);
+      }
+      parent = sub;
+      flags1 = 0;
+    }
+    int nd = tree.find(parent, item, 0);
+    if (nd < 0) {
+      Fl_Menu_Item m = blank;
+      m.text = fl_strdup(item);
+      m.labelfont_ = FL_HELVETICA;
+      nd = tree.append(parent, m);
+    }
+    Fl_Menu_Item &m = tree.node[nd].item;
+    m.shortcut_ = items[i].shortcut_;
+    m.callback_ = items[i].callback_;
+    m.user_data_ = items[i].user_data_;
+    m.flags = myflags | flags1;
+    last = nd;
+  }
+  if (last < 0) return -1;
+
+  // count the items and write the new menu array:
+  int count = 1;
+  for (i = 1; i < tree.size; i++)
+    count += (tree.node[i].item.flags & FL_SUBMENU) ? 2 : 1;
+  Fl_Menu_Item *array = new Fl_Menu_Item[count];
+  int *index = new int[tree.size];
+  memset(array + tree.write(0, array, 0, index), 0, sizeof(Fl_Menu_Item));
+  int r = index[last];
+  int value_index = value_node >= 0 ? index[value_node] : 0;
+  delete[] index;
+
+  // replace the menu array, the texts belong to the new array now:
+  if (this == fl_menu_array_owner)
+    fl_menu_array_owner = 0; // keep local_array for the next add()
+  else if (alloc)
+    delete[] menu_;
+  if (!alloc) alloc = menu_ ? 1 : 2;
+  if (value_) value_ = array + value_index;
+  menu_ = array;
+  path_index_changed_();
+  return r;
+}
+
+
+
 /**
   Changes the text of item \p i.  This is the only way to get
   slash into an add()'ed menu item.  If the menu array was directly set
@@ -458,6 +672,7 @@ void Fl_Menu_::replace(int i, const char *str) {
       str = fl_strdup(str?str:"");
   }
   menu_[i].text = str;
+  path_index_changed_();
 }
 
 
@@ -484,6 +699,7 @@ void Fl_Menu_::remove(int i) {
   }
   // MRS: "n" is the menu size(), which includes the trailing NULL entry...
   memmove(item, next_item, (menu_+n-next_item)*sizeof(Fl_Menu_Item));
+  path_index_changed_();
 }
 
 /**
@@ -29,6 +29,7 @@
 #include <config.h>
 #include <FL/Fl.H>
 #include "Fl_System_Driver.H"
+#include "Fl_Image_Scaler.h"
 #include <FL/Fl_PNG_Image.H>
 #include <FL/Fl_Shared_Image.H>
 #include <FL/fl_utf8.h>
@@ -91,6 +92,27 @@ Fl_PNG_Image::Fl_PNG_Image (const char *filename): Fl_RGB_Image(0,0,0)
 }
 
 
+/**
+ The constructor loads the named PNG image from the given png filename
+ in the given size.
+
+ This is faster than loading the image and scaling it with copy(W, H),
+ and needs less memory: the image rows are scaled to \p W x \p H pixels
+ as they are decoded, so that the image is never stored in its original
+ size. Interlaced PNG images are an exception: they must be decoded
+ completely before they can be scaled.
+
+ \param[in] filename    Name of PNG file to read
+ \param[in] W, H        Size of the image
+
+ \version 1.4.0
+ */
+Fl_PNG_Image::Fl_PNG_Image (const char *filename, int W, int H): Fl_RGB_Image(0,0,0)
+{
+  load_png_(filename, NULL, 0, W, H);
+}
+
+
 /**
  \brief Constructor that reads a PNG image from memory.
 
@@ -110,7 +132,8 @@ Fl_PNG_Image::Fl_PNG_Image (
 }
 
 
-void Fl_PNG_Image::load_png_(const char *name_png, const unsigned char *buffer_png, int maxsize)
+void Fl_PNG_Image::load_png_(const char *name_png, const unsigned char *buffer_png, int maxsize,
+                             int W, int H)
 {
 #if defined(HAVE_LIBPNG) && defined(HAVE_LIBZ)
   int i;                // Looping var
@@ -127,11 +150,15 @@ void Fl_PNG_Image::load_png_(const char *name_png, const unsigned char *buffer_p
 
   FILE** fp = new FILE*;   // always allocate file pointer
   *fp = NULL;
+  // Same for the scaler that scales the image while it is decoded
+  Fl_Image_Scaler** scaler = new Fl_Image_Scaler*;
+  *scaler = NULL;
 
   if (!from_memory) {
     if ((*fp = fl_fopen(name_png, "rb")) == NULL) {
       ld(ERR_FILE_ACCESS);
       delete fp;
+      delete scaler;
       return;
     }
   }
@@ -146,6 +173,7 @@ void Fl_PNG_Image::load_png_(const char *name_png, const unsigned char *buffer_p
     Fl::warning("Cannot allocate memory to read PNG file or data \"%s\".\n", display_name);
     w(0); h(0); d(0); ld(ERR_FORMAT);
     delete fp;
+    delete scaler;
     return;
   }
 
@@ -155,6 +183,8 @@ void Fl_PNG_Image::load_png_(const char *name_png, const unsigned char *buffer_p
     Fl::warning("PNG file or data \"%s\" is too large or contains errors!\n", display_name);
     w(0); h(0); d(0); ld(ERR_FORMAT);
     delete fp;
+    delete *scaler;
+    delete scaler;
     return;
   }
 
@@ -202,27 +232,60 @@ void Fl_PNG_Image::load_png_(const char *name_png, const unsigned char *buffer_p
     png_set_tRNS_to_alpha(pp);
 #  endif // HAVE_PNG_GET_VALID && HAVE_PNG_SET_TRNS_TO_ALPHA
 
-  if (((size_t)w()) * h() * d() > max_size() ) longjmp(png_jmpbuf(pp), 1);
-  array = new uchar[w() * h() * d()];
-  alloc_array = 1;
-
-  // Allocate pointers...
-  rows = new png_bytep[h()];
-
-  for (i = 0; i < h(); i ++)
-    rows[i] = (png_bytep)(array + i * w() * d());
+  if (W > 0 && H > 0 && (W != w() || H != h()) &&
+      png_get_interlace_type(pp, info) == PNG_INTERLACE_NONE) {
+    // Scale the rows to the requested size while reading them...
+    if (((size_t)W) * H * d() > max_size() ) longjmp(png_jmpbuf(pp), 1);
+    array = new uchar[W * H * d()];
+    alloc_array = 1;
+    *scaler = new Fl_Image_Scaler(w(), h(), d(), W, H, (uchar *)array);
+
+    for (i = 0; i < h(); i ++) {
+      png_read_row(pp, (*scaler)->buffer(), NULL);
+      (*scaler)->add_row();
+    }
 
-  // Read the image, handling interlacing as needed...
-  for (i = png_set_interlace_handling(pp); i > 0; i --)
-    png_read_rows(pp, rows, NULL, h());
+    delete *scaler;
+    *scaler = NULL;
+    w(W);
+    h(H);
+  } else {
+    if (((size_t)w()) * h() * d() > max_size() ) longjmp(png_jmpbuf(pp), 1);
+    array = new uchar[w() * h() * d()];
+    alloc_array = 1;
+
+    // Allocate pointers...
+    rows = new png_bytep[h()];
+
+    for (i = 0; i < h(); i ++)
+      rows[i] = (png_bytep)(array + i * w() * d());
+
+    // Read the image, handling interlacing as needed...
+    for (i = png_set_interlace_handling(pp); i > 0; i --)
+      png_read_rows(pp, rows, NULL, h());
+
+    // Free memory...
+    delete[] rows;
+
+    if (W > 0 && H > 0 && (W != w() || H != h())) {
+      // Interlaced image: scale it now
+      if (((size_t)W) * H * d() > max_size() ) longjmp(png_jmpbuf(pp), 1);
+      uchar *full = (uchar *)array;
+      array = new uchar[W * H * d()];
+      Fl_Image_Scaler full_scaler(w(), h(), d(), W, H, (uchar *)array);
+      for (i = 0; i < h(); i ++)
+        full_scaler.add_row(full + i * w() * d());
+      delete[] full;
+      w(W);
+      h(H);
+    }
+  }
 
   if (channels == 4) Fl::system_driver()->png_extra_rgba_processing((uchar*)array, w(), h());
 
-  // Free memory and return...
-  delete[] rows;
-
   png_read_end(pp, info);
   png_destroy_read_struct(&pp, &info, NULL);
+  delete scaler;
 
   if (from_memory) {
     if (w() && h() && name_png) {
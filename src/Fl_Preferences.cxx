@@ -839,12 +839,41 @@ char Fl_Preferences::getUserdataPath( char *path, int pathlen ) {
  Writes all preferences to disk. This function works only with
  the base preferences group. This function is rarely used as
  deleting the base preferences flushes automatically.
+
+ The preferences are written to a temporary file first, which then
+ replaces the preferences file. If the application is stopped while
+ writing, the previous preferences file is kept intact. Only groups
+ that were changed since they were last written are formatted again.
+
+ \see flush_async()
  */
 void Fl_Preferences::flush() {
-  if ( rootNode && node->dirty() )
+  if ( rootNode && ( node->dirty() || rootNode->writeFailed() ) )
     rootNode->write();
 }
 
+/**
+ Writes all preferences to disk in a background thread.
+
+ The preferences are formatted right away, but the file is written by
+ a background thread, so that the user interface is not blocked by a
+ slow disk. If this is called again while the file is still being
+ written, only the most recent preferences are written after that
+ (repeated calls are coalesced). Calling flush() or deleting the base
+ preferences writes the preferences immediately and makes sure that
+ the pending data of flush_async() is not written after them.
+
+ This function works only with the base preferences group. If the
+ platform does not support threads, the file is written immediately,
+ like flush() does.
+
+ \since 1.4.0
+ */
+void Fl_Preferences::flush_async() {
+  if ( rootNode && ( node->dirty() || rootNode->writeFailed() ) )
+    rootNode->write( 1 );
+}
+
 //-----------------------------------------------------------------------------
 // helper class to create dynamic group and entry names on the fly
 //
@@ -902,6 +931,117 @@ Fl_Preferences::Name::~Name() {
 
 int Fl_Preferences::Node::lastEntrySet = -1;
 
+// Entries and child nodes are found by hash indexes once a node has this many
+// of them. The indexes are kept current when entries and nodes are added and
+// removed. They use open addressing with linear probing.
+static const int hashThreshold = 16;
+
+// FNV-1a hash of an entry or node name
+static unsigned int hashName( const char *name, size_t len ) {
+  unsigned int h = 2166136261U;
+  for ( size_t i = 0; i < len; i++ )
+    h = ( h ^ (unsigned char)name[i] ) * 16777619U;
+  return h;
+}
+
+// The Writer writes the preferences file, maybe in a background thread.
+// - 'pending' is the file text that the background thread has yet to write
+// - every text gets a sequence number, and a file is only renamed into
+//   place if no later text was written before, so that an old text written
+//   by the background thread can not replace a newer one
+// - the background thread deletes the Writer if the RootNode was deleted
+//   while it was writing
+// - all members except 'seq' are protected by writer_mutex
+struct Fl_Preferences_Writer {
+  char *filename;
+  char *pending;
+  size_t pendingLen;
+  unsigned int pendingSeq;
+  unsigned int seq;           // last sequence number, used by the main thread only
+  unsigned int writtenSeq;    // sequence number of the current file
+  char busy;                  // the background thread is running
+  char orphan;                // the RootNode was deleted
+};
+
+static void *writer_mutex = 0;  // see Fl_System_Driver::mutex_lock()
+
+// make sure that system prefs are user-readable
+static void protectPrefsFile( char *filename ) {
+  if (Fl::system_driver()->preferences_need_protection_check()) {
+    // unix: make sure that system prefs are user-readable
+    if (strncmp(filename, "/etc/fltk/", 10) == 0) {
+      char *p;
+      p = filename + 9;
+      do {                       // for each directory to the pref file
+        *p = 0;
+        fl_chmod(filename, 0755); // rwxr-xr-x
+        *p = '/';
+        p = strchr(p+1, '/');
+      } while (p);
+      fl_chmod(filename, 0644);   // rw-r--r--
+    }
+  }
+}
+
+// write text into a temporary file and rename that to the preferences file
+// - 'suffix' makes the temporary file name unique per thread
+// - the text is on disk before it replaces the preferences file, and the
+//   file is replaced in one step, so that there is always a complete file
+static int writePrefsFile( Fl_Preferences_Writer *w, const char *suffix,
+                           const char *text, size_t len, unsigned int seq ) {
+  char tmpname[ FL_PATH_MAX ];
+  snprintf( tmpname, sizeof(tmpname), "%s%s", w->filename, suffix );
+  FILE *f = fl_fopen( tmpname, "wb" );
+  if ( !f )
+    return -1;
+  size_t written = fwrite( text, 1, len, f );
+  int synced = Fl::system_driver()->sync_file( f );
+  if ( fclose( f ) != 0 || written != len || synced != 0 ) {
+    fl_unlink( tmpname );
+    return -1;
+  }
+  int ret = 0;
+  Fl::system_driver()->mutex_lock(&writer_mutex);
+  if ( (int)(seq - w->writtenSeq) < 0 ) {
+    fl_unlink( tmpname );               // a newer text was written already
+  } else {
+    ret = Fl::system_driver()->replace_file( tmpname, w->filename );
+    if ( ret )
+      fl_unlink( tmpname );
+    else
+      w->writtenSeq = seq;
+  }
+  Fl::system_driver()->mutex_unlock(writer_mutex);
+  if ( !ret )
+    protectPrefsFile( w->filename );
+  return ret;
+}
+
+// background thread: write pending texts until there are none left
+static void writePrefsThread( void *data ) {
+  Fl_Preferences_Writer *w = (Fl_Preferences_Writer*)data;
+  for (;;) {
+    Fl::system_driver()->mutex_lock(&writer_mutex);
+    char *text = w->pending;
+    size_t len = w->pendingLen;
+    unsigned int seq = w->pendingSeq;
+    w->pending = 0L;
+    if ( !text ) {
+      w->busy = 0;
+      char orphan = w->orphan;
+      Fl::system_driver()->mutex_unlock(writer_mutex);
+      if ( orphan ) {
+        free( w->filename );
+        delete w;
+      }
+      return;
+    }
+    Fl::system_driver()->mutex_unlock(writer_mutex);
+    writePrefsFile( w, ".bgtmp", text, len, seq );
+    free( text );
+  }
+}
+
 // create the root node
 // - construct the name of the file that will hold our preferences
 Fl_Preferences::RootNode::RootNode( Fl_Preferences *prefs, Root root, const char *vendor, const char *application )
@@ -909,7 +1049,8 @@ Fl_Preferences::RootNode::RootNode( Fl_Preferences *prefs, Root root, const char
   filename_(0L),
   vendor_(0L),
   application_(0L),
-  root_(root)
+  root_(root),
+  writer_(0L)
 {
   char *filename = Fl::system_driver()->preference_rootnode(prefs, root, vendor, application);
   filename_    = filename ? fl_strdup(filename) : 0L;
@@ -925,7 +1066,8 @@ Fl_Preferences::RootNode::RootNode( Fl_Preferences *prefs, const char *path, con
   filename_(0L),
   vendor_(0L),
   application_(0L),
-  root_(Fl_Preferences::USER)
+  root_(Fl_Preferences::USER),
+  writer_(0L)
 {
 
   if (!vendor)
@@ -950,14 +1092,34 @@ Fl_Preferences::RootNode::RootNode( Fl_Preferences *prefs )
   filename_(0L),
   vendor_(0L),
   application_(0L),
-  root_(Fl_Preferences::USER)
+  root_(Fl_Preferences::USER),
+  writer_(0L)
 {
 }
 
 // destroy the root node and all depending nodes
 Fl_Preferences::RootNode::~RootNode() {
-  if ( prefs_->node->dirty() )
+  char busy = 0;
+  if ( writer_ ) {
+    Fl::system_driver()->mutex_lock(&writer_mutex);
+    busy = writer_->busy;
+    Fl::system_driver()->mutex_unlock(writer_mutex);
+  }
+  // if the background thread is still writing, write the latest text
+  // now, so that it is on disk when the application ends
+  if ( busy || prefs_->node->dirty() || writeFailed() )
     write();
+  if ( writer_ ) {
+    Fl::system_driver()->mutex_lock(&writer_mutex);
+    busy = writer_->busy;
+    writer_->orphan = 1;
+    Fl::system_driver()->mutex_unlock(writer_mutex);
+    if ( !busy ) {                      // else the thread deletes the writer
+      free( writer_->filename );
+      delete writer_;
+    }
+    writer_ = 0L;
+  }
   if ( filename_ ) {
     free( filename_ );
     filename_ = 0L;
@@ -1024,7 +1186,10 @@ int Fl_Preferences::RootNode::read() {
 }
 
 // write the group tree and all entry leafs
-int Fl_Preferences::RootNode::write() {
+// - the text of the file is assembled in memory and then written to a
+//   temporary file, which replaces the preferences file when complete
+// - if 'background' is set, the file is written by a background thread
+int Fl_Preferences::RootNode::write( int background ) {
   if (!filename_)   // RUNTIME preferences, or filename could not be created
     return -1;
   if ( (root_ & Fl_Preferences::CORE) && !(fileAccess_ & Fl_Preferences::CORE_WRITE_OK) )
@@ -1034,29 +1199,72 @@ int Fl_Preferences::RootNode::write() {
   if ( ((root_&Fl_Preferences::ROOT_MASK)==Fl_Preferences::SYSTEM) && !(fileAccess_ & Fl_Preferences::SYSTEM_WRITE_OK) )
     return -1;
   fl_make_path_for_file(filename_);
-  FILE *f = fl_fopen( filename_, "wb" );
-  if ( !f )
+  if ( !writer_ ) {
+    writer_ = new Fl_Preferences_Writer;
+    writer_->filename = fl_strdup( filename_ );
+    writer_->pending = 0L;
+    writer_->pendingLen = 0;
+    writer_->pendingSeq = writer_->seq = writer_->writtenSeq = 0;
+    writer_->busy = writer_->orphan = 0;
+  }
+  // assemble the file text
+  char head[ 3*FL_PATH_MAX ];
+  snprintf( head, sizeof(head), "; FLTK preferences file format 1.0\n"
+            "; vendor: %s\n; application: %s\n", vendor_, application_ );
+  size_t headLen = strlen( head );
+  size_t len = headLen + prefs_->node->write( 0L );
+  char *text = (char*)malloc( len );
+  if ( !text )
     return -1;
-  fprintf( f, "; FLTK preferences file format 1.0\n" );
-  fprintf( f, "; vendor: %s\n", vendor_ );
-  fprintf( f, "; application: %s\n", application_ );
-  prefs_->node->write( f );
-  fclose( f );
-  if (Fl::system_driver()->preferences_need_protection_check()) {
-    // unix: make sure that system prefs are user-readable
-    if (strncmp(filename_, "/etc/fltk/", 10) == 0) {
-      char *p;
-      p = filename_ + 9;
-      do {                       // for each directory to the pref file
-        *p = 0;
-        fl_chmod(filename_, 0755); // rwxr-xr-x
-        *p = '/';
-        p = strchr(p+1, '/');
-      } while (p);
-      fl_chmod(filename_, 0644);   // rw-r--r--
+  memcpy( text, head, headLen );
+  prefs_->node->write( text + headLen );
+  unsigned int seq = ++writer_->seq;
+  if ( background ) {
+    Fl::system_driver()->mutex_lock(&writer_mutex);
+    char *old = writer_->pending;       // not written yet, replace it
+    writer_->pending = text;
+    writer_->pendingLen = len;
+    writer_->pendingSeq = seq;
+    char start = !writer_->busy;
+    writer_->busy = 1;
+    Fl::system_driver()->mutex_unlock(writer_mutex);
+    if ( old )
+      free( old );
+    if ( !start || Fl::system_driver()->create_thread( writePrefsThread, writer_ ) == 0 ) {
+      // the text is formatted; if the thread fails to write it, writeFailed()
+      // makes flush() and the destructor try again
+      prefs_->node->clearDirtyFlags();
+      return 0;
     }
+    // no threads: write the file now
+    Fl::system_driver()->mutex_lock(&writer_mutex);
+    writer_->pending = 0L;
+    writer_->busy = 0;
+    Fl::system_driver()->mutex_unlock(writer_mutex);
+  } else {
+    // this text is newer than any pending text, so that is not needed
+    Fl::system_driver()->mutex_lock(&writer_mutex);
+    char *old = writer_->pending;
+    writer_->pending = 0L;
+    Fl::system_driver()->mutex_unlock(writer_mutex);
+    if ( old )
+      free( old );
   }
-  return 0;
+  int ret = writePrefsFile( writer_, ".tmp", text, len, seq );
+  free( text );
+  if ( ret == 0 )
+    prefs_->node->clearDirtyFlags();
+  return ret;
+}
+
+// check if the last text was not written, because writing the file failed
+char Fl_Preferences::RootNode::writeFailed() {
+  if ( !writer_ )
+    return 0;
+  Fl::system_driver()->mutex_lock(&writer_mutex);
+  char failed = !writer_->busy && writer_->writtenSeq != writer_->seq;
+  Fl::system_driver()->mutex_unlock(writer_mutex);
+  return failed;
 }
 
 // get the path to the preferences directory
@@ -1115,13 +1323,18 @@ char Fl_Preferences::RootNode::getPath( char *path, int pathlen ) {
 Fl_Preferences::Node::Node( const char *path ) {
   if ( path ) path_ = fl_strdup( path ); else path_ = 0;
   child_ = 0; next_ = 0; parent_ = 0;
+  text_ = 0; textLen_ = 0;
   entry_ = 0;
   nEntry_ = NEntry_ = 0;
   dirty_ = 0;
   top_ = 0;
   indexed_ = 0;
+  textValid_ = 0;
   index_ = 0;
   nIndex_ = NIndex_ = 0;
+  nChild_ = 0;
+  entryHash_ = 0; NEntryHash_ = 0;
+  childHash_ = 0; NChildHash_ = 0;
 }
 
 void Fl_Preferences::Node::deleteAllChildren() {
@@ -1131,7 +1344,13 @@ void Fl_Preferences::Node::deleteAllChildren() {
     delete nd;
   }
   child_ = 0L;
-  dirty_ = 1;
+  nChild_ = 0;
+  if ( childHash_ ) {
+    free( childHash_ );
+    childHash_ = 0L;
+    NChildHash_ = 0;
+  }
+  setDirty();
   updateIndex();
 }
 
@@ -1152,7 +1371,12 @@ void Fl_Preferences::Node::deleteAllEntries() {
     nEntry_ = 0;
     NEntry_ = 0;
   }
-  dirty_ = 1;
+  if ( entryHash_ ) {
+    free( entryHash_ );
+    entryHash_ = 0L;
+    NEntryHash_ = 0;
+  }
+  setDirty();
 }
 
 // delete this and all depending nodes
@@ -1160,6 +1384,10 @@ Fl_Preferences::Node::~Node() {
   deleteAllChildren();
   deleteAllEntries();
   deleteIndex();
+  if ( text_ ) {
+    free( text_ );
+    text_ = 0L;
+  }
   if ( path_ ) {
     free( path_ );
     path_ = 0L;
@@ -1186,37 +1414,64 @@ void Fl_Preferences::Node::clearDirtyFlags() {
   }
 }
 
-// write this node (recursively from the last neighbor back to this)
-// write all entries
-// write all children
-int Fl_Preferences::Node::write( FILE *f ) {
-  if ( next_ ) next_->write( f );
-  fprintf( f, "\n[%s]\n\n", path_ );
-  for ( int i = 0; i < nEntry_; i++ ) {
+// format the text of this group and all its entries into text_
+void Fl_Preferences::Node::createText() {
+  int i;
+  size_t len = strlen( path_ ) + 5;
+  for ( i = 0; i < nEntry_; i++ ) {
+    len += strlen( entry_[i].name ) + 2;
+    if ( entry_[i].value ) {    // continuation lines: '+' and up to 80 bytes
+      size_t n = strlen( entry_[i].value );
+      len += n + ( n > 60 ? ( n - 60 + 79 ) / 80 * 2 : 0 );
+    }
+  }
+  text_ = (char*)realloc( text_, len + 1 );
+  char *dst = text_;
+  dst += sprintf( dst, "\n[%s]\n\n", path_ );
+  for ( i = 0; i < nEntry_; i++ ) {
+    size_t n = strlen( entry_[i].name );
+    memcpy( dst, entry_[i].name, n );
+    dst += n;
     char *src = entry_[i].value;
     if ( src ) {                // hack it into smaller pieces if needed
-      fprintf( f, "%s:", entry_[i].name );
-      size_t cnt, written = 0;
+      *dst++ = ':';
+      size_t cnt;
       for ( cnt = 0; cnt < 60; cnt++ )
         if ( src[cnt]==0 ) break;
-      written += fwrite( src, cnt, 1, f );
-      fprintf( f, "\n" );
+      memcpy( dst, src, cnt );
+      dst += cnt;
       src += cnt;
       for (;*src;) {
+        *dst++ = '\n';
         for ( cnt = 0; cnt < 80; cnt++ )
           if ( src[cnt]==0 ) break;
-        fputc( '+', f );
-        written += fwrite( src, cnt, 1, f );
-        fputc( '\n', f );
+        *dst++ = '+';
+        memcpy( dst, src, cnt );
+        dst += cnt;
         src += cnt;
       }
     }
-    else
-      fprintf( f, "%s\n", entry_[i].name );
+    *dst++ = '\n';
   }
-  if ( child_ ) child_->write( f );
-  dirty_ = 0;
-  return 0;
+  textLen_ = dst - text_;
+}
+
+// write the text of this node and all its children into dst, in the order
+// the children were created, and return the length of the text
+// - if dst is NULL, only return the length
+// - the text of a node is only formatted again if its entries changed
+// - the dirty flags are cleared by the caller once the file was written
+size_t Fl_Preferences::Node::write( char *dst ) {
+  if ( !textValid_ ) {
+    createText();
+    textValid_ = 1;
+  }
+  size_t len = textLen_;
+  if ( dst ) memcpy( dst, text_, len );
+  createIndex();
+  for ( int i = 0; i < nIndex_; i++ )
+    len += index_[i]->write( dst ? dst+len : 0L );
+  return len;
 }
 
 // set the parent node and create the full path
@@ -1224,9 +1479,12 @@ void Fl_Preferences::Node::setParent( Node *pn ) {
   parent_ = pn;
   next_ = pn->child_;
   pn->child_ = this;
+  pn->nChild_++;
+  pn->updateIndex();
   sprintf( nameBuffer, "%s/%s", pn->path_, path_ );
   free( path_ );
   path_ = fl_strdup( nameBuffer );
+  if ( pn->childHash_ ) pn->hashChild( this );
 }
 
 // find the corresponding root node
@@ -1253,18 +1511,17 @@ Fl_Preferences::Node *Fl_Preferences::Node::addChild( const char *path ) {
 // create and set, or change an entry within this node
 void Fl_Preferences::Node::set( const char *name, const char *value )
 {
-  for ( int i=0; i<nEntry_; i++ ) {
-    if ( strcmp( name, entry_[i].name ) == 0 ) {
-      if ( !value ) return; // annotation
-      if ( strcmp( value, entry_[i].value ) != 0 ) {
-        if ( entry_[i].value )
-          free( entry_[i].value );
-        entry_[i].value = fl_strdup( value );
-        dirty_ = 1;
-      }
-      lastEntrySet = i;
-      return;
+  int i = getEntry( name );
+  if ( i >= 0 ) {
+    if ( !value ) return; // annotation
+    if ( strcmp( value, entry_[i].value ) != 0 ) {
+      if ( entry_[i].value )
+        free( entry_[i].value );
+      entry_[i].value = fl_strdup( value );
+      setDirty();
     }
+    lastEntrySet = i;
+    return;
   }
   if ( NEntry_==nEntry_ ) {
     NEntry_ = NEntry_ ? NEntry_*2 : 10;
@@ -1274,7 +1531,17 @@ void Fl_Preferences::Node::set( const char *name, const char *value )
   entry_[ nEntry_ ].value = value?fl_strdup(value):0;
   lastEntrySet = nEntry_;
   nEntry_++;
-  dirty_ = 1;
+  setDirty();
+  if ( entryHash_ ) {
+    if ( 2*nEntry_ > NEntryHash_ ) {
+      createEntryHash();
+    } else {
+      unsigned int mask = NEntryHash_-1;
+      unsigned int h = hashName( name, strlen( name ) ) & mask;
+      while ( entryHash_[h] ) h = (h+1) & mask;
+      entryHash_[h] = nEntry_;
+    }
+  }
 }
 
 // create or set a value (or annotation) from a single line in the file buffer
@@ -1308,6 +1575,7 @@ void Fl_Preferences::Node::add( const char *line ) {
   size_t b = strlen( line );
   dst = (char*)realloc( dst, a+b+1 );
   memcpy( dst+a, line, b+1 );
+  textValid_ = 0;
 }
 
 // get the value for a name, returns 0 if no such name
@@ -1318,9 +1586,22 @@ const char *Fl_Preferences::Node::get( const char *name ) {
 
 // find the index of an entry, returns -1 if no such entry
 int Fl_Preferences::Node::getEntry( const char *name ) {
-  for ( int i=0; i<nEntry_; i++ ) {
-    if ( strcmp( name, entry_[i].name ) == 0 ) {
-      return i;
+  if ( !entryHash_ ) {
+    if ( nEntry_ < hashThreshold ) {
+      for ( int i=0; i<nEntry_; i++ ) {
+        if ( strcmp( name, entry_[i].name ) == 0 ) {
+          return i;
+        }
+      }
+      return -1;
+    }
+    createEntryHash();
+  }
+  unsigned int mask = NEntryHash_-1;
+  unsigned int h = hashName( name, strlen( name ) ) & mask;
+  for ( int e; (e = entryHash_[h]); h = (h+1) & mask ) {
+    if ( strcmp( name, entry_[e-1].name ) == 0 ) {
+      return e-1;
     }
   }
   return -1;
@@ -1330,9 +1611,12 @@ int Fl_Preferences::Node::getEntry( const char *name ) {
 char Fl_Preferences::Node::deleteEntry( const char *name ) {
   int ix = getEntry( name );
   if ( ix == -1 ) return 0;
+  if ( entryHash_ ) unhashEntry( ix );
+  free( entry_[ix].name );
+  if ( entry_[ix].value ) free( entry_[ix].value );
   memmove( entry_+ix, entry_+ix+1, (nEntry_-ix-1) * sizeof(Entry) );
   nEntry_--;
-  dirty_ = 1;
+  setDirty();
   return 1;
 }
 
@@ -1345,18 +1629,15 @@ Fl_Preferences::Node *Fl_Preferences::Node::find( const char *path ) {
     if ( path[ len ] == 0 )
       return this;
     if ( path[ len ] == '/' ) {
-      Node *nd;
-      for ( nd = child_; nd; nd = nd->next_ ) {
-        Node *nn = nd->find( path );
-        if ( nn ) return nn;
-      }
       const char *s = path+len+1;
       const char *e = strchr( s, '/' );
+      Node *nd = findChild( s, e ? e-s : strlen( s ) );
+      if ( nd ) return nd->find( path );
       if (e) strlcpy( nameBuffer, s, e-s+1 );
       else strlcpy( nameBuffer, s, sizeof(nameBuffer));
       nd = new Node( nameBuffer );
       nd->setParent( this );
-      dirty_ = 1;
+      setDirty();
       return nd->find( path );
     }
   }
@@ -1392,11 +1673,10 @@ Fl_Preferences::Node *Fl_Preferences::Node::search( const char *path, int offset
     if ( len > 0 && path[ len ] == 0 )
       return this;
     if ( len <= 0 || path[ len ] == '/' ) {
-      for ( Node *nd = child_; nd; nd = nd->next_ ) {
-        Node *nn = nd->search( path, offset );
-        if ( nn ) return nn;
-      }
-      return 0;
+      const char *s = len > 0 ? path+len+1 : path;
+      const char *e = strchr( s, '/' );
+      Node *nd = findChild( s, e ? e-s : strlen( s ) );
+      return nd ? nd->search( path, offset ) : 0;
     }
   }
   return 0;
@@ -1404,14 +1684,7 @@ Fl_Preferences::Node *Fl_Preferences::Node::search( const char *path, int offset
 
 // return the number of child nodes (groups)
 int Fl_Preferences::Node::nChildren() {
-  if (indexed_) {
-    return nIndex_;
-  } else {
-    int cnt = 0;
-    for ( Node *nd = child_; nd; nd = nd->next_ )
-      cnt++;
-    return cnt;
-  }
+  return nChild_;
 }
 
 // return the node name
@@ -1463,10 +1736,12 @@ char Fl_Preferences::Node::remove() {
           np->next_ = nd->next_;
         else
           parent()->child_ = nd->next_;
+        parent()->nChild_--;
+        if ( parent()->childHash_ ) parent()->unhashChild( this );
         break;
       }
     }
-    parent()->dirty_ = 1;
+    parent()->setDirty();
     parent()->updateIndex();
   }
   delete this;
@@ -1500,6 +1775,104 @@ void Fl_Preferences::Node::deleteIndex() {
   indexed_ = 0;
 }
 
+// (re)build the hash index of all entries, with at most 50% of the slots used
+void Fl_Preferences::Node::createEntryHash() {
+  int n = 32;
+  while ( n < 2*nEntry_+2 ) n *= 2;
+  entryHash_ = (int*)realloc( entryHash_, n*sizeof(int) );
+  memset( entryHash_, 0, n*sizeof(int) );
+  NEntryHash_ = n;
+  unsigned int mask = n-1;
+  for ( int i = 0; i < nEntry_; i++ ) {
+    unsigned int h = hashName( entry_[i].name, strlen( entry_[i].name ) ) & mask;
+    while ( entryHash_[h] ) h = (h+1) & mask;
+    entryHash_[h] = i+1;
+  }
+}
+
+// remove entry ix from the hash index, and renumber the entries after it
+void Fl_Preferences::Node::unhashEntry( int ix ) {
+  unsigned int mask = NEntryHash_-1;
+  unsigned int h = hashName( entry_[ix].name, strlen( entry_[ix].name ) ) & mask;
+  while ( entryHash_[h] != ix+1 ) h = (h+1) & mask;
+  // move following entries of the cluster back into the free slot
+  for ( unsigned int j = (h+1) & mask; entryHash_[j]; j = (j+1) & mask ) {
+    const char *name = entry_[ entryHash_[j]-1 ].name;
+    unsigned int k = hashName( name, strlen( name ) ) & mask;
+    if ( ((j-k) & mask) >= ((j-h) & mask) ) {
+      entryHash_[h] = entryHash_[j];
+      h = j;
+    }
+  }
+  entryHash_[h] = 0;
+  for ( int i = 0; i < NEntryHash_; i++ )
+    if ( entryHash_[i] > ix+1 ) entryHash_[i]--;
+}
+
+// build the hash index of all children, with at most 50% of the slots used
+void Fl_Preferences::Node::createChildHash() {
+  int n = 32;
+  while ( n < 2*nChild_+2 ) n *= 2;
+  childHash_ = (Node**)realloc( childHash_, n*sizeof(Node*) );
+  memset( childHash_, 0, n*sizeof(Node*) );
+  NChildHash_ = n;
+  for ( Node *nd = child_; nd; nd = nd->next_ )
+    hashChild( nd );
+}
+
+// add a child node to the hash index
+void Fl_Preferences::Node::hashChild( Node *nd ) {
+  if ( 2*nChild_ > NChildHash_ ) {
+    createChildHash(); // this adds nd as well
+    return;
+  }
+  const char *name = nd->name();
+  unsigned int mask = NChildHash_-1;
+  unsigned int h = hashName( name, strlen( name ) ) & mask;
+  while ( childHash_[h] && childHash_[h] != nd ) h = (h+1) & mask;
+  childHash_[h] = nd;
+}
+
+// remove a child node from the hash index
+void Fl_Preferences::Node::unhashChild( Node *nd ) {
+  const char *name = nd->name();
+  unsigned int mask = NChildHash_-1;
+  unsigned int h = hashName( name, strlen( name ) ) & mask;
+  while ( childHash_[h] && childHash_[h] != nd ) h = (h+1) & mask;
+  if ( !childHash_[h] ) return;
+  // move following nodes of the cluster back into the free slot
+  for ( unsigned int j = (h+1) & mask; childHash_[j]; j = (j+1) & mask ) {
+    name = childHash_[j]->name();
+    unsigned int k = hashName( name, strlen( name ) ) & mask;
+    if ( ((j-k) & mask) >= ((j-h) & mask) ) {
+      childHash_[h] = childHash_[j];
+      h = j;
+    }
+  }
+  childHash_[h] = 0;
+}
+
+// find the child node with the given name of len bytes, returns 0 if there is none
+Fl_Preferences::Node *Fl_Preferences::Node::findChild( const char *name, size_t len ) {
+  if ( !childHash_ ) {
+    if ( nChild_ < hashThreshold ) {
+      for ( Node *nd = child_; nd; nd = nd->next_ ) {
+        const char *nn = nd->name();
+        if ( strncmp( nn, name, len ) == 0 && nn[len] == 0 ) return nd;
+      }
+      return 0;
+    }
+    createChildHash();
+  }
+  unsigned int mask = NChildHash_-1;
+  unsigned int h = hashName( name, len ) & mask;
+  for ( Node *nd; (nd = childHash_[h]); h = (h+1) & mask ) {
+    const char *nn = nd->name();
+    if ( strncmp( nn, name, len ) == 0 && nn[len] == 0 ) return nd;
+  }
+  return 0;
+}
+
 /**
  \brief Create a plugin.
 
@@ -23,8 +23,10 @@
 #include <FL/fl_draw.H>
 #include <FL/fl_string.h>
 #include "Fl_Screen_Driver.H"
+#include "Fl_System_Driver.H"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #if !defined(HAVE_LONG_LONG)
 static double strtoll(const char *str, char **endptr, int base) {
@@ -73,6 +75,8 @@ Fl_SVG_Image::Fl_SVG_Image(Fl_SVG_Image *source) : Fl_RGB_Image(NULL, 0, 0, 4) {
 Fl_SVG_Image::~Fl_SVG_Image() {
   if ( --counted_svg_image_->ref_count <= 0) {
     nsvgDelete(counted_svg_image_->svg_image);
+    delete[] counted_svg_image_->raster[0];
+    delete[] counted_svg_image_->raster[1];
     delete counted_svg_image_;
   }
 }
@@ -133,6 +137,7 @@ void Fl_SVG_Image::init_(const char *filename, const char *in_filedata, Fl_SVG_I
     counted_svg_image_ = new counted_NSVGimage;
     counted_svg_image_->svg_image = NULL;
     counted_svg_image_->ref_count = 1;
+    counted_svg_image_->raster[0] = counted_svg_image_->raster[1] = NULL;
   }
   char *filedata = NULL;
   to_desaturate_ = false;
@@ -182,8 +187,45 @@ void Fl_SVG_Image::init_(const char *filename, const char *in_filedata, Fl_SVG_I
 }
 
 
+// Rasterizers that are not in use; rasterize_tile() takes one or creates a
+// new one, so that several images or tiles can be rasterized at the same time
+static NSVGrasterizer *free_rasterizers[16];
+static int num_free_rasterizers = 0;
+static void *rasterizers_mutex = 0;     // protects the free rasterizers
+
+// What rasterize_tile() needs to know
+struct svg_tiles {
+  NSVGimage *image;
+  float fx, fy;         // scaling factors
+  uchar *array;         // RGBA image data
+  int W, H;             // image size
+  int tiles;            // number of tiles
+};
+
+// Rasterize rows H * tile / tiles to H * (tile + 1) / tiles - 1
+static void rasterize_tile(void *data, int tile) {
+  svg_tiles *t = (svg_tiles *)data;
+  int y0 = (int)((long)t->H * tile / t->tiles);
+  int y1 = (int)((long)t->H * (tile + 1) / t->tiles);
+  NSVGrasterizer *rasterizer = NULL;
+  Fl::system_driver()->mutex_lock(&rasterizers_mutex);
+  if (num_free_rasterizers > 0) rasterizer = free_rasterizers[--num_free_rasterizers];
+  Fl::system_driver()->mutex_unlock(rasterizers_mutex);
+  if (!rasterizer) rasterizer = nsvgCreateRasterizer();
+  nsvgRasterizeXY(rasterizer, t->image, 0, float(-y0), t->fx, t->fy,
+                  t->array + (size_t)y0 * t->W * 4, t->W, y1 - y0, t->W * 4);
+  Fl::system_driver()->mutex_lock(&rasterizers_mutex);
+  if (num_free_rasterizers < 16) {
+    free_rasterizers[num_free_rasterizers++] = rasterizer;
+    rasterizer = NULL;
+  }
+  Fl::system_driver()->mutex_unlock(rasterizers_mutex);
+  if (rasterizer) nsvgDeleteRasterizer(rasterizer);
+}
+
+
 void Fl_SVG_Image::rasterize_(int W, int H) {
-  static NSVGrasterizer *rasterizer = nsvgCreateRasterizer();
+  counted_NSVGimage *c = counted_svg_image_;
   double fx, fy;
   if (proportional) {
     fx = svg_scaling_(W, H);
@@ -193,7 +235,56 @@ void Fl_SVG_Image::rasterize_(int W, int H) {
     fy = (double)H / counted_svg_image_->svg_image->height;
   }
   array = new uchar[W*H*4];
-  nsvgRasterizeXY(rasterizer, counted_svg_image_->svg_image, 0, 0, float(fx), float(fy), (uchar* )array, W, H, W*4);
+  // Use the rasterization of another copy or of a previous size, if any...
+  int i, found = -1;
+  Fl::system_driver()->mutex_lock(&rasterizers_mutex);
+  for (i = 0; i < 2; i++) {
+    if (c->raster[i] && c->raster_w[i] == W && c->raster_h[i] == H &&
+        c->raster_proportional[i] == proportional) found = i;
+  }
+  if (found >= 0) memcpy((uchar *)array, c->raster[found], W*H*4);
+  if (found == 1) { // most recently used first
+    uchar *r = c->raster[0]; c->raster[0] = c->raster[1]; c->raster[1] = r;
+    c->raster_w[1] = c->raster_w[0]; c->raster_w[0] = W;
+    c->raster_h[1] = c->raster_h[0]; c->raster_h[0] = H;
+    c->raster_proportional[1] = c->raster_proportional[0];
+    c->raster_proportional[0] = proportional;
+  }
+  Fl::system_driver()->mutex_unlock(rasterizers_mutex);
+  if (found < 0) {
+    // ... or rasterize the image, in tiles of rows in parallel if it is large
+    svg_tiles tiles;
+    tiles.image = c->svg_image;
+    tiles.fx = float(fx);
+    tiles.fy = float(fy);
+    tiles.array = (uchar *)array;
+    tiles.W = W;
+    tiles.H = H;
+    // (each tile costs some overhead, so use no more tiles than threads)
+    tiles.tiles = (W*H >= 256*256) ? H / 64 : 1;
+    if (tiles.tiles > Fl::system_driver()->parallel_count())
+      tiles.tiles = Fl::system_driver()->parallel_count();
+    if (tiles.tiles < 1) tiles.tiles = 1; // short and wide images
+    if (tiles.tiles > 1)
+      Fl::system_driver()->run_parallel(rasterize_tile, &tiles, tiles.tiles);
+    else
+      rasterize_tile(&tiles, 0);
+    if (W*H <= 1024*1024) { // keep it, unless it's huge
+      uchar *keep = new uchar[W*H*4];
+      memcpy(keep, (uchar *)array, W*H*4);
+      Fl::system_driver()->mutex_lock(&rasterizers_mutex);
+      delete[] c->raster[1];
+      c->raster[1] = c->raster[0];
+      c->raster_w[1] = c->raster_w[0];
+      c->raster_h[1] = c->raster_h[0];
+      c->raster_proportional[1] = c->raster_proportional[0];
+      c->raster[0] = keep;
+      c->raster_w[0] = W;
+      c->raster_h[0] = H;
+      c->raster_proportional[0] = proportional;
+      Fl::system_driver()->mutex_unlock(rasterizers_mutex);
+    }
+  }
   alloc_array = 1;
   data((const char * const *)&array, 1);
   d(4);
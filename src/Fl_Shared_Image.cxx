@@ -17,6 +17,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <FL/fl_utf8.h>
+#include <FL/fl_string.h>
 #include "flstring.h"
 
 #include <FL/Fl.H>
@@ -25,6 +26,7 @@
 #include <FL/Fl_XPM_Image.H>
 #include <FL/Fl_Preferences.H>
 #include <FL/fl_draw.H>
+#include "Fl_System_Driver.H"
 
 //
 // Global class vars...
@@ -40,11 +42,185 @@ int     Fl_Shared_Image::alloc_handlers_ = 0;   // Allocated format handlers
 
 
 //
-// Typedef the C API sort function type the only way I know how...
+// Background loading (see Fl_Shared_Image::get_async())...
+//
+//    Jobs go from the pending list to the running list when a worker thread
+//    picks them up, and to the done list when the worker has loaded the image.
+//    The main thread then installs the image data in load_done().
+//    All lists are protected by images_mutex.
+//
+//    Each get_async() call for an image that is being loaded adds its
+//    callback to the job, so that all of them are called when it is done.
+//
+
+#define MAX_LOAD_THREADS 4              // Max. number of worker threads
+
+struct Fl_Shared_Image_Waiter {
+  Fl_Shared_Image_Loaded cb;            // Callback, or 0 to redraw all windows
+  void                  *data;          // User data for cb
+  Fl_Shared_Image_Waiter *next;         // Next callback of the same job
+};
+
+struct Fl_Shared_Image_Job {
+  Fl_Shared_Image       *image;         // Image to load, 0 if canceled
+  char                  *name;          // Filename (copy, for the worker)
+  int                   w, h;           // Requested size, or 0
+  Fl_Image              *result;        // Loaded image
+  int                   defer;          // Must be loaded in the main thread?
+  Fl_Shared_Image_Waiter *waiters;      // Callbacks to call when done
+  Fl_Shared_Image_Job   *next;          // Next job in list
+};
+
+static Fl_Shared_Image_Job *pending_first = 0,  // Jobs waiting for a worker
+                           *pending_last = 0,
+                           *running_jobs = 0,   // Jobs being loaded
+                           *done_jobs = 0;      // Jobs loaded, not yet installed
+static int num_jobs = 0;                        // Number of jobs in all lists
+static int num_threads = 0;                     // Number of worker threads
+static int awake_sent = 0;                      // load_done() requested via Fl::awake()?
+static void *images_mutex = 0;                  // See Fl_System_Driver::mutex_lock()
+
+
+//
+// 'find_job()' - Find the job that loads an image, call with the lock held.
+//
+
+static Fl_Shared_Image_Job *find_job(Fl_Shared_Image *img) {
+  Fl_Shared_Image_Job *lists[3] = { pending_first, running_jobs, done_jobs };
+
+  for (int i = 0; i < 3; i ++)
+    for (Fl_Shared_Image_Job *job = lists[i]; job; job = job->next)
+      if (job->image == img) return job;
+
+  return 0;
+}
+
+
+//
+// 'add_waiter()' - Add a callback to the job that loads an image.
+//
+
+static void add_waiter(Fl_Shared_Image *img, Fl_Shared_Image_Loaded cb, void *data) {
+  Fl_Shared_Image_Waiter *w = new Fl_Shared_Image_Waiter, **last;
+
+  w->cb   = cb;
+  w->data = data;
+  w->next = 0;
+
+  Fl::system_driver()->mutex_lock(&images_mutex);
+  Fl_Shared_Image_Job *job = find_job(img);
+  if (job) {
+    for (last = &job->waiters; *last; last = &(*last)->next) {}
+    *last = w;
+    w = 0;
+  }
+  Fl::system_driver()->mutex_unlock(images_mutex);
+
+  delete w;                             // no job, image isn't loading anymore
+}
+
+
+//
+// 'take_waiters()' - Take the callbacks from the job that loads an image.
+//
+
+static Fl_Shared_Image_Waiter *take_waiters(Fl_Shared_Image *img) {
+  Fl_Shared_Image_Waiter *w = 0;
+
+  Fl::system_driver()->mutex_lock(&images_mutex);
+  Fl_Shared_Image_Job *job = find_job(img);
+  if (job) {
+    w = job->waiters;
+    job->waiters = 0;
+  }
+  Fl::system_driver()->mutex_unlock(images_mutex);
+
+  return w;
+}
+
+
+//
+// 'call_waiters()' - Call and free callbacks, return 1 if windows need a redraw.
+//
+
+static int call_waiters(Fl_Shared_Image *img, Fl_Shared_Image_Waiter *w) {
+  int need_redraw = 0;
+
+  while (w) {
+    Fl_Shared_Image_Waiter *next = w->next;
+    if (w->cb) (w->cb)(img, w->data);
+    else need_redraw = 1;
+    delete w;
+    w = next;
+  }
+
+  return need_redraw;
+}
+
+
+//
+// 'free_waiters()' - Free callbacks of a canceled job.
+//
+
+static void free_waiters(Fl_Shared_Image_Waiter *w) {
+  while (w) {
+    Fl_Shared_Image_Waiter *next = w->next;
+    delete w;
+    w = next;
+  }
+}
+
+
+//
+// Memory budget (see Fl_Shared_Image::cache_budget())...
+//
+//    Images with image data are kept in a list, most recently used first.
+//    If their data exceeds the budget, trim() frees the data of the least
+//    recently used images that can be reloaded from their files.
 //
 
-extern "C" {
-  typedef int (*compare_func_t)(const void *, const void *);
+static size_t cache_budget_ = 0;                // Memory budget, 0 = none
+static size_t cache_bytes_ = 0;                 // Bytes of image data in cache
+static unsigned long cache_hits_ = 0;           // get() found the image
+static unsigned long cache_misses_ = 0;         // get() had to load or copy
+static unsigned long cache_evictions_ = 0;      // Images whose data was freed
+static Fl_Shared_Image *lru_first_ = 0;         // Most recently used image
+static Fl_Shared_Image *lru_last_ = 0;          // Least recently used image
+
+// Estimate the memory used by an image's data
+static size_t image_bytes(Fl_Image *img) {
+  if (!img) return 0;
+  size_t depth = img->d() > 0 ? img->d() : 1;
+  return (size_t)img->data_w() * img->data_h() * depth;
+}
+
+static Fl_Image *load_file(const char *name,
+                           Fl_Shared_Handler *handlers, int num_handlers,
+                           int in_thread, int *defer, int W = 0, int H = 0);
+
+// Handlers that load images in a given size (see add_handler())
+static Fl_Shared_Sized_Handler *sized_handlers_ = 0;
+static int num_sized_handlers_ = 0;
+static int alloc_sized_handlers_ = 0;
+
+
+//
+// Hash table of all shared images by name (see Fl_Shared_Image::find())...
+//
+//    All images with the same name are in the same chain, so find() can
+//    look for an image of the requested size or for the original image.
+//
+
+static Fl_Shared_Image **hash_table = 0;        // Chains of images
+static unsigned hash_size = 0;                  // Size of hash table (power of 2)
+
+static unsigned hash_name(const char *name) {
+  unsigned h = 2166136261U;                     // FNV-1a
+  while (*name) {
+    h ^= (unsigned char)*name++;
+    h *= 16777619U;
+  }
+  return h;
 }
 
 
@@ -60,6 +236,79 @@ int Fl_Shared_Image::num_images() {
 }
 
 
+/**
+  Sets the memory budget for the image data of all shared images.
+
+  If the image data of all shared images exceeds \p bytes, the data of the
+  least recently drawn images is freed, as long as it can be loaded from
+  the image file again. This is done automatically when such an image is
+  drawn or copied again. Images whose data was changed by color_average()
+  or desaturate(), and images not loaded from a file, are never freed.
+
+  With a budget, released images that can be loaded again are also kept
+  in the cache until the budget is exceeded, so get() can find them again.
+
+  The default, 0, means no budget: the data of all images stays in memory,
+  and images are deleted when they are released for the last time.
+
+  \param[in] bytes      memory budget in bytes, or 0
+  \see cache_bytes(), cache_statistics()
+  \since FLTK 1.4.0
+*/
+void Fl_Shared_Image::cache_budget(size_t bytes) {
+  cache_budget_ = bytes;
+  if (bytes) {
+    if (cache_bytes_ > bytes) trim(0);
+    return;
+  }
+  // No budget; delete unreferenced images as release() would have
+  Fl_Shared_Image *img, *prev;
+  for (img = lru_last_; img; img = prev) {
+    prev = img->lru_prev_;
+    if (img->refcount_ <= 0) {
+      img->remove();
+      delete img;
+    }
+  }
+}
+
+
+/** Returns the memory budget for the image data of all shared images.
+  \see cache_budget(size_t)
+*/
+size_t Fl_Shared_Image::cache_budget() {
+  return cache_budget_;
+}
+
+
+/** Returns the (estimated) size in bytes of the image data of all shared images
+  currently in memory.
+  \see cache_budget(size_t)
+*/
+size_t Fl_Shared_Image::cache_bytes() {
+  return cache_bytes_;
+}
+
+
+/**
+  Returns cache statistics.
+
+  \param[out] hits      number of get() and get_async() calls that found
+                        the requested image in the cache
+  \param[out] misses    number of get() and get_async() calls that had to
+                        load or copy the image
+  \param[out] evictions number of images whose data was freed to stay
+                        within the memory budget
+  \see cache_budget(size_t)
+*/
+void Fl_Shared_Image::cache_statistics(unsigned long &hits, unsigned long &misses,
+                                       unsigned long &evictions) {
+  hits      = cache_hits_;
+  misses    = cache_misses_;
+  evictions = cache_evictions_;
+}
+
+
 /**
   Compares two shared images.
 
@@ -76,9 +325,8 @@ int Fl_Shared_Image::num_images() {
   An image is marked \p original if it was directly loaded from a file or
   from memory as opposed to copied and resized images.
 
-  This comparison is used in Fl_Shared_Image::find() to find an image that
-  matches the requested one or to find the position where a new image
-  should be entered into the sorted list of shared images.
+  These are the rules Fl_Shared_Image::find() uses to find an image that
+  matches the requested one.
 
   It is usually used in two steps:
 
@@ -121,6 +369,13 @@ Fl_Shared_Image::Fl_Shared_Image() : Fl_Image(0,0,0) {
   original_    = 0;
   image_       = 0;
   alloc_image_ = 0;
+  loading_     = 0;
+  reloadable_  = 0;
+  bytes_       = 0;
+  lru_prev_    = 0;
+  lru_next_    = 0;
+  hash_next_   = 0;
+  index_       = -1;
 }
 
 
@@ -141,6 +396,13 @@ Fl_Shared_Image::Fl_Shared_Image(const char *n,         // I - Filename
   image_       = img;
   alloc_image_ = !img;
   original_    = 1;
+  loading_     = 0;
+  reloadable_  = 0;
+  bytes_       = 0;
+  lru_prev_    = 0;
+  lru_next_    = 0;
+  hash_next_   = 0;
+  index_       = -1;
 
   if (!img) reload();
   else update();
@@ -148,20 +410,18 @@ Fl_Shared_Image::Fl_Shared_Image(const char *n,         // I - Filename
 
 
 /**
-  Adds a shared image to the image cache.
+  Makes room for \p count images in the image cache.
 
-  This \b protected method adds an image to the cache, an ordered list
-  of shared images. The cache is searched for a matching image whenever
-  one is requested, for instance with Fl_Shared_Image::get() or
-  Fl_Shared_Image::find().
+  This \b protected method grows the array of shared images and the hash
+  table, so that \p count images can be added without allocating more
+  memory.
 */
-void
-Fl_Shared_Image::add() {
-  Fl_Shared_Image       **temp;         // New image pointer array...
-
-  if (num_images_ >= alloc_images_) {
+void Fl_Shared_Image::reserve(int count) {
+  if (count > alloc_images_) {
     // Allocate more memory...
-    temp = new Fl_Shared_Image *[alloc_images_ + 32];
+    int alloc = alloc_images_ < 32 ? 32 : 2 * alloc_images_;
+    while (alloc < count) alloc *= 2;
+    Fl_Shared_Image **temp = new Fl_Shared_Image *[alloc];
 
     if (alloc_images_) {
       memcpy(temp, images_, alloc_images_ * sizeof(Fl_Shared_Image *));
@@ -170,16 +430,47 @@ Fl_Shared_Image::add() {
     }
 
     images_       = temp;
-    alloc_images_ += 32;
+    alloc_images_ = alloc;
   }
 
+  if ((unsigned)count > hash_size) {
+    // Grow the hash table and rehash all images...
+    unsigned size = hash_size ? 2 * hash_size : 64;
+    while (size < (unsigned)count) size *= 2;
+    if (hash_table) delete[] hash_table;
+    hash_table = new Fl_Shared_Image *[size];
+    memset(hash_table, 0, size * sizeof(Fl_Shared_Image *));
+    hash_size = size;
+    for (int i = 0; i < num_images_; i ++) {
+      unsigned h = hash_name(images_[i]->name_) & (hash_size - 1);
+      images_[i]->hash_next_ = hash_table[h];
+      hash_table[h] = images_[i];
+    }
+  }
+}
+
+
+/**
+  Adds a shared image to the image cache.
+
+  This \b protected method adds an image to the cache, a hash table
+  of shared images. The cache is searched for a matching image whenever
+  one is requested, for instance with Fl_Shared_Image::get() or
+  Fl_Shared_Image::find().
+*/
+void
+Fl_Shared_Image::add() {
+  if (index_ >= 0) return;
+
+  reserve(num_images_ + 1);
+
+  index_ = num_images_;
   images_[num_images_] = this;
   num_images_ ++;
 
-  if (num_images_ > 1) {
-    qsort(images_, num_images_, sizeof(Fl_Shared_Image *),
-          (compare_func_t)compare);
-  }
+  unsigned h = hash_name(name_) & (hash_size - 1);
+  hash_next_ = hash_table[h];
+  hash_table[h] = this;
 }
 
 
@@ -195,6 +486,105 @@ Fl_Shared_Image::update() {
     d(image_->d());
     data(image_->data(), image_->count());
   }
+
+  // Account for the image data in the cache
+  cache_bytes_ -= bytes_;
+  bytes_ = image_bytes(image_);
+  cache_bytes_ += bytes_;
+  touch();
+  if (cache_budget_ && cache_bytes_ > cache_budget_) trim(this);
+}
+
+
+//
+// 'Fl_Shared_Image::touch()' - Mark image as most recently used.
+//
+// Images without image data are removed from the list instead.
+//
+
+void Fl_Shared_Image::touch() {
+  if (lru_first_ == this) {
+    if (bytes_) return;
+  }
+  // Unlink...
+  if (lru_prev_) lru_prev_->lru_next_ = lru_next_;
+  else if (lru_first_ == this) lru_first_ = lru_next_;
+  if (lru_next_) lru_next_->lru_prev_ = lru_prev_;
+  else if (lru_last_ == this) lru_last_ = lru_prev_;
+  lru_prev_ = lru_next_ = 0;
+  if (!bytes_) return;
+  // ...and put in front
+  lru_next_ = lru_first_;
+  if (lru_first_) lru_first_->lru_prev_ = this;
+  lru_first_ = this;
+  if (!lru_last_) lru_last_ = this;
+}
+
+
+//
+// 'Fl_Shared_Image::evict()' - Free the image data, keep everything else.
+//
+// restore() loads the data again when needed.
+//
+
+void Fl_Shared_Image::evict() {
+  if (alloc_image_) delete image_;
+  image_ = 0;
+  data(0, 0);
+  cache_bytes_ -= bytes_;
+  bytes_ = 0;
+  touch();
+  cache_evictions_ ++;
+}
+
+
+//
+// 'Fl_Shared_Image::restore()' - Load image data freed by evict() again.
+//
+
+void Fl_Shared_Image::restore() {
+  int W = w(), H = h();                 // Drawing size
+  int DW = data_w(), DH = data_h();     // Size of image data
+  Fl_Image *img = original_ ? load_file(name_, handlers_, num_handlers_, 0, 0)
+                : load_file(name_, handlers_, num_handlers_, 0, 0, DW, DH);
+
+  if (img && !original_ && (img->w() != DW || img->h() != DH)) {
+    Fl_Image *scaled = img->copy(DW, DH);
+    delete img;
+    img = scaled;
+  }
+  if (!img) {                           // e.g. file was removed
+    reloadable_ = 0;
+    return;
+  }
+  image_ = img;
+  alloc_image_ = 1;
+  update();
+  scale(W, H, 0, 1);
+}
+
+
+//
+// 'Fl_Shared_Image::trim()' - Free image data to stay within the budget.
+//
+// Starts with the least recently used images. Unreferenced images are
+// deleted, the data of other images is freed if it can be reloaded.
+//
+
+void Fl_Shared_Image::trim(Fl_Shared_Image *keep) {
+  Fl_Shared_Image *img, *prev;          // Looping vars
+
+  for (img = lru_last_; img && cache_bytes_ > cache_budget_; img = prev) {
+    prev = img->lru_prev_;
+    if (img == keep || !img->reloadable_ || img->loading_) continue;
+    if (img->refcount_ <= 0) {
+      img->remove();
+      delete img;
+      cache_evictions_ ++;
+    } else {
+      img->evict();
+    }
+  }
 }
 
 /**
@@ -205,6 +595,9 @@ Fl_Shared_Image::update() {
   Use the Fl_Shared_Image::release() method instead.
 */
 Fl_Shared_Image::~Fl_Shared_Image() {
+  cache_bytes_ -= bytes_;
+  bytes_ = 0;
+  touch();                              // removes image from LRU list
   if (name_) delete[] (char *)name_;
   if (alloc_image_) delete image_;
 }
@@ -217,71 +610,148 @@ Fl_Shared_Image::~Fl_Shared_Image() {
   so that no hole will occur.
 */
 void Fl_Shared_Image::release() {
-  int   i;      // Looping var...
-
   refcount_ --;
   if (refcount_ > 0) return;
 
-  for (i = 0; i < num_images_; i ++)
-    if (images_[i] == this) {
-      num_images_ --;
+  if (loading_) cancel_load();
 
-      if (i < num_images_) {
-        memmove(images_ + i, images_ + i + 1,
-               (num_images_ - i) * sizeof(Fl_Shared_Image *));
-      }
-
-      break;
-    }
+  // Keep unreferenced images in the cache while within the memory budget
+  if (cache_budget_ && reloadable_ && bytes_ && cache_bytes_ <= cache_budget_)
+    return;
 
+  remove();
   delete this;
+}
+
+
+/**
+  Removes a shared image from the image cache.
+
+  This \b protected method moves the last image of the shared image array
+  to the position of the removed image, so that no hole will occur.
+*/
+void Fl_Shared_Image::remove() {
+  if (index_ < 0) return;
+
+  // Remove from the hash table...
+  Fl_Shared_Image **prev = hash_table + (hash_name(name_) & (hash_size - 1));
+  while (*prev && *prev != this) prev = &(*prev)->hash_next_;
+  if (*prev) *prev = hash_next_;
+  hash_next_ = 0;
+
+  // ...and from the array
+  num_images_ --;
+  if (index_ < num_images_) {
+    images_[index_] = images_[num_images_];
+    images_[index_]->index_ = index_;
+  }
+  index_ = -1;
 
   if (num_images_ == 0 && images_) {
     delete[] images_;
 
     images_       = 0;
     alloc_images_ = 0;
+
+    delete[] hash_table;
+
+    hash_table    = 0;
+    hash_size     = 0;
   }
 }
 
 
-/** Reloads the shared image from disk. */
-void Fl_Shared_Image::reload() {
-  // Load image from disk...
+//
+// 'load_file()' - Load an image file using the known formats and handlers.
+//
+// When called in a worker thread (in_thread != 0), formats that can't be
+// loaded in a thread are left alone and 'defer' is set instead.
+//
+// If W and H are not 0, the sized handlers are tried first; the image may
+// still have another size if none of them could load it.
+//
+
+static Fl_Image *load_file(const char *name,
+                           Fl_Shared_Handler *handlers, int num_handlers,
+                           int in_thread, int *defer, int W, int H) {
   int           i;              // Looping var
   int           count = 0;      // number of bytes read from image header
   FILE          *fp;            // File pointer
   uchar         header[64];     // Buffer for auto-detecting files
   Fl_Image      *img;           // New image
 
-  if (!name_) return;
-
-  if ((fp = fl_fopen(name_, "rb")) != NULL) {
+  if ((fp = fl_fopen(name, "rb")) != NULL) {
     count = (int)fread(header, 1, sizeof(header), fp);
     fclose(fp);
     if (count == 0)
-      return;
+      return 0;
   } else {
-    return;
+    return 0;
   }
 
   // Load the image as appropriate...
   if (count >= 7 && memcmp(header, "#define", 7) == 0) // XBM file
-    img = new Fl_XBM_Image(name_);
-  else if (count >= 9 && memcmp(header, "/* XPM */", 9) == 0) // XPM file
-    img = new Fl_XPM_Image(name_);
-  else {
+    img = new Fl_XBM_Image(name);
+  else if (count >= 9 && memcmp(header, "/* XPM */", 9) == 0) { // XPM file
+    // fl_measure_pixmap() uses static variables
+    if (in_thread) {
+      *defer = 1;
+      return 0;
+    }
+    img = new Fl_XPM_Image(name);
+  } else {
+    img = 0;
+    if (W > 0 && H > 0) {
+      // Try to load the image in the requested size...
+      Fl_Shared_Sized_Handler *sized = 0;       // Copy of the sized handlers
+      Fl::system_driver()->mutex_lock(&images_mutex);
+      int nsized = num_sized_handlers_;
+      if (nsized) {
+        sized = new Fl_Shared_Sized_Handler[nsized];
+        memcpy(sized, sized_handlers_, nsized * sizeof(Fl_Shared_Sized_Handler));
+      }
+      Fl::system_driver()->mutex_unlock(images_mutex);
+      for (i = 0; i < nsized && !img; i ++)
+        img = (sized[i])(name, header, count, W, H);
+      delete[] sized;
+      if (img) return img;
+    }
     // Not a standard format; try an image handler...
-    for (i = 0, img = 0; i < num_handlers_; i ++) {
-      img = (handlers_[i])(name_, header, count);
+    for (i = 0, img = 0; i < num_handlers; i ++) {
+      img = (handlers[i])(name, header, count);
       if (img) break;
     }
   }
 
+  return img;
+}
+
+
+/** Reloads the shared image from disk.
+
+  If the image is being loaded in the background (see get_async()), this
+  stops the background job and loads the image right away. The callbacks
+  of the get_async() calls waiting for the image are then called before
+  this method returns.
+*/
+void Fl_Shared_Image::reload() {
+  Fl_Image      *img;           // New image
+  Fl_Shared_Image_Waiter *waiters = 0; // Callbacks of a pending get_async()
+
+  if (!name_) return;
+
+  if (loading_) {
+    waiters = take_waiters(this);
+    cancel_load();
+  }
+
+  img = load_file(name_, handlers_, num_handlers_, 0, 0);
+
   if (img) {
     if (alloc_image_) delete image_;
 
     alloc_image_ = 1;
+    reloadable_ = 1;
     image_ = img;
     int W = w();
     int H = h();
@@ -290,6 +760,8 @@ void Fl_Shared_Image::reload() {
     if (W)
       scale(W, H, 0, 1);
   }
+
+  if (waiters && call_waiters(this, waiters)) Fl::redraw();
 }
 
 
@@ -305,6 +777,7 @@ Fl_Shared_Image::copy(int W, int H) {
   Fl_Shared_Image       *temp_shared;   // New shared image
 
   // Make a copy of the image we're sharing...
+  if (!image_ && reloadable_) restore();
   if (!image_) temp_image = 0;
   else temp_image = image_->copy(W, H);
 
@@ -317,6 +790,7 @@ Fl_Shared_Image::copy(int W, int H) {
   temp_shared->refcount_    = 1;
   temp_shared->image_       = temp_image;
   temp_shared->alloc_image_ = 1;
+  temp_shared->reloadable_  = reloadable_ && temp_image;
 
   temp_shared->update();
 
@@ -331,9 +805,11 @@ Fl_Shared_Image::copy(int W, int H) {
 void
 Fl_Shared_Image::color_average(Fl_Color c,      // I - Color to blend with
                                float    i) {    // I - Blend fraction
+  if (!image_ && reloadable_) restore();
   if (!image_) return;
 
   image_->color_average(c, i);
+  reloadable_ = 0;                      // changed data can't be reloaded
   update();
 }
 
@@ -344,9 +820,11 @@ Fl_Shared_Image::color_average(Fl_Color c,      // I - Color to blend with
 
 void
 Fl_Shared_Image::desaturate() {
+  if (!image_ && reloadable_) restore();
   if (!image_) return;
 
   image_->desaturate();
+  reloadable_ = 0;                      // changed data can't be reloaded
   update();
 }
 
@@ -354,10 +832,13 @@ Fl_Shared_Image::desaturate() {
 // 'Fl_Shared_Image::draw()' - Draw a shared image...
 //
 void Fl_Shared_Image::draw(int X, int Y, int W, int H, int cx, int cy) {
+  if (loading_) return;         // nothing to draw yet
+  if (!image_ && reloadable_) restore();        // data was freed by trim()
   if (!image_) {
     Fl_Image::draw(X, Y, W, H, cx, cy);
     return;
   }
+  touch();
   // transiently set the drawing size of image_ to that of the shared image
   int width = image_->w(), height = image_->h();
   image_->scale(w(), h(), 0, 1);
@@ -381,7 +862,7 @@ void Fl_Shared_Image::uncache()
 
 /** Finds a shared image from its name and size specifications.
 
-  This uses a binary search in the image cache.
+  This uses a hash table lookup in the image cache.
 
   If the image \p name exists with the exact width \p W and height \p H,
   then it is returned.
@@ -394,25 +875,18 @@ void Fl_Shared_Image::uncache()
   when no longer needed.
 */
 Fl_Shared_Image* Fl_Shared_Image::find(const char *name, int W, int H) {
-  Fl_Shared_Image       *key,           // Image key
-                        **match;        // Matching image
-
-  if (num_images_) {
-    key = new Fl_Shared_Image();
-    key->name_ = new char[strlen(name) + 1];
-    strcpy((char *)key->name_, name);
-    key->w(W);
-    key->h(H);
-
-    match = (Fl_Shared_Image **)bsearch(&key, images_, num_images_,
-                                        sizeof(Fl_Shared_Image *),
-                                        (compare_func_t)compare);
-
-    delete key;
-
-    if (match) {
-      (*match)->refcount_ ++;
-      return *match;
+  Fl_Shared_Image       *match;         // Matching image
+
+  if (!num_images_ || !name) return 0;
+
+  // Same rules as compare()
+  for (match = hash_table[hash_name(name) & (hash_size - 1)]; match;
+       match = match->hash_next_) {
+    if (strcmp(match->name_, name)) continue;
+    if ((W == 0 && match->original_) ||
+        (match->data_w() == W && match->data_h() == H)) {
+      match->refcount_ ++;
+      return match;
     }
   }
 
@@ -445,6 +919,10 @@ Fl_Shared_Image* Fl_Shared_Image::find(const char *name, int W, int H) {
   Shared JPEG and PNG images can also be created from memory by using their
   named memory access constructor.
 
+  If the image is being loaded in the background by get_async(), it is
+  loaded right away instead, and the callbacks of the get_async() calls
+  waiting for it are called before this method returns.
+
   You should release() the image when you're done with it.
 
   \param name name of the image
@@ -458,9 +936,17 @@ Fl_Shared_Image* Fl_Shared_Image::find(const char *name, int W, int H) {
 Fl_Shared_Image* Fl_Shared_Image::get(const char *name, int W, int H) {
   Fl_Shared_Image       *temp;          // Image
 
-  if ((temp = find(name, W, H)) != NULL) return temp;
+  if ((temp = find(name, W, H)) != NULL) {
+    if (temp->loading_) temp->reload(); // don't wait for get_async()
+    cache_hits_ ++;
+    return temp;
+  }
+
+  cache_misses_ ++;
 
-  if ((temp = find(name)) == NULL) {
+  if ((temp = find(name)) != NULL && temp->loading_) temp->reload();
+
+  if (temp == NULL) {
     temp = new Fl_Shared_Image(name);
 
     if (!temp->image_) {
@@ -496,6 +982,337 @@ Fl_Shared_Image *Fl_Shared_Image::get(Fl_RGB_Image *rgb, int own_it)
 }
 
 
+/**
+  Finds or loads many images at once.
+
+  This works like calling get(const char *name, int W, int H) for each of
+  the \p count names in \p names, but makes room for all of them in the
+  image cache up front. This is faster when registering many images, for
+  instance all icons or thumbnails of an application.
+
+  \param[in] names      array of \p count image names
+  \param[in] count      number of images
+  \param[out] images    array of \p count images that receives the shared
+                        images, or NULL for images that could not be loaded
+  \param[in] W, H       desired size, or 0
+
+  \returns the number of images found or loaded
+
+  \version 1.4.0
+*/
+int Fl_Shared_Image::get(const char * const *names, int count,
+                         Fl_Shared_Image **images, int W, int H) {
+  int found = 0;
+
+  reserve(num_images_ + ((W && H) ? 2 * count : count));
+
+  for (int i = 0; i < count; i ++) {
+    images[i] = get(names[i], W, H);
+    if (images[i]) found ++;
+  }
+
+  return found;
+}
+
+
+/**
+  Find or start loading an image in the background.
+
+  This works like get(const char *name, int W, int H), except that images
+  which are not in the cache yet are loaded by worker threads, so that
+  loading many images (e.g. thumbnails) doesn't block the user interface.
+
+  If the image must be loaded, a new shared image without image data is
+  returned at once. loading() returns 1 and the image isn't drawn until
+  the image data is ready. Then the image data is put in place in the
+  main thread, and the callback \p cb is called with the image and \p data
+  as arguments. Without callback, all windows are redrawn (Fl::redraw()).
+  The callback is also called if the image could not be loaded; the image
+  then has no image data, and Fl_Image::fail() returns an error.
+
+  If both \p W and \p H are not zero, the image is scaled to this size by
+  the worker thread as well. Unlike get(), the image in its original size
+  is then not kept in the cache. Image formats with a handler for loading
+  images in a given size (see add_handler(Fl_Shared_Sized_Handler)), e.g.
+  JPEG and PNG, are then decoded in this size right away.
+
+  If the image is already being loaded for an earlier get_async() call,
+  the same image is returned, and \p cb is called as well when it has
+  been loaded.
+
+  Releasing the image (see release()) before it has been loaded cancels
+  loading it, e.g. for thumbnails that have been scrolled out of view.
+  The callbacks are then not called.
+  Calling get() or reload() for an image that is being loaded loads it
+  right away instead. The callbacks of all get_async() calls waiting for
+  it are then called by get() or reload() before they return.
+
+  The images are loaded with the image handlers (see add_handler()), which
+  must therefore be thread-safe. The handlers of fl_register_images() are
+  thread-safe; XPM images, which are not, are always loaded in the main
+  thread. If the platform doesn't support threads, images are loaded one
+  by one in the main thread when FLTK is idle.
+
+  To make the images show up as soon as they have been loaded, the program
+  should call Fl::lock() once before Fl::run() as described in
+  \ref advanced_multithreading; otherwise they are checked for a few
+  times per second.
+
+  \param[in] name       name of the image file
+  \param[in] W, H       desired size, or 0
+  \param[in] cb         function to call when the image has been loaded
+  \param[in] data       user data for \p cb
+
+  \returns      the image, or NULL if \p name is NULL
+  \see get(const char *name, int W, int H), loading(), release()
+  \since FLTK 1.4.0
+*/
+Fl_Shared_Image *Fl_Shared_Image::get_async(const char *name, int W, int H,
+                                            Fl_Shared_Image_Loaded cb, void *data) {
+  Fl_Shared_Image       *temp;          // Image
+  Fl_Shared_Image_Job   *job;           // New job
+
+  if (!name) return NULL;
+
+  if ((temp = find(name, W, H)) != NULL) {
+    // Still loading for an earlier call: call cb as well when it is done
+    if (temp->loading_) add_waiter(temp, cb, data);
+    cache_hits_ ++;
+    return temp;
+  }
+
+  cache_misses_ ++;
+
+  if ((temp = find(name)) != NULL && !temp->loading_ && temp->image_) {
+    // Original image is available; make a copy of the proper size like get()
+    if ((temp->w() != W || temp->h() != H) && W && H) {
+      temp = (Fl_Shared_Image *)temp->copy(W, H);
+      temp->add();
+    }
+    return temp;
+  }
+  if (temp) temp->release();            // loading or failed; don't use it
+
+  // Make a shared image without data that will be loaded later
+  temp = new Fl_Shared_Image();
+  temp->name_ = new char[strlen(name) + 1];
+  strcpy((char *)temp->name_, name);
+  if (W && H) {
+    temp->w(W);
+    temp->h(H);
+  } else {
+    temp->original_ = 1;
+  }
+  temp->loading_ = 1;
+  temp->add();
+
+  job = new Fl_Shared_Image_Job;
+  job->image  = temp;
+  job->name   = fl_strdup(name);
+  job->w      = (W && H) ? W : 0;
+  job->h      = (W && H) ? H : 0;
+  job->result = 0;
+  job->defer  = 0;
+  job->waiters = new Fl_Shared_Image_Waiter;
+  job->waiters->cb   = cb;
+  job->waiters->data = data;
+  job->waiters->next = 0;
+  job->next   = 0;
+
+  Fl::system_driver()->mutex_lock(&images_mutex);
+  if (pending_last) pending_last->next = job;
+  else pending_first = job;
+  pending_last = job;
+  num_jobs ++;
+  int start_thread = (num_threads < MAX_LOAD_THREADS);
+  if (start_thread) num_threads ++;
+  Fl::system_driver()->mutex_unlock(images_mutex);
+
+  if (start_thread &&
+      Fl::system_driver()->create_thread(load_thread, 0) < 0) {
+    // No threads; jobs are run by load_done() in the main thread
+    Fl::system_driver()->mutex_lock(&images_mutex);
+    num_threads --;
+    Fl::system_driver()->mutex_unlock(images_mutex);
+  }
+
+  if (!Fl::has_timeout(load_done, 0)) Fl::add_timeout(0.0, load_done, 0);
+
+  return temp;
+}
+
+
+//
+// 'Fl_Shared_Image::cancel_load()' - Stop loading this image in the background.
+//
+// Pending jobs are removed, jobs being loaded are marked as canceled;
+// load_done() discards their result.
+//
+
+void Fl_Shared_Image::cancel_load() {
+  Fl_Shared_Image_Job   *job, *prev;    // Looping vars
+
+  Fl::system_driver()->mutex_lock(&images_mutex);
+  for (job = pending_first, prev = 0; job; prev = job, job = job->next) {
+    if (job->image != this) continue;
+    if (prev) prev->next = job->next;
+    else pending_first = job->next;
+    if (pending_last == job) pending_last = prev;
+    num_jobs --;
+    free_waiters(job->waiters);
+    free(job->name);
+    delete job;
+    break;
+  }
+  if (!job) {
+    for (job = running_jobs; job; job = job->next)
+      if (job->image == this) job->image = 0;
+    for (job = done_jobs; job; job = job->next)
+      if (job->image == this) job->image = 0;
+  }
+  Fl::system_driver()->mutex_unlock(images_mutex);
+
+  loading_ = 0;
+}
+
+
+//
+// 'Fl_Shared_Image::load_thread()' - Load images in a worker thread.
+//
+// Runs until there are no more pending jobs.
+//
+
+void Fl_Shared_Image::load_thread(void *) {
+  Fl_Shared_Image_Job   *job, **prev;   // Current job
+  Fl_Shared_Handler     *handlers = 0;  // Copy of the image handlers
+  int                   nhandlers;      // Number of handlers
+  int                   ahandlers = 0;  // Allocated handlers
+
+  for (;;) {
+    Fl::system_driver()->mutex_lock(&images_mutex);
+    job = pending_first;
+    if (!job) {
+      num_threads --;
+      Fl::system_driver()->mutex_unlock(images_mutex);
+      delete[] handlers;
+      return;
+    }
+    pending_first = job->next;
+    if (!pending_first) pending_last = 0;
+    job->next = running_jobs;
+    running_jobs = job;
+    // Copy the handlers, add_handler() may change them meanwhile
+    nhandlers = num_handlers_;
+    if (nhandlers > ahandlers) {
+      delete[] handlers;
+      ahandlers = nhandlers;
+      handlers  = new Fl_Shared_Handler[ahandlers];
+    }
+    if (nhandlers) memcpy(handlers, handlers_, nhandlers * sizeof(Fl_Shared_Handler));
+    Fl::system_driver()->mutex_unlock(images_mutex);
+
+    Fl_Image *img = load_file(job->name, handlers, nhandlers, 1, &job->defer,
+                              job->w, job->h);
+    if (img && job->w && (img->w() != job->w || img->h() != job->h)) {
+      Fl_Image *scaled = img->copy(job->w, job->h);
+      delete img;
+      img = scaled;
+    }
+    job->result = img;
+
+    Fl::system_driver()->mutex_lock(&images_mutex);
+    for (prev = &running_jobs; *prev != job; prev = &(*prev)->next) {}
+    *prev = job->next;
+    job->next = done_jobs;
+    done_jobs = job;
+    int send_awake = !awake_sent;
+    awake_sent = 1;
+    Fl::system_driver()->mutex_unlock(images_mutex);
+
+    // Wake up the main thread (works if the program called Fl::lock())
+    if (send_awake) Fl::awake(load_done, 0);
+  }
+}
+
+
+//
+// 'Fl_Shared_Image::load_done()' - Put loaded images in place.
+//
+// Runs in the main thread, called via Fl::awake() and from a timeout that
+// runs until all jobs are done. Without worker threads it also loads the
+// next pending image.
+//
+
+void Fl_Shared_Image::load_done(void *) {
+  Fl_Shared_Image_Job   *job;                   // Current job
+  int                   need_redraw = 0;        // Redraw all windows?
+
+  Fl::system_driver()->mutex_lock(&images_mutex);
+  awake_sent = 0;
+  if (!num_threads && pending_first && !done_jobs) {
+    // No worker threads; load the next image here
+    job = pending_first;
+    pending_first = job->next;
+    if (!pending_first) pending_last = 0;
+    job->next = running_jobs;
+    running_jobs = job;
+    Fl::system_driver()->mutex_unlock(images_mutex);
+
+    job->result = load_file(job->name, handlers_, num_handlers_, 0, 0,
+                            job->w, job->h);
+    if (job->result && job->w &&
+        (job->result->w() != job->w || job->result->h() != job->h)) {
+      Fl_Image *scaled = job->result->copy(job->w, job->h);
+      delete job->result;
+      job->result = scaled;
+    }
+
+    Fl::system_driver()->mutex_lock(&images_mutex);
+    running_jobs = job->next;
+    job->next = done_jobs;
+    done_jobs = job;
+  }
+
+  // Take one job at a time: callbacks may cancel other jobs in the list
+  while ((job = done_jobs) != NULL) {
+    done_jobs = job->next;
+    num_jobs --;
+    Fl::system_driver()->mutex_unlock(images_mutex);
+
+    Fl_Shared_Image *img = job->image;
+    if (img) {
+      img->loading_ = 0;
+      if (job->defer) {
+        img->reload();
+      } else if (job->result) {
+        img->image_       = job->result;
+        img->alloc_image_ = 1;
+        img->reloadable_  = 1;
+        img->update();
+        job->result = 0;
+      }
+      need_redraw |= call_waiters(img, job->waiters);
+      job->waiters = 0;
+    }
+    free_waiters(job->waiters);
+    delete job->result;
+    free(job->name);
+    delete job;
+
+    Fl::system_driver()->mutex_lock(&images_mutex);
+  }
+  int more = (num_jobs > 0);
+  int idle = (pending_first && !num_threads);
+  Fl::system_driver()->mutex_unlock(images_mutex);
+
+  if (need_redraw) Fl::redraw();
+
+  // Keep checking for loaded images until all jobs are done
+  Fl::remove_timeout(load_done, 0);
+  if (more) Fl::add_timeout(idle ? 0.0 : 0.1, load_done, 0);
+}
+
+
 /** Adds a shared image handler, which is basically a test function
   for adding new image formats.
 
@@ -520,6 +1337,9 @@ void Fl_Shared_Image::add_handler(Fl_Shared_Handler f) {
     if (handlers_[i] == f) return;
   }
 
+  // Worker threads of get_async() copy the handlers...
+  Fl::system_driver()->mutex_lock(&images_mutex);
+
   if (num_handlers_ >= alloc_handlers_) {
     // Allocate more memory...
     temp = new Fl_Shared_Handler [alloc_handlers_ + 32];
@@ -536,6 +1356,8 @@ void Fl_Shared_Image::add_handler(Fl_Shared_Handler f) {
 
   handlers_[num_handlers_] = f;
   num_handlers_ ++;
+
+  Fl::system_driver()->mutex_unlock(images_mutex);
 }
 
 
@@ -551,6 +1373,7 @@ void Fl_Shared_Image::remove_handler(Fl_Shared_Handler f) {
   if (i >= num_handlers_) return;
 
   // OK, remove the handler from the array...
+  Fl::system_driver()->mutex_lock(&images_mutex);
   num_handlers_ --;
 
   if (i < num_handlers_) {
@@ -558,4 +1381,78 @@ void Fl_Shared_Image::remove_handler(Fl_Shared_Handler f) {
     memmove(handlers_ + i, handlers_ + i + 1,
            (num_handlers_ - i) * sizeof(Fl_Shared_Handler ));
   }
+  Fl::system_driver()->mutex_unlock(images_mutex);
+}
+
+
+/** Adds a handler for image formats that can be loaded in a given size.
+
+  These handlers are tried before the handlers added with
+  add_handler(Fl_Shared_Handler) when an image is loaded in a given size,
+  for instance by get_async() with a size or when the image data of a
+  scaled copy must be loaded again (see cache_budget()).
+  fl_register_images() adds a handler that loads JPEG and PNG images
+  in the requested size.
+
+  \see Fl_Shared_Sized_Handler for more information of the function you
+    need to define.
+
+  \version 1.4.0
+*/
+void Fl_Shared_Image::add_handler(Fl_Shared_Sized_Handler f) {
+  int                   i;              // Looping var...
+  Fl_Shared_Sized_Handler *temp;        // New image handler array...
+
+  // First see if we have already added the handler...
+  for (i = 0; i < num_sized_handlers_; i ++) {
+    if (sized_handlers_[i] == f) return;
+  }
+
+  Fl::system_driver()->mutex_lock(&images_mutex);
+
+  if (num_sized_handlers_ >= alloc_sized_handlers_) {
+    // Allocate more memory...
+    temp = new Fl_Shared_Sized_Handler [alloc_sized_handlers_ + 8];
+
+    if (alloc_sized_handlers_) {
+      memcpy(temp, sized_handlers_, alloc_sized_handlers_ * sizeof(Fl_Shared_Sized_Handler));
+
+      delete[] sized_handlers_;
+    }
+
+    sized_handlers_       = temp;
+    alloc_sized_handlers_ += 8;
+  }
+
+  sized_handlers_[num_sized_handlers_] = f;
+  num_sized_handlers_ ++;
+
+  Fl::system_driver()->mutex_unlock(images_mutex);
+}
+
+
+/** Removes a handler for image formats that can be loaded in a given size.
+
+  \version 1.4.0
+*/
+void Fl_Shared_Image::remove_handler(Fl_Shared_Sized_Handler f) {
+  int   i;                              // Looping var...
+
+  // First see if the handler has been added...
+  for (i = 0; i < num_sized_handlers_; i ++) {
+    if (sized_handlers_[i] == f) break;
+  }
+
+  if (i >= num_sized_handlers_) return;
+
+  // OK, remove the handler from the array...
+  Fl::system_driver()->mutex_lock(&images_mutex);
+  num_sized_handlers_ --;
+
+  if (i < num_sized_handlers_) {
+    // Shift later handlers down 1...
+    memmove(sized_handlers_ + i, sized_handlers_ + i + 1,
+           (num_sized_handlers_ - i) * sizeof(Fl_Shared_Sized_Handler));
+  }
+  Fl::system_driver()->mutex_unlock(images_mutex);
 }
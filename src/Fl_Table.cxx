@@ -26,26 +26,146 @@
 #include <stdlib.h>             // realloc/free
 
 
-// An STL-ish vector without templates (private to Fl_Table)
+// Row heights or column widths with a prefix sum index (private to Fl_Table)
+//
+//    sums[] is a Fenwick tree: sums[i] holds the sum of the sizes of the
+//    items (i - lowbit(i), i], so both the pixel position of an item and
+//    the item at a pixel position can be found in O(log n) steps.
+//    sums[] is built lazily, and only for tables whose items differ in size.
 
-void Fl_Table::IntVector::copy(int *newarr, unsigned int newsize) {
-    size(newsize);
-    memcpy(arr, newarr, newsize * sizeof(int));
-}
+#define LOWBIT(i) ((i) & (0u - (i)))
 
-Fl_Table::IntVector::~IntVector() { // DTOR
+Fl_Table::SizeVector::~SizeVector() { // DTOR
   if (arr)
     free(arr);
+  if (sums)
+    free(sums);
   arr = 0;
+  sums = 0;
+}
+
+// Make room for 'count' items in arr[] and sums[]
+void Fl_Table::SizeVector::reserve(unsigned int count) {
+  if (count <= alloc) return;
+  unsigned int n = alloc ? alloc : 64;
+  while (n < count) n *= 2;
+  arr = (int*)realloc(arr, n * sizeof(int));
+  sums = (long*)realloc(sums, (n + 1) * sizeof(long));
+  alloc = n;
+}
+
+// Switch from one 'uniform' size for all items to individual sizes
+void Fl_Table::SizeVector::unshare() {
+  reserve(_size);
+  for (unsigned int t = 0; t < _size; t++)
+    arr[t] = uniform;
+  nsums = 0;
+}
+
+// Extend sums[] to cover all items
+void Fl_Table::SizeVector::update_sums() {
+  if (nsums == _size) return;
+  if (nsums == 0) {                             // build from scratch in O(n)
+    unsigned int t;
+    for (t = 1; t <= _size; t++)
+      sums[t] = arr[t-1];
+    for (t = 1; t <= _size; t++)
+      if (t + LOWBIT(t) <= _size)
+        sums[t + LOWBIT(t)] += sums[t];
+  } else {                                      // append in O(log n) per item
+    for (unsigned int t = nsums + 1; t <= _size; t++) {
+      long sum = arr[t-1];
+      for (unsigned int u = t - 1; u > t - LOWBIT(t); u -= LOWBIT(u))
+        sum += sums[u];
+      sums[t] = sum;
+    }
+  }
+  nsums = _size;
 }
 
-void Fl_Table::IntVector::size(unsigned int count) {
-  if (count != _size) {
-    arr = (int*)realloc(arr, count * sizeof(int));
+// Change the number of items, new items get the size 'val'
+void Fl_Table::SizeVector::size(unsigned int count, int val) {
+  if (count == 0) {
+    free(arr);
+    free(sums);
+    init();
+    return;
+  }
+  if (count <= _size) {
     _size = count;
+    if (nsums > count) nsums = count;           // sums[1..count] stay valid
+    return;
   }
+  if (!arr) {
+    if (_size == 0) uniform = val;
+    if (val == uniform) {                       // OPTIMIZATION: still uniform
+      _size = count;
+      return;
+    }
+    unshare();
+  }
+  reserve(count);
+  while (_size < count)
+    arr[_size++] = val;
 }
 
+// Set the size of item 'x' (which must exist)
+void Fl_Table::SizeVector::set(unsigned int x, int val) {
+  int old = (*this)[x];
+  if (old == val) return;
+  if (!arr) unshare();
+  arr[x] = val;
+  for (unsigned int t = x + 1; t <= nsums; t += LOWBIT(t))
+    sums[t] += (long)val - old;
+}
+
+// Set the size of items 0..count-1, and the number of items to at least 'count'
+void Fl_Table::SizeVector::set_all(unsigned int count, int val) {
+  if (count < _size) {
+    for (unsigned int t = 0; t < count; t++)
+      set(t, val);
+    return;
+  }
+  free(arr);                                    // OPTIMIZATION: all uniform now
+  free(sums);
+  init();
+  uniform = val;
+  _size = count;
+}
+
+// Return the sum of the sizes of items 0..x-1
+long Fl_Table::SizeVector::position(unsigned int x) {
+  if (x > _size) x = _size;
+  if (!arr) return((long)x * uniform);
+  update_sums();
+  long pos = 0;
+  for (; x > 0; x -= LOWBIT(x))
+    pos += sums[x];
+  return(pos);
+}
+
+// Return the largest number of items whose sizes add up to no more than 'pos',
+// i.e. the index of the item covering pixel position 'pos' (or size() if none)
+unsigned int Fl_Table::SizeVector::find(long pos) {
+  if (pos < 0 || _size == 0) return(0);
+  if (!arr) {
+    if (uniform <= 0 || pos / uniform >= (long)_size) return(_size);
+    return((unsigned int)(pos / uniform));
+  }
+  update_sums();
+  unsigned int x = 0, step = 1;
+  while (step <= _size / 2) step *= 2;
+  for (; step > 0; step /= 2) {
+    if (x + step <= _size && sums[x + step] <= pos) {
+      x += step;
+      pos -= sums[x];
+    }
+  }
+  return(x);
+}
+
+#undef LOWBIT
+
 
 /** Sets the vertical scroll position so 'row' is at the top,
     and causes the screen to redraw.
@@ -88,38 +208,14 @@ void Fl_Table::col_position(int col) {
   Returns the scroll position (in pixels) of the specified 'row'.
 */
 long Fl_Table::row_scroll_position(int row) {
-  int startrow = 0;
-  long scroll = 0;
-  // OPTIMIZATION:
-  //     Attempt to use precomputed row scroll position
-  //
-  if ( toprow_scrollpos != -1 && row >= toprow ) {
-    scroll = toprow_scrollpos;
-    startrow = toprow;
-  }
-  for ( int t=startrow; t<row; t++ ) {
-    scroll += row_height(t);
-  }
-  return(scroll);
+  return(( row <= 0 ) ? 0 : _rowheights.position(row));
 }
 
 /**
   Returns the scroll position (in pixels) of the specified column 'col'.
 */
 long Fl_Table::col_scroll_position(int col) {
-  int startcol = 0;
-  long scroll = 0;
-  // OPTIMIZATION:
-  //     Attempt to use precomputed row scroll position
-  //
-  if ( leftcol_scrollpos != -1 && col >= leftcol ) {
-    scroll = leftcol_scrollpos;
-    startcol = leftcol;
-  }
-  for ( int t=startcol; t<col; t++ ) {
-    scroll += col_width(t);
-  }
-  return(scroll);
+  return(( col <= 0 ) ? 0 : _colwidths.position(col));
 }
 
 /**
@@ -212,13 +308,10 @@ void Fl_Table::row_height(int row, int height) {
     return;             // OPTIMIZATION: no change? avoid redraw
   }
   // Add row heights, even if none yet
-  int now_size = (int)_rowheights.size();
-  if ( row >= now_size ) {
-    _rowheights.size(row);
-    while (now_size < row)
-      _rowheights[now_size++] = height;
+  if ( row >= (int)_rowheights.size() ) {
+    _rowheights.size(row+1, height);
   }
-  _rowheights[row] = height;
+  _rowheights.set(row, height);
   table_resized();
   if ( row <= botrow ) {        // OPTIMIZATION: only redraw if onscreen or above screen
     redraw();
@@ -241,14 +334,10 @@ void Fl_Table::col_width(int col, int width)
     return;                     // OPTIMIZATION: no change? avoid redraw
   }
   // Add column widths, even if none yet
-  int now_size = (int)_colwidths.size();
-  if ( col >= now_size ) {
-    _colwidths.size(col+1);
-    while (now_size < col) {
-      _colwidths[now_size++] = width;
-    }
+  if ( col >= (int)_colwidths.size() ) {
+    _colwidths.size(col+1, width);
   }
-  _colwidths[col] = width;
+  _colwidths.set(col, width);
   table_resized();
   if ( col <= rightcol ) {      // OPTIMIZATION: only redraw if onscreen or to the left
     redraw();
@@ -259,6 +348,42 @@ void Fl_Table::col_width(int col, int width)
   }
 }
 
+/**
+  Convenience method to set the height of all rows to the
+  same value, in pixels. The screen is redrawn.
+*/
+void Fl_Table::row_height_all(int height) {
+  if ( Fl_Widget::callback() && when() & FL_WHEN_CHANGED ) {
+    // Caller wants a callback for each row that changed
+    for ( int r=0; r<rows(); r++ ) {
+      row_height(r, height);
+    }
+    return;
+  }
+  // OPTIMIZATION: all rows the same height; no need to store them
+  _rowheights.set_all(rows(), height);
+  table_resized();
+  redraw();
+}
+
+/**
+  Convenience method to set the width of all columns to the
+  same value, in pixels. The screen is redrawn.
+*/
+void Fl_Table::col_width_all(int width) {
+  if ( Fl_Widget::callback() && when() & FL_WHEN_CHANGED ) {
+    // Caller wants a callback for each column that changed
+    for ( int c=0; c<cols(); c++ ) {
+      col_width(c, width);
+    }
+    return;
+  }
+  // OPTIMIZATION: all columns the same width; no need to store them
+  _colwidths.set_all(cols(), width);
+  table_resized();
+  redraw();
+}
+
 /**
   Return specified row/col values R and C to within the table's
   current row/col limits.
@@ -560,38 +685,33 @@ void Fl_Table::recalc_dimensions() {
   TODO: Assumes ti[xywh] has already been recalculated.
 */
 void Fl_Table::table_scrolled() {
+  // OPTIMIZATION: _rowheights/_colwidths index the row/col positions,
+  //               so none of these need to walk the rows or columns.
+  //
   // Find top row
-  int y, row, voff = vscrollbar->value();
-  for ( row=y=0; row < _rows; row++ ) {
-    y += row_height(row);
-    if ( y > voff ) { y -= row_height(row); break; }
-  }
+  int row, voff = vscrollbar->value();
+  row = _rowheights.find(voff);                 // row covering voff
+  if ( row > _rows ) row = _rows;
   _row_position = toprow = ( row >= _rows ) ? (row - 1) : row;
-  toprow_scrollpos = y;         // OPTIMIZATION: save for later use
+  toprow_scrollpos = row_scroll_position(toprow);       // OPTIMIZATION: save for later use
   // Find bottom row
+  //    The last row that starts above voff, but not above the top row
+  //
   voff = vscrollbar->value() + tih;
-  for ( ; row < _rows; row++ ) {
-    y += row_height(row);
-    if ( y >= voff ) { break; }
-  }
-  botrow = ( row >= _rows ) ? (row - 1) : row;
+  int r = _rowheights.find(voff - 1);
+  if ( r > row ) row = r;
+  botrow = ( row >= _rows ) ? (_rows - 1) : row;
   // Left column
-  int x, col, hoff = hscrollbar->value();
-  for ( col=x=0; col < _cols; col++ ) {
-    x += col_width(col);
-    if ( x > hoff ) { x -= col_width(col); break; }
-  }
+  int col, hoff = hscrollbar->value();
+  col = _colwidths.find(hoff);                  // col covering hoff
+  if ( col > _cols ) col = _cols;
   _col_position = leftcol = ( col >= _cols ) ? (col - 1) : col;
-  leftcol_scrollpos = x;        // OPTIMIZATION: save for later use
+  leftcol_scrollpos = col_scroll_position(leftcol);     // OPTIMIZATION: save for later use
   // Right column
-  //    Work with data left over from leftcol calculation
-  //
   hoff = hscrollbar->value() + tiw;
-  for ( ; col < _cols; col++ ) {
-    x += col_width(col);
-    if ( x >= hoff ) { break; }
-  }
-  rightcol = ( col >= _cols ) ? (col - 1) : col;
+  int c = _colwidths.find(hoff - 1);
+  if ( c > col ) col = c;
+  rightcol = ( col >= _cols ) ? (_cols - 1) : col;
   // First tell children to scroll
   draw_cell(CONTEXT_RC_RESIZE, 0,0,0,0,0,0);
 }
@@ -658,11 +778,7 @@ void Fl_Table::rows(int val) {
   _rows = val;
   {
     int default_h = ( _rowheights.size() > 0 ) ? _rowheights.back() : 25;
-    int now_size = _rowheights.size();
-    _rowheights.size(val);                      // enlarge or shrink as needed
-    while ( now_size < val ) {
-      _rowheights[now_size++] = default_h;      // fill new
-    }
+    _rowheights.size(val, default_h);           // enlarge or shrink as needed
   }
   table_resized();
 
@@ -680,12 +796,8 @@ void Fl_Table::rows(int val) {
 void Fl_Table::cols(int val) {
   _cols = val;
   {
-    int default_w = ( _colwidths.size() > 0 ) ? _colwidths[_colwidths.size()-1] : 80;
-    int now_size = _colwidths.size();
-    _colwidths.size(val);                       // enlarge or shrink as needed
-    while ( now_size < val ) {
-      _colwidths[now_size++] = default_w;       // fill new
-    }
+    int default_w = ( _colwidths.size() > 0 ) ? _colwidths.back() : 80;
+    _colwidths.size(val, default_w);            // enlarge or shrink as needed
   }
   table_resized();
   redraw();
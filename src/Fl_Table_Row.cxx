@@ -26,6 +26,7 @@
 #include <FL/Fl.H>
 #include <FL/fl_draw.H>
 #include <stdlib.h>
+#include <string.h>             // memmove
 
 // for debugging...
 // #define DEBUG 1
@@ -38,30 +39,140 @@
 #define PRINTEVENT
 #endif
 
-// An STL-ish vector without templates (private to Fl_Table_Row)
-
-void Fl_Table_Row::CharVector::copy(char *newarr, int newsize) {
-  size(newsize);
-  memcpy(arr, newarr, newsize * sizeof(char));
-}
+// A set of rows stored as sorted row ranges (private to Fl_Table_Row)
+//
+//    Ranges are half open [first, last+1), never empty, and never touch,
+//    so each row is either in exactly one range or in none.
 
-Fl_Table_Row::CharVector::~CharVector() {       // DTOR
+Fl_Table_Row::RangeSet::~RangeSet() {           // DTOR
   if (arr) free(arr);
   arr = 0;
 }
 
-void Fl_Table_Row::CharVector::size(int count) {
-  if (count != _size) {
-    arr = (char*)realloc(arr, (unsigned)count * sizeof(char));
-    _size = count;
+// Return index of first range that ends after 'row'
+int Fl_Table_Row::RangeSet::find_end(int row) const {
+  int lo = 0, hi = _size;
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+    if (arr[2*mid+1] > row) hi = mid;
+    else lo = mid + 1;
+  }
+  return(lo);
+}
+
+// Return index of first range that starts after 'row'
+int Fl_Table_Row::RangeSet::find_start(int row) const {
+  int lo = 0, hi = _size;
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+    if (arr[2*mid] > row) hi = mid;
+    else lo = mid + 1;
+  }
+  return(lo);
+}
+
+// Replace ranges x..y-1 with the 'n' ranges in 'ranges'
+void Fl_Table_Row::RangeSet::replace(int x, int y, const int *ranges, int n) {
+  int newsize = _size - (y - x) + n;
+  if (newsize > alloc) {
+    alloc = alloc ? alloc * 2 : 16;
+    if (alloc < newsize) alloc = newsize;
+    arr = (int*)realloc(arr, (unsigned)alloc * 2 * sizeof(int));
   }
+  if (y != x + n)
+    memmove(arr + 2*(x+n), arr + 2*y, (unsigned)(_size - y) * 2 * sizeof(int));
+  if (n)
+    memcpy(arr + 2*x, ranges, (unsigned)n * 2 * sizeof(int));
+  _size = newsize;
+}
+
+// Is 'row' in the set?
+int Fl_Table_Row::RangeSet::contains(int row) const {
+  int x = find_end(row);
+  return((x < _size && arr[2*x] <= row) ? 1 : 0);
+}
+
+// Add (val=1) or remove (val=0) rows r1..r2, return 1 if the set changed
+int Fl_Table_Row::RangeSet::set(int r1, int r2, int val) {
+  int lo = r1, hi = r2 + 1;
+  if (lo >= hi) return(0);
+  if (val) {
+    // Merge with all ranges that overlap or touch lo..hi
+    int x = find_end(lo - 1), y = find_start(hi);
+    if (y == x + 1 && arr[2*x] <= lo && arr[2*x+1] >= hi)
+      return(0);                                // already in the set
+    int range[2] = { lo, hi };
+    if (x < y) {
+      if (arr[2*x] < lo) range[0] = arr[2*x];
+      if (arr[2*y-1] > hi) range[1] = arr[2*y-1];
+    }
+    replace(x, y, range, 1);
+  } else {
+    // Cut lo..hi out of all ranges that overlap it
+    int x = find_end(lo), y = find_start(hi - 1);
+    if (x >= y) return(0);                      // none in the set
+    int ranges[4], n = 0;
+    if (arr[2*x] < lo) { ranges[n*2] = arr[2*x]; ranges[n*2+1] = lo; n++; }
+    if (arr[2*y-1] > hi) { ranges[n*2] = hi; ranges[n*2+1] = arr[2*y-1]; n++; }
+    replace(x, y, ranges, n);
+  }
+  return(1);
+}
+
+// Toggle rows r1..r2
+void Fl_Table_Row::RangeSet::invert(int r1, int r2) {
+  int lo = r1, hi = r2 + 1;
+  if (lo >= hi) return;
+  int nalloc = _size + 2;                       // enough for all results
+  int *out = (int*)malloc((unsigned)nalloc * 2 * sizeof(int));
+  int n = 0, pos = lo;                          // pos: first row of next gap
+#define ADD_RANGE(a,b) \
+  if ((a) < (b)) { \
+    if (n > 0 && out[2*n-1] == (a)) out[2*n-1] = (b); \
+    else { out[2*n] = (a); out[2*n+1] = (b); n++; } \
+  }
+  for (int x = 0; x < _size; x++) {
+    int a = arr[2*x], b = arr[2*x+1];
+    if (b <= lo) { ADD_RANGE(a, b); continue; } // before lo..hi
+    if (a >= hi) {                              // after lo..hi
+      ADD_RANGE(pos, hi);
+      pos = hi;
+      ADD_RANGE(a, b);
+      continue;
+    }
+    ADD_RANGE(a, lo);                           // part before lo
+    ADD_RANGE(pos, a);                          // gap before this range
+    pos = b;
+    if (b > hi) {                               // part after hi
+      ADD_RANGE(hi, b);
+      pos = hi;
+    }
+  }
+  ADD_RANGE(pos, hi);
+#undef ADD_RANGE
+  if (arr) free(arr);
+  arr = out;
+  _size = n;
+  alloc = nalloc;
+}
+
+// Remove all rows >= count
+void Fl_Table_Row::RangeSet::truncate(int count) {
+  if (count <= 0) { clear(); return; }
+  set(count, 0x7ffffffe, 0);
+}
+
+// Remove all rows
+void Fl_Table_Row::RangeSet::clear() {
+  if (arr) free(arr);
+  init();
 }
 
 
 // Is row selected?
 int Fl_Table_Row::row_selected(int row) {
   if ( row < 0 || row >= rows() ) return(-1);
-  return(_rowselect[row]);
+  return(_rowselect.contains(row));
 }
 
 // Change row selection type
@@ -69,20 +180,15 @@ void Fl_Table_Row::type(TableRowSelectMode val) {
   _selectmode = val;
   switch ( _selectmode ) {
     case SELECT_NONE: {
-      for ( int row=0; row<rows(); row++ ) {
-        _rowselect[row] = 0;
-      }
+      _rowselect.clear();
       redraw();
       break;
     }
     case SELECT_SINGLE: {
-      int count = 0;
-      for ( int row=0; row<rows(); row++ ) {
-        if ( _rowselect[row] ) {
-          if ( ++count > 1 ) {  // only one allowed
-            _rowselect[row] = 0;
-          }
-        }
+      if ( _rowselect.size() > 0 ) {    // only one allowed: keep the first
+        int row = _rowselect.first(0);
+        _rowselect.clear();
+        _rowselect.set(row, row, 1);
       }
       redraw();
       break;
@@ -107,35 +213,31 @@ void Fl_Table_Row::type(TableRowSelectMode val) {
 int Fl_Table_Row::select_row(int row, int flag) {
   int ret = 0;
   if ( row < 0 || row >= rows() ) { return(-1); }
+  int oldval = _rowselect.contains(row);
+  int newval = ( flag == 2 ) ? !oldval : ( flag ? 1 : 0 );
   switch ( _selectmode ) {
     case SELECT_NONE:
       return(-1);
 
     case SELECT_SINGLE: {
-      int oldval;
-      for ( int t=0; t<rows(); t++ ) {
-        if ( t == row ) {
-          oldval = _rowselect[row];
-          if ( flag == 2 ) { _rowselect[row] ^= 1; }
-          else             { _rowselect[row] = flag; }
-          if ( oldval != _rowselect[row] ) {
-            redraw_range(row, row, leftcol, rightcol);
-            ret = 1;
-          }
-        }
-        else if ( _rowselect[t] ) {
-          _rowselect[t] = 0;
-          redraw_range(t, t, leftcol, rightcol);
+      // Deselect all other rows
+      for ( int x=0; x<_rowselect.size(); x++ ) {
+        for ( int t=_rowselect.first(x); t<=_rowselect.last(x); t++ ) {
+          if ( t != row ) redraw_range(t, t, leftcol, rightcol);
         }
       }
+      _rowselect.clear();
+      if ( newval ) _rowselect.set(row, row, 1);
+      if ( oldval != newval ) {
+        redraw_range(row, row, leftcol, rightcol);
+        ret = 1;
+      }
       break;
     }
 
     case SELECT_MULTI: {
-      int oldval = _rowselect[row];
-      if ( flag == 2 ) { _rowselect[row] ^= 1; }
-      else             { _rowselect[row] = flag; }
-      if ( _rowselect[row] != oldval ) {                // select state changed?
+      if ( newval != oldval ) {                         // select state changed?
+        _rowselect.set(row, row, newval);
         if ( row >= toprow && row <= botrow ) {         // row visible?
           // Extend partial redraw range
           redraw_range(row, row, leftcol, rightcol);
@@ -147,6 +249,40 @@ int Fl_Table_Row::select_row(int row, int flag) {
   return(ret);
 }
 
+// Change selection state for rows r1 through r2
+//
+//     flag and return value: see select_row()
+//
+int Fl_Table_Row::select_rows(int r1, int r2, int flag) {
+  if ( r1 > r2 ) { int t = r1; r1 = r2; r2 = t; }
+  if ( r1 < 0 || r2 >= rows() ) { return(-1); }
+  switch ( _selectmode ) {
+    case SELECT_NONE:
+      return(-1);
+
+    case SELECT_SINGLE: {
+      int ret = 0;
+      for ( int row = r1; row <= r2; row++ ) {
+        if ( select_row(row, flag) == 1 ) ret = 1;
+      }
+      return(ret);
+    }
+
+    case SELECT_MULTI: {
+      int ret = 1;
+      if ( flag == 2 ) { _rowselect.invert(r1, r2); }
+      else             { ret = _rowselect.set(r1, r2, flag ? 1 : 0); }
+      if ( ret && r2 >= toprow && r1 <= botrow ) {      // rows visible?
+        // Extend partial redraw range
+        redraw_range(r1 < toprow ? toprow : r1, r2 > botrow ? botrow : r2,
+                     leftcol, rightcol);
+      }
+      return(ret);
+    }
+  }
+  return(0);
+}
+
 // Select all rows to a known state
 void Fl_Table_Row::select_all_rows(int flag) {
   switch ( _selectmode ) {
@@ -159,16 +295,12 @@ void Fl_Table_Row::select_all_rows(int flag) {
 
     case SELECT_MULTI: {
       char changed = 0;
+      if ( rows() <= 0 ) return;
       if ( flag == 2 ) {
-        for ( int row=0; row<(int)_rowselect.size(); row++ ) {
-          _rowselect[row] ^= 1;
-        }
+        _rowselect.invert(0, rows() - 1);
         changed = 1;
       } else {
-        for ( int row=0; row<(int)_rowselect.size(); row++ ) {
-          changed |= (_rowselect[row] != flag)?1:0;
-          _rowselect[row] = flag;
-        }
+        changed = (char)_rowselect.set(0, rows() - 1, flag ? 1 : 0);
       }
       if ( changed ) {
         redraw();
@@ -180,8 +312,7 @@ void Fl_Table_Row::select_all_rows(int flag) {
 // Set number of rows
 void Fl_Table_Row::rows(int val) {
   Fl_Table::rows(val);
-  while ( val > (int)_rowselect.size() ) { _rowselect.push_back(0); }   // enlarge
-  while ( val < (int)_rowselect.size() ) { _rowselect.pop_back(); }     // shrink
+  _rowselect.truncate(val);                     // forget rows removed
 }
 
 // Handle events
@@ -233,14 +364,7 @@ int Fl_Table_Row::handle(int event) {
             case FL_SHIFT: {
               select_row(R, 1);
               if ( _last_row > -1 ) {
-                int srow = R, erow = _last_row;
-                if ( srow > erow ) {
-                  srow = _last_row;
-                  erow = R;
-                }
-                for ( int row = srow; row <= erow; row++ ) {
-                  select_row(row, 1);
-                }
+                select_rows(R, _last_row, 1);
               }
               break;
             }
@@ -299,14 +423,7 @@ int Fl_Table_Row::handle(int event) {
             default:
               select_row(R, 1);
               if ( _last_row > -1 ) {
-                int srow = R, erow = _last_row;
-                if ( srow > erow ) {
-                  srow = _last_row;
-                  erow = R;
-                }
-                for ( int row = srow; row <= erow; row++ ) {
-                  select_row(row, 1);
-                }
+                select_rows(R, _last_row, 1);
               }
               break;
           }
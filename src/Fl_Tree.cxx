@@ -4,9 +4,13 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <new>
+
 #include <FL/Fl_Tree.H>
 #include <FL/Fl_Preferences.H>
 #include <FL/fl_string.h>
+#include "Fl_Tree_Item_Arena.H"
+#include "Fl_Tree_Selection.H"
 
 //////////////////////
 // Fl_Tree.cxx
@@ -61,6 +65,305 @@ static void free_path(char **arr) {
   }
 }
 
+// INTERNAL: Fl_Tree_Item_Arena -- see Fl_Tree_Item_Arena.H
+//    Blocks hold many items; each item slot starts with a pointer to
+//    its arena. Free'd items and labels are chained through their
+//    first bytes into the free lists for reuse.
+//
+static const size_t ARENA_BLOCKSIZE = 64 * 1024;        // typical block size
+static const size_t ARENA_ALIGN     = sizeof(double) > sizeof(void*) ? sizeof(double) : sizeof(void*);
+static const size_t ARENA_MAXLABEL  = 32 * ARENA_ALIGN; // longer labels are malloc()'d
+
+Fl_Tree_Item_Arena::Fl_Tree_Item_Arena(size_t item_size) {
+  blocks_     = 0;
+  free_items_ = 0;
+  memset(free_labels_, 0, sizeof(free_labels_));
+  item_size_  = ARENA_ALIGN + ((item_size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1));
+  items_      = 0;
+  released_   = 0;
+}
+
+Fl_Tree_Item_Arena::~Fl_Tree_Item_Arena() {
+  reset();
+}
+
+// Return the arena an item was allocated from with alloc_item()
+Fl_Tree_Item_Arena *Fl_Tree_Item_Arena::owner(const void *item) {
+  return *(Fl_Tree_Item_Arena**)((char*)item - ARENA_ALIGN);
+}
+
+// Allocate 'size' bytes, aligned for any item or string
+void *Fl_Tree_Item_Arena::alloc(size_t size) {
+  size = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+  if ( !blocks_ || blocks_->used + size > blocks_->size ) {
+    size_t bsize = size > ARENA_BLOCKSIZE ? size : ARENA_BLOCKSIZE;
+    size_t hsize = (sizeof(Block) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+    Block *b = (Block*)malloc(hsize + bsize);
+    if ( !b ) return 0;
+    b->next = blocks_;
+    b->used = hsize;                            // data starts after header
+    b->size = hsize + bsize;
+    blocks_ = b;
+  }
+  void *p = (char*)blocks_ + blocks_->used;
+  blocks_->used += size;
+  return p;
+}
+
+// Allocate memory for one item, reusing a free'd item if any
+void *Fl_Tree_Item_Arena::alloc_item() {
+  void *p = free_items_;
+  if ( p ) free_items_ = *(void**)p;
+  else if ( !(p = alloc(item_size_)) ) return 0;
+  *(Fl_Tree_Item_Arena**)p = this;              // see owner()
+  ++items_;
+  return (char*)p + ARENA_ALIGN;
+}
+
+// Return an item's memory to the free list.
+//    Deletes the arena with its last item if the tree released it.
+//
+void Fl_Tree_Item_Arena::free_item(void *item) {
+  void *p = (char*)item - ARENA_ALIGN;
+  *(void**)p = free_items_;
+  free_items_ = p;
+  if ( --items_ == 0 && released_ ) delete this;
+}
+
+// Make a copy of string 's' in the arena
+char *Fl_Tree_Item_Arena::dup_label(const char *s) {
+  size_t len = strlen(s) + 1;
+  size_t size = (len + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+  if ( size > ARENA_MAXLABEL ) return fl_strdup(s);
+  void **list = &free_labels_[size / ARENA_ALIGN - 1];
+  char *p = (char*)*list;
+  if ( p ) *list = *(void**)p;
+  else if ( !(p = (char*)alloc(size)) ) return fl_strdup(s);
+  memcpy(p, s, len);
+  return p;
+}
+
+// Return the memory of a label made by dup_label() to its free list
+void Fl_Tree_Item_Arena::free_label(const char *s) {
+  size_t size = (strlen(s) + 1 + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+  if ( size > ARENA_MAXLABEL ) { free((void*)s); return; }
+  void **list = &free_labels_[size / ARENA_ALIGN - 1];
+  *(void**)s = *list;
+  *list = (void*)s;
+}
+
+// Release all memory at once, if no item is left.
+//    Items moved to another tree keep the blocks until they are destroyed.
+//
+void Fl_Tree_Item_Arena::reset() {
+  if ( items_ ) return;
+  while ( blocks_ ) {
+    Block *next = blocks_->next;
+    free((void*)blocks_);
+    blocks_ = next;
+  }
+  free_items_ = 0;
+  memset(free_labels_, 0, sizeof(free_labels_));
+}
+
+// Called by the tree instead of deleting the arena.
+//    The arena is deleted now or with the last of its items.
+//
+void Fl_Tree_Item_Arena::release() {
+  if ( items_ ) released_ = 1;
+  else delete this;
+}
+
+// INTERNAL: Fl_Tree_Selection -- see Fl_Tree_Selection.H
+//
+
+// Hash an item's address for the selection set
+static unsigned hash_item(const Fl_Tree_Item *item) {
+  fl_uintptr_t h = (fl_uintptr_t)item;
+  h ^= (h >> 4) ^ (h >> 16);
+  return (unsigned)h * 2654435761U;
+}
+
+// Returns 1 if 'item' is part of the hierarchy under 'root'
+static int in_tree(Fl_Tree_Item *item, Fl_Tree_Item *root) {
+  Fl_Tree_Item *p;
+  while ( (p = item->parent()) != NULL ) {
+    if ( p->find_child(item) < 0 ) return(0);   // not (yet) one of its parent's children
+    item = p;
+  }
+  return(item == root ? 1 : 0);
+}
+
+// qsort() wrapper for Fl_Tree_Selection::compare()
+static int compare_order(const void *a, const void *b) {
+  return Fl_Tree_Selection::compare(*(Fl_Tree_Item**)a, *(Fl_Tree_Item**)b);
+}
+
+Fl_Tree_Selection::Fl_Tree_Selection() {
+  slot_        = 0;
+  size_        = 0;
+  count_       = 0;
+  order_       = 0;
+  order_total_ = 0;
+  order_mem_   = 0;
+  order_size_  = 0;
+  order_valid_ = 1;                     // empty order is valid
+  hint_        = 0;
+}
+
+Fl_Tree_Selection::~Fl_Tree_Selection() {
+  if ( slot_ )  free((void*)slot_);
+  if ( order_mem_ ) free((void*)order_mem_);
+}
+
+// Compare the tree positions of items 'a' and 'b' in the same tree.
+//    Returns <0 if 'a' is above 'b', >0 if below, 0 if the same item.
+//    Costs O(depth), see Fl_Tree_Item::find_child(Fl_Tree_Item*).
+//
+int Fl_Tree_Selection::compare(Fl_Tree_Item *a, Fl_Tree_Item *b) {
+  if ( a == b ) return 0;
+  int da = a->depth(), db = b->depth();
+  for ( ; da > db; --da ) { a = a->parent(); if ( a == b ) return 1; }    // b is a's ancestor
+  for ( ; db > da; --db ) { b = b->parent(); if ( b == a ) return -1; }   // a is b's ancestor
+  while ( a->parent() != b->parent() ) { a = a->parent(); b = b->parent(); }
+  Fl_Tree_Item *p = a->parent();        // a, b are now siblings
+  if ( !p ) return (a < b) ? -1 : 1;    // different hierarchies: any stable order
+  return (p->find_child(a) < p->find_child(b)) ? -1 : 1;
+}
+
+// Find the hash slot for 'item', or the empty slot where it belongs
+int Fl_Tree_Selection::find_slot(const Fl_Tree_Item *item) const {
+  unsigned mask = size_ - 1;
+  unsigned i = hash_item(item) & mask;
+  while ( slot_[i] && slot_[i] != item ) i = (i+1) & mask;
+  return (int)i;
+}
+
+// Enlarge the hash set
+void Fl_Tree_Selection::grow() {
+  Fl_Tree_Item **old = slot_;
+  int oldsize = size_;
+  size_ = size_ ? size_ * 2 : 64;
+  slot_ = (Fl_Tree_Item**)calloc(size_, sizeof(Fl_Tree_Item*));
+  for ( int t=0; t<oldsize; t++ )
+    if ( old[t] ) slot_[find_slot(old[t])] = old[t];
+  if ( old ) free((void*)old);
+}
+
+// Append 'item' to order_[]
+void Fl_Tree_Selection::order_add(Fl_Tree_Item *item) {
+  if ( (order_ - order_mem_) + order_total_ >= order_size_ ) {
+    if ( order_ != order_mem_ ) {       // room at start? move items there
+      memmove(order_mem_, order_, order_total_ * sizeof(Fl_Tree_Item*));
+    }
+    if ( order_total_ >= order_size_ ) {
+      order_size_ = order_size_ ? order_size_ * 2 : 64;
+      order_mem_ = (Fl_Tree_Item**)realloc((void*)order_mem_, order_size_ * sizeof(Fl_Tree_Item*));
+    }
+    order_ = order_mem_;
+  }
+  order_[order_total_++] = item;
+}
+
+// Add newly selected 'item' to the set
+void Fl_Tree_Selection::add(Fl_Tree_Item *item, Fl_Tree_Item *root) {
+  if ( (count_+1) * 2 > size_ ) grow();
+  int i = find_slot(item);
+  if ( slot_[i] ) return;               // already in set
+  slot_[i] = item;
+  ++count_;
+  // Keep order current if item goes at the end (common case), else rebuild later
+  if ( order_valid_ && root && in_tree(item, root) ) {
+    if ( order_total_ == 0 || compare(order_[order_total_-1], item) < 0 )
+      order_add(item);
+    else
+      order_valid_ = 0;
+  }
+}
+
+// Remove deselected 'item' from the set
+void Fl_Tree_Selection::remove(Fl_Tree_Item *item) {
+  if ( !size_ ) return;
+  int i = find_slot(item);
+  if ( !slot_[i] ) return;              // not in set
+  // Backward shift delete: move later entries of the probe chain into the gap
+  unsigned mask = size_ - 1;
+  unsigned j = (unsigned)i;
+  slot_[i] = 0;
+  for ( ;; ) {
+    j = (j+1) & mask;
+    if ( !slot_[j] ) break;
+    unsigned home = hash_item(slot_[j]) & mask;
+    // Entry at j can move to i if its home is not in (i, j] cyclically
+    if ( ((j - home) & mask) >= ((j - (unsigned)i) & mask) ) {
+      slot_[i] = slot_[j];
+      slot_[j] = 0;
+      i = (int)j;
+    }
+  }
+  --count_;
+  if ( order_valid_ ) {                 // remove from order too
+    int pos;
+    if ( order_total_ && order_[order_total_-1] == item ) {
+      --order_total_;                   // last item
+    } else if ( order_total_ && order_[0] == item ) {
+      ++order_; --order_total_;         // first item: e.g. deselecting top to bottom
+    } else if ( find(item, pos) ) {     // move the shorter side over the gap
+      if ( pos < order_total_ / 2 ) {
+        memmove(&order_[1], &order_[0], pos * sizeof(Fl_Tree_Item*));
+        ++order_;
+      } else {
+        memmove(&order_[pos], &order_[pos+1], (order_total_-pos-1) * sizeof(Fl_Tree_Item*));
+      }
+      --order_total_;
+    }
+  }
+}
+
+// Remove 'item' that is being destroyed from the set.
+//    Unlike remove(), doesn't look at the item's (possibly dying) parents;
+//    the order is rebuilt when next needed.
+//
+void Fl_Tree_Selection::forget(Fl_Tree_Item *item) {
+  order_valid_ = 0;
+  remove(item);
+}
+
+// Return the selected items under 'root' in tree order, rebuilding as needed
+Fl_Tree_Item **Fl_Tree_Selection::order(Fl_Tree_Item *root, int &total) {
+  if ( !order_valid_ ) {
+    order_ = order_mem_;
+    order_total_ = 0;
+    for ( int t=0; t<size_; t++ )
+      if ( slot_[t] && root && in_tree(slot_[t], root) )
+        order_add(slot_[t]);
+    if ( order_total_ > 1 )
+      qsort(order_, order_total_, sizeof(Fl_Tree_Item*), compare_order);
+    order_valid_ = 1;
+  }
+  total = order_total_;
+  return order_;
+}
+
+// Binary search for 'item' in order_[], which must be current.
+//    Returns 1 and its position if found, otherwise 0 and the
+//    position of the first selected item below 'item'.
+//
+int Fl_Tree_Selection::find(Fl_Tree_Item *item, int &pos) {
+  // Walking the selection (e.g. next_selected_item()) finds the same or next item
+  for ( int t = hint_; t < hint_+2 && t < order_total_; t++ )
+    if ( order_[t] == item ) { pos = hint_ = t; return 1; }
+  int lo = 0, hi = order_total_;
+  while ( lo < hi ) {
+    int mid = (lo + hi) / 2;
+    int c = compare(order_[mid], item);
+    if ( c == 0 ) { pos = hint_ = mid; return 1; }
+    if ( c < 0 ) lo = mid + 1; else hi = mid;
+  }
+  pos = lo;
+  return 0;
+}
+
 #if 0           /* unused code -- STR #3169 */
 // INTERNAL: Recursively descend 'item's tree hierarchy
 //           accumulating total child 'count'
@@ -85,6 +388,8 @@ Fl_Tree::Fl_Tree(int X, int Y, int W, int H, const char *L) : Fl_Group(X,Y,W,H,L
   _scrollbar_size  = 0;                         // 0: uses Fl::scrollbar_size()
 
   _lastselect       = 0;
+  _arena            = 0;
+  _selection        = new Fl_Tree_Selection();
 
   box(FL_DOWN_BOX);
   color(FL_BACKGROUND2_COLOR, FL_SELECTION_COLOR);
@@ -106,12 +411,15 @@ Fl_Tree::Fl_Tree(int X, int Y, int W, int H, const char *L) : Fl_Group(X,Y,W,H,L
   _toh = _tih = H - Fl::box_dh(box());
   _tree_w = -1;
   _tree_h = -1;
+  _recalc_all = 1;
   end();
 }
 
 /// Destructor.
 Fl_Tree::~Fl_Tree() {
-  if ( _root ) { delete _root; _root = 0; }
+  if ( _root ) { Fl_Tree_Item::destroy(_root); _root = 0; }
+  if ( _arena ) { _arena->release(); _arena = 0; }
+  delete _selection; _selection = 0;            // after items: they remove themselves
 }
 
 /// Extend the selection between and including \p 'from' and \p 'to'
@@ -158,12 +466,12 @@ int Fl_Tree::extend_selection_dir(Fl_Tree_Item *from, Fl_Tree_Item *to,
 
 /// Extend a selection between \p 'from' and \p 'to' depending on \p 'visible'.
 ///
-/// Similar to the more efficient
+/// Similar to the
 /// extend_selection_dir(Fl_Tree_Item*,Fl_Tree_Item*,int dir,int val,bool vis)
 /// method, but direction (up or down) doesn't need to be known.<br>
-/// We're less efficient because we search the tree for to/from, then operate
-/// on items in between. The more efficient method avoids the "search",
-/// but necessitates a direction to be specified to find \p 'to'.<br>
+/// The direction is found by comparing the tree positions of \p 'from'
+/// and \p 'to', which only looks at their parents; only the items in
+/// between are walked.<br>
 /// Used by SHIFT-click to extend a selection between two items inclusive.<br>
 /// Handles calling redraw() if anything changed.
 ///
@@ -193,10 +501,11 @@ int Fl_Tree::extend_selection(Fl_Tree_Item *from, Fl_Tree_Item *to,
     }
     return(changed);
   }
-  char on = 0;
-  for ( Fl_Tree_Item *item = first(); item; item = item->next_visible(_prefs) ) {
-    if ( visible && !item->is_visible() ) continue;
-    if ( on || (item == from) || (item == to) ) {
+  // Find which of from/to is on top, then walk down to the other one
+  Fl_Tree_Item *top = from, *bottom = to;
+  if ( Fl_Tree_Selection::compare(from, to) > 0 ) { top = to; bottom = from; }
+  for ( Fl_Tree_Item *item = top; item; item = item->next_visible(_prefs) ) {
+    if ( !visible || item->is_visible() ) {
       switch (val) {
         case 0:
           if ( deselect(item, when()) ) ++changed;
@@ -209,11 +518,8 @@ int Fl_Tree::extend_selection(Fl_Tree_Item *from, Fl_Tree_Item *to,
           ++changed;    // toggle always involves a change
           break;
       }
-      if ( (item == from) || (item == to) ) {
-        on ^= 1;
-        if ( !on ) break;       // done
-      }
     }
+    if ( item == bottom ) break;        // done
   }
   return(changed);
 }
@@ -329,8 +635,8 @@ int Fl_Tree::handle(int e) {
               set_item_focus(next_visible_item(_item_focus, ekey));     // next item up|dn
               if ( _item_focus ) {                                      // item in focus?
                 // Autoscroll
-                int itemtop = _item_focus->y();
-                int itembot = _item_focus->y()+_item_focus->h();
+                int itemtop = calc_item_y(_item_focus);
+                int itembot = itemtop+_item_focus->h();
                 if ( itemtop < y() ) { show_item_top(_item_focus); }
                 if ( itembot > y()+h() ) { show_item_bottom(_item_focus); }
                 // Extend selection
@@ -650,9 +956,15 @@ void Fl_Tree::calc_dimensions() {
 /// The tree hierarchy's size only changes when items are added/removed,
 /// open/closed, label contents or font sizes changed, margins changed, etc.
 ///
-/// This calculation involves walking the *entire* tree from top to bottom,
-/// potentially a slow calculation if the tree has many items (potentially
-/// hundreds of thousands), and should therefore be called sparingly.
+/// Each item caches the size of its subtree, and changes to an item
+/// (open/close, add/remove, label, font..) only invalidate the caches
+/// of that item and its parents. So normally only the changed paths
+/// are walked; unchanged subtrees are skipped using their cached sizes.
+///
+/// After recalc_tree() all caches are discarded, and the calculation
+/// involves walking the *entire* open tree from top to bottom, potentially
+/// a slow calculation if the tree has many items (potentially hundreds
+/// of thousands), and should therefore be called sparingly.
 ///
 /// For this reason, recalc_tree() is used as a way to /schedule/
 /// calculation when changes affect the tree hierarchy's size.
@@ -667,6 +979,12 @@ void Fl_Tree::calc_tree() {
   _tree_w = _tree_h = -1;
   calc_dimensions();
   if ( !_root ) return;
+  // Discard all cached subtree sizes? (e.g. prefs changed)
+  if ( _recalc_all ) {
+    for ( Fl_Tree_Item *item = _root; item; item = item->next() )
+      item->_flags |= Fl_Tree_Item::RECALC;
+    _recalc_all = 0;
+  }
   // Walk the tree to determine its width and height.
   // We need this to compute scrollbars..
   // By the end, 'Y' will be the lowest point on the tree
@@ -800,6 +1118,8 @@ Fl_Tree_Item* Fl_Tree::root() {
 void Fl_Tree::root(Fl_Tree_Item *newitem) {
   if ( _root ) clear();
   _root = newitem;
+  _selection->reorder();        // new hierarchy: selected items may have changed
+  recalc_tree();                // new hierarchy: discard cached geometry
 }
 
 /** Adds a new item, given a menu style \p 'path'.
@@ -826,7 +1146,7 @@ void Fl_Tree::root(Fl_Tree_Item *newitem) {
 Fl_Tree_Item* Fl_Tree::add(const char *path, Fl_Tree_Item *item) {
   // Tree has no root? make one
   if ( ! _root ) {
-    _root = new Fl_Tree_Item(this);
+    _root = new_item();
     _root->parent(0);
     _root->label("ROOT");
   }
@@ -837,6 +1157,101 @@ Fl_Tree_Item* Fl_Tree::add(const char *path, Fl_Tree_Item *item) {
   return(item);
 }
 
+// INTERNAL: compare labels for Fl_Tree::add(const char**,int)'s sorting.
+//    Unlabeled items sort first, same as add() inserting sorted items.
+//
+static int compare_ascending(const Fl_Tree_Item *a, const Fl_Tree_Item *b) {
+  if ( !a->label() ) return b->label() ? -1 : 0;
+  if ( !b->label() ) return 1;
+  return strcmp(a->label(), b->label());
+}
+static int compare_descending(const Fl_Tree_Item *a, const Fl_Tree_Item *b) {
+  if ( !a->label() ) return b->label() ? -1 : 0;
+  if ( !b->label() ) return 1;
+  return strcmp(b->label(), a->label());
+}
+
+// INTERNAL: a parent that gained children in Fl_Tree::add(const char**,int),
+//    and the index of its first new child.
+//
+struct Fl_Tree_Added {
+  Fl_Tree_Item *parent;
+  int first;
+};
+static int compare_added(const void *a, const void *b) {
+  const Fl_Tree_Added *ia = (const Fl_Tree_Added*)a, *ib = (const Fl_Tree_Added*)b;
+  if ( ia->parent != ib->parent ) return (ia->parent < ib->parent) ? -1 : 1;
+  return ia->first - ib->first;
+}
+
+/** Adds many new items at once, given an array of menu style \p 'paths'.
+
+ Same as calling add(const char*,Fl_Tree_Item*) for each path, but much
+ faster for large numbers of items: new items are appended to their
+ parents, and the new children of each parent are sorted only once
+ at the end according to sortorder() and merged into the existing
+ children, which keep their order. Child lookups use the children's
+ label hash index (see Fl_Tree_Item_Array::find_label()), so building
+ e.g. a filesystem tree with many entries per directory is linear.
+
+ Paths that already exist in the tree are skipped.
+
+ \param[in] paths  Array of \p 'npaths' paths, e.g. "Flintstone/Fred".
+ \param[in] npaths Number of paths in the array.
+ \returns The number of paths added.
+ \version 1.4.0
+*/
+int Fl_Tree::add(const char * const *paths, int npaths) {
+  // Tree has no root? make one
+  if ( ! _root ) {
+    _root = new_item();
+    _root->parent(0);
+    _root->label("ROOT");
+  }
+  int count = 0;
+  int nparents = 0, sparents = 0;
+  Fl_Tree_Added *parents = 0;                   // parents that gained children
+  for ( int p=0; p<npaths; p++ ) {
+    char **arr = parse_path(paths[p]);
+    Fl_Tree_Item *item = _root;
+    int added = 0;
+    for ( char **ap = arr; *ap; ap++ ) {
+      Fl_Tree_Item *child = item->find_child_item(*ap);
+      if ( !child ) {                           // not found? append new child
+        if ( nparents == 0 || parents[nparents-1].parent != item ) {
+          if ( nparents >= sparents ) {
+            sparents = sparents ? sparents*2 : 64;
+            parents = (Fl_Tree_Added*)realloc(parents, sparents * sizeof(Fl_Tree_Added));
+          }
+          parents[nparents].parent = item;
+          parents[nparents].first = item->children();
+          nparents++;
+        }
+        child = new_item();
+        child->label(*ap);
+        child->_parent = item;
+        item->_children.add(child);
+        item->recalc_tree();                    // may change tree geometry
+        added = 1;
+      }
+      item = child;
+    }
+    if ( added ) ++count;
+    free_path(arr);
+  }
+  // Sort the new children of each parent once, from its first new child on
+  if ( nparents && _prefs.sortorder() != FL_TREE_SORT_NONE ) {
+    qsort(parents, nparents, sizeof(Fl_Tree_Added), compare_added);
+    for ( int t=0; t<nparents; t++ ) {
+      if ( t > 0 && parents[t].parent == parents[t-1].parent ) continue;  // skip dups
+      parents[t].parent->_children.sort(parents[t].first,
+                                        _prefs.sortorder() == FL_TREE_SORT_ASCENDING
+                                        ? compare_ascending : compare_descending);
+    }
+  }
+  if ( parents ) free((void*)parents);
+  return(count);
+}
 
 /// Add a new child item labeled \p 'name' to the specified \p 'parent_item'.
 ///
@@ -934,11 +1349,78 @@ int Fl_Tree::remove(Fl_Tree_Item *item) {
 void Fl_Tree::clear() {
   if ( ! _root ) return;
   _root->clear_children();
-  delete _root; _root = 0;
+  Fl_Tree_Item::destroy(_root); _root = 0;
+  if ( _arena ) _arena->reset();        // releases all item memory + labels at once
   _item_focus = 0;
   _lastselect = 0;
 }
 
+// INTERNAL: Create a new item for this tree.
+//    Allocated from the item arena if enabled, see item_arena(int).
+//
+Fl_Tree_Item *Fl_Tree::new_item() {
+  if ( !_arena ) return(new Fl_Tree_Item(this));
+  void *mem = _arena->alloc_item();
+  if ( !mem ) return(new Fl_Tree_Item(this));
+  Fl_Tree_Item *item = new (mem) Fl_Tree_Item(this);
+  item->set_flag(Fl_Tree_Item::ARENA, 1);     // before label() is set
+  return(item);
+}
+
+/** Enable or disable allocating the tree's items from a memory arena.
+
+ When enabled, items the tree creates (e.g. with add() and insert())
+ and their labels are carved out of large memory blocks instead of
+ being allocated one by one, and clear() releases all of them at once.
+ This makes building and clearing trees with many thousands of items
+ much faster, and uses less memory.
+
+ Memory of items that are removed individually (e.g. with remove() or
+ clear_children()) and of labels that are replaced is reused for new
+ items and labels.
+
+ Items created by the application and passed to e.g. add(const char*,Fl_Tree_Item*)
+ or root(Fl_Tree_Item*) are not affected. Items allocated from the arena
+ must not be deleted with \p delete; remove them with e.g. remove().
+ Items moved to another tree with Fl_Tree_Item::deparent() and
+ Fl_Tree_Item::reparent() keep their memory in this tree's arena, which
+ is released when the last of them is destroyed.
+
+ Can only be changed while the tree has no items other than the root,
+ e.g. right after construction or after clear(); otherwise this
+ method has no effect. Default is off.
+
+ \param[in] val 1: allocate items from an arena, 0: allocate items with new
+ \see item_arena()
+ \version 1.4.0
+*/
+void Fl_Tree::item_arena(int val) {
+  if ( _root && _root->has_children() ) return;
+  if ( val && !_arena ) {
+    _arena = new Fl_Tree_Item_Arena(sizeof(Fl_Tree_Item));
+  } else if ( !val && _arena ) {
+    if ( _root && _root->is_flag(Fl_Tree_Item::ARENA) ) {   // recreate root outside arena
+      Fl_Tree_Item *old = _root;
+      _root = new Fl_Tree_Item(this);
+      _root->parent(0);
+      _root->label(old->label());
+      Fl_Tree_Item::destroy(old);
+      _item_focus = 0;
+      _lastselect = 0;
+      recalc_tree();
+    }
+    _arena->release(); _arena = 0;
+  }
+}
+
+/// Returns 1 if the tree allocates its items from a memory arena.
+/// \see item_arena(int)
+/// \version 1.4.0
+///
+int Fl_Tree::item_arena() const {
+  return(_arena ? 1 : 0);
+}
+
 /// Clear all the children for \p 'item'.
 /// Item may not be NULL.
 ///
@@ -1257,7 +1739,9 @@ Fl_Tree_Item* Fl_Tree::last_visible_item() {
  \see first_selected_item(), last_selected_item(), next_selected_item()
 */
 Fl_Tree_Item *Fl_Tree::first_selected_item() {
-  return(next_selected_item(0));
+  int total;
+  Fl_Tree_Item **items = _selection->order(_root, total);
+  return(total ? items[0] : 0);
 }
 
 
@@ -1279,7 +1763,9 @@ Fl_Tree_Item *Fl_Tree::first_selected_item() {
  \version 1.3.3
 */
 Fl_Tree_Item *Fl_Tree::last_selected_item() {
-  return(next_selected_item(0, FL_Up));
+  int total;
+  Fl_Tree_Item **items = _selection->order(_root, total);
+  return(total ? items[total-1] : 0);
 }
 
 /**
@@ -1380,30 +1866,30 @@ Fl_Tree_Item *Fl_Tree::next_item(Fl_Tree_Item *item, int dir, bool visible) {
  \param[in] dir  The direction to go.
                  FL_Up for moving up the tree,
                  FL_Down for down the tree (default)
+ The tree keeps an index of the selected items, so this is fast
+ even for very large trees: it doesn't walk the items in between.
+
  \returns The next selected item, or 0 if there are no more selected items.
  \see first_selected_item(), last_selected_item(), next_selected_item()
  \version 1.3.3
 */
 Fl_Tree_Item *Fl_Tree::next_selected_item(Fl_Tree_Item *item, int dir) {
+  if ( ! item ) {
+    switch (dir) {
+      case FL_Down: return(first_selected_item());
+      case FL_Up:   return(last_selected_item());
+    }
+    return(0);
+  }
+  int total, pos;
+  Fl_Tree_Item **items = _selection->order(_root, total);
+  int found = _selection->find(item, pos);      // pos: item's or next item's position
   switch (dir) {
     case FL_Down:
-      if ( ! item ) {
-        if ( ! (item = first()) ) return(0);
-        if ( item->is_selected() ) return(item);
-      }
-      while ( (item = item->next()) )
-        if ( item->is_selected() )
-          return(item);
-      return(0);
+      if ( found ) ++pos;
+      return(pos < total ? items[pos] : 0);
     case FL_Up:
-      if ( ! item ) {
-        if ( ! (item = last()) ) return(0);
-        if ( item->is_selected() ) return(item);
-      }
-      while ( (item = item->prev()) )
-        if ( item->is_selected() )
-          return(item);
-      return(0);
+      return(pos > 0 ? items[pos-1] : 0);
   }
   return(0);
 }
@@ -1432,8 +1918,10 @@ Fl_Tree_Item *Fl_Tree::next_selected_item(Fl_Tree_Item *item, int dir) {
 */
 int Fl_Tree::get_selected_items(Fl_Tree_Item_Array &ret_items) {
   ret_items.clear();
-  for ( Fl_Tree_Item *i=first_selected_item(); i; i=next_selected_item(i) ) {
-    ret_items.add(i);
+  int total;
+  Fl_Tree_Item **items = _selection->order(_root, total);
+  for ( int t=0; t<total; t++ ) {
+    ret_items.add(items[t]);
   }
   return ret_items.total();
 }
@@ -1802,7 +2290,8 @@ int Fl_Tree::deselect(const char *path, int docallback) {
 /// Handles calling redraw() if anything changed.
 ///
 /// The callback can use callback_item() and callback_reason() respectively to determine
-/// the item changed and the reason the callback was called.
+/// the item changed and the reason the callback was called. The callback may
+/// delete items; deleted items are skipped.
 ///
 /// \param[in] item The item that will be deselected (along with all its children).
 ///                 If NULL, first() is used.
@@ -1815,15 +2304,36 @@ int Fl_Tree::deselect(const char *path, int docallback) {
 int Fl_Tree::deselect_all(Fl_Tree_Item *item, int docallback) {
   item = item ? item : first();                 // NULL? use first()
   if ( ! item ) return(0);
+  return(deselect_items(item, 0, docallback));
+}
+
+// INTERNAL: Deselect all selected items that are 'item' or its descendants,
+//    except 'keep'. Walks only the selected items, in tree order.
+//    Callbacks may delete items: deleted items leave the selection, so
+//    items of the copy that are no longer selected are skipped unused.
+//    Returns count of how many items were deselected.
+//
+int Fl_Tree::deselect_items(Fl_Tree_Item *item, Fl_Tree_Item *keep, int docallback) {
+  int total;
+  Fl_Tree_Item **sel = _selection->order(_root, total);
+  if ( total == 0 ) return(0);
+  // Work on a copy; callbacks change the selection
+  Fl_Tree_Item **items = (Fl_Tree_Item**)malloc(total * sizeof(Fl_Tree_Item*));
+  memcpy(items, sel, total * sizeof(Fl_Tree_Item*));
   int count = 0;
-  // Deselect item
-  if ( item->is_selected() )
-    if ( deselect(item, docallback) )
+  for ( int t=0; t<total; t++ ) {
+    Fl_Tree_Item *i = items[t];
+    if ( i == keep ) continue;
+    if ( !_selection->contains(i) ) continue;   // deselected or deleted by a callback
+    if ( item != _root ) {                      // only item and its descendants
+      Fl_Tree_Item *p = i;
+      while ( p && p != item ) p = p->parent();
+      if ( !p ) continue;
+    }
+    if ( deselect(i, docallback) )
       ++count;
-  // Deselect its children
-  for ( int t=0; t<item->children(); t++ ) {
-    count += deselect_all(item->child(t), docallback);  // recurse
   }
+  free((void*)items);
   return(count);
 }
 
@@ -1835,7 +2345,8 @@ int Fl_Tree::deselect_all(Fl_Tree_Item *item, int docallback) {
 /// Handles calling redraw() if anything changed.
 ///
 /// The callback can use callback_item() and callback_reason() respectively to determine
-/// the item changed and the reason the callback was called.
+/// the item changed and the reason the callback was called. The callback may
+/// delete other items, but not \p 'selitem' or its parents.
 ///
 /// \param[in] selitem The item to be selected. If NULL, first() is used.
 /// \param[in] docallback -- A flag that determines if the callback() is invoked or not:
@@ -1848,17 +2359,10 @@ int Fl_Tree::deselect_all(Fl_Tree_Item *item, int docallback) {
 int Fl_Tree::select_only(Fl_Tree_Item *selitem, int docallback) {
   selitem = selitem ? selitem : first();        // NULL? use first()
   if ( ! selitem ) return(0);
-  int changed = 0;
   // Deselect everything first.
   //    Prevents callbacks from seeing more than one item selected.
   //
-  for ( Fl_Tree_Item *item = first(); item; item = item->next() ) {
-    if ( item == selitem ) continue;            // don't do anything to selitem yet..
-    if ( item->is_selected() ) {
-      deselect(item, docallback);
-      ++changed;
-    }
-  }
+  int changed = _root ? deselect_items(_root, selitem, docallback) : 0;
   // Should we 'reselect' item if already selected?
   if ( selitem->is_selected() && (item_reselect_mode()==FL_TREE_SELECTABLE_ALWAYS) ) {
     // Selection unchanged, so no ++changed
@@ -2359,7 +2863,8 @@ void Fl_Tree::item_draw_mode(int mode) {
 int Fl_Tree::displayed(Fl_Tree_Item *item) {
   item = item ? item : first();
   if (!item) return(0);
-  return( (item->y() >= y()) && (item->y() <= (y()+h()-item->h())) ? 1 : 0);
+  int item_y = calc_item_y(item);
+  return( (item_y >= y()) && (item_y <= (y()+h()-item->h())) ? 1 : 0);
 }
 
 /// Adjust the vertical scrollbar so that \p 'item' is visible
@@ -2379,7 +2884,7 @@ int Fl_Tree::displayed(Fl_Tree_Item *item) {
 void Fl_Tree::show_item(Fl_Tree_Item *item, int yoff) {
   item = item ? item : first();
   if (!item) return;
-  int newval = item->y() - y() - yoff + (int)_vscroll->value();
+  int newval = calc_item_y(item) - y() - yoff + (int)_vscroll->value();
   if ( newval < _vscroll->minimum() ) newval = (int)_vscroll->minimum();
   if ( newval > _vscroll->maximum() ) newval = (int)_vscroll->maximum();
   _vscroll->value(newval);
@@ -2684,8 +3189,39 @@ void Fl_Tree::fix_scrollbar_order() {
 }
 
 /// Schedule tree to recalc the entire tree size.
+///
+/// Discards all items' cached subtree sizes, so the next calc_tree()
+/// re-measures every open item. Use this when changes affect all items,
+/// e.g. prefs or margins. Changes to individual items are handled
+/// by the items themselves, which only invalidate their own path.
+///
 /// \note Must be using FLTK ABI 1.3.3 or higher for this to be effective.
 ///
 void Fl_Tree::recalc_tree() {
   _tree_w = _tree_h = -1;
+  _recalc_all = 1;
+}
+
+// Return the current vertical position of \p 'item' relative to the window,
+// the same as item->y() after a redraw. Computed from the cached subtree
+// heights, so it's also correct for items draw() skipped as off-screen.
+//
+int Fl_Tree::calc_item_y(Fl_Tree_Item *item) {
+  if ( _tree_w == -1 ) calc_tree();             // bring cached sizes up to date
+  if ( item->is_root() )
+    return(_tiy + _prefs.margintop() - (int)_vscroll->value());
+  Fl_Tree_Item *p = item->parent();
+  int Y = calc_item_y(p);
+  if ( !p->is_flag(Fl_Tree_Item::RECALC) && p->_child_y ) {   // cached child offsets?
+    int t = p->_children.index(item);
+    if ( t >= 0 ) return(Y + p->_child_y[t]);
+  }
+  if ( !p->is_root() || _prefs.showroot() )     // parent drawn above its children?
+    Y += p->h() + _prefs.linespacing();
+  for ( int t=0; t<p->children(); t++ ) {
+    Fl_Tree_Item *c = p->child(t);
+    if ( c == item ) break;
+    if ( c->is_visible() ) Y += c->_subtree_h;
+  }
+  return(Y);
 }
@@ -8,6 +8,9 @@
 #include <FL/Fl_Tree_Item.H>
 #include <FL/Fl_Tree_Prefs.H>
 #include <FL/Fl_Tree.H>
+#include "Fl_Tree_Item_Arena.H"
+#include "Fl_Tree_Selection.H"
+#include "Fl_System_Driver.H"
 #include <FL/fl_string.h>
 
 //////////////////////
@@ -29,6 +32,9 @@
 //
 /////////////////////////////////////////////////////////////////////////// 80 /
 
+static void add_style_ref(const Fl_Tree_Item_Style *style);   // see style()
+static void release_style(const Fl_Tree_Item_Style *style);
+
 // Was the last event inside the specified xywh?
 static int event_inside(const int xywh[4]) {
   return(Fl::event_inside(xywh[0],xywh[1],xywh[2],xywh[3]));
@@ -48,24 +54,22 @@ Fl_Tree_Item::Fl_Tree_Item(const Fl_Tree_Prefs &prefs) {
 void Fl_Tree_Item::_Init(const Fl_Tree_Prefs &prefs, Fl_Tree *tree) {
   _tree         = tree;
   _label        = 0;
-  _labelfont    = prefs.labelfont();
-  _labelsize    = prefs.labelsize();
-  _labelfgcolor = prefs.labelfgcolor();
-  _labelbgcolor = prefs.labelbgcolor();
+  _style        = 0;
+  style(prefs.labelfont(), prefs.labelsize(), prefs.labelfgcolor(), prefs.labelbgcolor());
   _widget       = 0;
-  _flags        = OPEN|VISIBLE|ACTIVE;
+  _flags        = OPEN|VISIBLE|ACTIVE|RECALC;
   _xywh[0]      = 0;
   _xywh[1]      = 0;
   _xywh[2]      = 0;
   _xywh[3]      = 0;
-  _collapse_xywh[0] = 0;
-  _collapse_xywh[1] = 0;
-  _collapse_xywh[2] = 0;
-  _collapse_xywh[3] = 0;
   _label_xywh[0]    = 0;
   _label_xywh[1]    = 0;
   _label_xywh[2]    = 0;
   _label_xywh[3]    = 0;
+  _subtree_h        = 0;
+  _subtree_w        = 0;
+  _child_y          = 0;
+  _index            = -1;
   _usericon         = 0;
   _userdeicon       = 0;
   _userdata         = 0;
@@ -90,15 +94,23 @@ Fl_Tree_Item::Fl_Tree_Item(Fl_Tree *tree) {
 // DTOR
 Fl_Tree_Item::~Fl_Tree_Item() {
   if ( _label ) {
-    free((void*)_label);
+    if ( is_flag(ARENA) ) Fl_Tree_Item_Arena::owner(this)->free_label(_label);
+    else                  free((void*)_label);
     _label = 0;
   }
   _widget = 0;                  // Fl_Group will handle destruction
   _usericon = 0;                // user handled allocation
   _userdeicon = 0;              // user handled allocation
+  free(_child_y);
+  _child_y = 0;
+  release_style(_style);
+  _style = 0;
   // focus item? set to null
   if ( _tree && this == _tree->_item_focus )
     { _tree->_item_focus = 0; }
+  // selected? remove from tree's selection index
+  if ( _tree && is_flag(SELECTED) && _tree->_selection )
+    { _tree->_selection->forget(this); }
   //_children.clear();          // array's destructor handles itself
 }
 
@@ -106,29 +118,28 @@ Fl_Tree_Item::~Fl_Tree_Item() {
 Fl_Tree_Item::Fl_Tree_Item(const Fl_Tree_Item *o) {
   _tree             = o->_tree;
   _label        = o->label() ? fl_strdup(o->label()) : 0;
-  _labelfont    = o->labelfont();
-  _labelsize    = o->labelsize();
-  _labelfgcolor = o->labelfgcolor();
-  _labelbgcolor = o->labelbgcolor();
+  _style        = o->_style;
+  add_style_ref(_style);
   _widget       = o->widget();
-  _flags        = o->_flags;
+  _flags        = (o->_flags | RECALC) & ~ARENA;  // copy has no children: recalc its subtree
   _xywh[0]      = o->_xywh[0];
   _xywh[1]      = o->_xywh[1];
   _xywh[2]      = o->_xywh[2];
   _xywh[3]      = o->_xywh[3];
-  _collapse_xywh[0] = o->_collapse_xywh[0];
-  _collapse_xywh[1] = o->_collapse_xywh[1];
-  _collapse_xywh[2] = o->_collapse_xywh[2];
-  _collapse_xywh[3] = o->_collapse_xywh[3];
   _label_xywh[0]    = o->_label_xywh[0];
   _label_xywh[1]    = o->_label_xywh[1];
   _label_xywh[2]    = o->_label_xywh[2];
   _label_xywh[3]    = o->_label_xywh[3];
+  _subtree_h        = 0;
+  _subtree_w        = 0;
+  _child_y          = 0;
+  _index            = -1;
   _usericon         = o->usericon();
   _userdata         = o->user_data();
   _parent           = o->_parent;
   _prev_sibling     = 0;                // do not copy ptrs! use update_prev_next()
   _next_sibling     = 0;                // do not copy ptrs! use update_prev_next()
+  if ( is_flag(SELECTED) ) selection_changed();       // copy is selected too
 }
 
 /// Print the tree as 'ascii art' to stdout.
@@ -155,8 +166,15 @@ void Fl_Tree_Item::show_self(const char *indent) const {
 /// Makes and manages an internal copy of \p 'name'.
 ///
 void Fl_Tree_Item::label(const char *name) {
-  if ( _label ) { free((void*)_label); _label = 0; }
-  _label = name ? fl_strdup(name) : 0;
+  const char *old = _label;
+  Fl_Tree_Item_Arena *arena = is_flag(ARENA) ? Fl_Tree_Item_Arena::owner(this) : 0;
+  if ( arena ) _label = name ? arena->dup_label(name) : 0;
+  else         _label = name ? fl_strdup(name) : 0;
+  if ( _parent ) _parent->_children.hash_relabel(this, old);    // keep parent's index current
+  if ( old ) {
+    if ( arena ) arena->free_label(old);
+    else         free((void*)old);
+  }
   recalc_tree();                // may change label geometry
 }
 
@@ -183,13 +201,8 @@ void Fl_Tree_Item::clear_children() {
 /// \version 1.3.0 release
 ///
 int Fl_Tree_Item::find_child(const char *name) {
-  if ( name ) {
-    for ( int t=0; t<children(); t++ )
-      if ( child(t)->label() )
-        if ( strcmp(child(t)->label(), name) == 0 )
-          return(t);
-  }
-  return(-1);
+  Fl_Tree_Item *item = find_child_item(name);
+  return(item ? find_child(item) : -1);
 }
 
 /// Return the /immediate/ child of current item
@@ -199,12 +212,7 @@ int Fl_Tree_Item::find_child(const char *name) {
 /// \version 1.3.3
 ///
 const Fl_Tree_Item* Fl_Tree_Item::find_child_item(const char *name) const {
-  if ( name )
-    for ( int t=0; t<children(); t++ )
-      if ( child(t)->label() )
-        if ( strcmp(child(t)->label(), name) == 0 )
-          return(child(t));
-  return(0);
+  return(_children.find_label(name));   // hashed for items with many children
 }
 
 /// Non-const version of Fl_Tree_Item::find_child_item(const char *name) const.
@@ -222,18 +230,11 @@ Fl_Tree_Item* Fl_Tree_Item::find_child_item(const char *name) {
 /// \version 1.3.0 release
 ///
 const Fl_Tree_Item *Fl_Tree_Item::find_child_item(char **arr) const {
-  for ( int t=0; t<children(); t++ ) {
-    if ( child(t)->label() ) {
-      if ( strcmp(child(t)->label(), *arr) == 0 ) {     // match?
-        if ( *(arr+1) ) {                               // more in arr? descend
-          return(_children[t]->find_child_item(arr+1));
-        } else {                                        // end of arr? done
-          return(_children[t]);
-        }
-      }
-    }
-  }
-  return(0);
+  const Fl_Tree_Item *item = find_child_item(*arr);
+  if ( !item ) return(0);                               // no match
+  if ( *(arr+1) )                                       // more in arr? descend
+    return(item->find_child_item(arr+1));
+  return(item);                                         // end of arr? done
 }
 
 /// Non-const version of Fl_Tree_Item::find_child_item(char **arr) const.
@@ -274,10 +275,7 @@ Fl_Tree_Item *Fl_Tree_Item::find_item(char **names) {
 /// \returns the index, or -1 if not found.
 ///
 int Fl_Tree_Item::find_child(Fl_Tree_Item *item) {
-  for ( int t=0; t<children(); t++ )
-    if ( item == child(t) )
-      return(t);
-  return(-1);
+  return(_children.index(item));
 }
 
 /// Add a new child to this item with the name \p 'new_label'
@@ -304,7 +302,7 @@ Fl_Tree_Item *Fl_Tree_Item::add(const Fl_Tree_Prefs &prefs,
                                 const char *new_label,
                                 Fl_Tree_Item *item) {
   if ( !item )
-    { item = new Fl_Tree_Item(_tree); item->label(new_label); }
+    { item = new_child(); item->label(new_label); }
   recalc_tree();                // may change tree geometry
   item->_parent = this;
   switch ( prefs.sortorder() ) {
@@ -399,7 +397,7 @@ Fl_Tree_Item *Fl_Tree_Item::add(const Fl_Tree_Prefs &prefs,
   \see Fl_Tree::insert()
 */
 Fl_Tree_Item *Fl_Tree_Item::insert(const Fl_Tree_Prefs &prefs, const char *new_label, int pos) {
-  Fl_Tree_Item *item = new Fl_Tree_Item(_tree);
+  Fl_Tree_Item *item = new_child();
   item->label(new_label);
   item->_parent = this;
   _children.insert(pos, item);
@@ -438,11 +436,14 @@ Fl_Tree_Item *Fl_Tree_Item::insert_above(const Fl_Tree_Prefs &prefs, const char
 Fl_Tree_Item* Fl_Tree_Item::deparent(int pos) {
   Fl_Tree_Item *orphan = _children[pos];
   if ( _children.deparent(pos) < 0 ) return NULL;
+  recalc_tree();                        // may change tree geometry
   return orphan;
 }
 
 /// Reparent specified item as a child of ourself at position \p 'pos'.
 /// Typically 'newchild' was recently orphaned with deparent().
+/// If 'newchild' was orphaned from another tree, it and its children
+/// become items of this item's tree, and keep their selection state.
 ///
 /// \returns
 ///    -  0: on success
@@ -452,6 +453,8 @@ int Fl_Tree_Item::reparent(Fl_Tree_Item *newchild, int pos) {
   int ret;
   if ( (ret = _children.reparent(newchild, this, pos)) < 0 ) return ret;
   newchild->parent(this);               // take custody
+  if ( newchild->_tree != _tree ) newchild->move_to_tree(_tree);        // moved from another tree?
+  recalc_tree();                        // may change tree geometry
   return 0;
 }
 
@@ -653,16 +656,11 @@ int Fl_Tree_Item::remove_child(Fl_Tree_Item *item) {
 /// \version 1.3.3
 ///
 int Fl_Tree_Item::remove_child(const char *name) {
-  for ( int t=0; t<children(); t++ ) {
-    if ( child(t)->label() ) {
-      if ( strcmp(child(t)->label(), name) == 0 ) {
-        _children.remove(t);
-        recalc_tree();          // may change tree geometry
-        return(0);
-      }
-    }
-  }
-  return(-1);
+  int t = find_child(name);
+  if ( t < 0 ) return(-1);
+  _children.remove(t);
+  recalc_tree();                // may change tree geometry
+  return(0);
 }
 
 /// Swap two of our children, given two child index values \p 'ax' and \p 'bx'.
@@ -763,6 +761,10 @@ void Fl_Tree_Item::draw_vertical_connector(int x, int y1, int y2, const Fl_Tree_
 ///
 const Fl_Tree_Item *Fl_Tree_Item::find_clicked(const Fl_Tree_Prefs &prefs, int yonly) const {
   if ( ! is_visible() ) return(0);
+  // Event outside our subtree's cached extent? Skip entire subtree
+  if ( !is_flag(RECALC) &&
+       ( Fl::event_y() < _xywh[1] || Fl::event_y() > (_xywh[1]+_subtree_h) ) )
+    return(0);
   if ( is_root() && !prefs.showroot() ) {
     // skip event check if we're root but root not being shown
   } else {
@@ -778,7 +780,25 @@ const Fl_Tree_Item *Fl_Tree_Item::find_clicked(const Fl_Tree_Prefs &prefs, int y
       }
     }
   }
-  if ( is_open() ) {                            // open? check children of this item
+  if ( is_open() && !is_flag(UNPLACED) ) {      // open and placed? check children of this item
+    if ( !is_flag(RECALC) && _child_y ) {
+      // Cached child offsets: binary search the children under the event.
+      //    Children draw() didn't reach have stale positions, skip them.
+      int ey = Fl::event_y() - _xywh[1];
+      int n = children(), lo = 0, hi = n;
+      while ( lo < hi ) {
+        int mid = (lo + hi) / 2;
+        if ( _child_y[mid+1] < ey ) lo = mid + 1;
+        else                        hi = mid;
+      }
+      for ( int t=lo; t<n && _child_y[t]<=ey; t++ ) {
+        const Fl_Tree_Item *item = _children[t];
+        if ( item->_xywh[1] != _xywh[1] + _child_y[t] ) continue;
+        if ( (item = item->find_clicked(prefs, yonly)) != NULL )
+          return(item);
+      }
+      return(0);
+    }
     for ( int t=0; t<children(); t++ ) {
       const Fl_Tree_Item *item;
       if ( (item = _children[t]->find_clicked(prefs, yonly)) != NULL)  // recurse into child for descendents
@@ -848,8 +868,8 @@ int Fl_Tree_Item::calc_item_height(const Fl_Tree_Prefs &prefs) const {
   if ( ! is_visible() ) return(0);
   int H = 0;
   if ( _label ) {
-    fl_font(_labelfont, _labelsize);    // fl_descent() needs this :/
-    H = _labelsize + fl_descent() + 1;  // at least one pixel space below descender
+    fl_font(labelfont(), labelsize());  // fl_descent() needs this :/
+    H = labelsize() + fl_descent() + 1; // at least one pixel space below descender
   }
   if ( widget() &&
        (prefs.item_draw_mode() & FL_TREE_ITEM_HEIGHT_FROM_WIDGET) &&
@@ -863,6 +883,204 @@ int Fl_Tree_Item::calc_item_height(const Fl_Tree_Prefs &prefs) const {
   return(H);
 }
 
+// Internal: Calculate the collapse icon's xywh from the item's xywh.
+//    Not stored with the item to keep items small; only needed
+//    when drawing, or checking for a click on the icon.
+//
+void Fl_Tree_Item::calc_collapse_xywh(const Fl_Tree_Prefs &prefs, int xywh[4]) const {
+  xywh[2] = prefs.openicon()->w();
+  xywh[3] = prefs.openicon()->h();
+  xywh[0] = _xywh[0] + (xywh[2] + prefs.connectorwidth())/2 - 3;
+  xywh[1] = _xywh[1] + (_xywh[3]/2) - (xywh[3]/2);
+}
+
+// Internal: style records shared by all items, hashed by value.
+//    Records are reference counted and freed when no item uses them,
+//    the table is freed with its last record. Items of trees in
+//    different threads share the table, so it is locked by style_mutex.
+//
+static void *style_mutex = 0;                   // see Fl_System_Driver::mutex_lock()
+static Fl_Tree_Item_Style **style_table = 0;    // hash table of records
+static int style_table_size  = 0;               // #slots (power of 2)
+static int style_table_count = 0;               // #records in table
+static Fl_Tree_Item_Style *style_last = 0;      // most items share the last one used
+
+static unsigned style_hash(Fl_Font font, Fl_Fontsize size, Fl_Color fg, Fl_Color bg) {
+  unsigned h = (unsigned)font * 2654435761U;
+  h = (h ^ (unsigned)size) * 2654435761U;
+  h = (h ^ (unsigned)fg) * 2654435761U;
+  h = (h ^ (unsigned)bg) * 2654435761U;
+  return h ^ (h >> 15);
+}
+
+// Find or create the record for the given values, and add a reference to it
+static Fl_Tree_Item_Style *find_style_(Fl_Font font, Fl_Fontsize size, Fl_Color fg, Fl_Color bg) {
+  Fl_Tree_Item_Style *last = style_last;
+  if ( last && last->labelfont == font && last->labelsize == size &&
+       last->labelfgcolor == fg && last->labelbgcolor == bg ) {
+    ++last->refcount;
+    return last;
+  }
+  if ( (style_table_count+1) * 2 > style_table_size ) {       // grow table?
+    int newsize = style_table_size ? style_table_size * 2 : 64;
+    Fl_Tree_Item_Style **newtable = (Fl_Tree_Item_Style**)calloc(newsize, sizeof(Fl_Tree_Item_Style*));
+    for ( int t=0; t<style_table_size; t++ ) {
+      Fl_Tree_Item_Style *r = style_table[t];
+      if ( !r ) continue;
+      unsigned i = style_hash(r->labelfont, r->labelsize, r->labelfgcolor, r->labelbgcolor) & (newsize-1);
+      while ( newtable[i] ) i = (i+1) & (newsize-1);
+      newtable[i] = r;
+    }
+    if ( style_table ) free((void*)style_table);
+    style_table = newtable;
+    style_table_size = newsize;
+  }
+  unsigned mask = style_table_size - 1;
+  unsigned i = style_hash(font, size, fg, bg) & mask;
+  for ( ; style_table[i]; i = (i+1) & mask ) {
+    Fl_Tree_Item_Style *r = style_table[i];
+    if ( r->labelfont == font && r->labelsize == size &&
+         r->labelfgcolor == fg && r->labelbgcolor == bg ) {
+      ++r->refcount;
+      return (style_last = r);
+    }
+  }
+  Fl_Tree_Item_Style *r = (Fl_Tree_Item_Style*)malloc(sizeof(Fl_Tree_Item_Style));
+  r->labelfont    = font;
+  r->labelsize    = size;
+  r->labelfgcolor = fg;
+  r->labelbgcolor = bg;
+  r->refcount     = 1;
+  style_table[i] = r;
+  ++style_table_count;
+  return (style_last = r);
+}
+
+// Remove a reference to a record, and free it if no item uses it anymore
+static void release_style_(const Fl_Tree_Item_Style *style) {
+  Fl_Tree_Item_Style *r = (Fl_Tree_Item_Style*)style;
+  if ( --r->refcount > 0 ) return;
+  unsigned mask = style_table_size - 1;
+  unsigned i = style_hash(r->labelfont, r->labelsize, r->labelfgcolor, r->labelbgcolor) & mask;
+  while ( style_table[i] != r ) i = (i+1) & mask;
+  style_table[i] = 0;
+  // Move records of the same probe sequence into the gap (linear probing)
+  for ( unsigned j = (i+1) & mask; style_table[j]; j = (j+1) & mask ) {
+    Fl_Tree_Item_Style *m = style_table[j];
+    unsigned h = style_hash(m->labelfont, m->labelsize, m->labelfgcolor, m->labelbgcolor) & mask;
+    if ( ((j - h) & mask) >= ((j - i) & mask) ) {       // home slot at or before the gap?
+      style_table[i] = m;
+      style_table[j] = 0;
+      i = j;
+    }
+  }
+  if ( r == style_last ) style_last = 0;
+  free((void*)r);
+  if ( --style_table_count == 0 ) {             // last record? free the table
+    free((void*)style_table);
+    style_table = 0;
+    style_table_size = 0;
+  }
+}
+
+// Lock the table for find_style_()
+static Fl_Tree_Item_Style *find_style(Fl_Font font, Fl_Fontsize size, Fl_Color fg, Fl_Color bg) {
+  Fl::system_driver()->mutex_lock(&style_mutex);
+  Fl_Tree_Item_Style *r = find_style_(font, size, fg, bg);
+  Fl::system_driver()->mutex_unlock(style_mutex);
+  return r;
+}
+
+// Add a reference to a record, e.g. for a copy of an item
+static void add_style_ref(const Fl_Tree_Item_Style *style) {
+  if ( !style ) return;
+  Fl::system_driver()->mutex_lock(&style_mutex);
+  ++((Fl_Tree_Item_Style*)style)->refcount;
+  Fl::system_driver()->mutex_unlock(style_mutex);
+}
+
+// Lock the table for release_style_()
+static void release_style(const Fl_Tree_Item_Style *style) {
+  if ( !style ) return;
+  Fl::system_driver()->mutex_lock(&style_mutex);
+  release_style_(style);
+  Fl::system_driver()->mutex_unlock(style_mutex);
+}
+
+/// Internal: Set the item's label font, size and colors.
+/// Items with identical values share one Fl_Tree_Item_Style record.
+///
+void Fl_Tree_Item::style(Fl_Font font, Fl_Fontsize size, Fl_Color fg, Fl_Color bg) {
+  const Fl_Tree_Item_Style *old = _style;
+  _style = find_style(font, size, fg, bg);
+  release_style(old);
+}
+
+// Internal: Keep the tree's index of selected items current.
+//    Called by select() and deselect() when the item's state changed.
+//
+void Fl_Tree_Item::selection_changed() {
+  if ( !_tree || !_tree->_selection ) return;
+  if ( is_flag(SELECTED) ) _tree->_selection->add(this, _tree->_root);
+  else                     _tree->_selection->remove(this);
+}
+
+// Internal: Make 'tree' the tree of this item and its descendants.
+//    Called by reparent() for items moved from another tree: the old
+//    tree forgets them, and the new tree indexes the selected ones.
+//    Arena items stay in their old tree's arena, see Fl_Tree::item_arena().
+//
+void Fl_Tree_Item::move_to_tree(Fl_Tree *tree) {
+  Fl_Tree *old = _tree;
+  if ( old ) {
+    if ( this == old->_item_focus ) old->_item_focus = 0;
+    if ( this == old->_lastselect ) old->_lastselect = 0;
+    if ( is_flag(SELECTED) && old->_selection ) old->_selection->forget(this);
+  }
+  _tree = tree;
+  if ( is_flag(SELECTED) ) selection_changed();
+  for ( int t=0; t<children(); t++ )
+    _children[t]->move_to_tree(tree);
+}
+
+// Internal: Items were moved around in the tree near 'item'.
+//    Called by Fl_Tree_Item_Array; the parent's cached geometry is stale,
+//    and selected items may need reordering.
+//
+void Fl_Tree_Item::order_changed(Fl_Tree_Item *item) {
+  if ( item->_parent ) item->_parent->recalc_tree();    // children's offsets changed
+  Fl_Tree *tree = item->_tree;
+  if ( tree && tree->_selection && tree->_selection->count() )
+    tree->_selection->reorder();
+}
+
+// Internal: Create a new item for use as a child of this item.
+//    Allocated from the tree's item arena, if it has one.
+//
+Fl_Tree_Item *Fl_Tree_Item::new_child() {
+  return(_tree ? _tree->new_item() : new Fl_Tree_Item(_tree));
+}
+
+/// Destroy \p 'item', a child removed from the tree.
+///
+/// Same as 'delete item', except that items allocated from the tree's
+/// item arena are returned to the arena. Should only be used by
+/// Fl_Tree's internals, e.g. Fl_Tree_Item_Array.
+///
+/// \see Fl_Tree::item_arena()
+/// \version 1.4.0
+///
+void Fl_Tree_Item::destroy(Fl_Tree_Item *item) {
+  if ( !item ) return;
+  if ( item->is_flag(ARENA) ) {
+    Fl_Tree_Item_Arena *arena = Fl_Tree_Item_Arena::owner(item);
+    item->~Fl_Tree_Item();                      // arena items are always Fl_Tree_Item
+    arena->free_item((void*)item);
+  } else {
+    delete item;
+  }
+}
+
 // These methods held for 1.3.3 ABI: all need 'tree()' back-reference.
 
 /// Returns the recommended foreground color used for drawing this item.
@@ -870,9 +1088,9 @@ int Fl_Tree_Item::calc_item_height(const Fl_Tree_Prefs &prefs) const {
 /// \version 1.3.3 ABI ABI
 ///
 Fl_Color Fl_Tree_Item::drawfgcolor() const {
-  return is_selected() ? fl_contrast(_labelfgcolor, tree()->selection_color())
-                       : (is_active() && tree()->active_r()) ? _labelfgcolor
-                                                             : fl_inactive(_labelfgcolor);
+  return is_selected() ? fl_contrast(labelfgcolor(), tree()->selection_color())
+                       : (is_active() && tree()->active_r()) ? labelfgcolor()
+                                                             : fl_inactive(labelfgcolor());
 }
 
 /// Returns the recommended background color used for drawing this item.
@@ -883,8 +1101,8 @@ Fl_Color Fl_Tree_Item::drawbgcolor() const {
   const Fl_Color unspecified = 0xffffffff;
   return is_selected() ? is_active() && tree()->active_r() ? tree()->selection_color()
                                                            : fl_inactive(tree()->selection_color())
-                       : _labelbgcolor == unspecified ? tree()->color()
-                                                      : _labelbgcolor;
+                       : labelbgcolor() == unspecified ? tree()->color()
+                                                       : labelbgcolor();
 }
 
 /// Draw the item content
@@ -976,10 +1194,10 @@ int Fl_Tree_Item::draw_item_content(int render) {
          (prefs.item_draw_mode() & FL_TREE_ITEM_DRAW_LABEL_AND_WIDGET) ) ) {
     if ( render ) {
       fl_color(fg);
-      fl_font(_labelfont, _labelsize);
+      fl_font(labelfont(), labelsize());
     }
     int lx = label_x()+(_label ? prefs.labelmarginleft() : 0);
-    int ly = label_y()+(label_h()/2)+(_labelsize/2)-fl_descent()/2;
+    int ly = label_y()+(label_h()/2)+(labelsize()/2)-fl_descent()/2;
     int lw=0, lh=0;
     fl_measure(_label, lw, lh);         // get box around text (including white space)
     if ( render ) fl_draw(_label, lx, ly);
@@ -1011,6 +1229,33 @@ void Fl_Tree_Item::draw(int X, int &Y, int W, Fl_Tree_Item *itemfocus,
   if ( !is_visible() ) return;
   int tree_top = tree()->_tiy;
   int tree_bot = tree_top + tree()->_tih;
+
+  // Use cached subtree geometry if it's still valid, and either we're only
+  // measuring (render=0), or the entire subtree is more than a page off-screen.
+  //   Items within a page of the viewport are still placed so keyboard
+  //   navigation and drag-scrolling see current positions. Subtrees with
+  //   child widgets are never skipped; their widgets must move when scrolled.
+  //
+  if ( !is_flag(RECALC) ) {
+    if ( !render ) {
+      Y += _subtree_h;
+      if ( _subtree_w > 0 && (X + _subtree_w) > tree_item_xmax )
+        tree_item_xmax = X + _subtree_w;
+      return;
+    }
+    int page = tree()->_tih;
+    if ( !is_flag(HAS_WIDGETS) &&
+         ( (Y + _subtree_h) < (tree_top - page) || Y > (tree_bot + page) ) ) {
+      _xywh[0] = X;                             // place ourself for find_clicked(),
+      _xywh[1] = Y;                             // but not our children
+      _xywh[2] = W;
+      _xywh[3] = calc_item_height(prefs);
+      if ( has_children() ) _flags |= UNPLACED;
+      Y += _subtree_h;
+      return;
+    }
+  }
+  int Y_start = Y;                      // top of our subtree
   int H = calc_item_height(prefs);      // height of item
   int H2 = H + prefs.linespacing();     // height of item with line spacing
 
@@ -1021,17 +1266,12 @@ void Fl_Tree_Item::draw(int X, int &Y, int W, Fl_Tree_Item *itemfocus,
   _xywh[3] = H;
 
   // Determine collapse icon's xywh
-  //   Note: calculate collapse icon's xywh for possible mouse click detection.
-  //   We don't care about items clipped off the viewport; they won't get mouse events.
-  //
   int item_y_center = Y+(H/2);
-  _collapse_xywh[2] = prefs.openicon()->w();
-  int &icon_w = _collapse_xywh[2];
-  _collapse_xywh[0] = X + (icon_w + prefs.connectorwidth())/2 - 3;
-  int &icon_x = _collapse_xywh[0];
-  _collapse_xywh[1] = item_y_center - (prefs.openicon()->h()/2);
-  int &icon_y = _collapse_xywh[1];
-  _collapse_xywh[3] = prefs.openicon()->h();
+  int collapse_xywh[4];
+  calc_collapse_xywh(prefs, collapse_xywh);
+  int icon_x = collapse_xywh[0];
+  int icon_y = collapse_xywh[1];
+  int icon_w = collapse_xywh[2];
 
   // Horizontal connector values
   //   Must calculate these even if(clipped) because 'draw children' code (below)
@@ -1073,7 +1313,7 @@ void Fl_Tree_Item::draw(int X, int &Y, int W, Fl_Tree_Item *itemfocus,
              ? widget()->h() : H;
     if ( _label &&
          (prefs.item_draw_mode() & FL_TREE_ITEM_DRAW_LABEL_AND_WIDGET) ) {
-      fl_font(_labelfont, _labelsize);  // fldescent() needs this
+      fl_font(labelfont(), labelsize());  // fldescent() needs this
       int lw=0, lh=0;
       fl_measure(_label,lw,lh);         // get box around text (including white space)
       wx += (lw + prefs.widgetmarginleft());
@@ -1156,18 +1396,43 @@ void Fl_Tree_Item::draw(int X, int &Y, int W, Fl_Tree_Item *itemfocus,
     }                   // end drawthis
   }                     // end clipped
   if ( drawthis ) Y += H2;                                      // adjust Y (even if clipped)
-  // Manage tree_item_xmax
-  if ( xmax > tree_item_xmax )
-    tree_item_xmax = xmax;
+  // Manage subtree's xmax; merged into tree_item_xmax below
+  int subtree_xmax = xmax;
+  int subtree_widgets = widget() ? 1 : 0;
   // Draw child items (if any)
   if ( has_children() && is_open() ) {
     int child_x = drawthis ? (hconn_x_center - (icon_w/2) + 1)  // offset children to right,
                            : X;                                 // unless didn't drawthis
     int child_w = W - (child_x-X);
     int child_y_start = Y;
-    for ( int t=0; t<children(); t++ ) {
-      int is_lastchild = ((t+1)==children()) ? 1 : 0;
-      _children[t]->draw(child_x, Y, child_w, itemfocus, tree_item_xmax, is_lastchild, render);
+    int n = children();
+    if ( render && !is_flag(RECALC) && !is_flag(HAS_WIDGETS) && _child_y ) {
+      // Cached child offsets: binary search the first child that ends less
+      // than a page above the viewport, stop after the last one that starts
+      // less than a page below it, and skip the rest
+      int page = tree()->_tih;
+      int top = tree_top - page - Y_start;
+      int lo = 0, hi = n;
+      while ( lo < hi ) {
+        int mid = (lo + hi) / 2;
+        if ( _child_y[mid+1] < top ) lo = mid + 1;
+        else                         hi = mid;
+      }
+      for ( int t=lo; t<n; t++ ) {
+        Y = Y_start + _child_y[t];
+        if ( Y > tree_bot + page ) break;
+        _children[t]->draw(child_x, Y, child_w, itemfocus, subtree_xmax, (t+1)==n, render);
+      }
+      Y = Y_start + _child_y[n];
+    } else {
+      if ( !render ) _child_y = (int*)realloc(_child_y, (n+1) * sizeof(int));
+      for ( int t=0; t<n; t++ ) {
+        Fl_Tree_Item *c = _children[t];
+        if ( !render ) _child_y[t] = Y - Y_start;
+        c->draw(child_x, Y, child_w, itemfocus, subtree_xmax, (t+1)==n, render);
+        if ( c->is_visible() && c->is_flag(HAS_WIDGETS) ) subtree_widgets = 1;
+      }
+      if ( !render ) _child_y[n] = Y - Y_start;
     }
     if ( has_children() && is_open() ) {
       Y += prefs.openchild_marginbottom();              // offset below open child tree
@@ -1180,6 +1445,22 @@ void Fl_Tree_Item::draw(int X, int &Y, int W, Fl_Tree_Item *itemfocus,
         draw_vertical_connector(hconn_x, child_y_start, Y, prefs);
     }
   }
+  if ( subtree_xmax > tree_item_xmax )
+    tree_item_xmax = subtree_xmax;
+  if ( render ) {
+    _flags &= ~UNPLACED;                        // children were all placed
+  } else {
+    // Measuring: cache subtree geometry for later redraws and calc_tree()
+    _subtree_h = Y - Y_start;
+    _subtree_w = (subtree_xmax > X) ? (subtree_xmax - X) : 0;
+    if ( subtree_widgets ) _flags |= HAS_WIDGETS;
+    else                   _flags &= ~HAS_WIDGETS;
+    if ( !has_children() || !is_open() ) {      // no child offsets to cache
+      free(_child_y);
+      _child_y = 0;
+    }
+    _flags &= ~RECALC;
+  }
 }
 
 
@@ -1187,7 +1468,9 @@ void Fl_Tree_Item::draw(int X, int &Y, int W, Fl_Tree_Item *itemfocus,
 ///
 int Fl_Tree_Item::event_on_collapse_icon(const Fl_Tree_Prefs &prefs) const {
   if ( is_visible() && is_active() && has_children() && prefs.showcollapse() ) {
-    return(event_inside(_collapse_xywh) ? 1 : 0);
+    int collapse_xywh[4];
+    calc_collapse_xywh(prefs, collapse_xywh);
+    return(event_inside(collapse_xywh) ? 1 : 0);
   } else {
     return(0);
   }
@@ -1475,8 +1758,12 @@ int Fl_Tree_Item::visible_r() const {
 /// Call this when our geometry is changed. (Font size, label contents, etc)
 /// Schedules tree to recalculate itself, as changes to us may affect tree
 /// widget's scrollbar visibility and tab sizes.
+/// Only this item and its parents have their cached subtree geometry
+/// invalidated, so the next calc_tree() re-measures just that path.
 /// \version 1.3.3 ABI
 ///
 void Fl_Tree_Item::recalc_tree() {
-  _tree->recalc_tree();
+  for ( Fl_Tree_Item *p = this; p; p = p->_parent )
+    p->_flags |= RECALC;
+  if ( _tree ) _tree->_tree_w = _tree->_tree_h = -1;
 }
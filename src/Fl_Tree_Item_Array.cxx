@@ -36,6 +36,7 @@ Fl_Tree_Item_Array::Fl_Tree_Item_Array(int new_chunksize) {
   _size      = 0;
   _flags     = 0;
   _chunksize = new_chunksize;
+  _hash      = 0;
 }
 
 /// Destructor. Calls each item's destructor, destroys internal _items array.
@@ -49,7 +50,8 @@ Fl_Tree_Item_Array::Fl_Tree_Item_Array(const Fl_Tree_Item_Array* o) {
   _total     = 0;
   _size      = o->_size;
   _chunksize = o->_chunksize;
-  _flags     = o->_flags;
+  _flags     = o->_flags & ~INDEX_VALID;
+  _hash      = 0;                                       // index rebuilt on demand
   for ( int t=0; t<o->_total; t++ ) {
     if ( _flags & MANAGE_ITEM ) {
       _items[t] = new Fl_Tree_Item(o->_items[t]);       // make new copy of item
@@ -72,13 +74,15 @@ void Fl_Tree_Item_Array::clear() {
     for ( int t=0; t<_total; t++ ) {
       if ( _flags & MANAGE_ITEM )
       {
-        delete _items[t];
+        Fl_Tree_Item::destroy(_items[t]);
         _items[t] = 0;
       }
     }
     free((void*)_items); _items = 0;
   }
   _total = _size = 0;
+  _flags &= ~INDEX_VALID;
+  hash_free();
 }
 
 // Internal: Enlarge the items array.
@@ -126,7 +130,15 @@ void Fl_Tree_Item_Array::insert(int pos, Fl_Tree_Item *new_item) {
   if ( _flags & MANAGE_ITEM )
   {
     _items[pos]->update_prev_next(pos); // adjust item's prev/next and its neighbors
+    if ( pos == _total-1 )
+      new_item->_index = pos;           // appended: other index positions unchanged
+    else
+      _flags &= ~INDEX_VALID;
+    // New item's subtree may hold selected items (e.g. reparented branch)
+    if ( new_item->is_selected() || new_item->has_children() )
+      Fl_Tree_Item::order_changed(new_item);
   }
+  hash_add(new_item);
 }
 
 /// Add an item* to the end of the array.
@@ -146,16 +158,20 @@ void Fl_Tree_Item_Array::add(Fl_Tree_Item *val) {
 ///
 void Fl_Tree_Item_Array::replace(int index, Fl_Tree_Item *newitem) {
   if ( _items[index] ) {                        // delete if non-zero
+    hash_remove(_items[index], _items[index]->label());
     if ( _flags & MANAGE_ITEM )
       // Destroy old item
-      delete _items[index];
+      Fl_Tree_Item::destroy(_items[index]);
   }
   _items[index] = newitem;                      // install new item
   if ( _flags & MANAGE_ITEM )
   {
     // Restitch into linked list
     _items[index]->update_prev_next(index);
+    newitem->_index = index;
+    Fl_Tree_Item::order_changed(newitem);
   }
+  hash_add(newitem);
 }
 
 /// Remove the item at \param[in] index from the array.
@@ -164,11 +180,13 @@ void Fl_Tree_Item_Array::replace(int index, Fl_Tree_Item *newitem) {
 ///
 void Fl_Tree_Item_Array::remove(int index) {
   if ( _items[index] ) {                        // delete if non-zero
+    hash_remove(_items[index], _items[index]->label());
     if ( _flags & MANAGE_ITEM )
-      delete _items[index];
+      Fl_Tree_Item::destroy(_items[index]);
   }
   _items[index] = 0;
   _total--;
+  _flags &= ~INDEX_VALID;                       // later items moved up
   for ( int i=index; i<_total; i++ ) {          // reshuffle the array
     _items[i] = _items[i+1];
   }
@@ -188,13 +206,10 @@ void Fl_Tree_Item_Array::remove(int index) {
 ///     \returns 0 if removed, or -1 if the item was not in the array.
 ///
 int Fl_Tree_Item_Array::remove(Fl_Tree_Item *item) {
-  for ( int t=0; t<_total; t++ ) {
-    if ( item == _items[t] ) {
-      remove(t);
-      return(0);
-    }
-  }
-  return(-1);
+  int t = index(item);
+  if ( t < 0 ) return(-1);
+  remove(t);
+  return(0);
 }
 
 /// Swap the two items at index positions \p ax and \p bx.
@@ -207,6 +222,9 @@ void Fl_Tree_Item_Array::swap(int ax, int bx) {
     // Adjust prev/next ptrs
     _items[ax]->update_prev_next(ax);
     _items[bx]->update_prev_next(bx);
+    _items[ax]->_index = ax;
+    _items[bx]->_index = bx;
+    Fl_Tree_Item::order_changed(_items[ax]);
   }
 }
 
@@ -234,6 +252,7 @@ int Fl_Tree_Item_Array::move(int to, int from) {
   // Update all children
   for ( int r=0; r<_total; r++ )        // XXX: excessive to do all children,
     _items[r]->update_prev_next(r);     // XXX: but avoids weird boundary issues
+  changed(item);
   return 0;
 }
 
@@ -250,11 +269,13 @@ int Fl_Tree_Item_Array::deparent(int pos) {
   Fl_Tree_Item *item = _items[pos];
   Fl_Tree_Item *prev = item->prev_sibling();
   Fl_Tree_Item *next = item->next_sibling();
+  hash_remove(item, item->label());
   // Remove from parent's list of children
   _total -= 1;
   for ( int t=pos; t<_total; t++ )
     _items[t] = _items[t+1];            // delete, no destroy
   // Now an orphan: remove association with old parent and siblings
+  changed(item);                        // while item still knows its tree
   item->update_prev_next(-1);           // become an orphan
   // Adjust bereaved siblings
   if ( prev ) prev->update_prev_next(pos-1);
@@ -278,5 +299,206 @@ int Fl_Tree_Item_Array::reparent(Fl_Tree_Item *item, Fl_Tree_Item* newparent, in
   // Attach to new parent and siblings
   _items[pos]->parent(newparent);       // reparent (update_prev_next() needs this)
   _items[pos]->update_prev_next(pos);   // find new siblings
+  changed(item);
+  hash_add(item);
+  return 0;
+}
+
+/// Sort the items from index \p 'first' on using \p 'compare', which
+/// returns <0, 0 or >0 like strcmp(), and merge them into the items
+/// before \p 'first'. The items before \p 'first' keep their order,
+/// even if they are not sorted: each sorted item is placed before the
+/// first of them that compares greater, which is where inserting the
+/// items one by one in sorted order would put them. The sort is stable;
+/// items that compare equal keep their relative order.
+///
+void Fl_Tree_Item_Array::sort(int first,
+                              int (*compare)(const Fl_Tree_Item*, const Fl_Tree_Item*)) {
+  int n = _total - first;
+  if ( n < 1 || (n < 2 && first == 0) ) return;
+  // Bottom up merge sort of the new items (qsort() is not stable)
+  Fl_Tree_Item **tmp = (Fl_Tree_Item**)malloc(_total * sizeof(Fl_Tree_Item*));
+  Fl_Tree_Item **src = _items + first, **dst = tmp;
+  for ( int width=1; width<n; width*=2 ) {
+    for ( int lo=0; lo<n; lo+=2*width ) {
+      int mid = lo + width;      if ( mid > n ) mid = n;
+      int hi  = lo + 2*width;    if ( hi  > n ) hi  = n;
+      int a = lo, b = mid, d = lo;
+      while ( a < mid && b < hi )
+        dst[d++] = ( compare(src[b], src[a]) < 0 ) ? src[b++] : src[a++];
+      while ( a < mid ) dst[d++] = src[a++];
+      while ( b < hi )  dst[d++] = src[b++];
+    }
+    Fl_Tree_Item **swp = src; src = dst; dst = swp;
+  }
+  if ( src != _items + first )          // result ended up in tmp? copy back
+    memcpy(_items + first, src, n * sizeof(Fl_Tree_Item*));
+  // Merge into the old items
+  if ( first > 0 ) {
+    memcpy(tmp, _items, _total * sizeof(Fl_Tree_Item*));
+    int a = 0, b = first, d = 0;
+    while ( a < first && b < _total )
+      _items[d++] = ( compare(tmp[a], tmp[b]) > 0 ) ? tmp[b++] : tmp[a++];
+    while ( a < first )  _items[d++] = tmp[a++];
+    while ( b < _total ) _items[d++] = tmp[b++];
+  }
+  free((void*)tmp);
+  if ( _flags & MANAGE_ITEM ) {
+    for ( int t=0; t<_total; t++ )      // restitch prev/next
+      _items[t]->update_prev_next(t);
+  }
+  changed(_items[0]);
+}
+
+/// Return the index position of \p 'item' in the array, or -1 if not found.
+///
+/// For arrays that manage their items (such as an Fl_Tree_Item's children)
+/// this is fast: index positions are remembered by the items, and only
+/// renumbered after the array was changed.
+///
+int Fl_Tree_Item_Array::index(const Fl_Tree_Item *item) {
+  if ( !(_flags & MANAGE_ITEM) ) {
+    for ( int t=0; t<_total; t++ )
+      if ( item == _items[t] ) return(t);
+    return(-1);
+  }
+  if ( !(_flags & INDEX_VALID) ) {
+    for ( int t=0; t<_total; t++ )
+      _items[t]->_index = t;
+    _flags |= INDEX_VALID;
+  }
+  int t = item->_index;
+  return( (t >= 0 && t < _total && _items[t] == item) ? t : -1 );
+}
+
+// Internal: the order of the items changed.
+//    Invalidates index positions, and the tree's selection order.
+//
+void Fl_Tree_Item_Array::changed(Fl_Tree_Item *item) {
+  _flags &= ~INDEX_VALID;
+  if ( (_flags & MANAGE_ITEM) && item )
+    Fl_Tree_Item::order_changed(item);
+}
+
+// Internal: hash a label for the label index
+static unsigned hash_label(const char *s) {
+  unsigned h = 2166136261U;             // FNV-1a
+  while ( *s ) { h ^= (unsigned char)*s++; h *= 16777619U; }
+  return h;
+}
+
+// Internal: free the label index, if any
+void Fl_Tree_Item_Array::hash_free() {
+  if ( _hash ) { free((void*)_hash); _hash = 0; }
+}
+
+// Internal: allocate an empty label index with 'size' slots
+static void *hash_alloc(int size, size_t slotsize, size_t hdrsize) {
+  return calloc(1, hdrsize + (size-1) * slotsize);      // header includes one slot
+}
+
+// Internal: build label index for all items in the array
+void Fl_Tree_Item_Array::hash_build() const {
+  int size = 64;
+  while ( size < _total * 2 ) size *= 2;        // keep load factor <= 50%
+  _hash = (HashIndex*)hash_alloc(size, sizeof(HashSlot), sizeof(HashIndex));
+  _hash->size = size;
+  for ( int t=0; t<_total; t++ )
+    hash_add(_items[t]);
+}
+
+// Internal: double the size of the label index
+void Fl_Tree_Item_Array::hash_grow() const {
+  HashIndex *old = _hash;
+  int size = old->size * 2;
+  _hash = (HashIndex*)hash_alloc(size, sizeof(HashSlot), sizeof(HashIndex));
+  _hash->size = size;
+  unsigned mask = size - 1;
+  for ( int t=0; t<old->size; t++ ) {
+    if ( !old->slot[t].item ) continue;
+    unsigned i = old->slot[t].code & mask;
+    while ( _hash->slot[i].item ) i = (i+1) & mask;
+    _hash->slot[i] = old->slot[t];
+    ++_hash->count;
+  }
+  free((void*)old);
+}
+
+// Internal: add item to the label index (if there is one)
+void Fl_Tree_Item_Array::hash_add(Fl_Tree_Item *item) const {
+  if ( !_hash || !item || !item->label() ) return;
+  if ( (_hash->count+1) * 2 > _hash->size ) hash_grow();
+  HashSlot *slot = _hash->slot;
+  unsigned code = hash_label(item->label());
+  unsigned mask = _hash->size - 1;
+  unsigned i = code & mask;
+  while ( slot[i].item ) i = (i+1) & mask;
+  slot[i].code = code;
+  slot[i].item = item;
+  ++_hash->count;
+}
+
+// Internal: remove item that has \p 'label' from the label index (if there is one)
+void Fl_Tree_Item_Array::hash_remove(Fl_Tree_Item *item, const char *label) {
+  if ( !_hash || !label ) return;
+  HashSlot *slot = _hash->slot;
+  unsigned mask = _hash->size - 1;
+  unsigned i = hash_label(label) & mask;
+  while ( slot[i].item && slot[i].item != item ) i = (i+1) & mask;
+  if ( !slot[i].item ) return;                  // not found
+  // Linear probing delete: shift later entries of the probe chain back
+  unsigned j = i;
+  while ( 1 ) {
+    j = (j+1) & mask;
+    if ( !slot[j].item ) break;
+    unsigned k = slot[j].code & mask;           // entry's home slot
+    if ( (j > i && (k <= i || k > j)) ||
+         (j < i && (k <= i && k > j)) ) {
+      slot[i] = slot[j];
+      i = j;
+    }
+  }
+  slot[i].item = 0;
+  --_hash->count;
+}
+
+/// Update the label index after \p 'item' changed its label from \p 'oldlabel'.
+/// Called by Fl_Tree_Item::label() for items in a parent's array of children.
+///
+void Fl_Tree_Item_Array::hash_relabel(Fl_Tree_Item *item, const char *oldlabel) {
+  hash_remove(item, oldlabel);
+  hash_add(item);
+}
+
+/// Find the first item in the array whose label is \p 'name'.
+///
+/// Large arrays build a hash index of the item labels on first use,
+/// which is then kept up to date as items are added, removed or relabeled,
+/// making lookups O(1) instead of a linear scan.
+///
+/// \returns the item, or 0 if not found.
+/// \version 1.4.0
+///
+const Fl_Tree_Item *Fl_Tree_Item_Array::find_label(const char *name) const {
+  if ( !name ) return 0;
+  if ( !_hash && _total >= 32 ) hash_build();   // large array? index it
+  if ( _hash ) {
+    const HashSlot *slot = _hash->slot;
+    unsigned code = hash_label(name);
+    unsigned mask = _hash->size - 1;
+    const Fl_Tree_Item *found = 0;
+    int nfound = 0;
+    for ( unsigned i = code & mask; slot[i].item; i = (i+1) & mask ) {
+      if ( slot[i].code == code && strcmp(slot[i].item->label(), name) == 0 ) {
+        found = slot[i].item;
+        ++nfound;
+      }
+    }
+    if ( nfound < 2 ) return found;
+    // Duplicate labels: fall through to find the first one in array order
+  }
+  for ( int t=0; t<_total; t++ )
+    if ( _items[t]->label() && strcmp(_items[t]->label(), name) == 0 )
+      return _items[t];
   return 0;
 }
@@ -439,6 +439,99 @@ void Fl_Posix_System_Driver::lock_ring() {
   pthread_mutex_lock(ring_mutex);
 }
 
+// Worker threads, see Fl_System_Driver::create_thread()
+struct thread_start {
+  void (*func)(void *);
+  void *data;
+};
+
+static void *thread_start_cb(void *arg) {
+  thread_start start = *(thread_start *)arg;
+  delete (thread_start *)arg;
+  start.func(start.data);
+  return NULL;
+}
+
+int Fl_Posix_System_Driver::create_thread(void (*func)(void *), void *data) {
+  pthread_t thread;
+  thread_start *start = new thread_start;
+  start->func = func;
+  start->data = data;
+  if (pthread_create(&thread, NULL, thread_start_cb, start)) {
+    delete start;
+    return -1;
+  }
+  pthread_detach(thread);
+  return 0;
+}
+
+// Mutexes for data shared with these threads, created when first locked;
+// threads may lock a mutex for the first time at once, so the pointer is
+// read and set under this lock
+static pthread_mutex_t create_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+void Fl_Posix_System_Driver::mutex_lock(void **m) {
+  pthread_mutex_lock(&create_mutex);
+  if (!*m) {
+    pthread_mutex_t *mutex = (pthread_mutex_t*)malloc(sizeof(pthread_mutex_t));
+    pthread_mutex_init(mutex, NULL);
+    *m = mutex;
+  }
+  pthread_mutex_t *mutex = (pthread_mutex_t*)*m;
+  pthread_mutex_unlock(&create_mutex);
+  pthread_mutex_lock(mutex);
+}
+
+void Fl_Posix_System_Driver::mutex_unlock(void *m) {
+  pthread_mutex_unlock((pthread_mutex_t*)m);
+}
+
+// Threads for run_parallel(): thread t calls func(data, i) for i = t,
+// t + nthreads, ... < count
+struct parallel_start {
+  void (*func)(void *, int);
+  void *data;
+  int first, step, count;
+};
+
+static void *parallel_start_cb(void *arg) {
+  parallel_start *start = (parallel_start *)arg;
+  for (int i = start->first; i < start->count; i += start->step)
+    start->func(start->data, i);
+  return NULL;
+}
+
+int Fl_Posix_System_Driver::parallel_count() {
+  long ncpu = 1;
+#ifdef _SC_NPROCESSORS_ONLN
+  ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+  return ncpu < 1 ? 1 : ncpu > 16 ? 16 : (int)ncpu;
+}
+
+void Fl_Posix_System_Driver::run_parallel(void (*func)(void *, int), void *data, int count) {
+  pthread_t threads[16];
+  parallel_start starts[16];
+  int nthreads = parallel_count();
+  if (count < nthreads) nthreads = count;
+  if (nthreads < 1) nthreads = 1;
+  int t, started = 1;
+  for (t = 0; t < nthreads; t++) {
+    starts[t].func = func;
+    starts[t].data = data;
+    starts[t].first = t;
+    starts[t].step = nthreads;
+    starts[t].count = count;
+  }
+  // Start threads 1 .. nthreads - 1, run the others' share if that fails
+  for (t = 1; t < nthreads; t++, started++) {
+    if (pthread_create(threads + t, NULL, parallel_start_cb, starts + t)) break;
+  }
+  for (t = started; t < nthreads; t++) parallel_start_cb(starts + t);
+  parallel_start_cb(starts);
+  for (t = 1; t < started; t++) pthread_join(threads[t], NULL);
+}
+
 #else // ! HAVE_PTHREAD
 
 void Fl_Posix_System_Driver::awake(void*) {}
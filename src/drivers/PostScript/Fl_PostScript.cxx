@@ -24,6 +24,7 @@
 #include <FL/Fl_PostScript.H>
 #include <FL/Fl_Native_File_Chooser.H>
 #include "../../Fl_System_Driver.H"
+#include "../../Fl_Data_Table.H"
 #include <FL/fl_string.h>
 #include <FL/platform.H>
 #include <stdarg.h>
@@ -118,6 +119,10 @@ static const double dashes_cap[5][7]={
 };
 #endif
 
+#if ! USE_PANGO
+uchar *(*Fl_PostScript_Graphics_Driver::deflate_hook)(const uchar *, size_t, size_t *) = NULL;
+#endif
+
 /**
  \brief The constructor.
  */
@@ -128,6 +133,12 @@ Fl_PostScript_Graphics_Driver::Fl_PostScript_Graphics_Driver(void)
   lang_level_ = 2;
 #if ! USE_PANGO
   mask = 0;
+  share_images_ = compress_images_ = flate_ = 0;
+  image_data_ = new Fl_Data_Table();
+  image_rle_ = NULL;
+  image_rle_alloc_ = 0;
+  inline_count_ = 0;
+  document_output_ = NULL;
 #endif
   ps_filename_ = NULL;
   scale_x = scale_y = 1.;
@@ -138,6 +149,10 @@ Fl_PostScript_Graphics_Driver::Fl_PostScript_Graphics_Driver(void)
 /** \brief The destructor. */
 Fl_PostScript_Graphics_Driver::~Fl_PostScript_Graphics_Driver() {
   if(ps_filename_) free(ps_filename_);
+#if ! USE_PANGO
+  delete image_data_;
+  free(image_rle_);
+#endif
 }
 
 
@@ -170,9 +185,8 @@ void Fl_PostScript_Graphics_Driver::font(int f, int s) {
   this->font_descriptor(desc);
 #if ! USE_PANGO
   if (f < FL_FREE_FONT) {
-    fprintf(output, "/%s SF\n" , _fontNames[f]);
     float ps_size = driver.scale_font_for_PostScript(desc, s);
-    clocale_printf("%.1f FS\n", ps_size);
+    clocale_printf("/%s SF\n%.1f FS\n", _fontNames[f], ps_size);
   }
 #endif
 }
@@ -332,7 +346,10 @@ static const char * prolog =
 "/GL { setgray } bind def\n"
 "/SRGB { setrgbcolor } bind def\n"
 
-"/A85RLE { /ASCII85Decode filter /RunLengthDecode filter } bind def\n" // ASCII85Decode followed by RunLengthDecode filters
+// sources of image data and mask data: ASCII85Decode followed by the DEC filter,
+// redefined to draw image data stored in FLres
+"/IDS { currentfile /ASCII85Decode filter DEC } bind def\n"
+"/MDS { currentfile /ASCII85Decode filter DEC } bind def\n"
 
 //  color images
 
@@ -340,7 +357,7 @@ static const char * prolog =
 "translate \n"
 "sx sy scale px py 8 \n"
 "[ px 0 0 py neg 0 py ]\n"
-"currentfile A85RLE\n false 3"
+"IDS\n false 3"
 " colorimage GR\n"
 "} bind def\n"
 
@@ -352,7 +369,7 @@ static const char * prolog =
 
 
 "[ px 0 0 py neg 0 py ]\n"
-"currentfile A85RLE\n"
+"IDS\n"
 "image GR\n"
 "} bind def\n"
 
@@ -362,7 +379,7 @@ static const char * prolog =
 "translate \n"
 "sx sy scale px py true \n"
 "[ px 0 0 py neg 0 py ]\n"
-"currentfile A85RLE\n"
+"IDS\n"
 "imagemask GR\n"
 "} bind def\n"
 
@@ -413,7 +430,7 @@ static const char * prolog_2 =  // prolog relevant only if lang_level >1
 "/Height py def\n"
 "/BitsPerComponent 8 def\n"
 "/Interpolate inter def\n"
-"/DataSource currentfile A85RLE def\n"
+"/DataSource IDS def\n"
 "/MultipleDataSources false def\n"
 "/ImageMatrix [ px 0 0 py neg 0 py ] def\n"
 "/Decode [ 0 1 0 1 0 1 ] def\n"
@@ -433,7 +450,7 @@ static const char * prolog_2 =  // prolog relevant only if lang_level >1
 "/BitsPerComponent 8 def\n"
 
 "/Interpolate inter def\n"
-"/DataSource currentfile A85RLE def\n"
+"/DataSource IDS def\n"
 "/MultipleDataSources false def\n"
 "/ImageMatrix [ px 0 0 py neg 0 py ] def\n"
 "/Decode [ 0 1 ] def\n"
@@ -538,7 +555,7 @@ static const char * prolog_2_pixmap =  // prolog relevant only if lang_level ==
 "pixmap_w pixmap_h scale "
 "pixmap_sx pixmap_sy 8 "
 "pixmap_mat "
-"currentfile A85RLE "
+"IDS "
 "false 3 "
 "colorimage "
 "end "
@@ -556,7 +573,7 @@ static const char * prolog_2_pixmap =  // prolog relevant only if lang_level ==
 "pixmap_sx pixmap_sy\n"
 "true\n"
 "pixmap_mat\n"
-"currentfile A85RLE\n"
+"MDS\n"
 "imagemask\n"
 "GR\n"
 "} bind def\n"
@@ -578,7 +595,7 @@ static const char * prolog_3 = // prolog relevant only if lang_level >2
 "/Height py def\n"
 "/BitsPerComponent 8 def\n"
 "/Interpolate inter def\n"
-"/DataSource currentfile A85RLE def\n"
+"/DataSource IDS def\n"
 "/MultipleDataSources false def\n"
 "/ImageMatrix [ px 0 0 py neg 0 py ] def\n"
 
@@ -619,7 +636,7 @@ static const char * prolog_3 = // prolog relevant only if lang_level >2
 "/Height py def\n"
 "/BitsPerComponent 8 def\n"
 "/Interpolate inter def\n"
-"/DataSource currentfile A85RLE def\n"
+"/DataSource IDS def\n"
 "/MultipleDataSources false def\n"
 "/ImageMatrix [ px 0 0 py neg 0 py ] def\n"
 
@@ -649,6 +666,24 @@ static const char * prolog_3 = // prolog relevant only if lang_level >2
 "\n"
 ;
 
+static const char * prolog_images = // stored image data, see Fl_PostScript_image.cxx
+
+// FLres holds the image data
+"/FLres 64 dict def\n"
+
+// usage: key FLD <ASCII85 data>~>
+// reads the ASCII85 data into an array of strings stored in FLres under key
+"/FLD { currentfile /ASCII85Decode filter\n"
+"[ exch { dup 65535 string readstring { exch } { dup length string copy exch pop exit } ifelse } loop ]\n"
+"FLres 3 1 roll put } bind def\n"
+
+// usage: array RDS
+// makes a procedure returning the strings of the array one by one, then an empty string,
+// that is a data source for the DEC filter
+"/RDS { [ exch 0 ] [ exch { dup 1 get 1 index 0 get length lt\n"
+"{ dup 0 get 1 index 1 get get exch dup 1 get 1 add 1 exch put } { pop () } ifelse } /exec load ] cvx } bind def\n"
+;
+
 // end prolog
 
 int Fl_PostScript_Graphics_Driver::start_postscript (int pagecount,
@@ -673,14 +708,18 @@ int Fl_PostScript_Graphics_Driver::start_postscript (int pagecount,
     ph_ = Fl_Paged_Device::page_formats[format].height;
   }
 
+  flate_ = (compress_images_ && deflate_hook);
+  FILE *pages = share_images_ ? tmpfile() : NULL; // see buffer_pages()
   fputs("%!PS-Adobe-3.0\n", output);
   fputs("%%Creator: FLTK\n", output);
-  if (lang_level_>1)
-    fprintf(output, "%%%%LanguageLevel: %i\n" , lang_level_);
+  if (lang_level_>1) // the FlateDecode filter requires level 3
+    fprintf(output, "%%%%LanguageLevel: %i\n" , (flate_ && lang_level_ < 3) ? 3 : lang_level_);
   if ((pages_ = pagecount))
     fprintf(output, "%%%%Pages: %i\n", pagecount);
   else
     fputs("%%Pages: (atend)\n", output);
+  if (pages)
+    fputs("%%DocumentSuppliedResources: (atend)\n", output);
   fprintf(output, "%%%%BeginFeature: *PageSize %s\n", Fl_Paged_Device::page_formats[format].name );
   w = Fl_Paged_Device::page_formats[format].width;
   h = Fl_Paged_Device::page_formats[format].height;
@@ -704,12 +743,14 @@ int Fl_PostScript_Graphics_Driver::start_postscript (int pagecount,
     fputs("/CS { GS } bind def\n", output);
     fputs("/CR { GR } bind def\n", output);
   }
+  image_prolog();
   page_policy_ = 1;
 
 
   fputs("%%EndProlog\n",output);
   if (lang_level_ >= 2)
     fprintf(output,"<< /Policies << /Pagesize 1 >> >> setpagedevice\n");
+  if (pages) buffer_pages(pages);
 
   reset();
   nPages=0;
@@ -726,6 +767,7 @@ int Fl_PostScript_Graphics_Driver::start_eps (int width, int height) {
   time_t lt = time(NULL);
   fprintf(output,"%%%%CreationDate: %s", ctime(&lt)+4);
   lang_level_= 2;
+  flate_ = 0;
   fprintf(output, "%%%%LanguageLevel: 2\n");
   fputs("%%Pages: 1\n%%EndComments\n", output);
   fputs("%%BeginProlog\n", output);
@@ -740,6 +782,7 @@ int Fl_PostScript_Graphics_Driver::start_eps (int width, int height) {
   fputs(prolog_2_pixmap, output);
   fputs("/CS { GS } bind def\n", output);
   fputs("/CR { GR } bind def\n", output);
+  image_prolog();
   page_policy_ = 1;
   reset();
   nPages=0;
@@ -751,6 +794,13 @@ int Fl_PostScript_Graphics_Driver::start_eps (int width, int height) {
   return 0;
 }
 
+// writes the definitions used to send image data, see prolog_images
+void Fl_PostScript_Graphics_Driver::image_prolog() {
+  fprintf(output, "/DEC { /%s filter } bind def\n", flate_ ? "FlateDecode" : "RunLengthDecode");
+  fputs(prolog_images, output);
+  reset_image_data();
+}
+
 void Fl_PostScript_Graphics_Driver::recover(){
   color(cr_,cg_,cb_);
   line_style(linestyle_,linewidth_,linedash_);
@@ -791,6 +841,8 @@ void Fl_PostScript_Graphics_Driver::page(double pw, double ph, int media) {
     fprintf(output, "CR\nGR\nGR\nGR\nSP\nrestore\n");
   }
   ++nPages;
+  // image data stored in the page are lost by the restore at its end
+  if (!document_output_) reset_image_data();
   fprintf(output, "%%%%Page: %i %i\n" , nPages , nPages);
   fprintf(output, "%%%%PageBoundingBox: 0 0 %d %d\n", pw > ph ? (int)ph : (int)pw , pw > ph ? (int)pw : (int)ph);
   if (pw>ph){
@@ -851,14 +903,15 @@ void Fl_PostScript_Graphics_Driver::rect(int x, int y, int w, int h) {
   // fprintf(output, "GS\n");
   //  fprintf(output, "%i, %i, %i, %i R\n", x , y , w, h);
   //  fprintf(output, "GR\n");
-  fprintf(output, "GS\n");
-  fprintf(output,"BP\n");
-  fprintf(output, "%i %i MT\n", x , y);
-  fprintf(output, "%i %i LT\n", x+w-1 , y);
-  fprintf(output, "%i %i LT\n", x+w-1 , y+h-1);
-  fprintf(output, "%i %i LT\n", x , y+h-1);
-  fprintf(output, "ECP\n");
-  fprintf(output, "GR\n");
+  fprintf(output, "GS\n"
+          "BP\n"
+          "%i %i MT\n"
+          "%i %i LT\n"
+          "%i %i LT\n"
+          "%i %i LT\n"
+          "ECP\n"
+          "GR\n",
+          x, y, x+w-1, y, x+w-1, y+h-1, x, y+h-1);
 }
 
 void Fl_PostScript_Graphics_Driver::rectf(int x, int y, int w, int h) {
@@ -866,126 +919,134 @@ void Fl_PostScript_Graphics_Driver::rectf(int x, int y, int w, int h) {
 }
 
 void Fl_PostScript_Graphics_Driver::line(int x1, int y1, int x2, int y2) {
-  fprintf(output, "GS\n");
-  fprintf(output, "%i %i %i %i L\n", x1 , y1, x2 ,y2);
-  fprintf(output, "GR\n");
+  fprintf(output, "GS\n"
+          "%i %i %i %i L\n"
+          "GR\n",
+          x1, y1, x2, y2);
 }
 
 void Fl_PostScript_Graphics_Driver::line(int x0, int y0, int x1, int y1, int x2, int y2) {
-  fprintf(output, "GS\n");
-  fprintf(output,"BP\n");
-  fprintf(output, "%i %i MT\n", x0 , y0);
-  fprintf(output, "%i %i LT\n", x1 , y1);
-  fprintf(output, "%i %i LT\n", x2 , y2);
-  fprintf(output, "ELP\n");
-  fprintf(output, "GR\n");
+  fprintf(output, "GS\n"
+          "BP\n"
+          "%i %i MT\n"
+          "%i %i LT\n"
+          "%i %i LT\n"
+          "ELP\n"
+          "GR\n",
+          x0, y0, x1, y1, x2, y2);
 }
 
 void Fl_PostScript_Graphics_Driver::xyline(int x, int y, int x1, int y2, int x3){
-  fprintf(output, "GS\n");
-  fprintf(output,"BP\n");
-  fprintf(output, "%i %i MT\n", x , y );
-  fprintf(output, "%i %i LT\n", x1 , y );
-  fprintf(output, "%i %i LT\n", x1 , y2);
-  fprintf(output,"%i %i LT\n", x3 , y2);
-  fprintf(output, "ELP\n");
-  fprintf(output, "GR\n");
+  fprintf(output, "GS\n"
+          "BP\n"
+          "%i %i MT\n"
+          "%i %i LT\n"
+          "%i %i LT\n"
+          "%i %i LT\n"
+          "ELP\n"
+          "GR\n",
+          x, y, x1, y, x1, y2, x3, y2);
 }
 
 
 void Fl_PostScript_Graphics_Driver::xyline(int x, int y, int x1, int y2){
-
-  fprintf(output, "GS\n");
-  fprintf(output,"BP\n");
-  fprintf(output, "%i %i MT\n", x , y);
-  fprintf(output,"%i %i LT\n", x1 , y);
-  fprintf(output, "%i %i LT\n", x1 , y2 );
-  fprintf(output, "ELP\n");
-  fprintf(output, "GR\n");
+  fprintf(output, "GS\n"
+          "BP\n"
+          "%i %i MT\n"
+          "%i %i LT\n"
+          "%i %i LT\n"
+          "ELP\n"
+          "GR\n",
+          x, y, x1, y, x1, y2);
 }
 
 void Fl_PostScript_Graphics_Driver::xyline(int x, int y, int x1){
-  fprintf(output, "GS\n");
-  fprintf(output,"BP\n");
-  fprintf(output, "%i %i MT\n", x , y);
-  fprintf(output, "%i %i LT\n", x1 , y );
-  fprintf(output, "ELP\n");
-
-  fprintf(output, "GR\n");
+  fprintf(output, "GS\n"
+          "BP\n"
+          "%i %i MT\n"
+          "%i %i LT\n"
+          "ELP\n"
+          "GR\n",
+          x, y, x1, y);
 }
 
 void Fl_PostScript_Graphics_Driver::yxline(int x, int y, int y1, int x2, int y3){
-  fprintf(output, "GS\n");
-
-  fprintf(output,"BP\n");
-  fprintf(output,"%i %i MT\n", x , y);
-  fprintf(output, "%i %i LT\n", x , y1 );
-  fprintf(output, "%i %i LT\n", x2 , y1 );
-  fprintf(output , "%i %i LT\n", x2 , y3);
-  fprintf(output, "ELP\n");
-  fprintf(output, "GR\n");
+  fprintf(output, "GS\n"
+          "BP\n"
+          "%i %i MT\n"
+          "%i %i LT\n"
+          "%i %i LT\n"
+          "%i %i LT\n"
+          "ELP\n"
+          "GR\n",
+          x, y, x, y1, x2, y1, x2, y3);
 }
 
 void Fl_PostScript_Graphics_Driver::yxline(int x, int y, int y1, int x2){
-  fprintf(output, "GS\n");
-  fprintf(output,"BP\n");
-  fprintf(output, "%i %i MT\n", x , y);
-  fprintf(output, "%i %i LT\n", x , y1);
-  fprintf(output, "%i %i LT\n", x2 , y1);
-  fprintf(output, "ELP\n");
-  fprintf(output, "GR\n");
+  fprintf(output, "GS\n"
+          "BP\n"
+          "%i %i MT\n"
+          "%i %i LT\n"
+          "%i %i LT\n"
+          "ELP\n"
+          "GR\n",
+          x, y, x, y1, x2, y1);
 }
 
 void Fl_PostScript_Graphics_Driver::yxline(int x, int y, int y1){
-  fprintf(output, "GS\n");
-  fprintf(output,"BP\n");
-  fprintf(output, "%i %i MT\n", x , y);
-  fprintf(output, "%i %i LT\n", x , y1);
-  fprintf(output, "ELP\n");
-  fprintf(output, "GR\n");
+  fprintf(output, "GS\n"
+          "BP\n"
+          "%i %i MT\n"
+          "%i %i LT\n"
+          "ELP\n"
+          "GR\n",
+          x, y, x, y1);
 }
 
 void Fl_PostScript_Graphics_Driver::loop(int x0, int y0, int x1, int y1, int x2, int y2) {
-  fprintf(output, "GS\n");
-  fprintf(output,"BP\n");
-  fprintf(output, "%i %i MT\n", x0 , y0);
-  fprintf(output, "%i %i LT\n", x1 , y1);
-  fprintf(output, "%i %i LT\n", x2 , y2);
-  fprintf(output, "ECP\n");
-  fprintf(output, "GR\n");
+  fprintf(output, "GS\n"
+          "BP\n"
+          "%i %i MT\n"
+          "%i %i LT\n"
+          "%i %i LT\n"
+          "ECP\n"
+          "GR\n",
+          x0, y0, x1, y1, x2, y2);
 }
 
 void Fl_PostScript_Graphics_Driver::loop(int x0, int y0, int x1, int y1, int x2, int y2, int x3, int y3) {
-  fprintf(output, "GS\n");
-  fprintf(output,"BP\n");
-  fprintf(output, "%i %i MT\n", x0 , y0);
-  fprintf(output, "%i %i LT\n", x1 , y1);
-  fprintf(output, "%i %i LT\n", x2 , y2);
-  fprintf(output, "%i %i LT\n", x3 , y3);
-  fprintf(output, "ECP\n");
-  fprintf(output, "GR\n");
+  fprintf(output, "GS\n"
+          "BP\n"
+          "%i %i MT\n"
+          "%i %i LT\n"
+          "%i %i LT\n"
+          "%i %i LT\n"
+          "ECP\n"
+          "GR\n",
+          x0, y0, x1, y1, x2, y2, x3, y3);
 }
 
 void Fl_PostScript_Graphics_Driver::polygon(int x0, int y0, int x1, int y1, int x2, int y2) {
-  fprintf(output, "GS\n");
-  fprintf(output,"BP\n");
-  fprintf(output, "%i %i MT\n", x0 , y0);
-  fprintf(output,"%i %i LT\n", x1 , y1);
-  fprintf(output, "%i %i LT\n", x2 , y2);
-  fprintf(output, "EFP\n");
-  fprintf(output, "GR\n");
+  fprintf(output, "GS\n"
+          "BP\n"
+          "%i %i MT\n"
+          "%i %i LT\n"
+          "%i %i LT\n"
+          "EFP\n"
+          "GR\n",
+          x0, y0, x1, y1, x2, y2);
 }
 
 void Fl_PostScript_Graphics_Driver::polygon(int x0, int y0, int x1, int y1, int x2, int y2, int x3, int y3) {
-  fprintf(output, "GS\n");
-  fprintf(output,"BP\n");
-  fprintf(output, "%i %i MT\n", x0 , y0 );
-  fprintf(output, "%i %i LT\n", x1 , y1 );
-  fprintf(output, "%i %i LT\n", x2 , y2 );
-  fprintf(output, "%i %i LT\n", x3 , y3 );
-
-  fprintf(output, "EFP\n");
-  fprintf(output, "GR\n");
+  fprintf(output, "GS\n"
+          "BP\n"
+          "%i %i MT\n"
+          "%i %i LT\n"
+          "%i %i LT\n"
+          "%i %i LT\n"
+          "EFP\n"
+          "GR\n",
+          x0, y0, x1, y1, x2, y2, x3, y3);
 }
 
 void Fl_PostScript_Graphics_Driver::line_style(int style, int width, char* dashes){
@@ -1006,22 +1067,17 @@ void Fl_PostScript_Graphics_Driver::line_style(int style, int width, char* dashe
     width0=1;
   }
 
-  fprintf(output, "%i setlinewidth\n", width);
-
   if(!style && (!dashes || !(*dashes)) && width0) //system lines
     style = FL_CAP_SQUARE;
 
   int cap = (style &0xf00) >> 8;
   if(cap) cap--;
-  fprintf(output,"%i setlinecap\n", cap);
 
   int join = (style & 0xf000) >> 12;
 
   if(join) join--;
-  fprintf(output,"%i setlinejoin\n", join);
-
+  fprintf(output, "%i setlinewidth\n%i setlinecap\n%i setlinejoin\n[", width, cap, join);
 
-  fprintf(output, "[");
   if(dashes && *dashes){
     while(*dashes){
       fprintf(output, "%i ", *dashes);
@@ -1043,7 +1099,7 @@ void Fl_PostScript_Graphics_Driver::line_style(int style, int width, char* dashe
       }
     }
   }
-  fprintf(output, "] 0 setdash\n");
+  fputs("] 0 setdash\n", output);
 }
 
 void Fl_PostScript_Graphics_Driver::color(unsigned char r, unsigned char g, unsigned char b) {
@@ -1138,19 +1194,23 @@ void Fl_PostScript_Graphics_Driver::transformed_draw_extra(const char* str, int
   delete[] img;
   // write the string image to PostScript as a scaled bitmask
   scale = w2 / float(w);
-  clocale_printf("%g %g %g %g %d %d MI\n", x, y - h*0.77/scale, w2/scale, h/scale, w2, h);
-  uchar *di;
   int wmask = (w2+7)/8;
-  void *rle85 = prepare_rle85();
-  for (int j = h - 1; j >= 0; j--){
-    di = img_mask + j * wmask;
-    for (int i = 0; i < wmask; i++){
-      write_rle85(*di, rle85);
-      di++;
-    }
-  }
-  close_rle85(rle85); fputc('\n', output);
+  size_t length = (size_t)h * wmask;
+  uchar *data = new uchar[length], *p = data;
+  for (int j = h - 1; j >= 0; j--, p += wmask) memcpy(p, img_mask + j * wmask, wmask);
   delete[] img_mask;
+  int id = image_data(data, length);
+  if (id != -1) {
+    fputs("save\n", output);
+    image_source("IDS", id);
+  }
+  clocale_printf("%g %g %g %g %d %d MI\n", x, y - h*0.77/scale, w2/scale, h/scale, w2, h);
+  if (id < 0) {
+    write_image_data(data, length);
+    fputc('\n', output);
+  }
+  if (id != -1) fputs("restore\n", output);
+  delete[] data;
 }
 
 static int is_in_table(unsigned utf) {
@@ -1208,7 +1268,8 @@ void Fl_PostScript_Graphics_Driver::transformed_draw(const char* str, int n, dou
       utf = code;
       }
     else { // unhandled character: draw all string as bitmap image
-      fprintf(output, "~> pop pop\n"); // close and ignore the opened hex string
+      close85(data);
+      fputs(" pop pop\n", output); // ignore the opened hex string
       transformed_draw_extra(str, n, x, y, w, false);
       return;
     }
@@ -1398,7 +1459,7 @@ void Fl_PostScript_Graphics_Driver::push_clip(int x, int y, int w, int h) {
   clip_box(x,y,w,h,c->x,c->y,c->w,c->h);
   c->prev=clip_;
   clip_=c;
-  fprintf(output, "CR\nCS\n");
+  fputs("CR\nCS\n", output);
   if(lang_level_<3)
     recover();
   clocale_printf("%g %g %i %i CL\n", clip_->x-0.5 , clip_->y-0.5 , clip_->w  , clip_->h);
@@ -1410,7 +1471,7 @@ void Fl_PostScript_Graphics_Driver::push_no_clip() {
   c->prev=clip_;
   clip_=c;
   clip_->x = clip_->y = clip_->w = clip_->h = -1;
-  fprintf(output, "CR\nCS\n");
+  fputs("CR\nCS\n", output);
   if(lang_level_<3)
     recover();
 }
@@ -1420,7 +1481,7 @@ void Fl_PostScript_Graphics_Driver::pop_clip() {
   Clip * c=clip_;
   clip_=clip_->prev;
   delete c;
-  fprintf(output, "CR\nCS\n");
+  fputs("CR\nCS\n", output);
   if(clip_ && clip_->w >0)
     clocale_printf("%g %g %i %i CL\n", clip_->x - 0.5, clip_->y - 0.5, clip_->w  , clip_->h);
   // uh, -0.5 is to match screen clipping, for floats there should be something beter
@@ -1652,17 +1713,20 @@ void Fl_PostScript_File_Device::end_job (void)
   g_object_unref(ps->pango_layout());
   if (!error) error = fflush(ps->output);
 #else
-  if (ps->nPages) {  // for eps nPages is 0 so it is fine ....
+  if (ps->nPages)  // for eps nPages is 0 so it is fine ....
     fprintf(ps->output, "CR\nGR\nGR\nGR\nSP\n restore\n");
-    if (!ps->pages_){
-      fprintf(ps->output, "%%%%Trailer\n");
-      fprintf(ps->output, "%%%%Pages: %i\n" , ps->nPages);
-    };
-  } else
+  else
     fprintf(ps->output, "GR\n restore\n");
+  int shared = (ps->document_output_ != NULL);
+  error = ps->write_buffered_pages();
+  if (ps->nPages) {
+    if (!ps->pages_ || shared) fprintf(ps->output, "%%%%Trailer\n");
+    if (!ps->pages_) fprintf(ps->output, "%%%%Pages: %i\n" , ps->nPages);
+    if (shared) ps->write_image_resources();
+  }
   fputs("%%EOF",ps->output);
   fflush(ps->output);
-  error = ferror(ps->output);
+  if (!error) error = ferror(ps->output);
   ps->reset();
 #endif
   while (ps->clip_){
@@ -1682,6 +1746,34 @@ void Fl_PostScript_File_Device::close_command(Fl_PostScript_Close_Command cmd) {
   driver()->close_command(cmd);
 }
 
+void Fl_PostScript_File_Device::share_images(int flag) {
+#if ! USE_PANGO
+  driver()->share_images_ = flag;
+#endif
+}
+
+int Fl_PostScript_File_Device::share_images() {
+#if USE_PANGO
+  return 0;
+#else
+  return driver()->share_images_;
+#endif
+}
+
+void Fl_PostScript_File_Device::compress_images(int flag) {
+#if ! USE_PANGO
+  driver()->compress_images_ = flag;
+#endif
+}
+
+int Fl_PostScript_File_Device::compress_images() {
+#if USE_PANGO
+  return 0;
+#else
+  return driver()->compress_images_;
+#endif
+}
+
 Fl_EPS_File_Surface::Fl_EPS_File_Surface(int width, int height, FILE *eps, Fl_Color background, Fl_PostScript_Close_Command closef) :
         Fl_Widget_Surface(new Fl_PostScript_Graphics_Driver()) {
   Fl_PostScript_Graphics_Driver *ps = driver();
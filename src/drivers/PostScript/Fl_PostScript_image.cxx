@@ -19,6 +19,7 @@
 
 #include <FL/Fl_PostScript.H>
 #include "Fl_PostScript_Graphics_Driver.H"
+#include "../../Fl_Data_Table.H"
 #include <FL/Fl.H>
 #include <FL/Fl_Pixmap.H>
 #include <FL/Fl_Bitmap.H>
@@ -76,7 +77,8 @@ struct struct85 {
   uchar bytes4[4]; // holds up to 4 input bytes
   int l4;          // # of unencoded input bytes
   int blocks;      // counter to insert newlines after 80 output characters
-  uchar chars5[5]; // holds 5 output characters
+  int count;       // # of output characters in buffer
+  uchar buffer[4096]; // output characters not yet written
 };
 
 
@@ -85,6 +87,7 @@ void *Fl_PostScript_Graphics_Driver::prepare85() // prepare to produce ASCII85-e
   struct85 *big = new struct85;
   big->l4 = 0;
   big->blocks = 0;
+  big->count = 0;
   return big;
 }
 
@@ -109,7 +112,7 @@ static int convert85(const uchar *bytes4, uchar *chars5)
 }
 
 
-void Fl_PostScript_Graphics_Driver::write85(void *data, const uchar *p, int len) // sends len input bytes for ASCII85 encoding
+void Fl_PostScript_Graphics_Driver::write85(void *data, const uchar *p, size_t len) // sends len input bytes for ASCII85 encoding
 {
   struct85 *big = (struct85 *)data;
   const uchar *last = p + len;
@@ -120,10 +123,13 @@ void Fl_PostScript_Graphics_Driver::write85(void *data, const uchar *p, int len)
     p += c;
     big->l4 += c;
     if (big->l4 == 4) {
-      c = convert85(big->bytes4, big->chars5);
-      fwrite(big->chars5, c, 1, output);
+      big->count += convert85(big->bytes4, big->buffer + big->count);
       big->l4 = 0;
-      if (++big->blocks >= 16) { fputc('\n', output); big->blocks = 0; }
+      if (++big->blocks >= 16) { big->buffer[big->count++] = '\n'; big->blocks = 0; }
+      if (big->count > int(sizeof(big->buffer)) - 6) { // no room for another block
+        fwrite(big->buffer, 1, big->count, output);
+        big->count = 0;
+      }
     }
   }
 }
@@ -132,14 +138,16 @@ void Fl_PostScript_Graphics_Driver::write85(void *data, const uchar *p, int len)
 void Fl_PostScript_Graphics_Driver::close85(void *data)  // stops ASCII85-encoding after processing remaining unencoded input bytes, if any
 {
   struct85 *big = (struct85 *)data;
-  int l;
   if (big->l4) { // # of remaining unencoded input bytes
-    l = big->l4;
+    int l = big->l4;
+    uchar chars5[5];
     while (l < 4) big->bytes4[l++] = 0; // complete them with 0s
-    l = convert85(big->bytes4, big->chars5); // encode them
-    if (l == 1) memset(big->chars5, '!', 5);
-    fwrite(big->chars5, big->l4 + 1, 1, output);
+    l = convert85(big->bytes4, chars5); // encode them
+    if (l == 1) memset(chars5, '!', 5);
+    memcpy(big->buffer + big->count, chars5, big->l4 + 1);
+    big->count += big->l4 + 1;
   }
+  fwrite(big->buffer, 1, big->count, output);
   fputs("~>", output); // write EOD mark
   delete big;
 }
@@ -230,6 +238,145 @@ void Fl_PostScript_Graphics_Driver::close_rle85(void *data) // stop doing RLE+AS
 // End of implementation of the /RunLengthEncode + /ASCII85Encode PostScript filter
 //
 
+/* The data of each image are stored in the FLres dictionary of the PostScript
+ interpreter (see FLD in the prolog) the first time they are drawn, and all
+ images with the same data are drawn from there (see IDS and RDS). By default
+ the data are stored in the page, and FLres is emptied by the restore at the
+ end of the page. If share_images_ is set, the pages are written to a temporary
+ file (see buffer_pages()) while the data are stored in the setup section of
+ the document as DSC resources, so that each image is sent only once and the
+ pages remain independent from each other. Data larger than max_stored_data
+ are sent inline with each image instead. Data streams are found in an
+ Fl_Data_Table, which keeps a copy of them.
+ */
+
+// larger image data are not kept in the memory of the PostScript interpreter
+static const size_t max_stored_data = 4 * 1024 * 1024;
+
+void Fl_PostScript_Graphics_Driver::reset_image_data() {
+  image_data_->clear();
+}
+
+// Returns the key in FLres of an image data stream, after storing it there if
+// it's sent for the first time, or -1 if the stream is to be sent inline, or -2
+// if it's to be sent inline run-length encoded because compressing it failed.
+int Fl_PostScript_Graphics_Driver::image_data(const uchar *data, size_t length) {
+  if (length > max_stored_data) {
+    if (!flate_ || inline_count_ >= 2) return -1;
+    Inline_Data &d = inline_data_[inline_count_++];
+    d.data = data;
+    d.deflated = deflated_data(data, length, &d.length);
+    return d.deflated ? -1 : -2;
+  }
+  Fl_Data_Table::Key key(data, length);
+  int id = image_data_->find(key);
+  if (id >= 0) return id;
+  id = image_data_->add(key);
+  size_t l;
+  uchar *z = deflated_data(data, length, &l);
+  if (id >= image_rle_alloc_) {
+    image_rle_alloc_ = image_rle_alloc_ ? 2 * image_rle_alloc_ : 64;
+    image_rle_ = (char*)realloc(image_rle_, image_rle_alloc_);
+  }
+  image_rle_[id] = (flate_ && !z);
+  FILE *page_output = output;
+  if (document_output_) {
+    output = document_output_;
+    fprintf(output, "%%%%BeginResource: file FLimage%d\n", id);
+  }
+  fprintf(output, "%d FLD\n", id);
+  write_encoded_data(data, length, z, l);
+  fputc('\n', output);
+  if (document_output_) {
+    fputs("%%EndResource\n", output);
+    output = page_output;
+  }
+  delete[] z;
+  return id;
+}
+
+// With share_images_, makes output the temporary file 'pages' receiving the pages,
+// so that image data can be written to the setup section of the document before them
+void Fl_PostScript_Graphics_Driver::buffer_pages(FILE *pages) {
+  fputs("%%BeginSetup\n", output);
+  document_output_ = output;
+  output = pages;
+}
+
+// Ends the setup section of the document and copies the pages there from the
+// temporary file of buffer_pages(), returns non-zero if that failed
+int Fl_PostScript_Graphics_Driver::write_buffered_pages() {
+  if (!document_output_) return 0;
+  FILE *pages = output;
+  output = document_output_;
+  document_output_ = NULL;
+  fputs("%%EndSetup\n", output);
+  int error = fflush(pages) || fseek(pages, 0, SEEK_SET);
+  char buffer[16384];
+  size_t n;
+  while (!error && (n = fread(buffer, 1, sizeof(buffer), pages)) > 0)
+    error = (fwrite(buffer, 1, n, output) != n);
+  if (ferror(pages)) error = 1;
+  fclose(pages);
+  return error;
+}
+
+// Lists the image data stored in the setup section, for the trailer of the document
+void Fl_PostScript_Graphics_Driver::write_image_resources() {
+  for (int i = 0; i < image_data_->count(); i++)
+    fprintf(output, "%s file FLimage%d\n", i ? "%%+" : "%%DocumentSuppliedResources:", i);
+}
+
+// Makes the data source name (IDS or MDS) read the data stored in FLres under key id,
+// or run-length encoded data sent inline if id is -2, until the next restore.
+// Does nothing if id is -1, that is if data are sent inline for the DEC filter.
+void Fl_PostScript_Graphics_Driver::image_source(const char *name, int id) {
+  const char *dec = (id == -2 || (id >= 0 && image_rle_[id])) ? "/RunLengthDecode filter" : "DEC";
+  if (id >= 0)
+    fprintf(output, "/%s { FLres %d get RDS %s } def\n", name, id, dec);
+  else if (id == -2)
+    fprintf(output, "/%s { currentfile /ASCII85Decode filter %s } def\n", name, dec);
+}
+
+// Returns the data compressed for the FlateDecode filter as a new[]'ed array, or NULL
+// if the document doesn't use it or if compression failed: the data are then
+// run-length encoded, and the data source must use the RunLengthDecode filter.
+uchar *Fl_PostScript_Graphics_Driver::deflated_data(const uchar *data, size_t length, size_t *deflated_length) {
+  *deflated_length = 0;
+  return flate_ ? deflate_hook(data, length, deflated_length) : NULL;
+}
+
+// Sends an image data stream ASCII85 encoded, either its deflated form or run-length encoded
+void Fl_PostScript_Graphics_Driver::write_encoded_data(const uchar *data, size_t length,
+                                                       const uchar *deflated, size_t deflated_length) {
+  if (deflated) {
+    void *big = prepare85();
+    write85(big, deflated, deflated_length);
+    close85(big);
+    return;
+  }
+  void *rle = prepare_rle85();
+  const uchar *e = data + length;
+  while (data < e) write_rle85(*data++, rle);
+  close_rle85(rle);
+}
+
+// Sends an image data stream inline, encoded as image_data() decided
+void Fl_PostScript_Graphics_Driver::write_image_data(const uchar *data, size_t length) {
+  for (int i = 0; i < inline_count_; i++) {
+    if (inline_data_[i].data != data) continue;
+    Inline_Data d = inline_data_[i];
+    inline_data_[i] = inline_data_[--inline_count_];
+    write_encoded_data(data, length, d.deflated, d.length);
+    delete[] d.deflated;
+    return;
+  }
+  size_t l;
+  uchar *z = deflated_data(data, length, &l);
+  write_encoded_data(data, length, z, l);
+  delete[] z;
+}
+
 
 int Fl_PostScript_Graphics_Driver::alpha_mask(const uchar * data, int w, int h, int D, int LD){
 
@@ -389,62 +536,37 @@ static inline uchar swap_byte(const uchar b) {
 void Fl_PostScript_Graphics_Driver::draw_image(Fl_Draw_Image_Cb call, void *data, int ix, int iy, int iw, int ih, int D) {
   double x = ix, y = iy, w = iw, h = ih;
 
-  int level2_mask = 0;
-  fprintf(output,"save\n");
+  int level2_mask = (mask && lang_level_ == 2); // use method for drawing masked color image with PostScript level 2
+  int interleave = (mask && lang_level_ > 2); // InterleaveType 2 mask data
   int i,j,k;
-  const char * interpol;
-  if (lang_level_ > 1) {
-    if (interpolate_) interpol="true";
-    else interpol="false";
-    if (mask && lang_level_ > 2) {
-      fprintf(output, "%g %g %g %g %i %i %i %i %s CIM\n", x , y+h , w , -h , iw , ih, mx, my, interpol);
-    }
-    else if (mask && lang_level_ == 2) {
-      level2_mask = 1; // use method for drawing masked color image with PostScript level 2
-      fprintf(output, " %g %g %g %g %d %d pixmap_plot\n", x, y, w, h, iw, ih);
-    }
-    else {
-      fprintf(output, "%g %g %g %g %i %i %s CII\n", x , y+h , w , -h , iw , ih, interpol);
-    }
-  } else {
-    fprintf(output , "%g %g %g %g %i %i CI", x , y+h , w , -h , iw , ih);
-  }
-
-  int LD=iw*abs(D);
-  uchar *rgbdata=new uchar[LD];
+  int mrow = (mx+7)/8, mlines = (mask ? my/ih : 0); // mask bytes per line, mask lines per image row
+
+  // compute the image data, and the mask data that follow them for level2_mask
+  size_t length = (size_t)iw * ih * 3, mlength = 0;
+  if (level2_mask) mlength = (size_t)ih * mlines * mrow;
+  else if (interleave) length += (size_t)ih * mlines * mrow;
+  uchar *rgbdata=new uchar[iw*abs(D)];
+  uchar *buf = new uchar[length + mlength], *p = buf;
   uchar *curmask=mask;
-  void *big = prepare_rle85();
 
   if (level2_mask) {
-    for (j = ih - 1; j >= 0; j--) { // output full image data
+    for (j = ih - 1; j >= 0; j--) { // full image data
       call(data, 0, j, iw, rgbdata);
       uchar *curdata = rgbdata;
       for (i=0 ; i<iw ; i++) {
-        write_rle85(curdata[0], big); write_rle85(curdata[1], big); write_rle85(curdata[2], big);
+        *p++ = curdata[0]; *p++ = curdata[1]; *p++ = curdata[2];
         curdata += D;
       }
     }
-    close_rle85(big); fputc('\n', output);
-    big = prepare_rle85();
-    for (j = ih - 1; j >= 0; j--) { // output mask data
-      curmask = mask + j * (my/ih) * ((mx+7)/8);
-      for (k=0; k < my/ih; k++) {
-        for (i=0; i < ((mx+7)/8); i++) {
-          write_rle85(swap_byte(*curmask), big);
-          curmask++;
-        }
-      }
+    for (j = ih - 1; j >= 0; j--) { // mask data
+      curmask = mask + j * mlines * mrow;
+      for (k=0; k < mlines * mrow; k++) *p++ = swap_byte(*curmask++);
     }
   }
   else {
     for (j=0; j<ih;j++) {
-      if (mask && lang_level_ > 2) {  // InterleaveType 2 mask data
-        for (k=0; k<my/ih;k++) { //for alpha pseudo-masking
-          for (i=0; i<((mx+7)/8);i++) {
-            write_rle85(swap_byte(*curmask), big);
-            curmask++;
-          }
-        }
+      if (interleave) {
+        for (k=0; k < mlines * mrow; k++) *p++ = swap_byte(*curmask++); //for alpha pseudo-masking
       }
       call(data,0,j,iw,rgbdata);
       uchar *curdata=rgbdata;
@@ -461,53 +583,62 @@ void Fl_PostScript_Graphics_Driver::draw_image(Fl_Draw_Image_Cb call, void *data
           b = (a2 * b + bg_b * a)/255;
         }
 
-        write_rle85(r, big); write_rle85(g, big); write_rle85(b, big);
+        *p++ = r; *p++ = g; *p++ = b;
         curdata +=D;
       }
-
     }
   }
-  close_rle85(big);
-  fprintf(output,"\nrestore\n");
   delete[] rgbdata;
+
+  int id = image_data(buf, length), mid = -1;
+  if (level2_mask) mid = image_data(buf + length, mlength);
+  fprintf(output,"save\n");
+  image_source("IDS", id);
+  image_source("MDS", mid);
+  const char * interpol;
+  if (lang_level_ > 1) {
+    if (interpolate_) interpol="true";
+    else interpol="false";
+    if (interleave) {
+      fprintf(output, "%g %g %g %g %i %i %i %i %s CIM\n", x , y+h , w , -h , iw , ih, mx, my, interpol);
+    }
+    else if (level2_mask) {
+      fprintf(output, " %g %g %g %g %d %d pixmap_plot\n", x, y, w, h, iw, ih);
+    }
+    else {
+      fprintf(output, "%g %g %g %g %i %i %s CII\n", x , y+h , w , -h , iw , ih, interpol);
+    }
+  } else {
+    fprintf(output , "%g %g %g %g %i %i CI", x , y+h , w , -h , iw , ih);
+  }
+  if (id < 0) {
+    write_image_data(buf, length);
+    fputc('\n', output);
+  }
+  if (level2_mask && mid < 0) {
+    write_image_data(buf + length, mlength);
+    fputc('\n', output);
+  }
+  fprintf(output,"restore\n");
+  delete[] buf;
 }
 
 void Fl_PostScript_Graphics_Driver::draw_image_mono(const uchar *data, int ix, int iy, int iw, int ih, int D, int LD) {
   double x = ix, y = iy, w = iw, h = ih;
 
-  fprintf(output,"save\n");
-
   int i,j, k;
 
-  const char * interpol;
-  if (lang_level_>1){
-    if (interpolate_)
-      interpol="true";
-    else
-      interpol="false";
-    if (mask && lang_level_>2)
-      fprintf(output, "%g %g %g %g %i %i %i %i %s GIM\n", x , y+h , w , -h , iw , ih, mx, my, interpol);
-    else
-      fprintf(output, "%g %g %g %g %i %i %s GII\n", x , y+h , w , -h , iw , ih, interpol);
-  }else
-    fprintf(output , "%g %g %g %g %i %i GI", x , y+h , w , -h , iw , ih);
-
-
   if (!LD) LD = iw*abs(D);
 
-
   int bg = (bg_r + bg_g + bg_b)/3;
+  int mrow = (mx+7)/8, mlines = (mask ? my/ih : 0); // mask bytes per line, mask lines per image row
 
+  size_t length = (size_t)ih * (iw + mlines * mrow);
+  uchar *buf = new uchar[length], *p = buf;
   uchar *curmask=mask;
-  void *big = prepare_rle85();
   for (j=0; j<ih;j++){
     if (mask){
-      for (k=0;k<my/ih;k++){
-        for (i=0; i<((mx+7)/8);i++){
-          write_rle85(swap_byte(*curmask), big);
-          curmask++;
-        }
-      }
+      for (k=0; k < mlines * mrow; k++) *p++ = swap_byte(*curmask++);
     }
     const uchar *curdata=data+j*LD;
     for (i=0 ; i<iw ; i++) {
@@ -518,13 +649,30 @@ void Fl_PostScript_Graphics_Driver::draw_image_mono(const uchar *data, int ix, i
         unsigned int a = 255-a2;
         r = (a2 * r + bg * a)/255;
       }
-      write_rle85(r, big);
+      *p++ = r;
       curdata +=D;
     }
 
   }
-  close_rle85(big);
+
+  int id = image_data(buf, length);
+  fprintf(output,"save\n");
+  image_source("IDS", id);
+  const char * interpol;
+  if (lang_level_>1){
+    if (interpolate_)
+      interpol="true";
+    else
+      interpol="false";
+    if (mask && lang_level_>2)
+      fprintf(output, "%g %g %g %g %i %i %i %i %s GIM\n", x , y+h , w , -h , iw , ih, mx, my, interpol);
+    else
+      fprintf(output, "%g %g %g %g %i %i %s GII\n", x , y+h , w , -h , iw , ih, interpol);
+  }else
+    fprintf(output , "%g %g %g %g %i %i GI", x , y+h , w , -h , iw , ih);
+  if (id < 0) write_image_data(buf, length);
   fprintf(output,"restore\n");
+  delete[] buf;
 }
 
 
@@ -532,8 +680,28 @@ void Fl_PostScript_Graphics_Driver::draw_image_mono(const uchar *data, int ix, i
 void Fl_PostScript_Graphics_Driver::draw_image_mono(Fl_Draw_Image_Cb call, void *data, int ix, int iy, int iw, int ih, int D) {
   double x = ix, y = iy, w = iw, h = ih;
 
-  fprintf(output,"save\n");
   int i,j,k;
+  int interleave = (mask && lang_level_>2); // InterleaveType 2 mask data
+  int mrow = (mx+7)/8, mlines = (interleave ? my/ih : 0); // mask bytes per line, mask lines per image row
+
+  size_t length = (size_t)ih * (iw + mlines * mrow);
+  uchar *rgbdata=new uchar[iw*D];
+  uchar *buf = new uchar[length], *p = buf;
+  uchar *curmask=mask;
+  for (j=0; j<ih;j++){
+    for (k=0; k < mlines * mrow; k++) *p++ = swap_byte(*curmask++); //for alpha pseudo-masking
+    call(data,0,j,iw,rgbdata);
+    uchar *curdata=rgbdata;
+    for (i=0 ; i<iw ; i++) {
+      *p++ = curdata[0];
+      curdata +=D;
+    }
+  }
+  delete[] rgbdata;
+
+  int id = image_data(buf, length);
+  fprintf(output,"save\n");
+  image_source("IDS", id);
   const char * interpol;
   if (lang_level_>1){
     if (interpolate_) interpol="true";
@@ -544,31 +712,9 @@ void Fl_PostScript_Graphics_Driver::draw_image_mono(Fl_Draw_Image_Cb call, void
       fprintf(output, "%g %g %g %g %i %i %s GII\n", x , y+h , w , -h , iw , ih, interpol);
   } else
     fprintf(output , "%g %g %g %g %i %i GI", x , y+h , w , -h , iw , ih);
-
-  int LD=iw*D;
-  uchar *rgbdata=new uchar[LD];
-  uchar *curmask=mask;
-  void *big = prepare_rle85();
-  for (j=0; j<ih;j++){
-
-    if (mask && lang_level_>2){  // InterleaveType 2 mask data
-      for (k=0; k<my/ih;k++){ //for alpha pseudo-masking
-        for (i=0; i<((mx+7)/8);i++){
-          write_rle85(swap_byte(*curmask), big);
-          curmask++;
-        }
-      }
-    }
-    call(data,0,j,iw,rgbdata);
-    uchar *curdata=rgbdata;
-    for (i=0 ; i<iw ; i++) {
-      write_rle85(curdata[0], big);
-      curdata +=D;
-    }
-  }
-  close_rle85(big);
+  if (id < 0) write_image_data(buf, length);
   fprintf(output,"restore\n");
-  delete[] rgbdata;
+  delete[] buf;
 }
 
 
@@ -609,16 +755,21 @@ void Fl_PostScript_Graphics_Driver::draw_bitmap(Fl_Bitmap * bitmap,int XP, int Y
   if (scale_for_image_(bitmap, XP, YP, WP, HP, cx, cy)) return;
   WP = bitmap->data_w(), HP = bitmap->data_h();
   const uchar * di = bitmap->array;
-  int i, j, xx = (WP+7)/8;
+  size_t i, length = (size_t)HP * ((WP+7)/8);
+  uchar *buf = new uchar[length];
+  for (i=0; i<length; i++) buf[i] = swap_byte(di[i]);
+  int id = image_data(buf, length);
+  if (id != -1) {
+    fprintf(output, "save\n");
+    image_source("IDS", id);
+  }
   fprintf(output , "%i %i %i %i %i %i MI\n", 0, HP, WP, -HP, WP, HP);
-  void *rle85 = prepare_rle85();
-  for (j=0; j<HP; j++){
-    for (i=0; i<xx; i++){
-      write_rle85(swap_byte(*di), rle85);
-      di++;
-    }
+  if (id < 0) {
+    write_image_data(buf, length);
+    fputc('\n', output);
   }
-  close_rle85(rle85); fputc('\n', output);
+  if (id != -1) fprintf(output, "restore\n");
+  delete[] buf;
   clocale_printf("GR GR\n");
   pop_clip(); // matches push_no_clip in scale_for_image_
 }
@@ -29,6 +29,7 @@
 #include <FL/Fl_Pixmap.H>
 #include <FL/Fl_Bitmap.H>
 #include <FL/fl_string.h>
+#include "../../Fl_Data_Table.H"
 #include <stdlib.h>
 
 extern "C" {
@@ -62,7 +63,26 @@ class Fl_SVG_Graphics_Driver : public Fl_Graphics_Driver {
   };
   Clip * clip_; // top of pile of clips
   int clip_count_; // to generate distinct SVG clip Ids
-  char *last_rgb_name_; // NULL or SVG Id of last defined RGB image
+  struct Image_Def { // an image defined in the SVG file, its SVG Id is FLimg<index>
+    int data_w, data_h, d; // size and depth of the pixels
+    int w, h; // drawing size
+  };
+  struct Image_Use { // an image object that was drawn with a definition
+    const void *image; // the Fl_Image
+    const void *array; // its pixels
+    fl_uintptr_t id; // its id in the display driver
+    Fl_Color color; // drawing color of bitmaps
+    int w, h; // drawing size
+    int def; // index of the definition
+    int next; // next use in the same hash bucket, or -1
+  };
+  Image_Def *image_defs_; // all images defined in the SVG file
+  int image_def_alloc_;
+  Fl_Data_Table image_pixels_; // pixels of each definition, by its index
+  Image_Use *image_uses_; // image objects drawn so far
+  int image_use_count_, image_use_alloc_;
+  int *image_use_bucket_; // first use of each hash bucket
+  int image_bucket_count_; // # of hash buckets of uses, a power of 2
   const char *family_;
   const char *bold_;
   const char *style_;
@@ -93,8 +113,13 @@ protected:
   int height() ;
   int descent() ;
   void draw_rgb(Fl_RGB_Image *rgb, int XP, int YP, int WP, int HP, int cx, int cy);
-  void define_rgb_png(Fl_RGB_Image *rgb, const char *name, int x, int y);
-  void define_rgb_jpeg(Fl_RGB_Image *rgb, const char *name, int x, int y);
+  void define_rgb_png(Fl_RGB_Image *rgb, const char *name);
+  void define_rgb_jpeg(Fl_RGB_Image *rgb, const char *name);
+  void rehash_images();
+  int find_image_use(Fl_Image *img, fl_uintptr_t id, Fl_Color c);
+  void add_image_use(Fl_Image *img, fl_uintptr_t id, Fl_Color c, int def);
+  int image_def(Fl_RGB_Image *rgb, bool jpeg);
+  void use_image(int def, Fl_Image *img, int XP, int YP, int WP, int HP, int cx, int cy);
   void draw_pixmap(Fl_Pixmap *pxm,int XP, int YP, int WP, int HP, int cx, int cy);
   void draw_bitmap(Fl_Bitmap *bm,int XP, int YP, int WP, int HP, int cx, int cy);
   void draw_image(const uchar* buf, int x, int y, int w, int h, int d, int l);
@@ -138,7 +163,12 @@ Fl_SVG_Graphics_Driver::Fl_SVG_Graphics_Driver(FILE *f) {
   dasharray_ = fl_strdup("none");
   p_size = 0;
   p = NULL;
-  last_rgb_name_ = NULL;
+  image_defs_ = NULL;
+  image_def_alloc_ = 0;
+  image_uses_ = NULL;
+  image_use_count_ = image_use_alloc_ = 0;
+  image_bucket_count_ = 0;
+  image_use_bucket_ = NULL;
 }
 
 Fl_SVG_Graphics_Driver::~Fl_SVG_Graphics_Driver()
@@ -150,7 +180,9 @@ Fl_SVG_Graphics_Driver::~Fl_SVG_Graphics_Driver()
     clip_= clip_->prev;
     delete c;
   }
-  if (last_rgb_name_) free(last_rgb_name_);
+  free(image_defs_);
+  free(image_uses_);
+  delete[] image_use_bucket_;
 }
 
 void Fl_SVG_Graphics_Driver::rect(int x, int y, int w, int h) {
@@ -377,27 +409,38 @@ struct svg_base64_t { // holds data useful to perform base64-encoding of a strea
   int lline; // follows length of current line in svg file
   uchar buff[3]; // holds up to 3 bytes that still need encoding
   int lbuf; // # of valid bytes in buff
+  char out[4096]; // encoded characters not yet written to svg
+  int lout; // # of valid characters in out
 };
 
+// Writes the encoded characters to the output FILE.
+static void flush_base64(svg_base64_t *svg_base64) {
+  if (svg_base64->lout) fwrite(svg_base64->out, 1, svg_base64->lout, svg_base64->svg);
+  svg_base64->lout = 0;
+}
+
 // Performs base64 encoding of up to 3 bytes.
 // To be called successively with 3 consecutive bytes (l=3),
 // and possibly with l=1 or l=2 only at the end of the byte stream.
-// Always writes 4 printable characters to the output FILE.
+// Always writes 4 printable characters to the output buffer.
 static void to_base64(uchar *p, int l, svg_base64_t *svg_base64) {
   static char base64_table[] =
     "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
   uchar B0 = *p++;
   uchar B1 = (l == 1 ? 0 : *p++);
   uchar B2 = (l <= 2 ? 0 : *p);
-  fputc(base64_table[ B0 >> 2 ], svg_base64->svg);
-  fputc(base64_table[ ((B0 & 0x3) << 4) + (B1 >> 4) ], svg_base64->svg);
-  fputc( (l == 1 ? '=' : base64_table[ ((B1 & 0xF) << 2) + (B2 >> 6) ]), svg_base64->svg );
-  fputc( (l < 3 ? '=' : base64_table[ B2 & 0x3F ]), svg_base64->svg );
+  if (svg_base64->lout > (int)sizeof(svg_base64->out) - 5) flush_base64(svg_base64);
+  char *o = svg_base64->out + svg_base64->lout;
+  *o++ = base64_table[ B0 >> 2 ];
+  *o++ = base64_table[ ((B0 & 0x3) << 4) + (B1 >> 4) ];
+  *o++ = (l == 1 ? '=' : base64_table[ ((B1 & 0xF) << 2) + (B2 >> 6) ]);
+  *o++ = (l < 3 ? '=' : base64_table[ B2 & 0x3F ]);
   svg_base64->lline += 4;
   if (svg_base64->lline >= 80) {
-    fputc('\n', svg_base64->svg);
+    *o++ = '\n';
     svg_base64->lline = 0;
   }
+  svg_base64->lout = (int)(o - svg_base64->out);
 }
 
 // Writes to the svg file, in base64-encoded form, a block of length bytes.
@@ -439,6 +482,8 @@ static void user_write_data(png_structp png_ptr, png_bytep data, png_size_t leng
 static void user_flush_data(png_structp png_ptr) {
   svg_base64_t *svg_base64_data = (svg_base64_t*)png_get_io_ptr(png_ptr);
   if (svg_base64_data->lbuf) to_base64(svg_base64_data->buff, svg_base64_data->lbuf, svg_base64_data);
+  svg_base64_data->lbuf = 0;
+  flush_base64(svg_base64_data);
 }
 
 /* How to define first the image data and next use it, possibly several times:
@@ -459,7 +504,7 @@ AxhQP6QxgAEM+LYBf9sdYcTRmp6pAAAAAElFTkSuQmCCAAAAAElFTkSuQmCC"/>
  AxhQP6QxgAEM+LYBf9sdYcTRmp6pAAAAAElFTkSuQmCCAAAAAElFTkSuQmCC"/>
  */
 
-void Fl_SVG_Graphics_Driver::define_rgb_png(Fl_RGB_Image *rgb, const char *name, int x, int y) {
+void Fl_SVG_Graphics_Driver::define_rgb_png(Fl_RGB_Image *rgb, const char *name) {
   png_structp png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
   if (!png_ptr) return;
   png_infop info_ptr = png_create_info_struct(png_ptr);
@@ -467,13 +512,8 @@ void Fl_SVG_Graphics_Driver::define_rgb_png(Fl_RGB_Image *rgb, const char *name,
     png_destroy_write_struct(&png_ptr, (png_infopp)NULL);
     return;
   }
-  if (name) {
-    if (last_rgb_name_) free(last_rgb_name_);
-    last_rgb_name_ = fl_strdup(name);
-  }
   float f = rgb->data_w() > rgb->data_h() ? float(rgb->w()) / rgb->data_w(): float(rgb->h()) / rgb->data_h();
-  if (name) fprintf(out_, "<defs><image id=\"%s\" ", name);
-  else fprintf(out_, "<image x=\"%d\" y=\"%d\" ", x, y);
+  fprintf(out_, "<defs><image id=\"%s\" ", name);
   fprintf(out_, "width=\"%f\" height=\"%f\" href=\"data:image/png;base64,\n", f*rgb->data_w(), f*rgb->data_h());
   // Transforms the image into a stream of bytes in PNG format,
   // base64-encode this byte stream, and outputs the result to the svg FILE.
@@ -481,6 +521,7 @@ void Fl_SVG_Graphics_Driver::define_rgb_png(Fl_RGB_Image *rgb, const char *name,
   svg_base64_data.svg = out_;
   svg_base64_data.lline = 0;
   svg_base64_data.lbuf = 0;
+  svg_base64_data.lout = 0;
   // user_write_data is a function repetitively called by libpng which receives blocks of bytes.
   png_set_write_fn(png_ptr, &svg_base64_data, user_write_data, user_flush_data);
   int color_type;
@@ -508,8 +549,7 @@ void Fl_SVG_Graphics_Driver::define_rgb_png(Fl_RGB_Image *rgb, const char *name,
   user_flush_data(png_ptr);
   png_destroy_write_struct(&png_ptr, &info_ptr);
   delete[] row_pointers;
-  if (name) fputs("\"/></defs>\n", out_);
-  else fputs("\"/>\n", out_);
+  fputs("\"/></defs>\n", out_);
 }
 
 #endif // HAVE_LIBPNG
@@ -555,14 +595,9 @@ static void term_destination(jpeg_compress_struct *cinfo) {
   }
 }
 
-void Fl_SVG_Graphics_Driver::define_rgb_jpeg(Fl_RGB_Image *rgb, const char *name, int x, int y) {
-  if (name) {
-    if (last_rgb_name_) free(last_rgb_name_);
-    last_rgb_name_ = fl_strdup(name);
-  }
+void Fl_SVG_Graphics_Driver::define_rgb_jpeg(Fl_RGB_Image *rgb, const char *name) {
   float f = rgb->data_w() > rgb->data_h() ? float(rgb->w()) / rgb->data_w(): float(rgb->h()) / rgb->data_h();
-  if (name) fprintf(out_, "<defs><image id=\"%s\" ", name);
-  else fprintf(out_, "<image x=\"%d\" y=\"%d\" ", x, y);
+  fprintf(out_, "<defs><image id=\"%s\" ", name);
   fprintf(out_, "width=\"%f\" height=\"%f\" href=\"data:image/jpeg;base64,\n", f*rgb->data_w(), f*rgb->data_h());
   // Transforms the image into a stream of bytes in JPEG format,
   // base64-encode this byte stream, and outputs the result to the svg FILE.
@@ -586,6 +621,7 @@ void Fl_SVG_Graphics_Driver::define_rgb_jpeg(Fl_RGB_Image *rgb, const char *name
   jpeg_client_data.base64_data.svg = out_;
   jpeg_client_data.base64_data.lline = 0;
   jpeg_client_data.base64_data.lbuf = 0;
+  jpeg_client_data.base64_data.lout = 0;
   jpeg_start_compress(&cinfo, TRUE);
   int ld = rgb->ld() ? rgb->ld() : rgb->data_w() * rgb->d();
   JSAMPROW row_pointer[1];
@@ -595,62 +631,136 @@ void Fl_SVG_Graphics_Driver::define_rgb_jpeg(Fl_RGB_Image *rgb, const char *name
   }
   jpeg_finish_compress(&cinfo);
   jpeg_destroy_compress(&cinfo);
-  if (name) fputs("\"/></defs>\n", out_);
-  else fputs("\"/>\n", out_);
+  flush_base64(&jpeg_client_data.base64_data);
+  fputs("\"/></defs>\n", out_);
 }
 #endif // HAVE_LIBJPEG
 
-void Fl_SVG_Graphics_Driver::draw_rgb(Fl_RGB_Image *rgb, int XP, int YP, int WP, int HP, int cx, int cy) {
-#if defined(HAVE_LIBPNG)
+/* Images are defined once in the SVG file and drawn with <use> elements.
+ A definition is found by the pixels of the image (see Fl_Data_Table), so that
+ images with the same pixels and drawing size share a definition. An image
+ object that was drawn before is found by its address, pixel array, id in
+ the display driver and, for bitmaps, the drawing color, without computing
+ the pixels and their hash again. Temporary images, which have no id in
+ the display driver, are always found by their pixels.
+ */
+
+void Fl_SVG_Graphics_Driver::rehash_images() {
+  image_bucket_count_ = image_bucket_count_ ? 2 * image_bucket_count_ : 64;
+  delete[] image_use_bucket_;
+  image_use_bucket_ = new int[image_bucket_count_];
+  int mask = image_bucket_count_ - 1, i;
+  for (i = 0; i < image_bucket_count_; i++) image_use_bucket_[i] = -1;
+  for (i = 0; i < image_use_count_; i++) {
+    int b = (int)(((fl_uintptr_t)image_uses_[i].image >> 4) & mask);
+    image_uses_[i].next = image_use_bucket_[b];
+    image_use_bucket_[b] = i;
+  }
+}
+
+// Returns the definition used by image img before, or -1.
+int Fl_SVG_Graphics_Driver::find_image_use(Fl_Image *img, fl_uintptr_t id, Fl_Color c) {
+  if (!id || !image_bucket_count_) return -1;
+  const void *array = img->data() ? (const void*)img->data()[0] : NULL;
+  int b = (int)(((fl_uintptr_t)img >> 4) & (image_bucket_count_ - 1));
+  for (int i = image_use_bucket_[b]; i >= 0; i = image_uses_[i].next) {
+    Image_Use &u = image_uses_[i];
+    if (u.image == img && u.array == array && u.id == id && u.color == c &&
+        u.w == img->w() && u.h == img->h()) return u.def;
+  }
+  return -1;
+}
+
+// Remembers that image img was drawn with definition def.
+void Fl_SVG_Graphics_Driver::add_image_use(Fl_Image *img, fl_uintptr_t id, Fl_Color c, int def) {
+  if (!id) return;
+  if (image_use_count_ >= image_use_alloc_) {
+    image_use_alloc_ = image_use_alloc_ ? 2 * image_use_alloc_ : 16;
+    image_uses_ = (Image_Use*)realloc(image_uses_, image_use_alloc_ * sizeof(Image_Use));
+  }
+  if (image_use_count_ >= image_bucket_count_) rehash_images();
+  Image_Use &u = image_uses_[image_use_count_];
+  u.image = img;
+  u.array = img->data() ? (const void*)img->data()[0] : NULL;
+  u.id = id;
+  u.color = c;
+  u.w = img->w();
+  u.h = img->h();
+  u.def = def;
+  int b = (int)(((fl_uintptr_t)img >> 4) & (image_bucket_count_ - 1));
+  u.next = image_use_bucket_[b];
+  image_use_bucket_[b] = image_use_count_++;
+}
+
+// Returns the definition of the pixels of rgb, writes it if it's a new one.
+int Fl_SVG_Graphics_Driver::image_def(Fl_RGB_Image *rgb, bool jpeg) {
+  int dw = rgb->data_w(), dh = rgb->data_h(), d = rgb->d();
+  int ld = rgb->ld() ? rgb->ld() : dw * d;
+  Fl_Data_Table::Key key(rgb->array, dw * d, dh, ld);
+  for (int i = -1; (i = image_pixels_.find(key, i)) >= 0; ) {
+    Image_Def &f = image_defs_[i];
+    if (f.data_w == dw && f.data_h == dh && f.d == d && f.w == rgb->w() && f.h == rgb->h())
+      return i;
+  }
+  int n = image_pixels_.count();
+  if (n >= image_def_alloc_) {
+    image_def_alloc_ = image_def_alloc_ ? 2 * image_def_alloc_ : 16;
+    image_defs_ = (Image_Def*)realloc(image_defs_, image_def_alloc_ * sizeof(Image_Def));
+  }
+  image_pixels_.add(key);
+  Image_Def &f = image_defs_[n];
+  f.data_w = dw; f.data_h = dh; f.d = d;
+  f.w = rgb->w(); f.h = rgb->h();
   char name[24];
-  bool need_clip = (cx || cy || WP != rgb->w() || HP != rgb->h());
-  void *p = (void*)*Fl_Graphics_Driver::id(rgb);
-  if (p) sprintf(name, "FLrgb%p", p); else name[0] = 0;
-  if (!p || !last_rgb_name_ || strcmp(name, last_rgb_name_) != 0) {
-    if (*name==0 && need_clip) push_clip(XP, YP, WP, HP);
+  sprintf(name, "FLimg%d", n);
+#if defined(HAVE_LIBPNG)
 #if defined(HAVE_LIBJPEG)
-    if (rgb->d() == 3 || rgb->d() == 1) define_rgb_jpeg(rgb, *name ? name : NULL, XP-cx, YP-cy);
-    else
+  if (jpeg) define_rgb_jpeg(rgb, name);
+  else
 #endif // HAVE_LIBJPEG
-      define_rgb_png(rgb, *name ? name : NULL, XP-cx, YP-cy);
-    if (*name==0 && need_clip) pop_clip();
-  }
-  if (*name) {
-    if (need_clip) push_clip(XP, YP, WP, HP);
-    fprintf(out_, "<use href=\"#%s\" x=\"%d\" y=\"%d\"/>\n", last_rgb_name_, XP-cx, YP-cy);
-    if (need_clip) pop_clip();
+    define_rgb_png(rgb, name);
+#endif // HAVE_LIBPNG
+  return n;
+}
+
+void Fl_SVG_Graphics_Driver::use_image(int def, Fl_Image *img, int XP, int YP, int WP, int HP, int cx, int cy) {
+  bool need_clip = (cx || cy || WP != img->w() || HP != img->h());
+  if (need_clip) push_clip(XP, YP, WP, HP);
+  fprintf(out_, "<use href=\"#FLimg%d\" x=\"%d\" y=\"%d\"/>\n", def, XP-cx, YP-cy);
+  if (need_clip) pop_clip();
+}
+
+void Fl_SVG_Graphics_Driver::draw_rgb(Fl_RGB_Image *rgb, int XP, int YP, int WP, int HP, int cx, int cy) {
+#if defined(HAVE_LIBPNG)
+  fl_uintptr_t id = *Fl_Graphics_Driver::id(rgb);
+  int def = find_image_use(rgb, id, 0);
+  if (def < 0) {
+    def = image_def(rgb, rgb->d() == 3 || rgb->d() == 1);
+    add_image_use(rgb, id, 0, def);
   }
+  use_image(def, rgb, XP, YP, WP, HP, cx, cy);
 #endif // HAVE_LIBPNG
 }
 
 void Fl_SVG_Graphics_Driver::draw_pixmap(Fl_Pixmap *pxm, int XP, int YP, int WP, int HP, int cx, int cy) {
 #if defined(HAVE_LIBPNG)
-  char name[24];
-  bool need_clip = (cx || cy || WP != pxm->w() || HP != pxm->h());
-  void *p = (void*)*Fl_Graphics_Driver::id(pxm);
-  if (p) sprintf(name, "FLpx%p", p); else name[0] = 0;
-  if (!p || !last_rgb_name_ || strcmp(name, last_rgb_name_) != 0) {
+  fl_uintptr_t id = *Fl_Graphics_Driver::id(pxm);
+  int def = find_image_use(pxm, id, 0);
+  if (def < 0) {
     Fl_RGB_Image *rgb = new Fl_RGB_Image(pxm);
-    if (*name==0 && need_clip) push_clip(XP, YP, WP, HP);
-    define_rgb_png(rgb, *name ? name : NULL, XP-cx, YP-cy);
-    if (*name==0 && need_clip) pop_clip();
+    def = image_def(rgb, false);
     delete rgb;
+    add_image_use(pxm, id, 0, def);
   }
-  if (*name) {
-    if (need_clip) push_clip(XP, YP, WP, HP);
-    fprintf(out_, "<use href=\"#%s\" x=\"%d\" y=\"%d\"/>\n", last_rgb_name_, XP-cx, YP-cy);
-    if (need_clip) pop_clip();
-  }
+  use_image(def, pxm, XP, YP, WP, HP, cx, cy);
 #endif // HAVE_LIBPNG
 }
 
 void Fl_SVG_Graphics_Driver::draw_bitmap(Fl_Bitmap *bm, int XP, int YP, int WP, int HP, int cx, int cy) {
 #if defined(HAVE_LIBPNG)
-  char name[45];
-  bool need_clip = (cx || cy || WP != bm->w() || HP != bm->h());
-  void *p = (void*)*Fl_Graphics_Driver::id(bm);
-  if (p) sprintf(name, "FLbm%p%X", p, fl_color()); else name[0] = 0;
-  if (!p || !last_rgb_name_ || strcmp(name, last_rgb_name_) != 0) {
+  fl_uintptr_t id = *Fl_Graphics_Driver::id(bm);
+  int def = find_image_use(bm, id, fl_color());
+  if (def < 0) {
     uchar R, G, B;
     Fl::get_color(fl_color(), R, G, B);
     uchar *data = new uchar[bm->data_w() * bm->data_h() * 4];
@@ -673,16 +783,11 @@ void Fl_SVG_Graphics_Driver::draw_bitmap(Fl_Bitmap *bm, int XP, int YP, int WP,
         p++;
       }
     }
-    if (*name==0 && need_clip) push_clip(XP, YP, WP, HP);
-    define_rgb_png(rgb, *name ? name : NULL, XP-cx, YP-cy);
-    if (*name==0 && need_clip) pop_clip();
+    def = image_def(rgb, false);
     delete rgb;
+    add_image_use(bm, id, fl_color(), def);
   }
-  if (*name) {
-    if (need_clip) push_clip(XP, YP, WP, HP);
-    fprintf(out_, "<use href=\"#%s\" x=\"%d\" y=\"%d\"/>\n", last_rgb_name_, XP-cx, YP-cy);
-    if (need_clip) pop_clip();
-  }
+  use_image(def, bm, XP, YP, WP, HP, cx, cy);
 #endif // HAVE_LIBPNG
 }
 
@@ -58,7 +58,6 @@ inline int isdirsep(char c) { return c == '/' || c == '\\'; }
 
 static wchar_t *mbwbuf = NULL;
 static wchar_t *wbuf = NULL;
-static wchar_t *wbuf1 = NULL;
 
 extern "C" {
   int fl_scandir(const char *dirname, struct dirent ***namelist,
@@ -108,6 +107,33 @@ static wchar_t *utf8_to_wchar(const char *utf8, wchar_t *&wbuf, int lg = -1) {
   return wbuf;
 }
 
+/*
+  Filename converted to Windows wide character encoding (UTF-16) for the
+  duration of one call.
+
+  Unlike utf8_to_wchar() with the shared buffer 'wbuf' this
+  is thread-safe: the file functions below are also called by the worker
+  threads of Fl_Shared_Image::get_async(), Fl_Preferences and
+  Fl_File_Browser. Names up to MAX_PATH characters are converted on the
+  stack, longer names are allocated and freed by the destructor.
+*/
+class Fl_Wide_Filename {
+  wchar_t local_[MAX_PATH];
+  wchar_t *buf_;
+public:
+  Fl_Wide_Filename(const char *utf8, int lg = -1) {
+    unsigned len = (lg >= 0) ? (unsigned)lg : (unsigned)strlen(utf8);
+    unsigned wn = fl_utf8toUtf16(utf8, len, NULL, 0) + 1; // Query length
+    buf_ = (wn <= MAX_PATH) ? local_ : (wchar_t *)malloc(sizeof(wchar_t) * wn);
+    wn = fl_utf8toUtf16(utf8, len, (unsigned short *)buf_, wn); // Convert string
+    buf_[wn] = 0;
+  }
+  ~Fl_Wide_Filename() {
+    if (buf_ != local_) free(buf_);
+  }
+  const wchar_t *str() const { return buf_; }
+};
+
 /*
   Convert a Windows wide character (UTF-16) string to UTF-8 encoding.
 
@@ -206,9 +232,9 @@ int Fl_WinAPI_System_Driver::putenv(const char *var) {
 }
 
 int Fl_WinAPI_System_Driver::open(const char *fnam, int oflags, int pmode) {
-  utf8_to_wchar(fnam, wbuf);
-  if (pmode == -1) return _wopen(wbuf, oflags);
-  else return _wopen(wbuf, oflags, pmode);
+  Fl_Wide_Filename wnam(fnam);
+  if (pmode == -1) return _wopen(wnam.str(), oflags);
+  else return _wopen(wnam.str(), oflags, pmode);
 }
 
 int Fl_WinAPI_System_Driver::open_ext(const char *fnam, int binary, int oflags, int pmode) {
@@ -218,9 +244,8 @@ int Fl_WinAPI_System_Driver::open_ext(const char *fnam, int binary, int oflags,
 }
 
 FILE *Fl_WinAPI_System_Driver::fopen(const char *fnam, const char *mode) {
-  utf8_to_wchar(fnam, wbuf);
-  utf8_to_wchar(mode, wbuf1);
-  return _wfopen(wbuf, wbuf1);
+  Fl_Wide_Filename wnam(fnam), wmode(mode);
+  return _wfopen(wnam.str(), wmode.str());
 }
 
 int Fl_WinAPI_System_Driver::system(const char *cmd) {
@@ -245,11 +270,11 @@ int Fl_WinAPI_System_Driver::execvp(const char *file, char *const *argv) {
 }
 
 int Fl_WinAPI_System_Driver::chmod(const char *fnam, int mode) {
-  return _wchmod(utf8_to_wchar(fnam, wbuf), mode);
+  return _wchmod(Fl_Wide_Filename(fnam).str(), mode);
 }
 
 int Fl_WinAPI_System_Driver::access(const char *fnam, int mode) {
-  return _waccess(utf8_to_wchar(fnam, wbuf), mode);
+  return _waccess(Fl_Wide_Filename(fnam).str(), mode);
 }
 
 int Fl_WinAPI_System_Driver::stat(const char *fnam, struct stat *b) {
@@ -259,7 +284,7 @@ int Fl_WinAPI_System_Driver::stat(const char *fnam, struct stat *b) {
   if (len > 0 && (fnam[len-1] == '/' || fnam[len-1] == '\\'))
     len--;
   // convert filename and execute _wstat()
-  return _wstat(utf8_to_wchar(fnam, wbuf, len), (struct _stat *)b);
+  return _wstat(Fl_Wide_Filename(fnam, len).str(), (struct _stat *)b);
 }
 
 char *Fl_WinAPI_System_Driver::getcwd(char *buf, int len) {
@@ -281,21 +306,32 @@ int Fl_WinAPI_System_Driver::chdir(const char *path) {
 }
 
 int Fl_WinAPI_System_Driver::unlink(const char *fnam) {
-  return _wunlink(utf8_to_wchar(fnam, wbuf));
+  return _wunlink(Fl_Wide_Filename(fnam).str());
 }
 
 int Fl_WinAPI_System_Driver::mkdir(const char *fnam, int mode) {
-  return _wmkdir(utf8_to_wchar(fnam, wbuf));
+  return _wmkdir(Fl_Wide_Filename(fnam).str());
 }
 
 int Fl_WinAPI_System_Driver::rmdir(const char *fnam) {
-  return _wrmdir(utf8_to_wchar(fnam, wbuf));
+  return _wrmdir(Fl_Wide_Filename(fnam).str());
 }
 
 int Fl_WinAPI_System_Driver::rename(const char *fnam, const char *newnam) {
-  utf8_to_wchar(fnam, wbuf);
-  utf8_to_wchar(newnam, wbuf1);
-  return _wrename(wbuf, wbuf1);
+  Fl_Wide_Filename wnam(fnam), wnewnam(newnam);
+  return _wrename(wnam.str(), wnewnam.str());
+}
+
+int Fl_WinAPI_System_Driver::sync_file(FILE *f) {
+  return (fflush(f) || _commit(_fileno(f))) ? -1 : 0;
+}
+
+// unlike _wrename() this replaces an existing file, without a moment
+// in which neither file exists
+int Fl_WinAPI_System_Driver::replace_file(const char *fnam, const char *newnam) {
+  Fl_Wide_Filename wnam(fnam), wnewnam(newnam);
+  return MoveFileExW(wnam.str(), wnewnam.str(),
+                     MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) ? 0 : -1;
 }
 
 // Two Windows-specific functions fl_utf8_to_locale() and fl_locale_to_utf8()
@@ -667,9 +703,7 @@ int Fl_WinAPI_System_Driver::filename_isdir(const char *n) {
   }
 
   // convert filename to wide chars using *length*
-  utf8_to_wchar(n, wbuf, length);
-
-  DWORD fa = GetFileAttributesW(wbuf);
+  DWORD fa = GetFileAttributesW(Fl_Wide_Filename(n, length).str());
   return (fa != INVALID_FILE_ATTRIBUTES) && (fa & FILE_ATTRIBUTE_DIRECTORY);
 }
 
@@ -962,6 +996,105 @@ void Fl_WinAPI_System_Driver::lock_ring() {
   EnterCriticalSection(cs_ring);
 }
 
+// Worker threads, see Fl_System_Driver::create_thread()
+struct thread_start {
+  void (*func)(void *);
+  void *data;
+};
+
+static unsigned __stdcall thread_start_cb(void *arg) {
+  thread_start start = *(thread_start *)arg;
+  delete (thread_start *)arg;
+  start.func(start.data);
+  return 0;
+}
+
+int Fl_WinAPI_System_Driver::create_thread(void (*func)(void *), void *data) {
+  thread_start *start = new thread_start;
+  start->func = func;
+  start->data = data;
+  uintptr_t thread = _beginthreadex(NULL, 0, thread_start_cb, start, 0, NULL);
+  if (!thread) {
+    delete start;
+    return -1;
+  }
+  CloseHandle((HANDLE)thread);
+  return 0;
+}
+
+// Mutexes for data shared with these threads, created when first locked;
+// threads may lock a mutex for the first time at once, so the pointer is
+// set with a compare-and-swap
+void Fl_WinAPI_System_Driver::mutex_lock(void **m) {
+  CRITICAL_SECTION *cs = (CRITICAL_SECTION*)InterlockedCompareExchangePointer(m, NULL, NULL);
+  if (!cs) {
+    CRITICAL_SECTION *created = (CRITICAL_SECTION*)malloc(sizeof(CRITICAL_SECTION));
+    InitializeCriticalSection(created);
+    cs = (CRITICAL_SECTION*)InterlockedCompareExchangePointer(m, created, NULL);
+    if (cs) {                   // another thread was faster
+      DeleteCriticalSection(created);
+      free(created);
+    } else {
+      cs = created;
+    }
+  }
+  EnterCriticalSection(cs);
+}
+
+void Fl_WinAPI_System_Driver::mutex_unlock(void *m) {
+  LeaveCriticalSection((CRITICAL_SECTION*)m);
+}
+
+// Threads for run_parallel(): thread t calls func(data, i) for i = t,
+// t + nthreads, ... < count
+struct parallel_start {
+  void (*func)(void *, int);
+  void *data;
+  int first, step, count;
+};
+
+static unsigned __stdcall parallel_start_cb(void *arg) {
+  parallel_start *start = (parallel_start *)arg;
+  for (int i = start->first; i < start->count; i += start->step)
+    start->func(start->data, i);
+  return 0;
+}
+
+int Fl_WinAPI_System_Driver::parallel_count() {
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  int ncpu = (int)info.dwNumberOfProcessors;
+  return ncpu < 1 ? 1 : ncpu > 16 ? 16 : ncpu;
+}
+
+void Fl_WinAPI_System_Driver::run_parallel(void (*func)(void *, int), void *data, int count) {
+  HANDLE threads[16];
+  parallel_start starts[16];
+  int nthreads = parallel_count();
+  if (count < nthreads) nthreads = count;
+  if (nthreads < 1) nthreads = 1;
+  int t, started = 1;
+  for (t = 0; t < nthreads; t++) {
+    starts[t].func = func;
+    starts[t].data = data;
+    starts[t].first = t;
+    starts[t].step = nthreads;
+    starts[t].count = count;
+  }
+  // Start threads 1 .. nthreads - 1, run the others' share if that fails
+  for (t = 1; t < nthreads; t++, started++) {
+    uintptr_t thread = _beginthreadex(NULL, 0, parallel_start_cb, starts + t, 0, NULL);
+    if (!thread) break;
+    threads[t] = (HANDLE)thread;
+  }
+  for (t = started; t < nthreads; t++) parallel_start_cb(starts + t);
+  parallel_start_cb(starts);
+  for (t = 1; t < started; t++) {
+    WaitForSingleObject(threads[t], INFINITE);
+    CloseHandle(threads[t]);
+  }
+}
+
 //
 // 'unlock_function()' - Release the lock.
 //
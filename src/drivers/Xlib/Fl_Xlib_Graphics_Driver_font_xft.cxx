@@ -702,6 +702,10 @@ Fl_Xlib_Font_Descriptor::Fl_Xlib_Font_Descriptor(const char* name, Fl_Fontsize f
 //  encoding = fl_encoding_;
   angle = fangle;
   font = fontopen(name, fsize, false, angle);
+  width = NULL;
+  wide_char = NULL;
+  wide_width = NULL;
+  wide_size = wide_count = 0;
 }
 
 
@@ -739,6 +743,66 @@ static void utf8extents(Fl_Xlib_Font_Descriptor *desc, const char *str, int n, X
 #endif
 }
 
+static const int no_width = 0x7FFFFFFF; // marks advance widths not yet cached
+
+// double the size of the hash table of characters beyond the BMP
+static void grow_wide_widths(Fl_Xlib_Font_Descriptor *desc) {
+  int size = desc->wide_size ? 2 * desc->wide_size : 64;
+  unsigned *chars = new unsigned[size];
+  int *widths = new int[size];
+  memset(chars, 0, size * sizeof(unsigned));
+  for (int i = 0; i < desc->wide_size; i++) {
+    unsigned c = desc->wide_char[i];
+    if (!c) continue;
+    unsigned j = (c * 2654435761U) & (size - 1);
+    while (chars[j]) j = (j + 1) & (size - 1);
+    chars[j] = c;
+    widths[j] = desc->wide_width[i];
+  }
+  delete[] desc->wide_char;
+  delete[] desc->wide_width;
+  desc->wide_char = chars;
+  desc->wide_width = widths;
+  desc->wide_size = size;
+}
+
+/* Returns the advance width of character c, as XftTextExtents32() would.
+ The widths are cached in the font descriptor: in a table of blocks of 1024
+ characters for the BMP, and in a hash table beyond. Xft doesn't kern, so
+ the width of a string is the sum of the advance widths of its characters.
+ */
+static int fl_xft_advance(Fl_Xlib_Font_Descriptor *desc, FcChar32 c) {
+  int *w;
+  if (c <= 0xFFFF) {
+    int r = c >> 10;
+    if (!desc->width) {
+      desc->width = new int*[64];
+      memset(desc->width, 0, 64*sizeof(int*));
+    }
+    if (!desc->width[r]) {
+      desc->width[r] = new int[0x0400];
+      for (int i = 0; i < 0x0400; i++) desc->width[r][i] = no_width;
+    }
+    w = &desc->width[r][c & 0x03FF];
+  } else {
+    if (2 * (desc->wide_count + 1) > desc->wide_size) grow_wide_widths(desc);
+    unsigned i = (c * 2654435761U) & (desc->wide_size - 1);
+    while (desc->wide_char[i] && desc->wide_char[i] != c) i = (i + 1) & (desc->wide_size - 1);
+    if (!desc->wide_char[i]) {
+      desc->wide_char[i] = c;
+      desc->wide_width[i] = no_width;
+      desc->wide_count++;
+    }
+    w = &desc->wide_width[i];
+  }
+  if (*w == no_width) {
+    XGlyphInfo gi;
+    XftTextExtents32(fl_display, desc->font, &c, 1, &gi);
+    *w = gi.xOff;
+  }
+  return *w;
+}
+
 int Fl_Xlib_Graphics_Driver::height_unscaled() {
   if (font_descriptor()) return ((Fl_Xlib_Font_Descriptor*)font_descriptor())->font->ascent + ((Fl_Xlib_Font_Descriptor*)font_descriptor())->font->descent;
   else return -1;
@@ -751,21 +815,40 @@ int Fl_Xlib_Graphics_Driver::descent_unscaled() {
 
 double Fl_Xlib_Graphics_Driver::width_unscaled(const char* str, int n) {
   if (!font_descriptor()) return -1.0;
+#ifdef __CYGWIN__
   XGlyphInfo i;
   utf8extents((Fl_Xlib_Font_Descriptor*)font_descriptor(), str, n, &i);
   return i.xOff;
+#else
+  // sum the cached advance widths, decoding like fl_utf8towc()
+  Fl_Xlib_Font_Descriptor *desc = (Fl_Xlib_Font_Descriptor*)font_descriptor();
+  const char *end = str + n;
+  int w = 0;
+  while (str < end) {
+    FcChar32 c;
+    if (!(*str & 0x80)) { /* ascii */
+      c = *str++;
+    } else {
+      int len;
+      c = fl_utf8decode(str, end, &len);
+      str += len;
+    }
+    w += fl_xft_advance(desc, c);
+  }
+  return w;
+#endif
 }
 
 static double fl_xft_width(Fl_Font_Descriptor *desc, FcChar32 *str, int n) {
   if (!desc) return -1.0;
-  XGlyphInfo i;
-  XftTextExtents32(fl_display, ((Fl_Xlib_Font_Descriptor*)desc)->font, str, n, &i);
-  return i.xOff;
+  int w = 0;
+  for (int i = 0; i < n; i++) w += fl_xft_advance((Fl_Xlib_Font_Descriptor*)desc, str[i]);
+  return w;
 }
 
 double Fl_Xlib_Graphics_Driver::width_unscaled(unsigned int c) {
   if (!font_descriptor()) return -1.0;
-  return fl_xft_width(font_descriptor(), (FcChar32 *)(&c), 1);
+  return fl_xft_advance((Fl_Xlib_Font_Descriptor*)font_descriptor(), c);
 }
 
 void Fl_Xlib_Graphics_Driver::text_extents_unscaled(const char *c, int n, int &dx, int &dy, int &w, int &h) {
@@ -1012,9 +1095,11 @@ float Fl_Xlib_Graphics_Driver::scale_bitmap_for_PostScript() {
 Fl_Xlib_Font_Descriptor::~Fl_Xlib_Font_Descriptor() {
   if (this == fl_graphics_driver->font_descriptor()) fl_graphics_driver->font_descriptor(NULL);
   //  XftFontClose(fl_display, font);
-#if USE_PANGO
   if (width) for (int i = 0; i < 64; i++) delete[] width[i];
   delete[] width;
+#if !USE_PANGO
+  delete[] wide_char;
+  delete[] wide_width;
 #endif
 }
 
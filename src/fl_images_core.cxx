@@ -38,6 +38,9 @@
 #if defined(HAVE_LIBZ)
 #include <zlib.h>
 #endif
+#if defined(HAVE_LIBZ) && !defined(FL_NO_PRINT_SUPPORT)
+#include "drivers/PostScript/Fl_PostScript_Graphics_Driver.H"
+#endif
 
 //
 // Define a simple global image registration function that registers
@@ -45,6 +48,22 @@
 //
 
 static Fl_Image *fl_check_images(const char *name, uchar *header, int headerlen);
+static Fl_Image *fl_check_images_sized(const char *name, uchar *header, int headerlen,
+                                       int W, int H);
+
+#if defined(HAVE_LIBZ) && !defined(FL_NO_PRINT_SUPPORT) && !USE_PANGO
+// Compresses the image data of Fl_PostScript_File_Device::compress_images()
+static uchar *fl_deflate_postscript(const uchar *data, size_t length, size_t *deflated_length) {
+  uLongf l = compressBound((uLong)length);
+  uchar *z = new uchar[l];
+  if (compress2(z, &l, data, (uLong)length, Z_DEFAULT_COMPRESSION) != Z_OK) {
+    delete[] z;
+    return NULL;
+  }
+  *deflated_length = l;
+  return z;
+}
+#endif
 
 
 /**
@@ -55,10 +74,17 @@ static Fl_Image *fl_check_images(const char *name, uchar *header, int headerlen)
   that are not part of the core FLTK library.
 
   You may add your own image formats with Fl_Shared_Image::add_handler().
+
+  This function also enables the compression of image data in PostScript
+  output, see Fl_PostScript_File_Device::compress_images().
 */
 void fl_register_images() {
   Fl_Shared_Image::add_handler(fl_check_images);
+  Fl_Shared_Image::add_handler(fl_check_images_sized);
   Fl_Image::register_images_done = true;
+#if defined(HAVE_LIBZ) && !defined(FL_NO_PRINT_SUPPORT) && !USE_PANGO
+  Fl_PostScript_Graphics_Driver::deflate_hook = fl_deflate_postscript;
+#endif
 }
 
 
@@ -163,3 +189,40 @@ fl_check_images(const char *name,               // I - Filename
 
   return 0;
 }
+
+
+//
+// 'fl_check_images_sized()' - Check for an image format that can be loaded
+//                             in a given size.
+//
+// JPEG and PNG images are scaled while they are decoded, which is faster
+// and needs less memory than loading and scaling them. Other formats are
+// left to fl_check_images().
+
+Fl_Image *                                      // O - Image, if found
+fl_check_images_sized(const char *name,         // I - Filename
+                      uchar      *header,       // I - Header data from file
+                      int         headerlen,    // I - Amount of data in header
+                      int         W,            // I - Requested width
+                      int         H) {          // I - Requested height
+
+  if (headerlen < 6) // not a valid image
+    return 0;
+
+  // PNG
+
+#ifdef HAVE_LIBPNG
+  if (memcmp(header, "\211PNG", 4) == 0)// PNG file
+    return new Fl_PNG_Image(name, W, H);
+#endif // HAVE_LIBPNG
+
+  // JPEG
+
+#ifdef HAVE_LIBJPEG
+  if (memcmp(header, "\377\330\377", 3) == 0 && // Start-of-Image
+      header[3] >= 0xc0 && header[3] <= 0xfe)   // APPn .. comment for JPEG file
+    return new Fl_JPEG_Image(name, W, H);
+#endif // HAVE_LIBJPEG
+
+  return 0;
+}
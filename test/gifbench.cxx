@@ -0,0 +1,121 @@
+//
+// Animated GIF benchmark for the Fast Light Tool Kit (FLTK).
+//
+// Copyright 1998-2021 by Bill Spitzak and others.
+//
+// This library is free software. Distribution and use rights are outlined in
+// the file "COPYING" which should have been included with this file.  If this
+// file is missing or damaged, see the license at:
+//
+//     https://www.fltk.org/COPYING.php
+//
+// Please see the following page on how to report bugs and issues:
+//
+//     https://www.fltk.org/bugs.php
+//
+
+// Loads an animated GIF file with Fl_Anim_GIF_Image and shows how long it
+// took to show the first frame, how many frames per second were decoded
+// in the first loop of the animation without and with the frame cache,
+// and how many frames per second later loops showed from the cache.
+//
+// Usage: gifbench [file.gif]
+
+#include <FL/Fl.H>
+#include <FL/Fl_Double_Window.H>
+#include <FL/Fl_Button.H>
+#include <FL/Fl_Simple_Terminal.H>
+#include <FL/Fl_Anim_GIF_Image.H>
+#include <FL/Fl_File_Chooser.H>
+#include <FL/fl_string.h>         // fl_strdup()
+#include <stdlib.h>
+
+#ifndef _WIN32
+#  include <sys/time.h> // gettimeofday()
+#else
+#  include <windows.h>  // GetTickCount()
+#endif // !_WIN32
+
+static Fl_Simple_Terminal *tty = 0;
+static char *filename = 0;
+
+// Elapsed time in seconds
+static double elapsed() {
+#ifndef _WIN32
+  struct timeval t;
+  gettimeofday(&t, NULL);
+  return t.tv_sec + 0.000001 * t.tv_usec;
+#else
+  return GetTickCount() * 0.001;
+#endif
+}
+
+// Play the animation with a frame cache of 'cache' bytes
+static void play(size_t cache) {
+  double t0 = elapsed();
+  Fl_Anim_GIF_Image gif(filename, 0, 0);
+  double t1 = elapsed();
+  gif.frame_cache(cache);
+  int n = 1;
+  while (gif.next() != 0) n++;          // first loop: decode all frames
+  double t2 = elapsed();
+  int m = 0;
+  do {                                  // later loops, for at least a second
+    m++;
+  } while (gif.next() != 0 || elapsed() - t2 < 1.0);
+  double t3 = elapsed();
+  tty->printf("%-8s %9.2f ms %11.1f fps %11.1f fps\n", cache ? "cache" : "no cache",
+              1000 * (t1 - t0), t2 > t1 ? n / (t2 - t1) : 0., t3 > t2 ? m / (t3 - t2) : 0.);
+}
+
+static void run_cb(Fl_Widget *, void *) {
+  if (!filename) {
+    tty->printf("\nChoose a GIF file first.\n");
+    return;
+  }
+  tty->printf("\n%s\n", filename);
+  {
+    Fl_Anim_GIF_Image gif(filename, 0, 0);
+    if (gif.fail()) {
+      tty->printf("Can't load this file.\n");
+      return;
+    }
+    while (gif.next() != 0) { }         // read all frames to count them
+    tty->printf("%dx%d pixels, %d frames\n", gif.w(), gif.h(), gif.frames());
+    if (gif.frames() < 2) {
+      tty->printf("This GIF is not animated.\n");
+      return;
+    }
+  }
+  tty->printf("         first frame    first loop   later loops\n");
+  play(0);
+  Fl::check();
+  play((size_t)256 * 1024 * 1024);
+}
+
+static void open_cb(Fl_Widget *w, void *) {
+  const char *f = fl_file_chooser("GIF file?", "*.gif", filename);
+  if (!f) return;
+  free(filename);
+  filename = fl_strdup(f);
+  run_cb(w, 0);
+}
+
+int main(int argc, char **argv) {
+  Fl_Double_Window win(520, 300, "Animated GIF Benchmark");
+  Fl_Button *open = new Fl_Button(10, 10, 80, 25, "Open...");
+  open->callback(open_cb);
+  Fl_Button *run = new Fl_Button(100, 10, 80, 25, "Run");
+  run->callback(run_cb);
+  tty = new Fl_Simple_Terminal(10, 45, 500, 245);
+  tty->printf("Plays an animated GIF file as fast as possible and measures\n"
+              "how many frames per second Fl_Anim_GIF_Image shows.\n");
+  win.end();
+  win.resizable(tty);
+  win.show();
+  if (argc > 1) {
+    filename = fl_strdup(argv[1]);
+    run_cb(run, 0);
+  }
+  return Fl::run();
+}
@@ -0,0 +1,126 @@
+//
+// File icon lookup benchmark for the Fast Light Tool Kit (FLTK).
+//
+// Copyright 1998-2021 by Bill Spitzak and others.
+//
+// This library is free software. Distribution and use rights are outlined in
+// the file "COPYING" which should have been included with this file.  If this
+// file is missing or damaged, see the license at:
+//
+//     https://www.fltk.org/COPYING.php
+//
+// Please see the following page on how to report bugs and issues:
+//
+//     https://www.fltk.org/bugs.php
+//
+
+// Loads the system file icons and adds the chosen number of icons with
+// patterns like the ones converted from KDE mime types ("*.ext",
+// "{*.ext1|*.ext2}" and literal names). It then looks up the icon of many
+// generated file names with Fl_File_Icon::find() and shows how long this
+// took. Half of the names have an extension of one of the added icons.
+
+#include <FL/Fl.H>
+#include <FL/Fl_Double_Window.H>
+#include <FL/Fl_Button.H>
+#include <FL/Fl_Spinner.H>
+#include <FL/Fl_Simple_Terminal.H>
+#include <FL/Fl_File_Icon.H>
+#include <FL/fl_string.h>         // fl_strdup()
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#  include <sys/time.h> // gettimeofday()
+#else
+#  include <windows.h>  // GetTickCount()
+#endif // !_WIN32
+
+static Fl_Simple_Terminal *tty = 0;
+static Fl_Spinner *icons = 0;
+static Fl_Spinner *files = 0;
+
+// Elapsed time in seconds
+static double elapsed() {
+#ifndef _WIN32
+  struct timeval t;
+  gettimeofday(&t, NULL);
+  return t.tv_sec + 0.000001 * t.tv_usec;
+#else
+  return GetTickCount() * 0.001;
+#endif
+}
+
+static void run_cb(Fl_Widget *, void *) {
+  int ni = (int)icons->value(), nf = (int)files->value(), i, system = 0;
+  char name[64];
+  for (Fl_File_Icon *icon = Fl_File_Icon::first(); icon; icon = icon->next()) system++;
+
+  // Fl_File_Icon keeps the pattern pointer, so keep the strings until the
+  // icons are deleted
+  char **patterns = new char*[ni];
+  Fl_File_Icon **added = new Fl_File_Icon*[ni];
+  for (i = 0; i < ni; i++) {
+    switch (i % 3) {
+      case 0 : sprintf(name, "*.ext%d", i); break;
+      case 1 : sprintf(name, "{*.ext%d|*.alt%d}", i, i); break;
+      default : sprintf(name, "name%d", i); break;
+    }
+    patterns[i] = fl_strdup(name);
+    added[i] = new Fl_File_Icon(patterns[i], Fl_File_Icon::PLAIN);
+  }
+
+  char **names = new char*[nf];
+  for (i = 0; i < nf; i++) {
+    int k = rand() % (2 * ni);            // half of the names match no added icon
+    switch (k % 3) {
+      case 0 : sprintf(name, "/home/user/file%d.ext%d", i, k); break;
+      case 1 : sprintf(name, "/home/user/file%d.tar.alt%d", i, k); break;
+      default : sprintf(name, "/home/user/name%d", k); break;
+    }
+    names[i] = fl_strdup(name);
+  }
+
+  tty->printf("\n%d system icons, %d added icons, %d files:\n", system, ni, nf);
+  int found = 0;
+  double t = elapsed();
+  for (i = 0; i < nf; i++) {
+    Fl_File_Icon *icon = Fl_File_Icon::find(names[i], Fl_File_Icon::PLAIN);
+    if (icon && strcmp(icon->pattern(), "*")) found++;
+  }
+  t = elapsed() - t;
+  tty->printf("find() %8.3f s %10.2f us per file\n", t, 1e6 * t / nf);
+  tty->printf("%d files matched a pattern other than \"*\"\n", found);
+
+  for (i = 0; i < nf; i++) free(names[i]);
+  delete[] names;
+  for (i = 0; i < ni; i++) {
+    delete added[i];
+    free(patterns[i]);
+  }
+  delete[] added;
+  delete[] patterns;
+}
+
+int main(int argc, char **argv) {
+  Fl_File_Icon::load_system_icons();
+  Fl_Double_Window win(520, 300, "File Icon Benchmark");
+  icons = new Fl_Spinner(60, 10, 70, 25, "Icons:");
+  icons->range(1, 10000);
+  icons->step(100);
+  icons->value(400);
+  files = new Fl_Spinner(190, 10, 90, 25, "Files:");
+  files->range(1, 1000000);
+  files->step(1000);
+  files->value(100000);
+  Fl_Button *run = new Fl_Button(300, 10, 80, 25, "Run");
+  run->callback(run_cb);
+  tty = new Fl_Simple_Terminal(10, 45, 500, 245);
+  tty->printf("Adds file icons with many patterns to the system icons and\n"
+              "measures how fast Fl_File_Icon::find() finds the icon of a file.\n");
+  win.end();
+  win.resizable(tty);
+  win.show(argc, argv);
+  return Fl::run();
+}
@@ -0,0 +1,126 @@
+//
+// Preferences benchmark for the Fast Light Tool Kit (FLTK).
+//
+// Copyright 1998-2021 by Bill Spitzak and others.
+//
+// This library is free software. Distribution and use rights are outlined in
+// the file "COPYING" which should have been included with this file.  If this
+// file is missing or damaged, see the license at:
+//
+//     https://www.fltk.org/COPYING.php
+//
+// Please see the following page on how to report bugs and issues:
+//
+//     https://www.fltk.org/bugs.php
+//
+
+// Creates a preferences group with the chosen number of entries and of
+// child groups, then sets, gets and looks them up again, and shows how
+// long each operation took. File access is turned off, so the preferences
+// are only kept in memory and no file is read or written.
+
+#include <FL/Fl.H>
+#include <FL/Fl_Double_Window.H>
+#include <FL/Fl_Button.H>
+#include <FL/Fl_Spinner.H>
+#include <FL/Fl_Simple_Terminal.H>
+#include <FL/Fl_Preferences.H>
+#include <stdio.h>
+
+#ifndef _WIN32
+#  include <sys/time.h> // gettimeofday()
+#else
+#  include <windows.h>  // GetTickCount()
+#endif // !_WIN32
+
+static Fl_Simple_Terminal *tty = 0;
+static Fl_Spinner *count = 0;
+
+// Elapsed time in seconds
+static double elapsed() {
+#ifndef _WIN32
+  struct timeval t;
+  gettimeofday(&t, NULL);
+  return t.tv_sec + 0.000001 * t.tv_usec;
+#else
+  return GetTickCount() * 0.001;
+#endif
+}
+
+static void report(const char *what, int n, double t) {
+  tty->printf("%-22s %8.3f s %10.0f ns each\n", what, t, 1e9 * t / n);
+  Fl::check();
+}
+
+static void run_cb(Fl_Widget *, void *) {
+  int n = (int)count->value();
+  int errors = 0, i, v;
+  char name[32];
+  Fl_Preferences prefs(Fl_Preferences::USER, "fltk.org", "prefsbench");
+  Fl_Preferences bench(prefs, "bench");
+  tty->printf("\n%d entries and groups:\n", n);
+
+  double t = elapsed();
+  for (i = 0; i < n; i++) {
+    sprintf(name, "entry%d", i);
+    bench.set(name, i);
+  }
+  report("set (new entry)", n, elapsed() - t);
+
+  t = elapsed();
+  for (i = 0; i < n; i++) {
+    sprintf(name, "entry%d", i);
+    bench.set(name, n - i);
+  }
+  report("set (existing entry)", n, elapsed() - t);
+
+  t = elapsed();
+  for (i = 0; i < n; i++) {
+    sprintf(name, "entry%d", i);
+    if (!bench.get(name, v, -1) || v != n - i) errors++;
+  }
+  report("get", n, elapsed() - t);
+
+  t = elapsed();
+  for (i = 0; i < n; i++) {
+    sprintf(name, "group%d", i);
+    Fl_Preferences group(bench, name);
+  }
+  report("new group", n, elapsed() - t);
+
+  t = elapsed();
+  for (i = 0; i < n; i++) {
+    sprintf(name, "group%d", i);
+    Fl_Preferences group(bench, name);
+  }
+  report("open group", n, elapsed() - t);
+
+  t = elapsed();
+  for (i = 0; i < n; i++) {
+    sprintf(name, "group%d", i);
+    if (!bench.groupExists(name)) errors++;
+  }
+  report("groupExists()", n, elapsed() - t);
+
+  if (bench.entries() != n || bench.groups() != n) errors++;
+  bench.clear();
+  if (errors) tty->printf("%d lookups failed!\n", errors);
+}
+
+int main(int argc, char **argv) {
+  Fl_Preferences::file_access(Fl_Preferences::NONE);
+  Fl_Double_Window win(520, 300, "Preferences Benchmark");
+  count = new Fl_Spinner(60, 10, 90, 25, "Count:");
+  count->range(1, 1000000);
+  count->step(1000);
+  count->value(100000);
+  Fl_Button *run = new Fl_Button(170, 10, 80, 25, "Run");
+  run->callback(run_cb);
+  tty = new Fl_Simple_Terminal(10, 45, 500, 245);
+  tty->printf("Fills a preferences group with entries and child groups and\n"
+              "measures how fast Fl_Preferences sets and finds them.\n");
+  win.end();
+  win.resizable(tty);
+  win.show(argc, argv);
+  return Fl::run();
+}
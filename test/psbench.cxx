@@ -0,0 +1,157 @@
+//
+// PostScript output benchmark for the Fast Light Tool Kit (FLTK).
+//
+// Copyright 1998-2021 by Bill Spitzak and others.
+//
+// This library is free software. Distribution and use rights are outlined in
+// the file "COPYING" which should have been included with this file.  If this
+// file is missing or damaged, see the license at:
+//
+//     https://www.fltk.org/COPYING.php
+//
+// Please see the following page on how to report bugs and issues:
+//
+//     https://www.fltk.org/bugs.php
+//
+
+// Writes a report of many pages, each with the same logo, small icons,
+// bitmaps and lines, to a temporary PostScript file with each combination
+// of Fl_PostScript_File_Device::share_images() and compress_images(), and
+// shows how many pages per second were written and the size of the file.
+
+#include <FL/Fl.H>
+#include <FL/Fl_Double_Window.H>
+#include <FL/Fl_Button.H>
+#include <FL/Fl_Spinner.H>
+#include <FL/Fl_Simple_Terminal.H>
+#include <FL/Fl_PostScript.H>
+#include <FL/Fl_RGB_Image.H>
+#include <FL/Fl_Bitmap.H>
+#include <FL/Fl_Shared_Image.H>   // fl_register_images()
+#include <FL/fl_draw.H>
+#include <stdio.h>
+
+#ifndef _WIN32
+#  include <sys/time.h> // gettimeofday()
+#else
+#  include <windows.h>  // GetTickCount()
+#endif // !_WIN32
+
+static Fl_Simple_Terminal *tty = 0;
+static Fl_Spinner *pages = 0;
+static Fl_RGB_Image *logo = 0;
+static Fl_RGB_Image *icon = 0;
+static Fl_Bitmap *bitmap = 0;
+static long file_size = 0;
+
+// Elapsed time in seconds
+static double elapsed() {
+#ifndef _WIN32
+  struct timeval t;
+  gettimeofday(&t, NULL);
+  return t.tv_sec + 0.000001 * t.tv_usec;
+#else
+  return GetTickCount() * 0.001;
+#endif
+}
+
+// Make the images drawn on each page
+static void make_images() {
+  static uchar logo_data[200 * 100 * 3];
+  for (int y = 0; y < 100; y++) {
+    for (int x = 0; x < 200; x++) {
+      uchar *p = logo_data + 3 * (y * 200 + x);
+      int dx = x - 50, dy = y - 50;
+      int disc = dx * dx + dy * dy < 40 * 40;
+      int bar = x > 100 && x < 190 && (y / 12) % 2;
+      p[0] = disc ? 200 : bar ? 30 : 255;
+      p[1] = disc ? 40 : bar ? 60 : 255;
+      p[2] = disc ? 40 : bar ? (uchar)(100 + x / 2) : 255;
+    }
+  }
+  logo = new Fl_RGB_Image(logo_data, 200, 100, 3);
+  static uchar icon_data[16 * 16 * 4];
+  for (int i = 0; i < 256; i++) {
+    icon_data[4 * i]     = (uchar)i;
+    icon_data[4 * i + 1] = (uchar)(255 - i);
+    icon_data[4 * i + 2] = (uchar)(i * 7);
+    icon_data[4 * i + 3] = (i % 16 < 8) ? 255 : 0;
+  }
+  icon = new Fl_RGB_Image(icon_data, 16, 16, 4);
+  static uchar bits[32];
+  for (int i = 0; i < 32; i++) bits[i] = (uchar)(i * 37);
+  bitmap = new Fl_Bitmap(bits, 16, 16);
+}
+
+// Record the size of the file before closing it
+static int close_file(FILE *f) {
+  fseek(f, 0, SEEK_END);
+  file_size = ftell(f);
+  return fclose(f);
+}
+
+// Write 'n' pages, return the number of pages per second
+static double write_pages(int n, int share, int compress) {
+  FILE *f = tmpfile();
+  if (!f) return 0;
+  Fl_PostScript_File_Device ps;
+  ps.share_images(share);
+  ps.compress_images(compress);
+  double t0 = elapsed();
+  if (ps.begin_job(f, n)) {
+    fclose(f);
+    return 0;
+  }
+  ps.close_command(close_file);
+  for (int p = 0; p < n; p++) {
+    ps.begin_page();
+    logo->draw(20, 20);
+    fl_font(FL_HELVETICA, 12);
+    for (int r = 0; r < 40; r++) {
+      fl_color((Fl_Color)(r % 16));
+      fl_rect(20, 140 + r * 15, 500, 14);
+      fl_line(20, 140 + r * 15, 520, 140 + r * 15 + 14);
+      fl_rectf(30, 142 + r * 15, 50, 10);
+      icon->draw(100, 139 + r * 15);
+      bitmap->draw(130, 139 + r * 15);
+      fl_pie(150, 140 + r * 15, 12, 12, 0, 270);
+      fl_draw("Report line", 170, 151 + r * 15);
+    }
+    ps.end_page();
+  }
+  ps.end_job();
+  double t = elapsed() - t0;
+  return t > 0 ? n / t : 0;
+}
+
+static void run_cb(Fl_Widget *, void *) {
+  int n = (int)pages->value();
+  tty->printf("\n%d pages:\n", n);
+  static const char *modes[] = {
+    "default              ", "share_images         ",
+    "compress_images      ", "share + compress     "
+  };
+  for (int m = 0; m < 4; m++) {
+    double pps = write_pages(n, m & 1, (m & 2) != 0);
+    tty->printf("%s %8.1f pages/s %10ld bytes\n", modes[m], pps, file_size);
+    Fl::check();
+  }
+}
+
+int main(int argc, char **argv) {
+  fl_register_images();         // enables compress_images()
+  make_images();
+  Fl_Double_Window win(520, 300, "PostScript Benchmark");
+  pages = new Fl_Spinner(60, 10, 80, 25, "Pages:");
+  pages->range(1, 10000);
+  pages->value(200);
+  Fl_Button *run = new Fl_Button(160, 10, 80, 25, "Run");
+  run->callback(run_cb);
+  tty = new Fl_Simple_Terminal(10, 45, 500, 245);
+  tty->printf("Writes a report with the same logo on each page to a temporary\n"
+              "PostScript file and measures the speed and size of the output.\n");
+  win.end();
+  win.resizable(tty);
+  win.show(argc, argv);
+  return Fl::run();
+}
@@ -0,0 +1,114 @@
+//
+// RGB image scaling benchmark for the Fast Light Tool Kit (FLTK).
+//
+// Copyright 1998-2021 by Bill Spitzak and others.
+//
+// This library is free software. Distribution and use rights are outlined in
+// the file "COPYING" which should have been included with this file.  If this
+// file is missing or damaged, see the license at:
+//
+//     https://www.fltk.org/COPYING.php
+//
+// Please see the following page on how to report bugs and issues:
+//
+//     https://www.fltk.org/bugs.php
+//
+
+// Scales an RGB image of the chosen size and depth with Fl_RGB_Image::copy()
+// to a larger size, a smaller size and a thumbnail, with each scaling method
+// of Fl_Image::RGB_scaling(), and shows how long each copy took.
+
+#include <FL/Fl.H>
+#include <FL/Fl_Double_Window.H>
+#include <FL/Fl_Button.H>
+#include <FL/Fl_Spinner.H>
+#include <FL/Fl_Simple_Terminal.H>
+#include <FL/Fl_RGB_Image.H>
+
+#ifndef _WIN32
+#  include <sys/time.h> // gettimeofday()
+#else
+#  include <windows.h>  // GetTickCount()
+#endif // !_WIN32
+
+static Fl_Simple_Terminal *tty = 0;
+static Fl_Spinner *width = 0;
+static Fl_Spinner *height = 0;
+static Fl_Spinner *depth = 0;
+
+// Elapsed time in seconds
+static double elapsed() {
+#ifndef _WIN32
+  struct timeval t;
+  gettimeofday(&t, NULL);
+  return t.tv_sec + 0.000001 * t.tv_usec;
+#else
+  return GetTickCount() * 0.001;
+#endif
+}
+
+// Copy 'img' to W x H pixels for at least half a second,
+// return the time of one copy in milliseconds
+static double scale(Fl_RGB_Image *img, int W, int H) {
+  int n = 0;
+  double t0 = elapsed(), t;
+  do {
+    Fl_Image *copy = img->copy(W, H);
+    delete copy;
+    n++;
+    t = elapsed() - t0;
+  } while (t < 0.5);
+  return 1000. * t / n;
+}
+
+static void run_cb(Fl_Widget *, void *) {
+  int w = (int)width->value(), h = (int)height->value(), d = (int)depth->value();
+  uchar *pixels = new uchar[w * h * d];
+  for (int y = 0; y < h; y++) {
+    for (int x = 0; x < w; x++) {
+      uchar *p = pixels + d * (y * w + x);
+      for (int c = 0; c < d; c++) p[c] = (uchar)((x * (c + 1) + y * (3 - c)) ^ (x * y >> 6));
+    }
+  }
+  Fl_RGB_Image img(pixels, w, h, d);
+  struct { int w, h; } sizes[] = {{w * 4 / 3, h * 3 / 2}, {w / 2, h / 2}, {w / 20 + 1, h / 20 + 1}};
+  static const char *methods[] = {"nearest ", "bilinear", "area    "};
+  Fl_RGB_Scaling old = Fl_Image::RGB_scaling();
+  tty->printf("\n%dx%d pixels, depth %d, ms per copy:\n", w, h, d);
+  tty->printf("          ");
+  for (int s = 0; s < 3; s++) tty->printf("  %5dx%-5d", sizes[s].w, sizes[s].h);
+  tty->printf("\n");
+  for (int m = 0; m < 3; m++) {
+    Fl_Image::RGB_scaling((Fl_RGB_Scaling)m);
+    tty->printf("%s  ", methods[m]);
+    for (int s = 0; s < 3; s++) {
+      tty->printf("  %11.2f", scale(&img, sizes[s].w, sizes[s].h));
+      Fl::check();
+    }
+    tty->printf("\n");
+  }
+  Fl_Image::RGB_scaling(old);
+  delete[] pixels;
+}
+
+int main(int argc, char **argv) {
+  Fl_Double_Window win(520, 300, "Image Scaling Benchmark");
+  width = new Fl_Spinner(60, 10, 70, 25, "Width:");
+  width->range(16, 10000);
+  width->value(3000);
+  height = new Fl_Spinner(190, 10, 70, 25, "Height:");
+  height->range(16, 10000);
+  height->value(2000);
+  depth = new Fl_Spinner(310, 10, 45, 25, "Depth:");
+  depth->range(1, 4);
+  depth->value(3);
+  Fl_Button *run = new Fl_Button(380, 10, 80, 25, "Run");
+  run->callback(run_cb);
+  tty = new Fl_Simple_Terminal(10, 45, 500, 245);
+  tty->printf("Scales an image up, down and to a thumbnail with each\n"
+              "scaling method and measures the speed of Fl_RGB_Image::copy().\n");
+  win.end();
+  win.resizable(tty);
+  win.show(argc, argv);
+  return Fl::run();
+}
@@ -0,0 +1,114 @@
+//
+// Shared image cache benchmark for the Fast Light Tool Kit (FLTK).
+//
+// Copyright 1998-2021 by Bill Spitzak and others.
+//
+// This library is free software. Distribution and use rights are outlined in
+// the file "COPYING" which should have been included with this file.  If this
+// file is missing or damaged, see the license at:
+//
+//     https://www.fltk.org/COPYING.php
+//
+// Please see the following page on how to report bugs and issues:
+//
+//     https://www.fltk.org/bugs.php
+//
+
+// Registers many small images with Fl_Shared_Image::get(Fl_RGB_Image*),
+// finds each of them by name with Fl_Shared_Image::find() and with the
+// bulk Fl_Shared_Image::get(names, count, ...), then releases them, and
+// shows how long each step took.
+
+#include <FL/Fl.H>
+#include <FL/Fl_Double_Window.H>
+#include <FL/Fl_Button.H>
+#include <FL/Fl_Spinner.H>
+#include <FL/Fl_Simple_Terminal.H>
+#include <FL/Fl_Shared_Image.H>
+#include <FL/Fl_RGB_Image.H>
+#include <FL/fl_string.h>         // fl_strdup()
+#include <stdlib.h>
+
+#ifndef _WIN32
+#  include <sys/time.h> // gettimeofday()
+#else
+#  include <windows.h>  // GetTickCount()
+#endif // !_WIN32
+
+static Fl_Simple_Terminal *tty = 0;
+static Fl_Spinner *count = 0;
+
+// Elapsed time in seconds
+static double elapsed() {
+#ifndef _WIN32
+  struct timeval t;
+  gettimeofday(&t, NULL);
+  return t.tv_sec + 0.000001 * t.tv_usec;
+#else
+  return GetTickCount() * 0.001;
+#endif
+}
+
+static void report(const char *what, int n, double t) {
+  tty->printf("%-22s %8.3f s %12.0f per second\n", what, t, t > 0 ? n / t : 0.);
+  Fl::check();
+}
+
+static void run_cb(Fl_Widget *, void *) {
+  static uchar pixels[4 * 4 * 3];
+  int n = (int)count->value();
+  Fl_Shared_Image **images = new Fl_Shared_Image*[n];
+  Fl_Shared_Image **found = new Fl_Shared_Image*[n];
+  char **names = new char*[n];
+  int errors = 0, i;
+  tty->printf("\n%d images:\n", n);
+
+  double t = elapsed();
+  for (i = 0; i < n; i++)
+    images[i] = Fl_Shared_Image::get(new Fl_RGB_Image(pixels, 4, 4), 1);
+  report("register", n, elapsed() - t);
+  for (i = 0; i < n; i++) names[i] = fl_strdup(images[i]->name());
+
+  t = elapsed();
+  for (i = 0; i < n; i++) {
+    Fl_Shared_Image *img = Fl_Shared_Image::find(names[i]);
+    if (img != images[i]) errors++;
+    if (img) img->release();
+  }
+  report("find", n, elapsed() - t);
+
+  t = elapsed();
+  if (Fl_Shared_Image::get(names, n, found) != n) errors++;
+  report("get (bulk)", n, elapsed() - t);
+  for (i = 0; i < n; i++) {
+    if (found[i] != images[i]) errors++;
+    if (found[i]) found[i]->release();
+  }
+
+  t = elapsed();
+  for (i = 0; i < n; i++) images[i]->release();
+  report("release", n, elapsed() - t);
+
+  for (i = 0; i < n; i++) free(names[i]);
+  delete[] names;
+  delete[] found;
+  delete[] images;
+  if (errors) tty->printf("%d images were not found!\n", errors);
+}
+
+int main(int argc, char **argv) {
+  Fl_Double_Window win(520, 300, "Shared Image Benchmark");
+  count = new Fl_Spinner(60, 10, 90, 25, "Images:");
+  count->range(1, 1000000);
+  count->step(1000);
+  count->value(100000);
+  Fl_Button *run = new Fl_Button(170, 10, 80, 25, "Run");
+  run->callback(run_cb);
+  tty = new Fl_Simple_Terminal(10, 45, 500, 245);
+  tty->printf("Registers many small images in the shared image cache and\n"
+              "measures how fast they are found and released.\n");
+  win.end();
+  win.resizable(tty);
+  win.show(argc, argv);
+  return Fl::run();
+}
@@ -0,0 +1,145 @@
+//
+// Unit tests for the Fast Light Tool Kit (FLTK).
+//
+// Copyright 1998-2021 by Bill Spitzak and others.
+//
+// This library is free software. Distribution and use rights are outlined in
+// the file "COPYING" which should have been included with this file.  If this
+// file is missing or damaged, see the license at:
+//
+//     https://www.fltk.org/COPYING.php
+//
+// Please see the following page on how to report bugs and issues:
+//
+//     https://www.fltk.org/bugs.php
+//
+
+#include <FL/Fl_Group.H>
+#include <FL/Fl_Input.H>
+#include <FL/Fl_Simple_Terminal.H>
+#include <FL/fl_string.h>   // fl_strdup()
+#include <stdlib.h>
+#include <string.h>
+
+//
+//------- test the undo() and redo() of Fl_Input_ ----------
+//
+class InputUndoTest : public Fl_Group {
+  Fl_Simple_Terminal *tty;
+  int failed;
+
+  void check(int ok, const char *what) {
+    tty->printf("%s %s\n", ok ? "ok    " : "FAILED", what);
+    if (!ok) failed++;
+  }
+  // type text at the end of the input, one character at a time
+  static void type(Fl_Input *in, const char *text) {
+    for (; *text; text++) in->insert(text, 1);
+  }
+  // delete n characters before the end of the input, one at a time
+  static void backspace(Fl_Input *in, int n) {
+    for (; n > 0; n--) in->replace(in->size()-1, in->size(), 0);
+  }
+  static int undo_count(Fl_Input *in) {
+    int n = 0;
+    while (in->undo()) n++;
+    return n;
+  }
+
+  void test_coalescing() {
+    Fl_Input in(0, 0, 100, 20);
+    type(&in, "hello world");
+    in.undo();
+    check(!strcmp(in.value(), "hello "), "typing is undone word by word");
+    in.undo();
+    check(!strcmp(in.value(), "") && !in.can_undo(), "all words are undone");
+    in.redo();
+    in.redo();
+    check(!strcmp(in.value(), "hello world") && !in.can_redo(), "all words are redone");
+    backspace(&in, 5);
+    check(!strcmp(in.value(), "hello "), "deleting characters");
+    in.undo();
+    check(!strcmp(in.value(), "hello world"), "deleted characters are undone at once");
+    in.replace(0, 5, "HELLO");
+    in.undo();
+    check(!strcmp(in.value(), "hello world"), "replaced text is undone");
+    in.undo();
+    in.insert("!", 1);
+    check(!in.can_redo(), "a new change forgets the changes that could be redone");
+  }
+
+  void test_limit() {
+    Fl_Input in(0, 0, 100, 20);
+    const int n = 50;
+    int i;
+    in.undo_limit(1000);
+    for (i = 0; i < n; i++) {
+      in.replace(0, in.size(), "0123456789012345678901234567890123456789", 40);
+      in.insert(" x", 2);
+    }
+    int count = undo_count(&in);
+    check(count > 0 && count < n, "old changes are forgotten at the memory limit");
+    in.undo_limit(0);
+    for (i = 0; i < 3; i++) type(&in, " word");
+    check(undo_count(&in) == 1, "the last change is kept with a limit of 0 bytes");
+    in.undo_limit(1024*1024);
+    in.value("");
+    for (i = 0; i < n; i++) type(&in, "word ");
+    check(undo_count(&in) == n, "all changes are kept below the memory limit");
+    check(!in.can_undo() && !strcmp(in.value(), ""), "nothing is left to undo");
+    in.value("new value");
+    check(!in.can_undo() && !in.can_redo(), "value() forgets all changes");
+  }
+
+  void test_round_trip() {
+    Fl_Input in(0, 0, 100, 20);
+    in.value("The quick brown fox jumps over the lazy dog");
+    char *first = fl_strdup(in.value());
+    srand(1);
+    for (int i = 0; i < 500; i++) {
+      int b = in.size() ? rand() % (in.size()+1) : 0;
+      int e = b + rand() % 4;
+      if (e > in.size()) e = in.size();
+      switch (rand() % 3) {
+        case 0: in.replace(b, e, 0); break;
+        case 1: in.replace(b, b, "ab c", rand() % 4 + 1); break;
+        default: in.replace(b, e, "xyz", rand() % 3 + 1); break;
+      }
+    }
+    char *last = fl_strdup(in.value());
+    undo_count(&in);
+    check(!strcmp(in.value(), first), "undo() restores the first text");
+    while (in.redo()) { }
+    check(!strcmp(in.value(), last), "redo() restores the last text");
+    free(first);
+    free(last);
+  }
+
+  void test_secret() {
+    Fl_Input in(0, 0, 100, 20);
+    in.type(FL_SECRET_INPUT);
+    type(&in, "my secret password");
+    in.replace(0, 2, "your");
+    check(undo_count(&in) == 1, "secret input keeps only the last change");
+    check(!strcmp(in.value(), "my secret password"), "secret input undoes the last change");
+  }
+
+public:
+  static Fl_Widget *create() {
+    return new InputUndoTest(TESTAREA_X, TESTAREA_Y, TESTAREA_W, TESTAREA_H);
+  }
+  InputUndoTest(int x, int y, int w, int h) : Fl_Group(x, y, w, h) {
+    failed = 0;
+    Fl_Input *in = new Fl_Input(x+50, y+10, w-60, 25, "Try:");
+    in->value("Type, delete, undo, and redo text here");
+    tty = new Fl_Simple_Terminal(x, y+45, w, h-45);
+    end();
+    test_coalescing();
+    test_limit();
+    test_round_trip();
+    test_secret();
+    tty->printf("\n%s\n", failed ? "Some tests FAILED!" : "All tests passed.");
+  }
+};
+
+UnitTest input_undo("input undo", InputUndoTest::create);
@@ -0,0 +1,248 @@
+//
+// Unit tests for the Fast Light Tool Kit (FLTK).
+//
+// Copyright 1998-2021 by Bill Spitzak and others.
+//
+// This library is free software. Distribution and use rights are outlined in
+// the file "COPYING" which should have been included with this file.  If this
+// file is missing or damaged, see the license at:
+//
+//     https://www.fltk.org/COPYING.php
+//
+// Please see the following page on how to report bugs and issues:
+//
+//     https://www.fltk.org/bugs.php
+//
+
+#include <FL/Fl_Group.H>
+#include <FL/Fl_Button.H>
+#include <FL/Fl_Simple_Terminal.H>
+#include <FL/Fl_Image.H>
+#include <string.h>
+
+#ifndef _WIN32
+#  include <sys/time.h> // gettimeofday()
+#else
+#  include <windows.h>  // GetTickCount()
+#endif // !_WIN32
+
+//
+//------- test Fl_RGB_Image::copy() against the FLTK 1.3 scaling code ----------
+//
+
+// Elapsed time in seconds
+static double scaling_time() {
+#ifndef _WIN32
+  struct timeval t;
+  gettimeofday(&t, NULL);
+  return t.tv_sec + 0.000001 * t.tv_usec;
+#else
+  return GetTickCount() * 0.001;
+#endif
+}
+
+// Scale like Fl_RGB_Image::copy() did before it was split into bands of
+// rows, the results must be the same byte by byte
+static uchar *scaling_reference(const uchar *array, int w, int h, int d, int ld,
+                                int W, int H, Fl_RGB_Scaling method) {
+  uchar *new_array = new uchar[W * H * d];
+  uchar *new_ptr;
+  const uchar *old_ptr;
+  int dx, dy, line_d = ld ? ld : w * d;
+
+  if (method == FL_RGB_SCALING_NEAREST) {
+    int c, sy, xerr, yerr, xmod, ymod, xstep, ystep;
+    xmod   = w % W;
+    xstep  = (w / W) * d;
+    ymod   = h % H;
+    ystep  = h / H;
+    for (dy = H, sy = 0, yerr = H, new_ptr = new_array; dy > 0; dy --) {
+      for (dx = W, xerr = W, old_ptr = array + sy * line_d; dx > 0; dx --) {
+        for (c = 0; c < d; c ++) *new_ptr++ = old_ptr[c];
+        old_ptr += xstep;
+        xerr    -= xmod;
+        if (xerr <= 0) {
+          xerr    += W;
+          old_ptr += d;
+        }
+      }
+      sy   += ystep;
+      yerr -= ymod;
+      if (yerr <= 0) {
+        yerr += H;
+        sy ++;
+      }
+    }
+  } else {
+    const float xscale = (w - 1) / (float) W;
+    const float yscale = (h - 1) / (float) H;
+    for (dy = 0; dy < H; dy++) {
+      float oldy = dy * yscale;
+      if (oldy >= h)
+        oldy = float(h - 1);
+      const float yfract = oldy - (unsigned) oldy;
+      for (dx = 0; dx < W; dx++) {
+        new_ptr = new_array + dy * W * d + dx * d;
+        float oldx = dx * xscale;
+        if (oldx >= w)
+          oldx = float(w - 1);
+        const float xfract = oldx - (unsigned) oldx;
+        const unsigned leftx = (unsigned)oldx;
+        const unsigned lefty = (unsigned)oldy;
+        const unsigned rightx = (unsigned)(oldx + 1 >= w ? oldx : oldx + 1);
+        const unsigned dlefty = (unsigned)(oldy + 1 >= h ? oldy : oldy + 1);
+        uchar left[4], right[4], downleft[4], downright[4];
+        memcpy(left, array + lefty * line_d + leftx * d, d);
+        memcpy(right, array + lefty * line_d + rightx * d, d);
+        memcpy(downleft, array + dlefty * line_d + leftx * d, d);
+        memcpy(downright, array + dlefty * line_d + rightx * d, d);
+        int i;
+        if (d == 4) {
+          for (i = 0; i < 3; i++) {
+            left[i] = (uchar)(left[i] * left[3] / 255.0f);
+            right[i] = (uchar)(right[i] * right[3] / 255.0f);
+            downleft[i] = (uchar)(downleft[i] * downleft[3] / 255.0f);
+            downright[i] = (uchar)(downright[i] * downright[3] / 255.0f);
+          }
+        }
+        const float leftf = 1 - xfract;
+        const float rightf = xfract;
+        const float upf = 1 - yfract;
+        const float downf = yfract;
+        for (i = 0; i < d; i++) {
+          new_ptr[i] = (uchar)((left[i] * leftf +
+                   right[i] * rightf) * upf +
+                   (downleft[i] * leftf +
+                   downright[i] * rightf) * downf);
+        }
+        if (d == 4 && new_ptr[3]) {
+          for (i = 0; i < 3; i++) {
+            new_ptr[i] = (uchar)(new_ptr[i] / (new_ptr[3] / 255.0f));
+          }
+        }
+      }
+    }
+  }
+  return new_array;
+}
+
+// Source image of w x h pixels with d channels and 'pad' unused bytes per row
+static uchar *scaling_source(int w, int h, int d, int pad) {
+  int ld = w * d + pad;
+  uchar *p = new uchar[ld * h];
+  unsigned r = 1;
+  for (int i = 0; i < ld * h; i++) {
+    r = r * 1103515245 + 12345;
+    p[i] = (uchar)((r >> 16) & 0xff);
+    if (i % 7 == 0) p[i] = 0; // some fully transparent pixels
+  }
+  return p;
+}
+
+class ScalingTest : public Fl_Group {
+  Fl_Simple_Terminal *tty;
+
+  // Compare one scaling with the reference, return 1 if it is the same
+  int compare(int w, int h, int d, int pad, int W, int H, Fl_RGB_Scaling method) {
+    uchar *src = scaling_source(w, h, d, pad);
+    Fl_RGB_Image img(src, w, h, d, pad ? w * d + pad : 0);
+    Fl_Image::RGB_scaling(method);
+    Fl_RGB_Image *copy = (Fl_RGB_Image *)img.copy(W, H);
+    uchar *ref = scaling_reference(src, w, h, d, pad ? w * d + pad : 0, W, H, method);
+    int same = copy && copy->data_w() == W && copy->data_h() == H &&
+               memcmp(copy->array, ref, W * H * d) == 0;
+    if (!same)
+      tty->printf("\033[31m%s %dx%dx%d -> %dx%d differs\033[0m\n",
+                  method == FL_RGB_SCALING_NEAREST ? "nearest" : "bilinear", w, h, d, W, H);
+    delete copy;
+    delete[] ref;
+    delete[] src;
+    return same;
+  }
+
+  // Scaling speed in million destination pixels per second
+  double speed(const uchar *src, int w, int h, int W, int H, Fl_RGB_Scaling method, int reference) {
+    Fl_RGB_Image img(src, w, h, 3);
+    Fl_Image::RGB_scaling(method);
+    int n = 0;
+    double t0 = scaling_time(), t;
+    do {
+      if (reference) {
+        delete[] scaling_reference(src, w, h, 3, 0, W, H, method);
+      } else {
+        delete img.copy(W, H);
+      }
+      n++;
+      t = scaling_time() - t0;
+    } while (t < 0.5);
+    return (double)W * H * n / t / 1000000.0;
+  }
+
+  void run() {
+    // sizes to scale: up, down, odd ratios and short and wide targets
+    static const int sizes[][4] = {
+      { 128, 128, 256, 256 }, { 128, 128, 64, 64 }, { 37, 53, 211, 17 },
+      { 640, 480, 100, 75 }, { 300, 200, 1024, 768 }, { 100, 10, 2000, 40 },
+      { 200, 4, 2000, 40 }, { 3000, 30, 4000, 20 }, { 1, 1, 300, 300 },
+      { 1024, 768, 1, 1 }
+    };
+    Fl_RGB_Scaling saved = Fl_Image::RGB_scaling();
+    int n = 0, ok = 0;
+    tty->clear();
+    tty->printf("Comparing Fl_RGB_Image::copy() with the FLTK 1.3 code...\n");
+    for (unsigned i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+      for (int d = 1; d <= 4; d++) {
+        for (int pad = 0; pad <= 5; pad += 5) {
+          const int *s = sizes[i];
+          ok += compare(s[0], s[1], d, pad, s[2], s[3], FL_RGB_SCALING_NEAREST);
+          ok += compare(s[0], s[1], d, pad, s[2], s[3], FL_RGB_SCALING_BILINEAR);
+          n += 2;
+          Fl::check();
+        }
+      }
+    }
+    tty->printf("%d of %d scalings are the same\n\n", ok, n);
+
+    tty->printf("Scaling 1024x768 RGB to 1600x1200 and 400x300 (Mpixels/s):\n");
+    tty->printf("                      old      new\n");
+    uchar *src = scaling_source(1024, 768, 3, 0);
+    static const int targets[][2] = { { 1600, 1200 }, { 400, 300 } };
+    for (int t = 0; t < 2; t++) {
+      int W = targets[t][0], H = targets[t][1];
+      tty->printf("nearest  %4dx%-4d %8.1f %8.1f\n", W, H,
+                  speed(src, 1024, 768, W, H, FL_RGB_SCALING_NEAREST, 1),
+                  speed(src, 1024, 768, W, H, FL_RGB_SCALING_NEAREST, 0));
+      Fl::check();
+      tty->printf("bilinear %4dx%-4d %8.1f %8.1f\n", W, H,
+                  speed(src, 1024, 768, W, H, FL_RGB_SCALING_BILINEAR, 1),
+                  speed(src, 1024, 768, W, H, FL_RGB_SCALING_BILINEAR, 0));
+      Fl::check();
+      tty->printf("area     %4dx%-4d        - %8.1f\n", W, H,
+                  speed(src, 1024, 768, W, H, FL_RGB_SCALING_AREA, 0));
+      Fl::check();
+    }
+    delete[] src;
+    Fl_Image::RGB_scaling(saved);
+  }
+
+  static void run_cb(Fl_Widget *, void *data) {
+    ((ScalingTest *)data)->run();
+  }
+
+public:
+  static Fl_Widget *create() {
+    return new ScalingTest(TESTAREA_X, TESTAREA_Y, TESTAREA_W, TESTAREA_H);
+  }
+  ScalingTest(int x, int y, int w, int h) : Fl_Group(x, y, w, h) {
+    Fl_Button *b = new Fl_Button(x, y, 120, 25, "Run Tests");
+    b->callback(run_cb, this);
+    tty = new Fl_Simple_Terminal(x, y + 35, w, h - 35);
+    tty->ansi(true);
+    tty->printf("Scales images with Fl_RGB_Image::copy() in many sizes and\n"
+                "compares the results with the FLTK 1.3 code, then measures\n"
+                "the scaling speed of both.\n");
+    end();
+  }
+};
+
+UnitTest scaling("image scaling", ScalingTest::create);
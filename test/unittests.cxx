@@ -150,10 +150,12 @@ public:
 #include "unittest_text.cxx"
 #include "unittest_symbol.cxx"
 #include "unittest_images.cxx"
+#include "unittest_scaling.cxx"
 #include "unittest_viewport.cxx"
 #include "unittest_scrollbarsize.cxx"
 #include "unittest_schemes.cxx"
 #include "unittest_simple_terminal.cxx"
+#include "unittest_input_undo.cxx"
 
 // callback whenever the browser value changes
 void Browser_CB(Fl_Widget*, void*) {
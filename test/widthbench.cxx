@@ -0,0 +1,109 @@
+//
+// Text width benchmark for the Fast Light Tool Kit (FLTK).
+//
+// Copyright 1998-2021 by Bill Spitzak and others.
+//
+// This library is free software. Distribution and use rights are outlined in
+// the file "COPYING" which should have been included with this file.  If this
+// file is missing or damaged, see the license at:
+//
+//     https://www.fltk.org/COPYING.php
+//
+// Please see the following page on how to report bugs and issues:
+//
+//     https://www.fltk.org/bugs.php
+//
+
+// Measures strings of several scripts with fl_width() and fl_text_extents()
+// and shows how long each call took per character. With Xft and without
+// Pango, fl_width() sums advance widths that are cached per font, while
+// fl_text_extents() still asks Xft for the whole string, which is how
+// fl_width() used to work. The first column shows the time of the first
+// fl_width() call for each string in a font size that was not used before,
+// i.e. while the widths are added to the cache.
+
+#include <FL/Fl.H>
+#include <FL/Fl_Double_Window.H>
+#include <FL/Fl_Button.H>
+#include <FL/Fl_Simple_Terminal.H>
+#include <FL/fl_draw.H>
+#include <FL/fl_utf8.h>         // fl_utf_nb_char()
+#include <string.h>
+
+#ifndef _WIN32
+#  include <sys/time.h> // gettimeofday()
+#else
+#  include <windows.h>  // GetTickCount()
+#endif // !_WIN32
+
+static Fl_Simple_Terminal *tty = 0;
+static Fl_Fontsize size = 10;   // a new font size for each run
+
+static const struct {
+  const char *name, *text;
+} strings[] = {
+  {"ASCII",    "The quick brown fox jumps over the lazy dog. 0123456789"},
+  {"Latin",    "Größenmaßstäbe für Ærøskøbing, Señor Müller, façade, naïve"},
+  {"Greek",    "Ξεσκεπάζω την ψυχοφθόρα βδελυγμία, Τάχιστη αλώπηξ βαφής"},
+  {"CJK",      "日本語の文章を測ります。中文字符宽度测试。한국어 텍스트"},
+  {"non-BMP",  "𝐀𝐁𝐂𝐃𝐄𝐅𝐆 𝔄𝔅ℭ𝔇𝔈𝔉 😀😁😂😃😄😅 𠀀𠀁𠀂𠀃"}
+};
+
+// Elapsed time in seconds
+static double elapsed() {
+#ifndef _WIN32
+  struct timeval t;
+  gettimeofday(&t, NULL);
+  return t.tv_sec + 0.000001 * t.tv_usec;
+#else
+  return GetTickCount() * 0.001;
+#endif
+}
+
+static void run_cb(Fl_Widget *, void *) {
+  int dx, dy, w, h;
+  tty->printf("\nFont size %d, ns per character:\n", size);
+  tty->printf("          first fl_width   fl_width   fl_text_extents\n");
+  for (unsigned s = 0; s < sizeof(strings) / sizeof(strings[0]); s++) {
+    const char *text = strings[s].text;
+    int n = (int)strlen(text), chars = fl_utf_nb_char((const unsigned char *)text, n);
+    fl_font(FL_HELVETICA, size);
+    double t0 = elapsed();
+    fl_width(text, n);
+    double first = elapsed() - t0;
+    int count = 0;
+    double t;
+    t0 = elapsed();
+    do {
+      for (int i = 0; i < 1000; i++) fl_width(text, n);
+      count += 1000;
+      t = elapsed() - t0;
+    } while (t < 0.3);
+    double width = t / count;
+    count = 0;
+    t0 = elapsed();
+    do {
+      for (int i = 0; i < 1000; i++) fl_text_extents(text, n, dx, dy, w, h);
+      count += 1000;
+      t = elapsed() - t0;
+    } while (t < 0.3);
+    double extents = t / count;
+    tty->printf("%-8s %15.1f %10.1f %17.1f\n", strings[s].name,
+                1e9 * first / chars, 1e9 * width / chars, 1e9 * extents / chars);
+    Fl::check();
+  }
+  size++;
+}
+
+int main(int argc, char **argv) {
+  Fl_Double_Window win(520, 300, "Text Width Benchmark");
+  Fl_Button *run = new Fl_Button(10, 10, 80, 25, "Run");
+  run->callback(run_cb);
+  tty = new Fl_Simple_Terminal(10, 45, 500, 245);
+  tty->printf("Measures text in several scripts and compares the speed\n"
+              "of fl_width() and fl_text_extents().\n");
+  win.end();
+  win.resizable(tty);
+  win.show(argc, argv);
+  return Fl::run();
+}